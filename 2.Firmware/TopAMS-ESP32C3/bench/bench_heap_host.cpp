@@ -0,0 +1,76 @@
+// 主机端的计时和堆统计：包装 glibc 的 malloc / free，统计分配次数和占用字节数
+// 基准测试和 host/test 下的测试共用
+
+#include "report_bench.h"
+#include <atomic>
+#include <malloc.h>
+#include <stdlib.h>
+#include <time.h>
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+static std::atomic<uint32_t> alloc_count{0};
+static std::atomic<int64_t> heap_used{0};
+static std::atomic<int64_t> heap_peak{0};
+static std::atomic<int64_t> heap_base{0};
+
+static void track_alloc(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    alloc_count++;
+    int64_t used = heap_used += malloc_usable_size(ptr);
+    int64_t peak = heap_peak.load();
+    while (used > peak && !heap_peak.compare_exchange_weak(peak, used)) {
+    }
+}
+
+static void track_free(void *ptr) {
+    if (ptr) {
+        heap_used -= malloc_usable_size(ptr);
+    }
+}
+
+extern "C" void *malloc(size_t size) {
+    void *ptr = __libc_malloc(size);
+    track_alloc(ptr);
+    return ptr;
+}
+
+extern "C" void *calloc(size_t n, size_t size) {
+    void *ptr = __libc_calloc(n, size);
+    track_alloc(ptr);
+    return ptr;
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+    track_free(ptr);
+    void *result = __libc_realloc(ptr, size);
+    track_alloc(result);
+    return result;
+}
+
+extern "C" void free(void *ptr) {
+    track_free(ptr);
+    __libc_free(ptr);
+}
+
+int64_t bench_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint32_t bench_alloc_count() { return alloc_count; }
+
+size_t bench_heap_peak() { return heap_peak - heap_base; }
+
+int64_t bench_heap_used() { return heap_used - heap_base; }
+
+void bench_heap_reset_peak() {
+    heap_base = heap_used.load();
+    heap_peak = heap_base.load();
+}
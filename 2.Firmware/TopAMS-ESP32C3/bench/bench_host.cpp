@@ -0,0 +1,112 @@
+// 报告解析基准测试的主机入口，链接到 host/ 的 mock 上
+//
+// 用法: topams_bench [-n iterations] [-p max_p99_us] [-a max_allocs_per_msg] [file.jsonl ...]
+// 超出 -p / -a 阈值时返回 1，可在每次提交时运行以发现性能回退
+// 每组另输出一行 <组>_cjson，为同一批负载经 cJSON 解析的基线 (不参与阈值检查)
+
+#include "esp_log.h"
+#include "report_bench.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char *read_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return nullptr;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = (char *)malloc(size + 1);
+    text[fread(text, 1, size, f)] = '\0';
+    fclose(f);
+    return text;
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = 1000;
+    double max_p99_us = 0;
+    double max_allocs = -1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:a:")) != -1) {
+        switch (opt) {
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            case 'p':
+                max_p99_us = atof(optarg);
+                break;
+            case 'a':
+                max_allocs = atof(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n iterations] [-p max_p99_us] "
+                                "[-a max_allocs_per_msg] [file.jsonl ...]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+    // 解析器的警告日志会影响计时
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    static BenchPayload payloads[4096];
+    size_t count = 0;
+    const char *default_files[] = {"../script/sim_data/sample_reports.jsonl"};
+    const char *const *files = optind < argc ? argv + optind : default_files;
+    int file_count = optind < argc ? argc - optind : 1;
+    for (int i = 0; i < file_count; i++) {
+        const char *path = files[i];
+        char *text = read_file(path);
+        if (!text) {
+            fprintf(stderr, "Failed to read %s\n", path);
+            return 2;
+        }
+        count += load_bench_payloads(text, payloads + count, 4096 - count);
+    }
+    printf("Loaded %zu payloads, %u iterations\n", count, iterations);
+
+    struct {
+        const char *name;
+        size_t min_len;
+        size_t max_len;
+    } classes[] = {
+        {"small", 0, 256},
+        {"medium", 256, 1024},
+        {"large", 1024, SIZE_MAX},
+        {"all", 0, SIZE_MAX},
+    };
+
+    int failed = 0;
+    for (auto &c : classes) {
+        ReportBenchResult result =
+            run_report_bench(payloads, count, iterations, c.min_len, c.max_len);
+        if (result.messages == 0) {
+            continue;
+        }
+        print_bench_result(c.name, result);
+        if (max_p99_us > 0 && result.p99_ns / 1000.0 > max_p99_us) {
+            printf("FAIL %s p99 %.2f us > %.2f us\n", c.name, result.p99_ns / 1000.0, max_p99_us);
+            failed = 1;
+        }
+        if (max_allocs >= 0 && result.allocs_per_msg > max_allocs) {
+            printf("FAIL %s allocs_per_msg %.2f > %.2f\n", c.name, result.allocs_per_msg,
+                   max_allocs);
+            failed = 1;
+        }
+        if (result.errors > 0) {
+            printf("FAIL %s %" PRIu32 " payloads failed to parse\n", c.name, result.errors);
+            failed = 1;
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "%s_cjson", c.name);
+        print_bench_result(name,
+                           run_report_bench_cjson(payloads, count, iterations, c.min_len,
+                                                  c.max_len));
+    }
+    return failed;
+}
@@ -0,0 +1,119 @@
+// 打印机命令构造的微基准测试，与之前每条命令一个 std::ostringstream 的实现对比
+//
+// 用法: topams_cmd_bench [-n iterations]
+// 输出: BENCH cmd_<命令>_<实现> ns_per_op=.. bytes=.. allocs_per_op=..
+//       *_legacy 为之前的 ostringstream 实现 (不转义字符串)，*_writer 为 BambuCmd::Writer
+
+#include "bambu_command.h"
+#include "command_tracker.h"
+#include "report_bench.h"
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+// 之前的实现，sequence_id 固定为 "0"
+namespace legacy {
+static std::string SwitchAmsCmd(int target, int curr_temp, int tar_temp) {
+    std::ostringstream oss;
+    oss << R"({"print":{"command":"ams_change_filament","sequence_id":"0","target":)" << target
+        << R"(,"curr_temp":)" << curr_temp << R"(,"tar_temp":)" << tar_temp << "}}";
+    return oss.str();
+}
+
+static std::string AmsFilamentSettingCmd(int ams_id, int tray_id, const std::string &tray_info_idx,
+                                         const std::string &tray_color, int nozzle_temp_min,
+                                         int nozzle_temp_max, const std::string &tray_type) {
+    std::ostringstream oss;
+    oss << R"({"print":{"sequence_id":"0","command":"ams_filament_setting","ams_id":)" << ams_id
+        << R"(,"tray_id":)" << tray_id << R"(,"tray_info_idx":")" << tray_info_idx
+        << R"(","tray_color":")" << tray_color << R"(","nozzle_temp_min":)" << nozzle_temp_min
+        << R"(,"nozzle_temp_max":)" << nozzle_temp_max << R"(,"tray_type":")" << tray_type
+        << R"("}})";
+    return oss.str();
+}
+
+static std::string SendGcodeCmd(const std::string &gcode) {
+    std::ostringstream oss;
+    oss << R"({"print":{"sequence_id":"0","command":"gcode_line","param":")" << gcode << R"("}})";
+    return oss.str();
+}
+
+static std::string MoveAxisGcode(char axis, int distance, int speed) {
+    std::ostringstream oss;
+    oss << "M211 S\nM211 X1 Y1 Z1\nM1002 push_ref_mode\nG91 \nG1 " << axis << distance << ".0 F"
+        << speed << "\nM1002 pop_ref_mode\nM211 R\n";
+    return oss.str();
+}
+} // namespace legacy
+
+// 避免结果被优化掉
+static volatile size_t sink;
+
+template <typename Fn>
+static void run(const char *name, const char *impl, uint32_t iterations, Fn fn) {
+    size_t bytes = 0;
+    uint32_t allocs_before = bench_alloc_count();
+    int64_t start = bench_time_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        bytes = fn(i);
+        sink = bytes;
+    }
+    int64_t elapsed = bench_time_ns() - start;
+    uint32_t allocs = bench_alloc_count() - allocs_before;
+    printf("BENCH cmd_%s_%s ns_per_op=%.1f bytes=%zu allocs_per_op=%.2f\n", name, impl,
+           (double)elapsed / iterations, bytes, (double)allocs / iterations);
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = 200000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n iterations]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    // 换料时发送的命令，参数随迭代变化以免被常量折叠
+    run("switch_ams", "legacy", iterations,
+        [](uint32_t i) { return legacy::SwitchAmsCmd(i & 3, 220, 230).size(); });
+    run("switch_ams", "writer", iterations, [](uint32_t i) {
+        char buf[BAMBU_CMD_MAX_LEN];
+        BambuCmd::Writer w(buf);
+        BambuCmd::SwitchAmsCmd(w, i & 3, 220, 230, i);
+        return w.length();
+    });
+
+    run("filament_setting", "legacy", iterations, [](uint32_t i) {
+        return legacy::AmsFilamentSettingCmd(0, i & 3, "GFA00", "00AE42FF", 190, 230, "PLA")
+            .size();
+    });
+    run("filament_setting", "writer", iterations, [](uint32_t i) {
+        char buf[BAMBU_CMD_MAX_LEN];
+        BambuCmd::Writer w(buf);
+        BambuCmd::AmsFilamentSettingCmd(w, 0, i & 3, "GFA00", "00AE42FF", 190, 230, "PLA", i);
+        return w.length();
+    });
+
+    // 移动 Z 轴：先生成 G-code 再作为 gcode_line 的参数 (Writer 转义其中的换行)
+    run("move_axis", "legacy", iterations, [](uint32_t i) {
+        return legacy::SendGcodeCmd(legacy::MoveAxisGcode('Z', (int)(i & 15), 600)).size();
+    });
+    run("move_axis", "writer", iterations, [](uint32_t i) {
+        char gcode[128];
+        char buf[BAMBU_CMD_MAX_LEN];
+        BambuCmd::Writer g(gcode);
+        BambuCmd::MoveAxisGcode(g, 'Z', (int)(i & 15), 600);
+        BambuCmd::Writer w(buf);
+        BambuCmd::SendGcodeCmd(w, g.view(), i);
+        return w.length();
+    });
+    return 0;
+}
@@ -0,0 +1,89 @@
+// 上报解析基准测试的设备端入口，负载来自嵌入的 script/sim_data/sample_reports.jsonl
+
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "report_bench.h"
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_ITERATIONS 200
+#define BENCH_MAX_PAYLOADS 256
+
+static const char *TAG = "[Bench]";
+
+extern const char sample_reports_start[] asm("_binary_sample_reports_jsonl_start");
+extern const char sample_reports_end[] asm("_binary_sample_reports_jsonl_end");
+
+static std::atomic<uint32_t> alloc_count{0};
+static size_t heap_base = 0;
+
+// CONFIG_HEAP_USE_HOOKS 提供的分配钩子
+extern "C" IRAM_ATTR void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps) {
+    alloc_count++;
+}
+
+extern "C" IRAM_ATTR void esp_heap_trace_free_hook(void *ptr) {}
+
+// esp_timer 分辨率为 1 us，对单条上报足够
+int64_t bench_time_ns() { return esp_timer_get_time() * 1000; }
+
+uint32_t bench_alloc_count() { return alloc_count; }
+
+// 设备上无法重置最低水位，峰值取自启动以来的最小空闲堆，需在启动后尽早运行
+size_t bench_heap_peak() {
+    size_t total = heap_caps_get_total_size(MALLOC_CAP_DEFAULT);
+    size_t peak = total - heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+    return peak > heap_base ? peak - heap_base : 0;
+}
+
+int64_t bench_heap_used() {
+    size_t used = heap_caps_get_total_size(MALLOC_CAP_DEFAULT) -
+                  heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    return (int64_t)used - (int64_t)heap_base;
+}
+
+void bench_heap_reset_peak() {
+    heap_base = heap_caps_get_total_size(MALLOC_CAP_DEFAULT) -
+                heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+}
+
+extern "C" void app_main(void) {
+    // 嵌入的数据只读，复制一份用于原地解码
+    size_t size = sample_reports_end - sample_reports_start;
+    char *text = (char *)malloc(size + 1);
+    static BenchPayload payloads[BENCH_MAX_PAYLOADS];
+    memcpy(text, sample_reports_start, size);
+    text[size] = '\0';
+    size_t count = load_bench_payloads(text, payloads, BENCH_MAX_PAYLOADS);
+    ESP_LOGI(TAG, "Loaded %d payloads, %d iterations", (int)count, BENCH_ITERATIONS);
+
+    struct {
+        const char *name;
+        size_t min_len;
+        size_t max_len;
+    } classes[] = {
+        {"small", 0, 256},
+        {"medium", 256, 1024},
+        {"large", 1024, SIZE_MAX},
+        {"all", 0, SIZE_MAX},
+    };
+    for (auto &c : classes) {
+        ReportBenchResult result =
+            run_report_bench(payloads, count, BENCH_ITERATIONS, c.min_len, c.max_len);
+        if (result.messages > 0) {
+            print_bench_result(c.name, result);
+            char name[32];
+            snprintf(name, sizeof(name), "%s_cjson", c.name);
+            print_bench_result(name, run_report_bench_cjson(payloads, count, BENCH_ITERATIONS,
+                                                            c.min_len, c.max_len));
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    ESP_LOGI(TAG, "Done");
+}
@@ -0,0 +1,146 @@
+// FilamentManager 查找 / 增删的微基准测试，与之前 vector + std::map 的实现对比
+//
+// 用法: topams_filament_bench [-n iterations]
+// 输出: BENCH filament_<操作>_<实现> ns_per_op=.. allocs_per_op=..
+
+#include "esp_log.h"
+#include "filament_manager.h"
+#include "report_bench.h"
+#include <algorithm>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * @brief 旧实现的索引部分：vector 保存耗材，std::map 映射 id，按电机编号线性查找，
+ *        删除后整体重建 map。元数据只保存指针，不复制也不解析。
+ */
+class LegacyFilamentTable {
+public:
+    int add(int motor_id, const char *metadata) {
+        if (getByMotorId(motor_id) != nullptr) {
+            return -1;
+        }
+        while (id_to_index.find(next_id) != id_to_index.end()) {
+            next_id++;
+        }
+        int id = next_id++;
+        filaments.push_back(Filament(id, motor_id, metadata));
+        id_to_index[id] = filaments.size() - 1;
+        return id;
+    }
+
+    bool remove(int id) {
+        auto it = id_to_index.find(id);
+        if (it == id_to_index.end()) {
+            return false;
+        }
+        filaments.erase(filaments.begin() + it->second);
+        id_to_index.clear();
+        for (size_t i = 0; i < filaments.size(); i++) {
+            id_to_index[filaments[i].id] = i;
+        }
+        return true;
+    }
+
+    const Filament *getById(int id) const {
+        auto it = id_to_index.find(id);
+        return it == id_to_index.end() ? nullptr : &filaments[it->second];
+    }
+
+    const Filament *getByMotorId(int motor_id) const {
+        auto it = std::find_if(filaments.begin(), filaments.end(),
+                               [motor_id](const Filament &f) { return f.motor_id == motor_id; });
+        return it == filaments.end() ? nullptr : &(*it);
+    }
+
+private:
+    std::vector<Filament> filaments;
+    std::map<int, size_t> id_to_index;
+    int next_id = 1;
+};
+
+static const char *METADATA = "{\"type\":\"PETG\",\"color\":\"FF0000FF\"}";
+
+static uint32_t rng_state = 1;
+
+static uint32_t next_random() {
+    rng_state = rng_state * 1664525 + 1013904223;
+    return rng_state >> 8;
+}
+
+// 避免查找结果被优化掉
+static volatile intptr_t sink;
+
+template <typename Fn> static void run(const char *name, uint32_t iterations, Fn fn) {
+    uint32_t allocs_before = bench_alloc_count();
+    int64_t start = bench_time_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        fn(i);
+    }
+    int64_t elapsed = bench_time_ns() - start;
+    uint32_t allocs = bench_alloc_count() - allocs_before;
+    printf("BENCH %s ns_per_op=%.1f allocs_per_op=%.2f\n", name, (double)elapsed / iterations,
+           (double)allocs / iterations);
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = 1000000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n iterations]\n", argv[0]);
+                return 2;
+        }
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    // 两种实现装入相同的满表，FilamentManager 不调用 init()，只在内存中操作
+    static FilamentManager manager;
+    static LegacyFilamentTable legacy;
+    int ids[FILAMENT_MAX_COUNT];
+    int legacy_ids[FILAMENT_MAX_COUNT];
+    for (int motor_id = 0; motor_id < FILAMENT_MAX_COUNT; motor_id++) {
+        ids[motor_id] = manager.addFilament(motor_id, METADATA);
+        legacy_ids[motor_id] = legacy.add(motor_id, METADATA);
+    }
+
+    // 查找的参数预先生成，不计入时间
+    static uint8_t motors[4096];
+    for (auto &motor : motors) {
+        motor = next_random() % FILAMENT_MAX_COUNT;
+    }
+
+    run("filament_get_by_id_legacy", iterations, [&](uint32_t i) {
+        sink = (intptr_t)legacy.getById(legacy_ids[motors[i & 4095]]);
+    });
+    run("filament_get_by_id_slots", iterations, [&](uint32_t i) {
+        sink = (intptr_t)manager.read()->getFilamentById(ids[motors[i & 4095]]);
+    });
+    run("filament_get_by_motor_legacy", iterations,
+        [&](uint32_t i) { sink = (intptr_t)legacy.getByMotorId(motors[i & 4095]); });
+    run("filament_get_by_motor_slots", iterations, [&](uint32_t i) {
+        sink = (intptr_t)manager.read()->getFilamentByMotorId(motors[i & 4095]);
+    });
+
+    // 删除再添加同一电机的耗材；新实现同时复制并解析元数据、重建材料索引
+    uint32_t churn = iterations / 10;
+    run("filament_remove_add_legacy", churn, [&](uint32_t i) {
+        int motor_id = motors[i & 4095];
+        legacy.remove(legacy_ids[motor_id]);
+        legacy_ids[motor_id] = legacy.add(motor_id, METADATA);
+    });
+    run("filament_remove_add_slots", churn, [&](uint32_t i) {
+        int motor_id = motors[i & 4095];
+        manager.removeFilament(ids[motor_id]);
+        ids[motor_id] = manager.addFilament(motor_id, METADATA);
+    });
+    return 0;
+}
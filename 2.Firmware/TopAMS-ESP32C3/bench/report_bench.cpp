@@ -0,0 +1,205 @@
+#include "report_bench.h"
+#include "bambu_mqtt.h"
+#include "payload_ring.h"
+#include "report_parser.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+void LatencyHistogram::reset() {
+    memset(buckets_, 0, sizeof(buckets_));
+    count_ = 0;
+    max_ = 0;
+    total_ = 0;
+}
+
+// 值 < 8 直接落在前 8 个桶，之后每个 2 的幂区间 [2^k, 2^(k+1)) 均分为 8 份
+int LatencyHistogram::bucketOf(uint32_t ns) {
+    if (ns < SUB_BUCKETS) {
+        return ns;
+    }
+    int msb = 31 - __builtin_clz(ns);
+    int sub = (ns >> (msb - 3)) & (SUB_BUCKETS - 1);
+    return (msb - 2) * SUB_BUCKETS + sub;
+}
+
+uint32_t LatencyHistogram::upperBound(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    int msb = bucket / SUB_BUCKETS + 2;
+    int sub = bucket % SUB_BUCKETS;
+    uint64_t upper = ((uint64_t)(SUB_BUCKETS + sub + 1) << (msb - 3)) - 1;
+    return upper > UINT32_MAX ? UINT32_MAX : (uint32_t)upper;
+}
+
+void LatencyHistogram::add(uint32_t ns) {
+    buckets_[bucketOf(ns)]++;
+    count_++;
+    total_ += ns;
+    if (ns > max_) {
+        max_ = ns;
+    }
+}
+
+uint32_t LatencyHistogram::percentile(double p) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    uint64_t target = (uint64_t)(p * count_ + 0.5);
+    if (target == 0) {
+        target = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += buckets_[i];
+        if (seen >= target) {
+            uint32_t upper = upperBound(i);
+            return upper < max_ ? upper : max_;
+        }
+    }
+    return max_;
+}
+
+// 只处理 ASCII 转义，\uXXXX 按 UTF-8 写回；输出不会长于输入，可以原地进行
+static size_t unescape_json_string(char *str) {
+    char *out = str;
+    const char *in = str;
+    while (*in && *in != '"') {
+        if (*in != '\\') {
+            *out++ = *in++;
+            continue;
+        }
+        in++;
+        switch (*in) {
+            case 'n':
+                *out++ = '\n';
+                break;
+            case 't':
+                *out++ = '\t';
+                break;
+            case 'r':
+                *out++ = '\r';
+                break;
+            case 'b':
+                *out++ = '\b';
+                break;
+            case 'f':
+                *out++ = '\f';
+                break;
+            case 'u': {
+                unsigned cp = 0;
+                sscanf(in + 1, "%4x", &cp);
+                in += 4;
+                if (cp < 0x80) {
+                    *out++ = (char)cp;
+                } else if (cp < 0x800) {
+                    *out++ = (char)(0xC0 | (cp >> 6));
+                    *out++ = (char)(0x80 | (cp & 0x3F));
+                } else {
+                    *out++ = (char)(0xE0 | (cp >> 12));
+                    *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+                    *out++ = (char)(0x80 | (cp & 0x3F));
+                }
+                break;
+            }
+            default:
+                *out++ = *in;
+                break;
+        }
+        in++;
+    }
+    *out = '\0';
+    return out - str;
+}
+
+size_t load_bench_payloads(char *text, BenchPayload *out, size_t max) {
+    static const char PAYLOAD_KEY[] = "\"payload\":";
+    size_t count = 0;
+    char *line = text;
+    while (line && *line && count < max) {
+        char *next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        }
+        char *payload = strstr(line, PAYLOAD_KEY);
+        if (payload) {
+            payload += sizeof(PAYLOAD_KEY) - 1;
+            while (*payload == ' ') {
+                payload++;
+            }
+            if (*payload == '"') {
+                payload++;
+                out[count] = {payload, unescape_json_string(payload)};
+                count++;
+            }
+        } else if (*line == '{') {
+            out[count] = {line, strlen(line)};
+            count++;
+        }
+        line = next;
+    }
+    return count;
+}
+
+ReportBenchResult run_report_bench(const BenchPayload *payloads, size_t count,
+                                   uint32_t iterations, size_t min_len, size_t max_len) {
+    static PayloadRing<BAMBU_MQTT_RING_SIZE> ring;
+    static LatencyHistogram histogram;
+    BambuStatus status;
+    ReportParser parser(status);
+    ReportBenchResult result = {};
+
+    histogram.reset();
+    bench_heap_reset_peak();
+    uint32_t allocs_before = bench_alloc_count();
+
+    for (uint32_t iter = 0; iter < iterations; iter++) {
+        for (size_t i = 0; i < count; i++) {
+            const BenchPayload &payload = payloads[i];
+            if (payload.len < min_len || payload.len >= max_len) {
+                continue;
+            }
+            int64_t start = bench_time_ns();
+            ReportParser::Result parsed = ReportParser::Result::Pending;
+            // 与 MQTT_EVENT_DATA -> ingest 任务的路径一致：分片入队，再逐片取出解析
+            for (size_t offset = 0; offset < payload.len; offset += BAMBU_MQTT_RX_BUFFER_SIZE) {
+                size_t len = payload.len - offset;
+                if (len > BAMBU_MQTT_RX_BUFFER_SIZE) {
+                    len = BAMBU_MQTT_RX_BUFFER_SIZE;
+                }
+                ring.push(payload.data + offset, len, offset, payload.len);
+                PayloadRing<BAMBU_MQTT_RING_SIZE>::Slice slice;
+                while (ring.peek(slice)) {
+                    parsed = parser.feed(slice.data, slice.len, slice.offset, slice.total);
+                    ring.pop();
+                }
+            }
+            int64_t elapsed = bench_time_ns() - start;
+
+            histogram.add(elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed);
+            result.bytes += payload.len;
+            if (parsed != ReportParser::Result::Complete) {
+                result.errors++;
+            }
+        }
+    }
+
+    result.messages = histogram.count();
+    result.p50_ns = histogram.percentile(0.50);
+    result.p99_ns = histogram.percentile(0.99);
+    result.max_ns = histogram.max();
+    result.mean_ns = histogram.mean();
+    result.allocs_per_msg =
+        result.messages ? (double)(bench_alloc_count() - allocs_before) / result.messages : 0;
+    result.peak_heap = bench_heap_peak();
+    return result;
+}
+
+void print_bench_result(const char *name, const ReportBenchResult &result) {
+    printf("BENCH %s messages=%" PRIu32 " errors=%" PRIu32 " bytes=%llu p50_us=%.2f p99_us=%.2f "
+           "max_us=%.2f mean_us=%.2f allocs_per_msg=%.2f peak_heap=%u\n",
+           name, result.messages, result.errors, (unsigned long long)result.bytes,
+           result.p50_ns / 1000.0, result.p99_ns / 1000.0, result.max_ns / 1000.0,
+           result.mean_ns / 1000.0, result.allocs_per_msg, (unsigned)result.peak_heap);
+}
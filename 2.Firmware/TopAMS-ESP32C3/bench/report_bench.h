@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 平台相关接口，由 bench_heap_host.cpp (Linux) 和 device/main/bench_main.cpp (ESP32) 实现
+int64_t bench_time_ns();
+uint32_t bench_alloc_count(); // 累计分配次数
+size_t bench_heap_peak();     // 自 bench_heap_reset_peak() 以来堆占用的最大增长 (字节)
+int64_t bench_heap_used();    // 自 bench_heap_reset_peak() 以来堆占用的当前增长 (字节)
+void bench_heap_reset_peak();
+
+/**
+ * @brief 一条录制的上报负载
+ */
+struct BenchPayload {
+    const char *data;
+    size_t len;
+};
+
+/**
+ * @brief 延迟直方图：每个 2 的幂区间再分 8 个子区间，分位数误差约 12%，占用 1 KB
+ */
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKETS = 8;
+    static constexpr int BUCKETS = 32 * SUB_BUCKETS;
+
+    void reset();
+    void add(uint32_t ns);
+    uint32_t percentile(double p) const; // 返回区间上界 (ns)
+    uint32_t count() const { return count_; }
+    uint32_t max() const { return max_; }
+    double mean() const { return count_ ? (double)total_ / count_ : 0; }
+
+private:
+    static int bucketOf(uint32_t ns);
+    static uint32_t upperBound(int bucket);
+
+    uint32_t buckets_[BUCKETS];
+    uint32_t count_;
+    uint32_t max_;
+    uint64_t total_;
+};
+
+/**
+ * @brief 一组负载的测试结果
+ */
+struct ReportBenchResult {
+    uint32_t messages;
+    uint32_t errors;
+    uint64_t bytes;
+    uint32_t p50_ns;
+    uint32_t p99_ns;
+    uint32_t max_ns;
+    double mean_ns;
+    double allocs_per_msg;
+    size_t peak_heap;
+};
+
+/**
+ * @brief 从录制文件中提取负载 (原地修改 text)
+ *
+ * 支持 script/mqtt_test.py 保存的 JSONL ({"payload": "<转义后的 JSON>"}) 和每行一条原始负载
+ * @return 提取的负载数
+ */
+size_t load_bench_payloads(char *text, BenchPayload *out, size_t max);
+
+/**
+ * @brief 以与 BambuMQTT 相同的路径处理负载，并统计延迟与堆分配
+ *
+ * 每条负载按 BAMBU_MQTT_RX_BUFFER_SIZE 拆分为分片写入 PayloadRing，再逐片取出送入
+ * ReportParser，计时从第一个分片入队开始到解析完成为止；日志和回调不计入。
+ * 只处理长度在 [min_len, max_len) 内的负载。
+ */
+ReportBenchResult run_report_bench(const BenchPayload *payloads, size_t count,
+                                   uint32_t iterations, size_t min_len, size_t max_len);
+
+/**
+ * @brief cJSON 基线：与 run_report_bench 相同的分片路径，拼接为整条消息后 cJSON_Parse，
+ *        按名称取出主要字段合并到 BambuStatus，再释放 DOM 树 (之前 BambuMQTT 的处理方式)
+ *
+ * 由 report_bench_cjson.cpp 实现，需要链接 cJSON
+ */
+ReportBenchResult run_report_bench_cjson(const BenchPayload *payloads, size_t count,
+                                         uint32_t iterations, size_t min_len, size_t max_len);
+
+/**
+ * @brief 输出一行结果，格式固定便于脚本比较:
+ *        BENCH <name> messages=.. p50_us=.. p99_us=.. max_us=.. mean_us=.. allocs_per_msg=..
+ *        peak_heap=..
+ */
+void print_bench_result(const char *name, const ReportBenchResult &result);
@@ -0,0 +1,146 @@
+// cJSON 基线：之前 BambuMQTT 的处理方式，整条负载 cJSON_Parse 为 DOM 树后按名称取字段，
+// 用于与 ReportParser 对比延迟和堆分配
+
+#include "bambu_mqtt.h"
+#include "cJSON.h"
+#include "payload_ring.h"
+#include "report_bench.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void read_number(const cJSON *obj, const char *name, float &field, uint32_t bit,
+                        BambuStatus &status) {
+    const cJSON *item = cJSON_GetObjectItem(obj, name);
+    if (cJSON_IsNumber(item)) {
+        status.merge(field, (float)item->valuedouble, bit);
+    }
+}
+
+template <typename T>
+static void read_int(const cJSON *obj, const char *name, T &field, uint32_t bit,
+                     BambuStatus &status) {
+    const cJSON *item = cJSON_GetObjectItem(obj, name);
+    if (cJSON_IsNumber(item)) {
+        status.merge(field, (T)item->valueint, bit);
+    } else if (cJSON_IsString(item)) {
+        status.merge(field, (T)atoi(item->valuestring), bit);
+    }
+}
+
+static void read_string(const cJSON *obj, const char *name, char *field, size_t size,
+                        uint32_t bit, BambuStatus &status) {
+    const cJSON *item = cJSON_GetObjectItem(obj, name);
+    if (cJSON_IsString(item)) {
+        status.merge(field, size, item->valuestring, strlen(item->valuestring), bit);
+    }
+}
+
+// 取出与 ReportParser 相同的主要字段
+static bool apply_report(const cJSON *root, BambuStatus &status) {
+    const cJSON *print = cJSON_GetObjectItem(root, "print");
+    if (!cJSON_IsObject(print)) {
+        return false;
+    }
+    read_number(print, "nozzle_temper", status.nozzle_temper, BAMBU_FIELD_NOZZLE_TEMPER,
+                status);
+    read_number(print, "nozzle_target_temper", status.nozzle_target_temper,
+                BAMBU_FIELD_NOZZLE_TARGET, status);
+    read_number(print, "bed_temper", status.bed_temper, BAMBU_FIELD_BED_TEMPER, status);
+    read_number(print, "bed_target_temper", status.bed_target_temper, BAMBU_FIELD_BED_TARGET,
+                status);
+    read_int(print, "stg_cur", status.stg_cur, BAMBU_FIELD_STG_CUR, status);
+    read_int(print, "mc_percent", status.mc_percent, BAMBU_FIELD_PERCENT, status);
+    read_int(print, "mc_remaining_time", status.mc_remaining_time, BAMBU_FIELD_REMAINING_TIME,
+             status);
+    read_int(print, "layer_num", status.layer_num, BAMBU_FIELD_LAYER, status);
+    read_string(print, "gcode_state", status.gcode_state, sizeof(status.gcode_state),
+                BAMBU_FIELD_GCODE_STATE, status);
+    read_string(print, "wifi_signal", status.wifi_signal, sizeof(status.wifi_signal),
+                BAMBU_FIELD_WIFI_SIGNAL, status);
+
+    const cJSON *ams = cJSON_GetObjectItem(print, "ams");
+    if (!cJSON_IsObject(ams)) {
+        return true;
+    }
+    read_int(ams, "tray_now", status.tray_now, BAMBU_FIELD_TRAY_NOW, status);
+    read_int(ams, "tray_tar", status.tray_tar, BAMBU_FIELD_TRAY_TAR, status);
+    int ams_id = 0;
+    const cJSON *unit;
+    cJSON_ArrayForEach(unit, cJSON_GetObjectItem(ams, "ams")) {
+        if (ams_id >= BAMBU_MAX_AMS) {
+            break;
+        }
+        int tray_id = 0;
+        const cJSON *tray;
+        cJSON_ArrayForEach(tray, cJSON_GetObjectItem(unit, "tray")) {
+            if (tray_id >= BAMBU_TRAYS_PER_AMS) {
+                break;
+            }
+            BambuTray &t = status.ams[ams_id].trays[tray_id];
+            read_string(tray, "tray_type", t.type, sizeof(t.type), BAMBU_FIELD_AMS_TRAY, status);
+            read_string(tray, "tray_color", t.color, sizeof(t.color), BAMBU_FIELD_AMS_TRAY,
+                        status);
+            read_int(tray, "remain", t.remain, BAMBU_FIELD_AMS_TRAY, status);
+            tray_id++;
+        }
+        ams_id++;
+    }
+    return true;
+}
+
+ReportBenchResult run_report_bench_cjson(const BenchPayload *payloads, size_t count,
+                                         uint32_t iterations, size_t min_len, size_t max_len) {
+    static PayloadRing<BAMBU_MQTT_RING_SIZE> ring;
+    static LatencyHistogram histogram;
+    BambuStatus status;
+    ReportBenchResult result = {};
+
+    histogram.reset();
+    bench_heap_reset_peak();
+    uint32_t allocs_before = bench_alloc_count();
+
+    for (uint32_t iter = 0; iter < iterations; iter++) {
+        for (size_t i = 0; i < count; i++) {
+            const BenchPayload &payload = payloads[i];
+            if (payload.len < min_len || payload.len >= max_len) {
+                continue;
+            }
+            int64_t start = bench_time_ns();
+            // 分片经 PayloadRing 取出后拼接为整条消息，cJSON 只能解析完整的文本
+            char *text = (char *)malloc(payload.len);
+            for (size_t offset = 0; offset < payload.len; offset += BAMBU_MQTT_RX_BUFFER_SIZE) {
+                size_t len = payload.len - offset;
+                if (len > BAMBU_MQTT_RX_BUFFER_SIZE) {
+                    len = BAMBU_MQTT_RX_BUFFER_SIZE;
+                }
+                ring.push(payload.data + offset, len, offset, payload.len);
+                PayloadRing<BAMBU_MQTT_RING_SIZE>::Slice slice;
+                while (ring.peek(slice)) {
+                    memcpy(text + slice.offset, slice.data, slice.len);
+                    ring.pop();
+                }
+            }
+            cJSON *root = cJSON_ParseWithLength(text, payload.len);
+            bool parsed = root && apply_report(root, status);
+            cJSON_Delete(root);
+            free(text);
+            int64_t elapsed = bench_time_ns() - start;
+
+            histogram.add(elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed);
+            result.bytes += payload.len;
+            if (!parsed) {
+                result.errors++;
+            }
+        }
+    }
+
+    result.messages = histogram.count();
+    result.p50_ns = histogram.percentile(0.50);
+    result.p99_ns = histogram.percentile(0.99);
+    result.max_ns = histogram.max();
+    result.mean_ns = histogram.mean();
+    result.allocs_per_msg =
+        result.messages ? (double)(bench_alloc_count() - allocs_before) / result.messages : 0;
+    result.peak_heap = bench_heap_peak();
+    return result;
+}
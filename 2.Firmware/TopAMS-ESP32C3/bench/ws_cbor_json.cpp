@@ -0,0 +1,284 @@
+#include "ws_cbor_json.h"
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+// 转换中的 JSON 输入
+struct JsonCursor {
+    const char *p;
+    const char *end;
+
+    bool eat(char c) {
+        if (p < end && *p == c) {
+            p++;
+            return true;
+        }
+        return false;
+    }
+};
+
+int hex_digit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// 解码一个字符 (p 指向引号内)，写入 out 并返回字节数；无效转义返回 0
+size_t decode_char(const char *&p, const char *end, char out[3]) {
+    if (*p != '\\') {
+        out[0] = *p++;
+        return 1;
+    }
+    if (end - p < 2) {
+        return 0;
+    }
+    char c = p[1];
+    p += 2;
+    switch (c) {
+        case '"':
+        case '\\':
+        case '/':
+            out[0] = c;
+            return 1;
+        case 'b':
+            out[0] = '\b';
+            return 1;
+        case 'f':
+            out[0] = '\f';
+            return 1;
+        case 'n':
+            out[0] = '\n';
+            return 1;
+        case 'r':
+            out[0] = '\r';
+            return 1;
+        case 't':
+            out[0] = '\t';
+            return 1;
+        case 'u': {
+            if (end - p < 4) {
+                return 0;
+            }
+            uint32_t cp = 0;
+            for (int i = 0; i < 4; i++) {
+                int digit = hex_digit(p[i]);
+                if (digit < 0) {
+                    return 0;
+                }
+                cp = (cp << 4) | digit;
+            }
+            p += 4;
+            if (cp < 0x80) {
+                out[0] = static_cast<char>(cp);
+                return 1;
+            }
+            if (cp < 0x800) {
+                out[0] = static_cast<char>(0xC0 | (cp >> 6));
+                out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+                return 2;
+            }
+            out[0] = static_cast<char>(0xE0 | (cp >> 12));
+            out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+            return 3;
+        }
+        default:
+            return 0;
+    }
+}
+
+// 第一遍求出解码后的长度写入头部，第二遍按段复制；key 为 true 时优先写为键编号
+bool copy_string(JsonCursor &in, CborWriter &out, bool key) {
+    if (!in.eat('"')) {
+        return false;
+    }
+    const char *start = in.p;
+    const char *close = start;
+    size_t len = 0;
+    bool escaped = false;
+    char tmp[3];
+    while (close < in.end && *close != '"') {
+        if (*close != '\\') {
+            close++;
+            len++;
+            continue;
+        }
+        escaped = true;
+        size_t n = decode_char(close, in.end, tmp);
+        if (n == 0) {
+            return false;
+        }
+        len += n;
+    }
+    if (close >= in.end) {
+        return false;
+    }
+    in.p = close + 1;
+    if (!escaped) {
+        std::string_view s(start, len);
+        if (key) {
+            out.key(s);
+        } else {
+            out.str(s);
+        }
+        return true;
+    }
+    out.textHead(len);
+    for (const char *p = start; p < close;) {
+        const char *run = p;
+        while (p < close && *p != '\\') {
+            p++;
+        }
+        out.raw(run, p - run);
+        if (p < close) {
+            out.raw(tmp, decode_char(p, close, tmp));
+        }
+    }
+    return true;
+}
+
+bool copy_number(JsonCursor &in, CborWriter &out) {
+    const char *start = in.p;
+    bool integral = true;
+    while (in.p < in.end) {
+        char c = *in.p;
+        if (c == '.' || c == 'e' || c == 'E') {
+            integral = false;
+        } else if (!(c == '-' || c == '+' || (c >= '0' && c <= '9'))) {
+            break;
+        }
+        in.p++;
+    }
+    size_t len = in.p - start;
+    char text[32];
+    if (len == 0 || len >= sizeof(text)) {
+        return false;
+    }
+    memcpy(text, start, len);
+    text[len] = '\0';
+    char *parsed;
+    if (integral) {
+        out.num(strtoll(text, &parsed, 10));
+    } else {
+        out.real(strtof(text, &parsed));
+    }
+    return parsed == text + len;
+}
+
+bool copy_literal(JsonCursor &in, CborWriter &out) {
+    static constexpr std::string_view literals[] = {"true", "false", "null"};
+    for (std::string_view word : literals) {
+        if (static_cast<size_t>(in.end - in.p) >= word.size() &&
+            std::string_view(in.p, word.size()) == word) {
+            in.p += word.size();
+            if (word == "null") {
+                out.null();
+            } else {
+                out.boolean(word == "true");
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void skip_ws(JsonCursor &in) {
+    while (in.p < in.end && (*in.p == ' ' || *in.p == '\n' || *in.p == '\r' || *in.p == '\t')) {
+        in.p++;
+    }
+}
+
+// 读取一个值；遇到 '{' / '[' 时只写入容器的开始，open 返回 true
+bool copy_value(JsonCursor &in, CborWriter &out, bool &open) {
+    open = false;
+    if (in.p >= in.end) {
+        return false;
+    }
+    switch (*in.p) {
+        case '{':
+            in.p++;
+            out.beginMap();
+            open = true;
+            return true;
+        case '[':
+            in.p++;
+            out.beginArray();
+            open = true;
+            return true;
+        case '"':
+            return copy_string(in, out, false);
+        case 't':
+        case 'f':
+        case 'n':
+            return copy_literal(in, out);
+        default:
+            return copy_number(in, out);
+    }
+}
+
+} // namespace
+
+bool ws_cbor_from_json(std::string_view json, CborWriter &out) {
+    JsonCursor in{json.data(), json.data() + json.size()};
+    uint32_t arrays = 0; // 按层，该层是数组
+    int depth = 0;
+    bool opened = false; // 刚写入容器的开始
+
+    do {
+        // 容器内的下一个成员，空容器直接关闭
+        bool array = arrays & (1u << depth);
+        skip_ws(in);
+        bool empty = opened && in.eat(array ? ']' : '}');
+        if (!empty) {
+            if (depth > 0 && !array) {
+                if (!copy_string(in, out, true)) {
+                    return false;
+                }
+                skip_ws(in);
+                if (!in.eat(':')) {
+                    return false;
+                }
+                skip_ws(in);
+            }
+            bool open;
+            if (!copy_value(in, out, open)) {
+                return false;
+            }
+            opened = open;
+            if (open) {
+                if (++depth >= 32) {
+                    return false;
+                }
+                arrays = in.p[-1] == '[' ? arrays | (1u << depth) : arrays & ~(1u << depth);
+                continue;
+            }
+        } else {
+            out.end();
+            depth--;
+            opened = false;
+        }
+        // 逗号之后是下一个成员，否则依次关闭容器
+        while (depth > 0) {
+            skip_ws(in);
+            if (in.eat(',')) {
+                break;
+            }
+            if (!in.eat((arrays & (1u << depth)) ? ']' : '}')) {
+                return false;
+            }
+            out.end();
+            depth--;
+        }
+    } while (depth > 0);
+
+    skip_ws(in);
+    return in.p == in.end && out.ok();
+}
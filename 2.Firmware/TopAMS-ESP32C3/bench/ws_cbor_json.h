@@ -0,0 +1,16 @@
+#pragma once
+
+// 测试和基准测试共用的 JSON -> CBOR 转换，不链接进固件
+
+#include "ws_cbor.h"
+#include <string_view>
+
+/**
+ * @brief 把 JSON 文本流式转换为 CBOR，不使用 token 表；用于由 JSON 构造 CBOR 请求；固件中
+ * 的响应由处理函数直接编码，不经过此转换
+ *
+ * 键按 ws_schema.def 编码，不含小数点和指数的数字写为整数，其余数字写为单精度浮点数。
+ * 字符串支持 BambuCmd::Writer 产生的所有转义，\u 转义不合并代理对。
+ * @return false JSON 无效、嵌套超过 32 层或输出溢出
+ */
+bool ws_cbor_from_json(std::string_view json, CborWriter &out);
@@ -0,0 +1,204 @@
+// WebSocket 两种编码的对比：推送帧的编码耗时和长度，以及请求经 WSFramePool 的完整处理
+// (解析 -> 处理 -> 响应编码) 耗时和收发的总字节数。*_json 为文本帧，*_cbor 为
+// "topams.cbor.v1" 子协议的二进制帧，两者内容相同。
+//
+// 用法: topams_ws_bench [-n iterations]
+// 输出: BENCH ws_<内容>_<编码> ns_per_op=.. bytes=.. allocs_per_op=..
+
+#include "esp_log.h"
+#include "filament_changer.h"
+#include "report_bench.h"
+#include "ws_cbor_json.h"
+#include "ws_filament.h"
+#include "ws_frame.h"
+#include "ws_topic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define REQUEST_SIZE 512
+
+static const char *METADATA = "{\"type\":\"PETG\",\"color\":\"FF0000FF\",\"brand\":\"Bambu\"}";
+
+// 避免编码结果被优化掉
+static volatile size_t sink;
+
+static void print_result(const char *name, const char *encoding, int64_t elapsed,
+                         uint32_t iterations, size_t bytes, uint32_t allocs) {
+    printf("BENCH ws_%s_%s ns_per_op=%.1f bytes=%zu allocs_per_op=%.2f\n", name, encoding,
+           (double)elapsed / iterations, bytes, (double)allocs / iterations);
+}
+
+template <typename Enc, typename Fn>
+static void run_push(const char *name, const char *encoding, uint32_t iterations, Fn fn) {
+    static char buffer[4096];
+    size_t bytes = 0;
+    uint32_t allocs_before = bench_alloc_count();
+    int64_t start = bench_time_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        Enc w(buffer, sizeof(buffer));
+        fn(w);
+        bytes = w.length();
+        sink = bytes;
+    }
+    int64_t elapsed = bench_time_ns() - start;
+    print_result(name, encoding, elapsed, iterations, bytes, bench_alloc_count() - allocs_before);
+}
+
+template <typename Fn> static void run_push_both(const char *name, uint32_t iterations, Fn fn) {
+    run_push<WSJsonWriter>(name, "json", iterations, fn);
+    run_push<CborWriter>(name, "cbor", iterations, fn);
+}
+
+// 打印中的完整状态：2 个 AMS、8 个托盘和 2 条 HMS
+static void fill_status(BambuStatus &s) {
+    s.nozzle_temper = 219.8f;
+    s.nozzle_target_temper = 220;
+    s.bed_temper = 54.9f;
+    s.bed_target_temper = 55;
+    s.mc_print_stage = 2;
+    s.stg_cur = 0;
+    s.mc_percent = 37;
+    s.mc_remaining_time = 84;
+    s.layer_num = 112;
+    s.total_layer_num = 305;
+    s.cooling_fan_speed = 15;
+    s.big_fan1_speed = 10;
+    s.heatbreak_fan_speed = 15;
+    s.ams_status = 768;
+    s.tray_now = 1;
+    s.tray_tar = 1;
+    s.tray_pre = 0;
+    s.ams_count = 2;
+    s.hms_count = 2;
+    strcpy(s.gcode_state, "RUNNING");
+    strcpy(s.wifi_signal, "-52dBm");
+    static const char *colors[] = {"FFFFFFFF", "000000FF", "FF0000FF", "00AE42FF"};
+    for (int i = 0; i < s.ams_count; i++) {
+        s.ams[i].temp = 26.4f + i;
+        s.ams[i].humidity = 3 + i;
+        for (int j = 0; j < BAMBU_TRAYS_PER_AMS; j++) {
+            BambuTray &tray = s.ams[i].trays[j];
+            strcpy(tray.type, j % 2 ? "PETG" : "PLA");
+            strcpy(tray.color, colors[j]);
+            tray.remain = 80 - 10 * j;
+            tray.nozzle_temp_min = 190 + 10 * j;
+            tray.nozzle_temp_max = 230 + 10 * j;
+        }
+    }
+    s.hms[0] = {0x0C000100, 0x0001000A};
+    s.hms[1] = {0x07000200, 0x00020003};
+}
+
+struct RequestCase {
+    const char *name;
+    char json[REQUEST_SIZE];
+    size_t json_len;
+    char cbor[REQUEST_SIZE];
+    size_t cbor_len;
+};
+
+// 同一请求的两种编码，CBOR 由 JSON 转换得到
+static void make_request(RequestCase &c, const char *name, const char *json) {
+    c.name = name;
+    c.json_len = strlen(json);
+    memcpy(c.json, json, c.json_len);
+    CborWriter w(c.cbor, sizeof(c.cbor));
+    if (!ws_cbor_from_json(std::string_view(c.json, c.json_len), w)) {
+        fprintf(stderr, "failed to encode %s\n", name);
+        exit(1);
+    }
+    c.cbor_len = w.length();
+}
+
+static size_t response_len;
+
+static void on_send(void *ctx, int fd, const httpd_ws_frame_t *frame) {
+    response_len = frame->len;
+}
+
+static WSDispatcher dispatcher;
+
+static void run_request(WSFramePool &pool, FilamentManager &manager, const RequestCase &c,
+                        bool cbor, uint32_t iterations) {
+    // 与设备相同，握手时按子协议绑定连接的编码
+    httpd_req_t req;
+    memset(&req, 0, sizeof(req));
+    req.method = HTTP_GET;
+    req.mock_fd = cbor ? 61 : 60;
+    req.mock_protocol = cbor ? WS_PROTOCOL_CBOR : nullptr;
+    pool.open(&req);
+
+    req.method = HTTP_POST;
+    req.mock_type = cbor ? HTTPD_WS_TYPE_BINARY : HTTPD_WS_TYPE_TEXT;
+    req.mock_payload = reinterpret_cast<const uint8_t *>(cbor ? c.cbor : c.json);
+    req.mock_len = cbor ? c.cbor_len : c.json_len;
+    req.mock_send = on_send;
+
+    uint32_t allocs_before = bench_alloc_count();
+    int64_t start = bench_time_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        pool.handle(&req, WS_HANDLER(WSDispatcher::handle), &dispatcher);
+    }
+    int64_t elapsed = bench_time_ns() - start;
+    print_result(c.name, cbor ? "cbor" : "json", elapsed, iterations, req.mock_len + response_len,
+                 bench_alloc_count() - allocs_before);
+    pool.release(req.mock_fd);
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = 200000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n iterations]\n", argv[0]);
+                return 2;
+        }
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    static BambuStatus status;
+    fill_status(status);
+    static FilamentManager manager;
+    for (int motor_id = 0; motor_id < 8; motor_id++) {
+        manager.addFilament(motor_id, METADATA);
+    }
+    static WSFilamentModule filaments = {&manager, nullptr, nullptr};
+    ws_filament_register(dispatcher, filaments);
+    WSMotorState motors = {FILAMENT_PHASE_FEED, 0, 3, 12, 1};
+
+    // 推送：订阅时的完整快照、打印中典型的增量 (温度和进度)、耗材表和换料阶段
+    run_push_both("status_full", iterations, [&](auto &w) {
+        ws_write_status(w, status, 0, ~0u, (1u << (2 * BAMBU_TRAYS_PER_AMS)) - 1);
+    });
+    uint32_t delta = BAMBU_FIELD_NOZZLE_TEMPER | BAMBU_FIELD_BED_TEMPER | BAMBU_FIELD_PERCENT |
+                     BAMBU_FIELD_REMAINING_TIME | BAMBU_FIELD_LAYER;
+    run_push_both("status_delta", iterations,
+                  [&](auto &w) { ws_write_status(w, status, 0, delta, 0); });
+    run_push_both("filaments", iterations, [&](auto &w) { ws_write_filaments(w, &manager); });
+    run_push_both("motors", iterations, [&](auto &w) { ws_write_motors(w, motors); });
+
+    // 请求：解析、处理和响应编码，bytes 为请求和响应的长度之和
+    static WSFramePool pool;
+    static RequestCase requests[3];
+    int id = manager.read()->getFilamentByMotorId(2)->id;
+    char text[REQUEST_SIZE];
+    snprintf(text, sizeof(text), R"({"type":"filament","action":"list","id":%d})", id);
+    make_request(requests[0], "req_list", text);
+    snprintf(text, sizeof(text),
+             R"({"type":"filament","action":"update","id":%d,"motor_id":2,"metadata":"%s"})", id,
+             "{\\\"type\\\":\\\"PLA\\\",\\\"color\\\":\\\"00AE42FF\\\"}");
+    make_request(requests[1], "req_update", text);
+    make_request(requests[2], "req_error", R"({"type":"filament","action":"explode"})");
+    for (const RequestCase &c : requests) {
+        run_request(pool, manager, c, false, iterations);
+        run_request(pool, manager, c, true, iterations);
+    }
+    return 0;
+}
@@ -0,0 +1,273 @@
+// TopAMS 主机构建入口：连接 script/printer_sim.py 模拟的打印机，运行上报解析和命令收发
+//
+// 用法: topams_host [-h host] [-s serial] [-k password] [-t seconds] [-c commands] [-d]
+//                   [-r host:serial] [-n printers] [-m heap_kb] [-l e|w|i|d]
+// 端口固定为 BAMBU_MQTT_DEFAULT_PORT (8883)，模拟器默认监听该端口
+// -d: 先监听 UDP 2021 上的 SSDP 广播 (模拟器的 --ssdp)，连接第一台发现的打印机
+// -r: 运行一半时间后切换到另一台打印机 (setPrinter())，不重启客户端进程
+// -n: 经 PrinterSessions 同时连接 N 台打印机 (模拟器的 --printers N)，第 i 台的 IP 为
+//     host 加 i，序列号为 SIM 加 13 位的 i + 1；-m 设置模拟的空闲堆，验证会话的内存预算
+
+#include "bambu_command.h"
+#include "bambu_mqtt.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "printer_discovery.h"
+#include "printer_sessions.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char *TAG = "[Host]";
+
+static std::atomic<uint32_t> status_updates{0};
+static std::atomic<uint32_t> command_results[BAMBU_CMD_RESULT_CANCELLED + 1];
+
+static void on_status(void *ctx, const BambuStatus &status) { status_updates++; }
+
+static void wait_until(int64_t deadline_us) {
+    while (esp_timer_get_time() < deadline_us) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+}
+
+static void on_command(void *ctx, uint32_t sequence_id, BambuCommandResult result) {
+    command_results[result]++;
+}
+
+static std::atomic<uint32_t> session_updates[PRINTER_SESSION_MAX];
+static std::atomic<int64_t> session_first_us[PRINTER_SESSION_MAX];
+
+static void on_session_status(void *ctx, size_t session, const BambuStatus &status) {
+    int64_t none = 0;
+    session_first_us[session].compare_exchange_strong(none, esp_timer_get_time());
+    session_updates[session]++;
+}
+
+// 第 i 台模拟打印机的地址和序列号，与 printer_sim.py --printers 一致
+static bool sim_printer(const char *base, int i, PrinterProfile &out) {
+    struct in_addr addr;
+    if (inet_pton(AF_INET, base, &addr) != 1) {
+        return false;
+    }
+    addr.s_addr = htonl(ntohl(addr.s_addr) + i);
+    inet_ntop(AF_INET, &addr, out.host, sizeof(out.host));
+    snprintf(out.serial, sizeof(out.serial), "SIM%013d", i + 1);
+    return true;
+}
+
+// 会话 0 之外的打印机保存为档案，按位掩码交给 PrinterSessions 打开
+static int run_sessions(const char *host, const char *password, int printers, int seconds) {
+    NVSManager nvs;
+    nvs.init();
+    PrinterProfiles profiles;
+    profiles.load(nvs);
+    PrinterProfile printer = {};
+    uint32_t mask = 0;
+    for (int i = 1; i < printers; i++) {
+        if (!sim_printer(host, i, printer) ||
+            profiles.save(i - 1, "", printer.host, printer.serial, password) != ESP_OK) {
+            fprintf(stderr, "invalid printer %d at %s + %d\n", i, host, i);
+            return 1;
+        }
+        mask |= 1u << (i - 1);
+    }
+    if (!sim_printer(host, 0, printer)) {
+        fprintf(stderr, "-n requires an IPv4 host\n");
+        return 1;
+    }
+
+    BambuStatus status;
+    auto primary = std::make_shared<BambuMQTT>(printer.host, password, printer.serial, status,
+                                               nullptr);
+    PrinterSessions sessions(primary);
+    sessions.setStatusCallback(on_session_status, nullptr);
+    size_t opened = sessions.apply(profiles, mask);
+    printf("sessions: %zu/%d opened\n", opened + 1, printers);
+
+    int64_t start = esp_timer_get_time();
+    sessions.start();
+    wait_until(start + seconds * 1000000LL);
+    sessions.stop();
+
+    uint32_t total = 0;
+    for (size_t i = 0; i < PRINTER_SESSION_MAX; i++) {
+        std::shared_ptr<BambuMQTT> mqtt = sessions.get(i);
+        if (!mqtt) {
+            continue;
+        }
+        BambuMQTT::IngestStats ingest = mqtt->getIngestStats();
+        const BambuStatus &s = mqtt->getStatus();
+        // -1 表示没有收到上报
+        long long first_ms =
+            session_first_us[i] ? (long long)(session_first_us[i] - start) / 1000 : -1;
+        printf("session %zu %s/%s: updates=%" PRIu32 " first=%lld ms pushed=%" PRIu32
+               " dropped=%" PRIu32 " high_water=%" PRIu32 " gcode_state=%s tray_now=%d\n",
+               i, mqtt->getIP(), mqtt->getSerial(), session_updates[i].load(), first_ms,
+               ingest.pushed, ingest.dropped, ingest.high_water, s.gcode_state, s.tray_now);
+        total += session_updates[i];
+    }
+    printf("status updates: %" PRIu32 "\n", total);
+    return 0;
+}
+
+static esp_log_level_t parse_level(const char *arg) {
+    switch (arg[0]) {
+        case 'e':
+            return ESP_LOG_ERROR;
+        case 'w':
+            return ESP_LOG_WARN;
+        case 'd':
+            return ESP_LOG_DEBUG;
+        default:
+            return ESP_LOG_INFO;
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *host = "127.0.0.1";
+    const char *serial = "SIM0000000000001";
+    const char *password = "12345678";
+    int seconds = 10;
+    int commands = 0;
+    bool discover = false;
+    char *switch_to = nullptr;
+    int printers = 1;
+    esp_log_level_t level = ESP_LOG_WARN;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "h:s:k:t:c:dr:n:m:l:")) != -1) {
+        switch (opt) {
+            case 'h':
+                host = optarg;
+                break;
+            case 's':
+                serial = optarg;
+                break;
+            case 'k':
+                password = optarg;
+                break;
+            case 't':
+                seconds = atoi(optarg);
+                break;
+            case 'c':
+                commands = atoi(optarg);
+                break;
+            case 'd':
+                discover = true;
+                break;
+            case 'r':
+                switch_to = optarg;
+                break;
+            case 'n':
+                printers = atoi(optarg);
+                break;
+            case 'm':
+                esp_mock_set_free_heap_size(atoi(optarg) * 1024);
+                break;
+            case 'l':
+                level = parse_level(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-h host] [-s serial] [-k password] [-t seconds] "
+                                "[-c commands] [-d] [-r host:serial] [-n printers] "
+                                "[-m heap_kb] [-l e|w|i|d]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+    esp_log_level_set("*", level);
+    if (printers < 1 || printers > PRINTER_SESSION_MAX) {
+        fprintf(stderr, "-n must be 1-%d\n", PRINTER_SESSION_MAX);
+        return 2;
+    }
+    if (printers > 1) {
+        return run_sessions(host, password, printers, seconds);
+    }
+
+    PrinterDiscovery discovery;
+    PrinterDiscovery::Printer found = {};
+    if (discover) {
+        int64_t deadline = esp_timer_get_time() + seconds * 1000000LL;
+        if (!discovery.start()) {
+            return 1;
+        }
+        while (discovery.list(&found, 1) == 0 && esp_timer_get_time() < deadline) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+        discovery.stop();
+        if (found.serial[0] == '\0') {
+            fprintf(stderr, "no printer discovered in %d s\n", seconds);
+            return 1;
+        }
+        printf("discovered: %s %s (%s) at %s\n", found.model, found.name, found.serial,
+               found.host);
+        host = found.host;
+        serial = found.serial;
+    }
+
+    BambuStatus status;
+    BambuMQTT mqtt(host, password, serial, status, nullptr);
+    mqtt.setStatusCallback(on_status, nullptr);
+    mqtt.start();
+
+    int64_t start = esp_timer_get_time();
+    // 收到第一条上报说明已订阅，此时发送的命令才会有回复
+    while (status_updates == 0 && esp_timer_get_time() - start < seconds * 1000000LL) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    for (int i = 0; i < commands; i++) {
+        char buf[BAMBU_CMD_MAX_LEN];
+        BambuCmd::Writer w(buf);
+        BambuCmd::SimpleCmd(w, "pushing", "pushall");
+        // 从负载中取回 sequence_id，与 NextSequenceId() 分配的一致
+        uint32_t seq = strtoul(strstr(buf, "\"sequence_id\":\"") + 15, nullptr, 10);
+        while (!mqtt.send_command(w.view(), seq, on_command, nullptr)) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+    }
+    if (switch_to) {
+        // 切换前后的上报数分别统计，切换后状态清空并重新请求完整上报
+        wait_until(start + seconds * 500000LL);
+        char *colon = strchr(switch_to, ':');
+        if (colon) {
+            *colon = '\0';
+        }
+        uint32_t before = status_updates.exchange(0);
+        int64_t switched = esp_timer_get_time();
+        if (!mqtt.setPrinter(switch_to, password, colon ? colon + 1 : serial)) {
+            fprintf(stderr, "invalid printer: %s\n", switch_to);
+        }
+        while (status_updates == 0 && esp_timer_get_time() - start < seconds * 1000000LL) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        // -1 表示切换后没有收到上报
+        long long first_ms =
+            status_updates ? (long long)(esp_timer_get_time() - switched) / 1000 : -1;
+        printf("switched to %s/%s: updates before=%" PRIu32 " first report after %lld ms\n",
+               mqtt.getIP(), mqtt.getSerial(), before, first_ms);
+    }
+    wait_until(start + seconds * 1000000LL);
+    mqtt.stop();
+
+    BambuMQTT::IngestStats ingest = mqtt.getIngestStats();
+    printf("status updates: %" PRIu32 "\n", status_updates.load());
+    printf("ingest: pushed=%" PRIu32 " dropped=%" PRIu32 " high_water=%" PRIu32 "/%" PRIu32 "\n",
+           ingest.pushed, ingest.dropped, ingest.high_water, ingest.capacity);
+    printf("commands: success=%" PRIu32 " failed=%" PRIu32 " timeout=%" PRIu32
+           " cancelled=%" PRIu32 "\n",
+           command_results[BAMBU_CMD_RESULT_SUCCESS].load(),
+           command_results[BAMBU_CMD_RESULT_FAILED].load(),
+           command_results[BAMBU_CMD_RESULT_TIMEOUT].load(),
+           command_results[BAMBU_CMD_RESULT_CANCELLED].load());
+    printf("nozzle=%.1f/%.1f bed=%.1f/%.1f gcode_state=%s stage=%d ams=%d tray_now=%d\n",
+           status.nozzle_temper, status.nozzle_target_temper, status.bed_temper,
+           status.bed_target_temper, status.gcode_state, status.stg_cur, status.ams_count,
+           status.tray_now);
+    ESP_LOGI(TAG, "Done");
+    return 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 主机构建的 esp_http_server 子集: 只有 WebSocket 帧的收发，不监听端口
+// 请求由测试构造，httpd_req_t 的 mock_* 字段提供收到的帧和发送回调
+
+#define ESP_ERR_HTTPD_RESULT_TRUNC 0xb00c
+
+typedef void *httpd_handle_t;
+
+typedef enum {
+    HTTP_GET = 1,
+    HTTP_POST = 3,
+} httpd_method_t;
+
+typedef enum {
+    HTTPD_WS_TYPE_CONTINUE = 0x0,
+    HTTPD_WS_TYPE_TEXT = 0x1,
+    HTTPD_WS_TYPE_BINARY = 0x2,
+    HTTPD_WS_TYPE_CLOSE = 0x8,
+    HTTPD_WS_TYPE_PING = 0x9,
+    HTTPD_WS_TYPE_PONG = 0xA,
+} httpd_ws_type_t;
+
+typedef struct httpd_ws_frame {
+    bool final;
+    bool fragmented;
+    httpd_ws_type_t type;
+    uint8_t *payload;
+    size_t len;
+} httpd_ws_frame_t;
+
+typedef struct httpd_req {
+    httpd_handle_t handle;
+    int method;
+
+    // mock: 连接、握手请求的子协议、收到的帧、发送回调
+    int mock_fd;
+    const char *mock_protocol;
+    httpd_ws_type_t mock_type;
+    const uint8_t *mock_payload;
+    size_t mock_len;
+    void (*mock_send)(void *ctx, int fd, const httpd_ws_frame_t *frame);
+    void *mock_ctx;
+} httpd_req_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 与设备相同: len 为 0 时先读取帧头，max_len 为 0 时只返回长度，
+ *        负载超过 max_len 返回 ESP_ERR_INVALID_SIZE
+ */
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *frame, size_t max_len);
+esp_err_t httpd_ws_send_frame(httpd_req_t *req, httpd_ws_frame_t *frame);
+int httpd_req_to_sockfd(httpd_req_t *req);
+
+/**
+ * @brief 只支持 "Sec-WebSocket-Protocol" (mock_protocol)，其余请求头返回 ESP_ERR_NOT_FOUND
+ */
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *req, const char *field, char *val,
+                                      size_t val_size);
+
+#ifdef __cplusplus
+}
+#endif
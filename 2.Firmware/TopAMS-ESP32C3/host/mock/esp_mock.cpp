@@ -0,0 +1,203 @@
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdarg.h>
+#include <stdio.h>
+#include <thread>
+#include <time.h>
+
+static esp_log_level_t log_level = ESP_LOG_INFO;
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK:
+            return "ESP_OK";
+        case ESP_FAIL:
+            return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:
+            return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:
+            return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:
+            return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:
+            return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:
+            return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_TIMEOUT:
+            return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_CRC:
+            return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_INVALID_VERSION:
+            return "ESP_ERR_INVALID_VERSION";
+        case ESP_ERR_NVS_NOT_FOUND:
+            return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_KEY_TOO_LONG:
+            return "ESP_ERR_NVS_KEY_TOO_LONG";
+        case ESP_ERR_NVS_INVALID_LENGTH:
+            return "ESP_ERR_NVS_INVALID_LENGTH";
+        default:
+            return "UNKNOWN ERROR";
+    }
+}
+
+// 主机构建只有全局日志级别，tag 被忽略
+void esp_log_level_set(const char *tag, esp_log_level_t level) { log_level = level; }
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+    if (level > log_level) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+static std::atomic<int64_t> time_offset_us{0};
+
+int64_t esp_timer_get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 + time_offset_us.load();
+}
+
+void esp_mock_advance_time(int64_t us) { time_offset_us += us; }
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable cond;
+    bool running = false;
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out) {
+    if (args == nullptr || args->callback == nullptr || out == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out = new esp_timer{args->callback, args->arg};
+    return ESP_OK;
+}
+
+static esp_err_t timer_start(esp_timer_handle_t timer, uint64_t us, bool periodic) {
+    std::lock_guard<std::mutex> guard(timer->lock);
+    if (timer->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (timer->thread.joinable()) {
+        timer->thread.join();
+    }
+    timer->running = true;
+    timer->thread = std::thread([timer, us, periodic] {
+        std::unique_lock<std::mutex> lock(timer->lock);
+        do {
+            if (timer->cond.wait_for(lock, std::chrono::microseconds(us),
+                                     [timer] { return !timer->running; })) {
+                return;
+            }
+            lock.unlock();
+            timer->callback(timer->arg);
+            lock.lock();
+        } while (periodic && timer->running);
+        timer->running = false;
+    });
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return timer_start(timer, timeout_us, false);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    return timer_start(timer, period_us, true);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    bool was_running;
+    {
+        std::lock_guard<std::mutex> guard(timer->lock);
+        was_running = timer->running;
+        timer->running = false;
+    }
+    timer->cond.notify_all();
+    if (timer->thread.joinable()) {
+        timer->thread.join();
+    }
+    return was_running ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    esp_timer_stop(timer);
+    delete timer;
+    return ESP_OK;
+}
+
+uint32_t esp_log_timestamp(void) { return (uint32_t)(esp_timer_get_time() / 1000); }
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+// 与 ESP-IDF 相同，最多 5 个关机回调
+#define SHUTDOWN_HANDLERS_NO 5
+
+static shutdown_handler_t shutdown_handlers[SHUTDOWN_HANDLERS_NO];
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle) {
+    for (auto &handler : shutdown_handlers) {
+        if (handler == handle) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        if (handler == nullptr) {
+            handler = handle;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_unregister_shutdown_handler(shutdown_handler_t handle) {
+    for (auto &handler : shutdown_handlers) {
+        if (handler == handle) {
+            handler = nullptr;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_STATE;
+}
+
+void esp_mock_run_shutdown_handlers(void) {
+    // 与 esp_restart() 相同，后注册的先调用
+    for (int i = SHUTDOWN_HANDLERS_NO - 1; i >= 0; i--) {
+        if (shutdown_handlers[i]) {
+            shutdown_handlers[i]();
+        }
+    }
+}
+
+static uint32_t free_heap_size = UINT32_MAX;
+
+uint32_t esp_get_free_heap_size(void) { return free_heap_size; }
+
+void esp_mock_set_free_heap_size(uint32_t size) { free_heap_size = size; }
+
+void esp_restart(void) {
+    esp_mock_run_shutdown_handlers();
+    exit(0);
+}
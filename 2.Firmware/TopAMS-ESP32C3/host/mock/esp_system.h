@@ -0,0 +1,27 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*shutdown_handler_t)(void);
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle);
+esp_err_t esp_unregister_shutdown_handler(shutdown_handler_t handle);
+
+// 调用关机回调后退出进程
+void esp_restart(void);
+
+// 仅主机构建：调用已注册的关机回调但不退出，用于测试重启前的写回
+void esp_mock_run_shutdown_handlers(void);
+
+// 主机构建不统计堆，返回 esp_mock_set_free_heap_size() 设置的值，默认不限制
+uint32_t esp_get_free_heap_size(void);
+void esp_mock_set_free_heap_size(uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
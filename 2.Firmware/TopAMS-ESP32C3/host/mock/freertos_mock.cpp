@@ -0,0 +1,146 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+struct HostTask {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+};
+
+struct HostSemaphore {
+    pthread_mutex_t mutex;
+};
+
+static thread_local HostTask *current_task = nullptr;
+
+static void deadline_after(TickType_t ticks, struct timespec *ts) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ticks / 1000;
+    ts->tv_nsec += (long)(ticks % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+static void *task_entry(void *arg) {
+    HostTask *task = static_cast<HostTask *>(arg);
+    current_task = task;
+    task->fn(task->arg);
+    return nullptr;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *created) {
+    HostTask *task = new HostTask();
+    task->fn = fn;
+    task->arg = arg;
+    pthread_mutex_init(&task->lock, nullptr);
+    pthread_cond_init(&task->cond, nullptr);
+    // 句柄先于任务运行写出，与 FreeRTOS 行为一致
+    if (created) {
+        *created = task;
+    }
+    if (pthread_create(&task->thread, nullptr, task_entry, task) != 0) {
+        delete task;
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+// 只支持删除当前任务 (vTaskDelete(nullptr))，任务结构体有意不释放，
+// 其他线程可能仍持有句柄并调用 xTaskNotifyGive
+void vTaskDelete(TaskHandle_t task) {
+    if (task == nullptr || task == current_task) {
+        pthread_exit(nullptr);
+    }
+}
+
+void vTaskDelay(TickType_t ticks) { usleep((useconds_t)ticks * 1000); }
+
+TickType_t xTaskGetTickCount(void) { return (TickType_t)(esp_timer_get_time() / 1000); }
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    if (task == nullptr) {
+        return pdFAIL;
+    }
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    HostTask *task = current_task;
+    if (task == nullptr) {
+        return 0;
+    }
+    struct timespec deadline;
+    deadline_after(ticks_to_wait, &deadline);
+    pthread_mutex_lock(&task->lock);
+    while (task->notify == 0 && ticks_to_wait > 0) {
+        if (ticks_to_wait == portMAX_DELAY) {
+            pthread_cond_wait(&task->cond, &task->lock);
+        } else if (pthread_cond_timedwait(&task->cond, &task->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    uint32_t value = task->notify;
+    if (value > 0) {
+        task->notify = clear_on_exit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    HostSemaphore *sem = new HostSemaphore();
+    pthread_mutex_init(&sem->mutex, nullptr);
+    return sem;
+}
+
+// 同一任务可以重复取得，取得几次就要释放几次
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void) {
+    HostSemaphore *sem = new HostSemaphore();
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&sem->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    return sem;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    pthread_mutex_destroy(&sem->mutex);
+    delete sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait) {
+    if (ticks_to_wait == portMAX_DELAY) {
+        return pthread_mutex_lock(&sem->mutex) == 0 ? pdTRUE : pdFALSE;
+    }
+    struct timespec deadline;
+    deadline_after(ticks_to_wait, &deadline);
+    return pthread_mutex_timedlock(&sem->mutex, &deadline) == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    return pthread_mutex_unlock(&sem->mutex) == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks_to_wait) {
+    return xSemaphoreTake(sem, ticks_to_wait);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem) { return xSemaphoreGive(sem); }
@@ -0,0 +1,57 @@
+#include "esp_http_server.h"
+#include <string.h>
+#include <strings.h>
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *frame, size_t max_len) {
+    if (req == nullptr || frame == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (frame->len == 0) {
+        frame->type = req->mock_type;
+        frame->final = true;
+        frame->len = req->mock_len;
+        if (max_len == 0) {
+            frame->payload = nullptr;
+            return ESP_OK;
+        }
+    }
+    if (frame->len == 0) {
+        return ESP_OK;
+    }
+    if (frame->payload == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (frame->len > max_len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(frame->payload, req->mock_payload, frame->len);
+    return ESP_OK;
+}
+
+esp_err_t httpd_ws_send_frame(httpd_req_t *req, httpd_ws_frame_t *frame) {
+    if (req == nullptr || frame == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (req->mock_send != nullptr) {
+        req->mock_send(req->mock_ctx, req->mock_fd, frame);
+    }
+    return ESP_OK;
+}
+
+int httpd_req_to_sockfd(httpd_req_t *req) { return req ? req->mock_fd : -1; }
+
+// 与设备相同，值过长时截断并返回 ESP_ERR_HTTPD_RESULT_TRUNC
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *req, const char *field, char *val,
+                                      size_t val_size) {
+    if (req == nullptr || field == nullptr || val == nullptr || val_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (strcasecmp(field, "Sec-WebSocket-Protocol") != 0 || req->mock_protocol == nullptr) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    size_t len = strlen(req->mock_protocol);
+    size_t copied = len < val_size ? len : val_size - 1;
+    memcpy(val, req->mock_protocol, copied);
+    val[copied] = '\0';
+    return copied == len ? ESP_OK : ESP_ERR_HTTPD_RESULT_TRUNC;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// 主机构建的 lwIP 套接字接口，直接使用系统的 BSD socket
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
@@ -0,0 +1,358 @@
+#include "mqtt_client.h"
+#include "esp_log.h"
+#include <atomic>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+static const char *TAG = "[MQTTMock]";
+
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_SUBSCRIBE 0x82
+#define MQTT_SUBACK 0x90
+#define MQTT_PINGREQ 0xC0
+#define MQTT_PINGRESP 0xD0
+#define MQTT_DISCONNECT 0xE0
+
+struct esp_mqtt_client {
+    std::string host;
+    std::string port;
+    std::string username;
+    std::string password;
+    std::string client_id;
+    int keepalive;
+    int reconnect_timeout_ms;
+    int buffer_size;
+
+    esp_event_handler_t handler;
+    void *handler_args;
+
+    int sock;
+    pthread_mutex_t write_lock;
+    pthread_t thread;
+    bool thread_started;
+    std::atomic<bool> running;
+    std::atomic<uint16_t> next_packet_id;
+};
+
+static void dispatch(esp_mqtt_client_handle_t client, esp_mqtt_event_t &event) {
+    event.client = client;
+    if (client->handler) {
+        client->handler(client->handler_args, "MQTT_EVENTS", event.event_id, &event);
+    }
+}
+
+static void dispatch_simple(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t id) {
+    esp_mqtt_event_t event = {};
+    event.event_id = id;
+    dispatch(client, event);
+}
+
+static void put_u16(std::vector<uint8_t> &buf, uint16_t value) {
+    buf.push_back(value >> 8);
+    buf.push_back(value & 0xFF);
+}
+
+static void put_str(std::vector<uint8_t> &buf, const std::string &str) {
+    put_u16(buf, str.size());
+    buf.insert(buf.end(), str.begin(), str.end());
+}
+
+static bool send_packet(esp_mqtt_client_handle_t client, uint8_t type,
+                        const std::vector<uint8_t> &body) {
+    std::vector<uint8_t> packet;
+    packet.push_back(type);
+    size_t len = body.size();
+    do {
+        uint8_t byte = len % 128;
+        len /= 128;
+        packet.push_back(len > 0 ? byte | 0x80 : byte);
+    } while (len > 0);
+    packet.insert(packet.end(), body.begin(), body.end());
+
+    pthread_mutex_lock(&client->write_lock);
+    bool ok = client->sock >= 0;
+    size_t sent = 0;
+    while (ok && sent < packet.size()) {
+        ssize_t n = send(client->sock, packet.data() + sent, packet.size() - sent, MSG_NOSIGNAL);
+        ok = n > 0;
+        sent += ok ? n : 0;
+    }
+    pthread_mutex_unlock(&client->write_lock);
+    return ok;
+}
+
+static bool read_full(int sock, uint8_t *buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = recv(sock, buf + got, len - got, 0);
+        if (n <= 0) {
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
+static bool read_packet(int sock, uint8_t &type, std::vector<uint8_t> &body) {
+    if (!read_full(sock, &type, 1)) {
+        return false;
+    }
+    size_t len = 0;
+    for (int shift = 0; shift < 28; shift += 7) {
+        uint8_t byte;
+        if (!read_full(sock, &byte, 1)) {
+            return false;
+        }
+        len |= (size_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            body.resize(len);
+            return len == 0 || read_full(sock, body.data(), len);
+        }
+    }
+    return false;
+}
+
+static int open_socket(esp_mqtt_client_handle_t client) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *res = nullptr;
+    if (getaddrinfo(client->host.c_str(), client->port.c_str(), &hints, &res) != 0) {
+        return -1;
+    }
+    int sock = -1;
+    for (struct addrinfo *ai = res; ai && sock < 0; ai = ai->ai_next) {
+        sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (sock >= 0 && connect(sock, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(sock);
+            sock = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return sock;
+}
+
+static bool mqtt_connect(esp_mqtt_client_handle_t client) {
+    std::vector<uint8_t> body;
+    put_str(body, "MQTT");
+    body.push_back(4);    // 3.1.1
+    body.push_back(0xC2); // username | password | clean session
+    put_u16(body, client->keepalive);
+    put_str(body, client->client_id);
+    put_str(body, client->username);
+    put_str(body, client->password);
+    if (!send_packet(client, MQTT_CONNECT, body)) {
+        return false;
+    }
+    uint8_t type;
+    std::vector<uint8_t> ack;
+    return read_packet(client->sock, type, ack) && type == MQTT_CONNACK && ack.size() == 2 &&
+           ack[1] == 0;
+}
+
+// 与 esp-mqtt 一致：超过接收缓冲区的消息拆成多个 MQTT_EVENT_DATA，只有第一个带主题
+static void handle_publish(esp_mqtt_client_handle_t client, uint8_t type,
+                           std::vector<uint8_t> &body) {
+    if (body.size() < 2) {
+        return;
+    }
+    int qos = (type >> 1) & 0x03;
+    size_t topic_len = (body[0] << 8) | body[1];
+    size_t pos = 2 + topic_len;
+    uint16_t packet_id = 0;
+    if (qos > 0) {
+        packet_id = (body[pos] << 8) | body[pos + 1];
+        pos += 2;
+    }
+    if (pos > body.size()) {
+        return;
+    }
+    int total = body.size() - pos;
+    int offset = 0;
+    do {
+        int chunk = total - offset < client->buffer_size ? total - offset : client->buffer_size;
+        esp_mqtt_event_t event = {};
+        event.event_id = MQTT_EVENT_DATA;
+        event.topic = offset == 0 ? reinterpret_cast<char *>(body.data() + 2) : nullptr;
+        event.topic_len = offset == 0 ? topic_len : 0;
+        event.data = reinterpret_cast<char *>(body.data() + pos + offset);
+        event.data_len = chunk;
+        event.total_data_len = total;
+        event.current_data_offset = offset;
+        event.msg_id = packet_id;
+        event.qos = qos;
+        dispatch(client, event);
+        offset += chunk;
+    } while (offset < total);
+
+    if (qos == 1) {
+        std::vector<uint8_t> ack;
+        put_u16(ack, packet_id);
+        send_packet(client, MQTT_PUBACK, ack);
+    }
+}
+
+static void wait_reconnect(esp_mqtt_client_handle_t client) {
+    for (int waited = 0; client->running && waited < client->reconnect_timeout_ms; waited += 100) {
+        usleep(100 * 1000);
+    }
+}
+
+static void *client_task(void *arg) {
+    esp_mqtt_client_handle_t client = static_cast<esp_mqtt_client_handle_t>(arg);
+    while (client->running) {
+        dispatch_simple(client, MQTT_EVENT_BEFORE_CONNECT);
+        int sock = open_socket(client);
+        pthread_mutex_lock(&client->write_lock);
+        client->sock = sock;
+        pthread_mutex_unlock(&client->write_lock);
+        if (sock < 0 || !mqtt_connect(client)) {
+            ESP_LOGW(TAG, "Connect to %s:%s failed", client->host.c_str(), client->port.c_str());
+            dispatch_simple(client, MQTT_EVENT_ERROR);
+        } else {
+            dispatch_simple(client, MQTT_EVENT_CONNECTED);
+            int ping_ms = client->keepalive > 0 ? client->keepalive * 500 : -1;
+            while (client->running) {
+                struct pollfd pfd = {sock, POLLIN, 0};
+                int ready = poll(&pfd, 1, ping_ms);
+                if (ready == 0) {
+                    send_packet(client, MQTT_PINGREQ, {});
+                    continue;
+                }
+                uint8_t type;
+                std::vector<uint8_t> body;
+                if (ready < 0 || !read_packet(sock, type, body)) {
+                    break;
+                }
+                if ((type & 0xF0) == MQTT_PUBLISH) {
+                    handle_publish(client, type, body);
+                } else if (type == MQTT_SUBACK || type == MQTT_PUBACK) {
+                    esp_mqtt_event_t event = {};
+                    event.event_id = type == MQTT_SUBACK ? MQTT_EVENT_SUBSCRIBED
+                                                         : MQTT_EVENT_PUBLISHED;
+                    event.msg_id = body.size() >= 2 ? (body[0] << 8) | body[1] : 0;
+                    dispatch(client, event);
+                }
+            }
+            dispatch_simple(client, MQTT_EVENT_DISCONNECTED);
+        }
+        pthread_mutex_lock(&client->write_lock);
+        if (client->sock >= 0) {
+            close(client->sock);
+            client->sock = -1;
+        }
+        pthread_mutex_unlock(&client->write_lock);
+        wait_reconnect(client);
+    }
+    return nullptr;
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config) {
+    esp_mqtt_client *client = new esp_mqtt_client();
+    // mqtts://host:port，scheme 被忽略
+    std::string uri = config->broker.address.uri ? config->broker.address.uri : "";
+    size_t scheme = uri.find("://");
+    std::string authority = scheme == std::string::npos ? uri : uri.substr(scheme + 3);
+    size_t colon = authority.rfind(':');
+    client->host = authority.substr(0, colon);
+    client->port = colon == std::string::npos ? "1883" : authority.substr(colon + 1);
+    client->username = config->credentials.username ? config->credentials.username : "";
+    client->password = config->credentials.authentication.password
+                           ? config->credentials.authentication.password
+                           : "";
+    client->client_id = config->credentials.client_id ? config->credentials.client_id
+                                                      : "topams-host";
+    client->keepalive = config->session.keepalive ? config->session.keepalive : 120;
+    client->reconnect_timeout_ms =
+        config->network.reconnect_timeout_ms ? config->network.reconnect_timeout_ms : 10000;
+    client->buffer_size = config->buffer.size > 0 ? config->buffer.size : 1024;
+    client->handler = nullptr;
+    client->handler_args = nullptr;
+    client->sock = -1;
+    client->thread_started = false;
+    client->running = false;
+    client->next_packet_id = 1;
+    pthread_mutex_init(&client->write_lock, nullptr);
+    return client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client,
+                                         esp_mqtt_event_id_t event, esp_event_handler_t handler,
+                                         void *handler_args) {
+    client->handler = handler;
+    client->handler_args = handler_args;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client) {
+    if (client->thread_started) {
+        return ESP_FAIL;
+    }
+    client->running = true;
+    if (pthread_create(&client->thread, nullptr, client_task, client) != 0) {
+        client->running = false;
+        return ESP_FAIL;
+    }
+    client->thread_started = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client) {
+    if (!client->thread_started) {
+        return ESP_FAIL;
+    }
+    client->running = false;
+    send_packet(client, MQTT_DISCONNECT, {});
+    pthread_mutex_lock(&client->write_lock);
+    if (client->sock >= 0) {
+        shutdown(client->sock, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&client->write_lock);
+    pthread_join(client->thread, nullptr);
+    client->thread_started = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client) {
+    if (client->thread_started) {
+        esp_mqtt_client_stop(client);
+    }
+    pthread_mutex_destroy(&client->write_lock);
+    delete client;
+    return ESP_OK;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos) {
+    uint16_t packet_id = client->next_packet_id++;
+    std::vector<uint8_t> body;
+    put_u16(body, packet_id);
+    put_str(body, topic);
+    body.push_back(qos);
+    return send_packet(client, MQTT_SUBSCRIBE, body) ? packet_id : -1;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data,
+                            int len, int qos, int retain) {
+    if (len == 0 && data) {
+        len = strlen(data);
+    }
+    uint16_t packet_id = qos > 0 ? client->next_packet_id++ : 0;
+    std::vector<uint8_t> body;
+    put_str(body, topic);
+    if (qos > 0) {
+        put_u16(body, packet_id);
+    }
+    body.insert(body.end(), data, data + len);
+    uint8_t type = MQTT_PUBLISH | (qos << 1) | (retain ? 1 : 0);
+    return send_packet(client, type, body) ? packet_id : -1;
+}
@@ -0,0 +1,250 @@
+#include "nvs.h"
+#include "nvs_flash.h"
+#include <map>
+#include <mutex>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// 内存中的 NVS 分区，不区分命名空间；值按类型保存，读取时类型不符视为不存在
+struct Entry {
+    nvs_type_t type;
+    std::vector<uint8_t> data;
+};
+
+// 创建时复制键名和类型，之后的修改不影响遍历
+struct nvs_opaque_iterator_t {
+    std::vector<std::pair<std::string, nvs_type_t>> entries;
+    size_t pos;
+};
+
+static std::mutex nvs_mutex;
+static std::map<std::string, Entry> nvs_entries;
+static uint32_t nvs_writes = 0;
+static uint32_t nvs_reads = 0;
+static bool nvs_cut = false;        // nvs_mock_cut_after() 生效中
+static uint32_t nvs_cut_writes = 0; // 断电前剩余的写入次数
+static bool nvs_cut_torn = false;   // 下一次被切断的 blob 写入只保存一半
+
+// 调用时持有 nvs_mutex；返回 false 表示已断电，这次写入不生效
+static bool write_allowed() {
+    if (!nvs_cut) {
+        return true;
+    }
+    if (nvs_cut_writes == 0) {
+        return false;
+    }
+    nvs_cut_writes--;
+    return true;
+}
+
+static esp_err_t check_key(const char *key) {
+    if (key == nullptr || strlen(key) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t set_entry(const char *key, nvs_type_t type, const void *data, size_t length) {
+    esp_err_t err = check_key(key);
+    if (err != ESP_OK) {
+        return err;
+    }
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    if (!write_allowed()) {
+        if (nvs_cut_torn && type == NVS_TYPE_BLOB) {
+            Entry &entry = nvs_entries[key];
+            entry.type = type;
+            entry.data.assign((const uint8_t *)data, (const uint8_t *)data + length / 2);
+            nvs_cut_torn = false;
+        }
+        return ESP_FAIL;
+    }
+    Entry &entry = nvs_entries[key];
+    entry.type = type;
+    entry.data.assign((const uint8_t *)data, (const uint8_t *)data + length);
+    nvs_writes++;
+    return ESP_OK;
+}
+
+static esp_err_t get_int(const char *key, nvs_type_t type, size_t int_size, void *out_value) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    nvs_reads++;
+    auto it = nvs_entries.find(key);
+    if (it == nvs_entries.end() || it->second.type != type) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (out_value) {
+        memcpy(out_value, it->second.data.data(), int_size);
+    }
+    return ESP_OK;
+}
+
+// 与 nvs_get_str / nvs_get_blob 相同：out_value 为空时只返回所需长度
+static esp_err_t get_data(const char *key, nvs_type_t type, void *out_value, size_t *length) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    nvs_reads++;
+    auto it = nvs_entries.find(key);
+    if (it == nvs_entries.end() || it->second.type != type) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    size_t size = it->second.data.size();
+    if (out_value == nullptr) {
+        *length = size;
+        return ESP_OK;
+    }
+    if (*length < size) {
+        *length = size;
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out_value, it->second.data.data(), size);
+    *length = size;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_init(void) { return ESP_OK; }
+
+esp_err_t nvs_flash_erase(void) {
+    nvs_mock_reset();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    return nvs_cut && nvs_cut_writes == 0 ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    if (nvs_entries.count(key) == 0) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (!write_allowed()) {
+        return ESP_FAIL;
+    }
+    nvs_entries.erase(key);
+    nvs_writes++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    nvs_mock_reset();
+    return ESP_OK;
+}
+
+#define NVS_MOCK_INT(type, name, nvs_type)                                                         \
+    esp_err_t nvs_set_##name(nvs_handle_t handle, const char *key, type value) {                   \
+        return set_entry(key, nvs_type, &value, sizeof(type));                                     \
+    }                                                                                              \
+    esp_err_t nvs_get_##name(nvs_handle_t handle, const char *key, type *out_value) {              \
+        return get_int(key, nvs_type, sizeof(type), out_value);                                    \
+    }
+
+NVS_MOCK_INT(int8_t, i8, NVS_TYPE_I8)
+NVS_MOCK_INT(uint8_t, u8, NVS_TYPE_U8)
+NVS_MOCK_INT(int16_t, i16, NVS_TYPE_I16)
+NVS_MOCK_INT(uint16_t, u16, NVS_TYPE_U16)
+NVS_MOCK_INT(int32_t, i32, NVS_TYPE_I32)
+NVS_MOCK_INT(uint32_t, u32, NVS_TYPE_U32)
+NVS_MOCK_INT(int64_t, i64, NVS_TYPE_I64)
+NVS_MOCK_INT(uint64_t, u64, NVS_TYPE_U64)
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value) {
+    return set_entry(key, NVS_TYPE_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    return set_entry(key, NVS_TYPE_BLOB, value, length);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length) {
+    return get_data(key, NVS_TYPE_STR, out_value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+    return get_data(key, NVS_TYPE_BLOB, out_value, length);
+}
+
+esp_err_t nvs_entry_find_in_handle(nvs_handle_t handle, nvs_type_t type,
+                                   nvs_iterator_t *output_iterator) {
+    nvs_iterator_t it = new nvs_opaque_iterator_t();
+    {
+        std::lock_guard<std::mutex> lock(nvs_mutex);
+        for (const auto &entry : nvs_entries) {
+            if (type == NVS_TYPE_ANY || entry.second.type == type) {
+                it->entries.emplace_back(entry.first, entry.second.type);
+            }
+        }
+    }
+    it->pos = 0;
+    if (it->entries.empty()) {
+        delete it;
+        *output_iterator = nullptr;
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *output_iterator = it;
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_next(nvs_iterator_t *iterator) {
+    if (iterator == nullptr || *iterator == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (++(*iterator)->pos >= (*iterator)->entries.size()) {
+        delete *iterator;
+        *iterator = nullptr;
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_info(const nvs_iterator_t iterator, nvs_entry_info_t *out_info) {
+    if (iterator == nullptr || out_info == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const auto &entry = iterator->entries[iterator->pos];
+    memset(out_info, 0, sizeof(*out_info));
+    strncpy(out_info->namespace_name, "storage", sizeof(out_info->namespace_name) - 1);
+    strncpy(out_info->key, entry.first.c_str(), sizeof(out_info->key) - 1);
+    out_info->type = entry.second;
+    return ESP_OK;
+}
+
+void nvs_release_iterator(nvs_iterator_t iterator) { delete iterator; }
+
+void nvs_mock_reset(void) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    nvs_entries.clear();
+    nvs_writes = 0;
+    nvs_reads = 0;
+    nvs_cut = false;
+}
+
+void nvs_mock_cut_after(uint32_t writes, bool torn) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    nvs_cut = true;
+    nvs_cut_writes = writes;
+    nvs_cut_torn = torn;
+}
+
+void nvs_mock_restore(void) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    nvs_cut = false;
+}
+
+uint32_t nvs_mock_write_count(void) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    return nvs_writes;
+}
+
+uint32_t nvs_mock_read_count(void) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    return nvs_reads;
+}
@@ -0,0 +1,167 @@
+// 待回复命令表测试：按 sequence_id 关联回复、超时重发后以 TIMEOUT 完成、表满后完成的槽位被复用
+// (旧的 sequence_id 不再匹配)，以及回调中可以登记新命令
+//
+// 用法: command_tracker_test
+
+#include "command_tracker.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// 最近完成的命令
+struct Completion {
+    int count;
+    uint32_t sequence_id;
+    BambuCommandResult result;
+};
+
+static void on_complete(void *ctx, uint32_t sequence_id, BambuCommandResult result) {
+    Completion &completion = *static_cast<Completion *>(ctx);
+    completion.count++;
+    completion.sequence_id = sequence_id;
+    completion.result = result;
+}
+
+// 重发的负载
+struct Published {
+    int count;
+    std::string payload;
+};
+
+static int on_publish(void *ctx, const char *payload) {
+    Published &published = *static_cast<Published *>(ctx);
+    published.count++;
+    published.payload = payload;
+    return 0;
+}
+
+static void test_match() {
+    CommandTracker tracker;
+    Completion done = {};
+    check(tracker.add(10, "a", on_complete, &done, 1000, 0), "add 10");
+    check(tracker.add(11, "b", on_complete, &done, 1000, 0), "add 11");
+    check(tracker.add(12, "c", on_complete, &done, 1000, 0), "add 12");
+
+    check(tracker.complete(11, BAMBU_CMD_RESULT_FAILED), "complete 11");
+    check(done.count == 1 && done.sequence_id == 11 && done.result == BAMBU_CMD_RESULT_FAILED,
+          "callback for 11");
+    check(!tracker.complete(11, BAMBU_CMD_RESULT_SUCCESS), "duplicate reply matched");
+    check(!tracker.complete(99, BAMBU_CMD_RESULT_SUCCESS), "unknown reply matched");
+    check(done.count == 1 && tracker.pending() == 2, "unmatched replies ignored");
+
+    check(tracker.complete(12, BAMBU_CMD_RESULT_SUCCESS) && done.sequence_id == 12 &&
+              done.result == BAMBU_CMD_RESULT_SUCCESS,
+          "complete 12");
+    tracker.cancelAll();
+    check(done.count == 3 && done.sequence_id == 10 && done.result == BAMBU_CMD_RESULT_CANCELLED &&
+              tracker.pending() == 0,
+          "cancel remaining");
+}
+
+static void test_timeout() {
+    CommandTracker tracker;
+    Completion done = {};
+    Published published = {};
+    check(tracker.add(20, R"({"print":{"sequence_id":"20"}})", on_complete, &done, 100, 2),
+          "add 20");
+
+    tracker.poll(on_publish, &published);
+    check(published.count == 0 && done.count == 0, "polled before deadline");
+
+    // 每次超时重发原始负载，重试次数用尽后以 TIMEOUT 完成
+    for (int retry = 1; retry <= 2; retry++) {
+        esp_mock_advance_time(101 * 1000);
+        tracker.poll(on_publish, &published);
+        check(published.count == retry && done.count == 0, "retry");
+    }
+    check(published.payload == R"({"print":{"sequence_id":"20"}})", "retry payload");
+    esp_mock_advance_time(50 * 1000);
+    tracker.poll(on_publish, &published);
+    check(done.count == 0, "timed out before deadline");
+    esp_mock_advance_time(51 * 1000);
+    tracker.poll(on_publish, &published);
+    check(published.count == 2 && done.count == 1 && done.sequence_id == 20 &&
+              done.result == BAMBU_CMD_RESULT_TIMEOUT && tracker.pending() == 0,
+          "timeout");
+    check(!tracker.complete(20, BAMBU_CMD_RESULT_SUCCESS), "late reply matched");
+
+    // 回复在超时前到达则不再重发
+    check(tracker.add(21, "x", on_complete, &done, 100, 1), "add 21");
+    check(tracker.complete(21, BAMBU_CMD_RESULT_SUCCESS), "complete 21");
+    esp_mock_advance_time(200 * 1000);
+    tracker.poll(on_publish, &published);
+    check(published.count == 2 && done.count == 2 && done.result == BAMBU_CMD_RESULT_SUCCESS,
+          "completed command retried");
+}
+
+// 完成回调中登记下一条命令 (回调在锁外执行)
+struct Chain {
+    CommandTracker *tracker;
+    Completion done;
+    uint32_t next;
+};
+
+static void on_chain(void *ctx, uint32_t sequence_id, BambuCommandResult result) {
+    Chain &chain = *static_cast<Chain *>(ctx);
+    on_complete(&chain.done, sequence_id, result);
+    if (chain.next != 0) {
+        chain.tracker->add(chain.next, "next", on_chain, &chain, 1000, 0);
+        chain.next = 0;
+    }
+}
+
+static void test_reuse() {
+    CommandTracker tracker;
+    Completion done = {};
+    for (uint32_t i = 0; i < BAMBU_CMD_MAX_PENDING; i++) {
+        check(tracker.add(100 + i, "cmd", on_complete, &done, 1000, 0), "fill");
+    }
+    check(!tracker.add(200, "cmd", on_complete, &done, 1000, 0), "add to full table");
+    check(tracker.pending() == BAMBU_CMD_MAX_PENDING, "full pending");
+
+    // 完成的槽位给新命令使用，旧的 sequence_id 不再匹配
+    check(tracker.complete(103, BAMBU_CMD_RESULT_SUCCESS), "complete 103");
+    check(tracker.add(200, "cmd", on_complete, &done, 1000, 0), "reuse slot");
+    check(!tracker.complete(103, BAMBU_CMD_RESULT_SUCCESS), "stale sequence_id matched");
+    check(tracker.complete(200, BAMBU_CMD_RESULT_FAILED) && done.sequence_id == 200 &&
+              done.result == BAMBU_CMD_RESULT_FAILED,
+          "reused slot completes");
+
+    static char long_payload[BAMBU_CMD_MAX_LEN + 1];
+    memset(long_payload, 'x', BAMBU_CMD_MAX_LEN);
+    check(!tracker.add(201, long_payload, on_complete, &done, 1000, 0), "payload too long");
+    tracker.cancelAll();
+    check(tracker.pending() == 0, "cancel all");
+
+    Chain chain = {&tracker, {}, 301};
+    check(tracker.add(300, "first", on_chain, &chain, 1000, 0), "add 300");
+    check(tracker.complete(300, BAMBU_CMD_RESULT_SUCCESS), "complete 300");
+    check(tracker.pending() == 1 && tracker.complete(301, BAMBU_CMD_RESULT_SUCCESS) &&
+              chain.done.count == 2 && chain.done.sequence_id == 301,
+          "add from callback");
+}
+
+int main() {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    test_match();
+    test_timeout();
+    test_reuse();
+
+    if (failures) {
+        printf("FAILED: %d checks\n", failures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
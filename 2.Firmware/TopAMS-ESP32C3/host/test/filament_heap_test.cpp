@@ -0,0 +1,236 @@
+// FilamentManager 堆碎片测试：随机增删改耗材数千次，检查元数据内容、堆占用是否回到基线，
+// 以及重新加载后与内存中的表一致。修改期间另一个任务持续经 read() 查找，校验读到的每个版本
+// 都是完整的 (不会读到修改了一半的表)
+//
+// 用法: filament_heap_test [-n operations] [-s seed]
+
+#include "esp_log.h"
+#include "filament_manager.h"
+#include "nvs_flash.h"
+#include "report_bench.h"
+#include "freertos/task.h"
+#include <atomic>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// 期望的表内容，按电机编号保存，不使用堆
+struct Expected {
+    int id; // 0 表示该电机没有耗材
+    char metadata[FILAMENT_METADATA_MAX];
+};
+
+static Expected expected[FILAMENT_MAX_COUNT];
+static uint32_t rng_state;
+static int failures = 0;
+
+static uint32_t next_random() {
+    rng_state = rng_state * 1664525 + 1013904223;
+    return rng_state >> 8;
+}
+
+static void make_metadata(char *out, int motor_id) {
+    int len = 8 + next_random() % 180;
+    int pos = snprintf(out, FILAMENT_METADATA_MAX, "{\"motor\":%d,\"note\":\"", motor_id);
+    while (pos < len) {
+        out[pos++] = 'a' + next_random() % 26;
+    }
+    strcpy(out + pos, "\"}");
+}
+
+static void check(bool condition, const char *what, int motor_id) {
+    if (!condition) {
+        fprintf(stderr, "FAIL: %s (motor %d)\n", what, motor_id);
+        failures++;
+    }
+}
+
+static void verify(const FilamentManager &manager) {
+    FilamentManager::Reader table = manager.read();
+    size_t count = 0;
+    for (int motor_id = 0; motor_id < FILAMENT_MAX_COUNT; motor_id++) {
+        const Filament *filament = table->getFilamentByMotorId(motor_id);
+        if (expected[motor_id].id == 0) {
+            check(filament == nullptr, "unexpected filament", motor_id);
+            continue;
+        }
+        count++;
+        check(filament != nullptr && filament->id == expected[motor_id].id, "missing filament",
+              motor_id);
+        if (filament) {
+            check(strcmp(filament->metadata, expected[motor_id].metadata) == 0, "metadata mismatch",
+                  motor_id);
+        }
+    }
+    check(table->getCount() == count, "count mismatch", -1);
+}
+
+// 并发读者：模拟换料路径的查找，与修改在不同任务中
+struct ReaderTask {
+    const FilamentManager *manager;
+    std::atomic<bool> stop;
+    std::atomic<bool> done;
+    std::atomic<uint32_t> reads;
+    uint32_t torn;
+};
+
+static void reader_task(void *arg) {
+    ReaderTask &task = *static_cast<ReaderTask *>(arg);
+    while (!task.stop.load()) {
+        FilamentManager::Reader table = task.manager->read();
+        size_t count = 0;
+        bool consistent = true;
+        table->forEach([&](const Filament &filament) {
+            count++;
+            consistent = consistent && table->getFilamentById(filament.id) == &filament &&
+                         table->getFilamentByMotorId(filament.motor_id) == &filament &&
+                         strncmp(filament.metadata, "{\"motor\":", 9) == 0 &&
+                         strlen(filament.metadata) < FILAMENT_METADATA_MAX;
+        });
+        if (!consistent || count != table->getCount()) {
+            task.torn++;
+        }
+        task.reads++;
+    }
+    task.done.store(true);
+    vTaskDelete(nullptr);
+}
+
+static void random_operation(FilamentManager &manager, uint32_t *failed_writes) {
+    int motor_id = next_random() % FILAMENT_MAX_COUNT;
+    Expected &entry = expected[motor_id];
+    char metadata[FILAMENT_METADATA_MAX];
+    uint32_t op = next_random() % 8;
+
+    if (entry.id == 0) {
+        make_metadata(metadata, motor_id);
+        int id = manager.addFilament(motor_id, metadata);
+        if (id < 0) {
+            // 存储区满，表保持不变
+            (*failed_writes)++;
+            return;
+        }
+        entry.id = id;
+        strcpy(entry.metadata, metadata);
+    } else if (op < 3) {
+        check(manager.removeFilament(entry.id), "remove failed", motor_id);
+        entry.id = 0;
+    } else if (op < 4) {
+        // 换到一个空闲的电机
+        int target = next_random() % FILAMENT_MAX_COUNT;
+        if (expected[target].id != 0) {
+            return;
+        }
+        check(manager.updateFilament(entry.id, target), "move failed", motor_id);
+        expected[target] = entry;
+        entry.id = 0;
+    } else if (op < 7) {
+        make_metadata(metadata, motor_id);
+        if (manager.updateFilament(entry.id, -1, metadata)) {
+            strcpy(entry.metadata, metadata);
+        } else {
+            (*failed_writes)++;
+        }
+    } else {
+        // 走 cJSON 路径，验证 setMetadataValue 不泄漏
+        if (manager.setMetadataValue(entry.id, "color", "FF0000FF")) {
+            strcpy(entry.metadata, manager.read()->getFilamentById(entry.id)->metadata);
+        } else {
+            (*failed_writes)++;
+        }
+    }
+}
+
+// 把表补满到每个电机一条短元数据，使堆上的容器回到相同的形状
+static void fill_table(FilamentManager &manager) {
+    for (int motor_id = 0; motor_id < FILAMENT_MAX_COUNT; motor_id++) {
+        Expected &entry = expected[motor_id];
+        snprintf(entry.metadata, sizeof(entry.metadata), "{\"motor\":%d}", motor_id);
+        if (entry.id == 0) {
+            entry.id = manager.addFilament(motor_id, entry.metadata);
+            check(entry.id > 0, "refill add failed", motor_id);
+        } else {
+            check(manager.updateFilament(entry.id, -1, entry.metadata), "refill update failed",
+                  motor_id);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t operations = 20000;
+    rng_state = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+            case 'n':
+                operations = atoi(optarg);
+                break;
+            case 's':
+                rng_state = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n operations] [-s seed]\n", argv[0]);
+                return 2;
+        }
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    static NVSManager nvs;
+    static FilamentManager manager;
+    nvs.init();
+    manager.init(nvs);
+
+    // 预热：容器和 NVS 条目达到稳定大小后再开始统计，读者任务在统计前创建
+    fill_table(manager);
+    verify(manager);
+    static ReaderTask reader = {&manager, {false}, {false}, {0}, 0};
+    xTaskCreate(reader_task, "reader", 4096, &reader, 5, nullptr);
+    while (reader.reads == 0) {
+        vTaskDelay(1);
+    }
+    bench_heap_reset_peak();
+    uint32_t allocs_before = bench_alloc_count();
+
+    uint32_t failed_writes = 0;
+    for (uint32_t i = 0; i < operations; i++) {
+        random_operation(manager, &failed_writes);
+        if (i % 64 == 0) {
+            verify(manager);
+        }
+    }
+    verify(manager);
+    fill_table(manager);
+    verify(manager);
+
+    uint32_t allocs = bench_alloc_count() - allocs_before;
+    int64_t growth = bench_heap_used();
+    size_t peak = bench_heap_peak();
+    reader.stop.store(true);
+    while (!reader.done.load()) {
+        vTaskDelay(1);
+    }
+
+    // 重新从 NVS 加载，表应与内存中一致
+    static FilamentManager reloaded;
+    reloaded.init(nvs);
+    verify(reloaded);
+
+    printf("TEST filament_heap operations=%" PRIu32 " failed_writes=%" PRIu32
+           " allocs_per_op=%.2f heap_growth=%lld peak_heap=%zu\n",
+           operations, failed_writes, operations ? (double)allocs / operations : 0,
+           (long long)growth, peak);
+    printf("TEST filament_rcu reads=%" PRIu32 " torn=%" PRIu32 "\n", reader.reads.load(),
+           reader.torn);
+
+    check(growth == 0, "heap did not return to baseline", -1);
+    check(reader.reads > 0 && reader.torn == 0, "reader saw an inconsistent table", -1);
+    if (failures) {
+        printf("FAILED: %d checks\n", failures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
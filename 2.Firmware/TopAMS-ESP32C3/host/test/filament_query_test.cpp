@@ -0,0 +1,107 @@
+// 耗材元数据查询测试：findFilamentsByMetadata 按写入时保存的顶层键值哈希匹配，
+// findFilamentByMaterial 经材料索引按类型 (不区分大小写) 和颜色查找，两者都随增删改更新
+//
+// 用法: filament_query_test
+
+#include "esp_log.h"
+#include "filament_manager.h"
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static size_t find(const FilamentManager &manager, const char *key, const char *value,
+                   const Filament **out, size_t max) {
+    return manager.read()->findFilamentsByMetadata(key, value, out, max);
+}
+
+static void test_metadata(FilamentManager &manager) {
+    int a = manager.addFilament(3, R"({"type":"PLA","brand":"Bambu","diameter":1.75})");
+    int b = manager.addFilament(1, R"({"type":"PETG","brand":"Bambu","dry":true})");
+    int c = manager.addFilament(5, R"({"type":"PLA","brand":"Other","spool":{"brand":"Bambu"}})");
+    check(a > 0 && b > 0 && c > 0, "metadata fixture");
+
+    // 按电机编号顺序返回，max 之外的不写入
+    const Filament *found[4] = {};
+    check(find(manager, "brand", "Bambu", found, 4) == 2, "brand count");
+    check(found[0] && found[0]->id == b && found[1] && found[1]->id == a, "brand order");
+    check(find(manager, "brand", "Bambu", found, 1) == 1 && found[0]->id == b, "brand max");
+
+    // 数字和字面量按原文比较，嵌套对象中的键不参与匹配
+    check(find(manager, "diameter", "1.75", found, 4) == 1 && found[0]->id == a, "number value");
+    check(find(manager, "diameter", "1.750", found, 4) == 0, "number is not reformatted");
+    check(find(manager, "dry", "true", found, 4) == 1 && found[0]->id == b, "literal value");
+    check(find(manager, "brand", "Other", found, 4) == 1 && found[0]->id == c, "nested ignored");
+    check(find(manager, "Brand", "Bambu", found, 4) == 0, "key is case sensitive");
+    check(find(manager, "missing", "Bambu", found, 4) == 0, "missing key");
+
+    // 修改和删除后的版本
+    check(manager.updateFilament(a, -1, R"({"type":"PLA","brand":"Other"})"), "update metadata");
+    check(find(manager, "brand", "Bambu", found, 4) == 1 && found[0]->id == b, "after update");
+    check(find(manager, "brand", "Other", found, 4) == 2, "updated value");
+    check(manager.removeFilament(b), "remove");
+    check(find(manager, "brand", "Bambu", found, 4) == 0, "after remove");
+
+    manager.removeFilament(a);
+    manager.removeFilament(c);
+}
+
+static void test_material(FilamentManager &manager) {
+    int a = manager.addFilament(6, R"({"type":"petg","color":"#00AE42"})");
+    int b = manager.addFilament(2, R"({"type":"PETG","color":"00AE42FF"})");
+    int c = manager.addFilament(4, R"({"type":"PLA","color":"00AE4280"})");
+    int d = manager.addFilament(7, R"({"type":"ABS"})");
+    check(a > 0 && b > 0 && c > 0 && d > 0, "material fixture");
+
+    // 类型不区分大小写，6 位颜色补 FF；相同材料返回电机编号最小的
+    const Filament *filament = manager.read()->findFilamentByMaterial("Petg", 0x00AE42FF);
+    check(filament != nullptr && filament->id == b, "material lookup");
+    filament = manager.read()->findFilamentByMaterial("PLA", 0x00AE4280);
+    check(filament != nullptr && filament->id == c, "color with alpha");
+    check(manager.read()->findFilamentByMaterial("PLA", 0x00AE42FF) == nullptr, "alpha differs");
+    check(manager.read()->findFilamentByMaterial("ABS", 0) == nullptr, "no color not indexed");
+    check(manager.read()->findFilamentByMaterial("TPU", 0x00AE42FF) == nullptr, "unknown type");
+
+    // 删除后由另一条相同材料补上，修改颜色后按新值查找
+    check(manager.removeFilament(b), "remove material");
+    filament = manager.read()->findFilamentByMaterial("PETG", 0x00AE42FF);
+    check(filament != nullptr && filament->id == a, "duplicate after remove");
+    check(manager.updateFilament(a, -1, R"({"type":"PETG","color":"FF0000"})"), "update color");
+    check(manager.read()->findFilamentByMaterial("PETG", 0x00AE42FF) == nullptr, "old color");
+    filament = manager.read()->findFilamentByMaterial("PETG", 0xFF0000FF);
+    check(filament != nullptr && filament->id == a, "new color");
+
+    // 批量修改提交前读者看到的仍是旧索引
+    check(manager.beginBatch(), "begin batch");
+    check(manager.updateFilament(c, -1, R"({"type":"PLA","color":"FFFFFF"})"), "batch update");
+    check(manager.read()->findFilamentByMaterial("PLA", 0x00AE4280) != nullptr, "batch isolated");
+    manager.commitBatch();
+    check(manager.read()->findFilamentByMaterial("PLA", 0x00AE4280) == nullptr &&
+              manager.read()->findFilamentByMaterial("PLA", 0xFFFFFFFF) != nullptr,
+          "batch committed");
+
+    manager.removeFilament(a);
+    manager.removeFilament(c);
+    manager.removeFilament(d);
+}
+
+int main() {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    static FilamentManager manager;
+    test_metadata(manager);
+    test_material(manager);
+
+    if (failures) {
+        printf("FAILED: %d checks\n", failures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
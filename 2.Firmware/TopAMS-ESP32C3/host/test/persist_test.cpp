@@ -0,0 +1,212 @@
+// PersistService 写入合并测试：批量修改只写回一次、持续修改不超过最长延迟、
+// 批量事务提交时只写回一次而回滚后表与存储不变、批量事务执行中读者看不到、其他任务的修改
+// 等待其结束且不被回滚、重启前的关机回调写回未保存的修改
+//
+// 用法: persist_test
+
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "filament_manager.h"
+#include "nvs_flash.h"
+#include "persist_service.h"
+#include <atomic>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEBOUNCE_MS 200
+#define MAX_DELAY_MS 1000
+
+static int failures = 0;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// 等待持久化任务写回，超时返回 false
+static bool wait_flushed(PersistService &persist, uint32_t timeout_ms) {
+    int64_t deadline = esp_timer_get_time() + timeout_ms * 1000LL;
+    while (persist.pending()) {
+        if (esp_timer_get_time() > deadline) {
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    // pending() 在写回开始时已清除，flush() 等待正在进行的写回完成
+    persist.flush();
+    return true;
+}
+
+// 从 NVS 重新加载，与内存中的表比较
+static bool same_as_storage(NVSManager &nvs, const FilamentManager &manager) {
+    static FilamentManager reloaded;
+    reloaded.init(nvs);
+    FilamentManager::Reader stored_table = reloaded.read();
+    bool same = stored_table->getCount() == manager.getCount();
+    manager.forEach([&](const Filament &filament) {
+        const Filament *stored = stored_table->getFilamentById(filament.id);
+        same = same && stored != nullptr && stored->motor_id == filament.motor_id &&
+               strcmp(stored->metadata, filament.metadata) == 0;
+    });
+    return same;
+}
+
+// 在另一个任务中修改耗材，批量修改期间应等待
+struct ConcurrentEdit {
+    FilamentManager *manager;
+    int id;
+    std::atomic<bool> done;
+};
+
+static void edit_task(void *arg) {
+    ConcurrentEdit &edit = *static_cast<ConcurrentEdit *>(arg);
+    edit.manager->updateFilament(edit.id, -1, "{\"type\":\"ASA\"}");
+    edit.done.store(true);
+    vTaskDelete(nullptr);
+}
+
+int main() {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    static NVSManager nvs;
+    static PersistService persist;
+    static FilamentManager manager;
+    nvs.init();
+    manager.init(nvs, &persist);
+    persist.setWindow(DEBOUNCE_MS, MAX_DELAY_MS);
+    persist.start();
+
+    // 批量修改：添加并更新每个电机的耗材
+    uint32_t writes_before = nvs_mock_write_count();
+    int ids[FILAMENT_MAX_COUNT];
+    char metadata[64];
+    for (int motor_id = 0; motor_id < FILAMENT_MAX_COUNT; motor_id++) {
+        ids[motor_id] = manager.addFilament(motor_id);
+        snprintf(metadata, sizeof(metadata), "{\"type\":\"PLA\",\"motor\":%d}", motor_id);
+        manager.updateFilament(ids[motor_id], -1, metadata);
+    }
+    check(nvs_mock_write_count() == writes_before, "burst written before debounce window");
+    check(wait_flushed(persist, MAX_DELAY_MS * 2), "burst not flushed");
+    uint32_t burst_writes = nvs_mock_write_count() - writes_before;
+    PersistService::Stats stats = persist.stats();
+    printf("TEST persist_burst requests=%" PRIu32 " commits=%" PRIu32 " avoided=%" PRIu32
+           " nvs_writes=%" PRIu32 " bytes=%llu\n",
+           stats.requests, stats.commits, stats.commits_avoided, burst_writes,
+           (unsigned long long)stats.bytes_written);
+    check(stats.requests == 2 * FILAMENT_MAX_COUNT, "request count");
+    check(stats.commits == 1, "burst should commit once");
+    check(burst_writes == FILAMENT_MAX_COUNT, "one write per record");
+    check(stats.bytes_written > 0, "bytes written not counted");
+    check(same_as_storage(nvs, manager), "storage mismatch after burst");
+
+    // 添加后在窗口内删除，不写入记录
+    writes_before = nvs_mock_write_count();
+    manager.removeFilament(ids[0]);
+    ids[0] = manager.addFilament(0, "{\"type\":\"PETG\"}");
+    manager.removeFilament(ids[0]);
+    check(wait_flushed(persist, MAX_DELAY_MS * 2), "add/remove not flushed");
+    check(nvs_mock_write_count() - writes_before == 1, "add/remove should only erase once");
+    check(same_as_storage(nvs, manager), "storage mismatch after add/remove");
+
+    // 持续修改时静默窗口一直不满足，最长延迟到达后仍然写回
+    uint32_t commits_before = persist.stats().commits;
+    int64_t start = esp_timer_get_time();
+    int64_t first_commit_ms = -1;
+    for (int i = 0; esp_timer_get_time() - start < MAX_DELAY_MS * 1500LL; i++) {
+        snprintf(metadata, sizeof(metadata), "{\"type\":\"PLA\",\"n\":%d}", i);
+        manager.updateFilament(ids[1], -1, metadata);
+        if (first_commit_ms < 0 && persist.stats().commits > commits_before) {
+            first_commit_ms = (esp_timer_get_time() - start) / 1000;
+        }
+        vTaskDelay(pdMS_TO_TICKS(DEBOUNCE_MS / 4));
+    }
+    printf("TEST persist_max_delay first_commit_ms=%lld\n", (long long)first_commit_ms);
+    check(first_commit_ms >= 0 && first_commit_ms < MAX_DELAY_MS + DEBOUNCE_MS,
+          "continuous updates exceeded max delay");
+
+    // 批量事务：提交时整体只请求一次写回
+    check(wait_flushed(persist, MAX_DELAY_MS * 2), "max delay updates not flushed");
+    stats = persist.stats();
+    check(manager.beginBatch(), "begin batch");
+    check(!manager.beginBatch(), "nested batch should fail");
+    for (int motor_id = 1; motor_id < FILAMENT_MAX_COUNT; motor_id++) {
+        snprintf(metadata, sizeof(metadata), "{\"type\":\"PETG\",\"motor\":%d}", motor_id);
+        manager.updateFilament(ids[motor_id], -1, metadata);
+    }
+    check(!persist.pending(), "batch should not schedule before commit");
+    manager.commitBatch();
+    check(wait_flushed(persist, MAX_DELAY_MS * 2), "batch not flushed");
+    PersistService::Stats batch_stats = persist.stats();
+    check(batch_stats.requests == stats.requests + 1, "batch should request one write");
+    check(batch_stats.commits == stats.commits + 1, "batch should commit once");
+    check(same_as_storage(nvs, manager), "storage mismatch after batch");
+
+    // 批量事务回滚：内存中的表和存储都不变
+    const char *before = manager.toJson();
+    writes_before = nvs_mock_write_count();
+    check(manager.beginBatch(), "begin batch for rollback");
+    manager.removeFilament(ids[3]);
+    manager.updateFilament(ids[4], 0, "{\"type\":\"TPU\",\"color\":\"00FF00\"}");
+    int added = manager.addFilament(4, "{\"type\":\"ABS\"}");
+    check(added > 0, "add inside batch");
+    manager.rollbackBatch();
+    const char *after = manager.toJson();
+    check(strcmp(before, after) == 0, "rollback did not restore table");
+    check(manager.read()->getFilamentById(added) == nullptr,
+          "rolled back filament still present");
+    check(manager.read()->findFilamentByMaterial("TPU", 0x00FF00FF) == nullptr,
+          "material index not restored");
+    check(!persist.pending() && nvs_mock_write_count() == writes_before,
+          "rollback should not write");
+    check(same_as_storage(nvs, manager), "storage mismatch after rollback");
+    free((void *)before);
+    free((void *)after);
+
+    // 批量事务执行中读者只看到旧表，其他任务的修改等到回滚之后，回滚不影响它
+    check(manager.beginBatch(), "begin batch for isolation");
+    manager.updateFilament(ids[5], -1, "{\"type\":\"PC\"}");
+    manager.removeFilament(ids[7]);
+    check(strcmp(manager.read()->getFilamentById(ids[5])->metadata, "{\"type\":\"PC\"}") != 0,
+          "reader saw uncommitted batch update");
+    check(manager.read()->getFilamentById(ids[7]) != nullptr, "reader saw uncommitted remove");
+    static ConcurrentEdit edit = {&manager, ids[6], {false}};
+    xTaskCreate(edit_task, "edit", 4096, &edit, 5, nullptr);
+    vTaskDelay(pdMS_TO_TICKS(50));
+    check(!edit.done.load(), "concurrent edit ran inside batch");
+    manager.rollbackBatch();
+    while (!edit.done.load()) {
+        vTaskDelay(1);
+    }
+    check(strcmp(manager.read()->getFilamentById(ids[6])->metadata, "{\"type\":\"ASA\"}") == 0,
+          "concurrent edit lost by rollback");
+    check(manager.read()->getFilamentById(ids[7]) != nullptr, "rolled back remove applied");
+    check(wait_flushed(persist, MAX_DELAY_MS * 2), "concurrent edit not flushed");
+    check(same_as_storage(nvs, manager), "storage mismatch after concurrent edit");
+
+    // 重启前的关机回调写回窗口内的修改
+    manager.updateFilament(ids[2], -1, "{\"type\":\"ABS\"}");
+    check(persist.pending(), "update should be pending");
+    esp_mock_run_shutdown_handlers();
+    check(!persist.pending(), "shutdown handler did not flush");
+    check(same_as_storage(nvs, manager), "storage mismatch after shutdown flush");
+
+    persist.stop();
+    stats = persist.stats();
+    printf("TEST persist requests=%" PRIu32 " commits=%" PRIu32 " avoided=%" PRIu32
+           " failures=%" PRIu32 " bytes=%llu\n",
+           stats.requests, stats.commits, stats.commits_avoided, stats.failures,
+           (unsigned long long)stats.bytes_written);
+    check(stats.failures == 0, "flush failures");
+
+    if (failures) {
+        printf("FAILED: %d checks\n", failures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
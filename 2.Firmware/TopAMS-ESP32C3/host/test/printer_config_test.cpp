@@ -0,0 +1,277 @@
+// 打印机配置测试：PrinterProfiles 的保存 / 删除 / 重新加载和断电、SSDP NOTIFY 的解析、
+// 发现缓存的更新 / 过期 / 替换、经 UDP 收到模拟器格式的广播、BambuMQTT::setPrinter()
+// 的参数校验和重新连接、未配置时启动不连接
+//
+// 用法: printer_config_test
+
+#include "bambu_mqtt.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "printer_discovery.h"
+#include "printer_profiles.h"
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// script/printer_sim.py --ssdp 发送的格式，与 A1 实际广播的头部相同
+static const char NOTIFY[] = "NOTIFY * HTTP/1.1\r\n"
+                             "HOST: 239.255.255.250:2021\r\n"
+                             "Server: Buildroot/2018.02-rc3 UPnP/1.0 ssdpd/1.8\r\n"
+                             "Location: 192.168.1.50\r\n"
+                             "NT: urn:bambulab-com:device:3dprinter:1\r\n"
+                             "USN: 03919D530105226\r\n"
+                             "Cache-Control: max-age=1800\r\n"
+                             "DevModel.bambu.com: N2S\r\n"
+                             "DevName.bambu.com: Farm A1 #1\r\n"
+                             "DevSignal.bambu.com: -44\r\n"
+                             "DevConnect.bambu.com: lan\r\n"
+                             "DevBind.bambu.com: free\r\n"
+                             "\r\n";
+
+static int failures = 0;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static int64_t now_ms() { return esp_timer_get_time() / 1000; }
+
+static void notify(char *buf, size_t size, const char *host, const char *serial) {
+    snprintf(buf, size,
+             "NOTIFY * HTTP/1.1\r\nLocation: %s\r\nNT: urn:bambulab-com:device:3dprinter:1\r\n"
+             "USN: %s\r\nDevModel.bambu.com: N2S\r\n\r\n",
+             host, serial);
+}
+
+static int found_count = 0;
+
+static void on_found(void *ctx, const PrinterDiscovery::Printer &printer) { found_count++; }
+
+static void test_parse() {
+    PrinterDiscovery::Printer printer;
+    check(PrinterDiscovery::parse(NOTIFY, strlen(NOTIFY), printer), "parse NOTIFY");
+    check(strcmp(printer.host, "192.168.1.50") == 0, "host");
+    check(strcmp(printer.serial, "03919D530105226") == 0, "serial");
+    check(strcmp(printer.model, "N2S") == 0 && strcmp(printer.name, "Farm A1 #1") == 0,
+          "model / name");
+    check(printer.lan_only, "lan_only");
+
+    // M-SEARCH 的回复：ST 代替 NT，头部名称不区分大小写，只有 \n 换行
+    const char reply[] = "HTTP/1.1 200 OK\nst: urn:bambulab-com:device:3dprinter:1\n"
+                         "usn: 01S00A000000001\nlocation: 10.0.0.9\n"
+                         "devconnect.bambu.com: cloud\n";
+    check(PrinterDiscovery::parse(reply, strlen(reply), printer), "parse M-SEARCH reply");
+    check(strcmp(printer.serial, "01S00A000000001") == 0 && strcmp(printer.host, "10.0.0.9") == 0,
+          "reply fields");
+    check(!printer.lan_only, "cloud printer");
+
+    // 其他 SSDP 设备、缺少序列号、不是 SSDP
+    const char router[] = "NOTIFY * HTTP/1.1\r\nNT: upnp:rootdevice\r\nUSN: uuid:1234\r\n\r\n";
+    check(!PrinterDiscovery::parse(router, strlen(router), printer), "other device accepted");
+    const char no_usn[] = "NOTIFY * HTTP/1.1\r\nNT: urn:bambulab-com:device:3dprinter:1\r\n\r\n";
+    check(!PrinterDiscovery::parse(no_usn, strlen(no_usn), printer), "missing USN accepted");
+    check(!PrinterDiscovery::parse("GET / HTTP/1.1\r\n", 16, printer), "HTTP request accepted");
+
+    // 超长的值截断，不越界
+    char long_name[512];
+    snprintf(long_name, sizeof(long_name),
+             "NOTIFY * HTTP/1.1\r\nNT: urn:bambulab-com:device:3dprinter:1\r\nUSN: %s\r\n"
+             "DevName.bambu.com: %s\r\n",
+             "0123456789012345678901234567890123456789", "A very long printer name that does "
+                                                         "not fit in the cache entry");
+    check(PrinterDiscovery::parse(long_name, strlen(long_name), printer), "parse long values");
+    check(strlen(printer.serial) == sizeof(printer.serial) - 1 &&
+              strlen(printer.name) == sizeof(printer.name) - 1,
+          "long values truncated");
+}
+
+static void test_cache() {
+    PrinterDiscovery discovery;
+    discovery.setCallback(on_found, nullptr);
+    found_count = 0;
+    char packet[256];
+    int64_t now = now_ms();
+
+    notify(packet, sizeof(packet), "192.168.1.50", "SERIAL1");
+    check(discovery.handlePacket(packet, strlen(packet), "192.168.1.50", now - 3000), "new");
+    check(discovery.handlePacket(packet, strlen(packet), "192.168.1.50", now - 2000), "repeat");
+    check(found_count == 1, "callback only for a new printer");
+    notify(packet, sizeof(packet), "192.168.1.77", "SERIAL1");
+    discovery.handlePacket(packet, strlen(packet), "192.168.1.77", now - 1000);
+    check(found_count == 2, "callback when the IP changes");
+    notify(packet, sizeof(packet), "192.168.1.51", "SERIAL2");
+    discovery.handlePacket(packet, strlen(packet), "192.168.1.51", now);
+    // 没有 Location 时使用发送方地址
+    const char no_location[] = "NOTIFY * HTTP/1.1\r\nNT: urn:bambulab-com:device:3dprinter:1\r\n"
+                               "USN: SERIAL3\r\n\r\n";
+    discovery.handlePacket(no_location, strlen(no_location), "192.168.1.52",
+                           now - PRINTER_DISCOVERY_TTL_MS - 1000);
+    check(!discovery.handlePacket("junk", 4, "192.168.1.53", now), "junk accepted");
+
+    PrinterDiscovery::Printer list[PRINTER_DISCOVERY_MAX];
+    size_t n = discovery.list(list, PRINTER_DISCOVERY_MAX);
+    check(n == 2, "expired printer listed");
+    check(n == 2 && strcmp(list[0].serial, "SERIAL2") == 0 &&
+              strcmp(list[1].serial, "SERIAL1") == 0 && strcmp(list[1].host, "192.168.1.77") == 0,
+          "list order / updated host");
+    check(discovery.list(list, 1) == 1 && strcmp(list[0].serial, "SERIAL2") == 0, "list max");
+
+    // 缓存已满时替换最久未见的
+    for (int i = 0; i < PRINTER_DISCOVERY_MAX; i++) {
+        char serial[16];
+        snprintf(serial, sizeof(serial), "FILL%d", i);
+        notify(packet, sizeof(packet), "10.0.0.1", serial);
+        discovery.handlePacket(packet, strlen(packet), "10.0.0.1", now);
+    }
+    n = discovery.list(list, PRINTER_DISCOVERY_MAX);
+    bool has_fill = false;
+    for (size_t i = 0; i < n; i++) {
+        has_fill |= strcmp(list[i].serial, "FILL7") == 0;
+    }
+    check(n == PRINTER_DISCOVERY_MAX && has_fill, "full cache should evict the oldest");
+}
+
+// 经 UDP 收到广播，端口避开 2021 以免与本机的模拟器冲突
+static void test_listen() {
+    uint16_t port = 42021;
+    PrinterDiscovery discovery(port);
+    if (!discovery.start()) {
+        check(false, "listen");
+        return;
+    }
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    PrinterDiscovery::Printer printer = {};
+    int64_t start = now_ms();
+    while (discovery.list(&printer, 1) == 0 && now_ms() - start < 2000) {
+        sendto(sock, NOTIFY, strlen(NOTIFY), 0, (struct sockaddr *)&addr, sizeof(addr));
+        usleep(20 * 1000);
+    }
+    int64_t latency = now_ms() - start;
+    close(sock);
+    discovery.stop();
+    printf("TEST printer_discovery_udp latency_ms=%lld\n", (long long)latency);
+    check(strcmp(printer.serial, "03919D530105226") == 0, "NOTIFY not received over UDP");
+}
+
+static void test_profiles() {
+    nvs_mock_reset();
+    NVSManager nvs;
+    nvs.init();
+    PrinterProfiles profiles;
+    check(profiles.save(0, "A1", "10.0.0.5", "SERIAL1", "12345678") == ESP_ERR_INVALID_STATE,
+          "save before load");
+    check(profiles.load(nvs) == ESP_OK, "load empty");
+    check(profiles.save(0, "Farm A1 #1", "10.0.0.5", "SERIAL1", "12345678") == ESP_OK, "save 0");
+    check(profiles.save(2, "", "printer.lan", "SERIAL2", "87654321") == ESP_OK, "save 2");
+    check(profiles.save(PRINTER_PROFILE_MAX, "", "h", "s", "") == ESP_ERR_INVALID_ARG,
+          "slot out of range");
+    check(profiles.save(1, "", "", "SERIAL3", "") == ESP_ERR_INVALID_SIZE, "empty host");
+    check(profiles.save(1, "", "h", "SERIAL3", "access-code-too-long") == ESP_ERR_INVALID_SIZE,
+          "access code too long");
+    uint32_t writes = nvs_mock_write_count();
+    check(profiles.save(0, "Farm A1 #1", "10.0.0.5", "SERIAL1", "12345678") == ESP_OK &&
+              nvs_mock_write_count() == writes,
+          "unchanged profile written");
+    check(profiles.find("SERIAL2") == 2 && profiles.find("SERIAL9") == -1, "find");
+
+    PrinterProfiles reloaded;
+    reloaded.load(nvs);
+    PrinterProfile profile;
+    check(reloaded.get(0, profile) && strcmp(profile.name, "Farm A1 #1") == 0 &&
+              strcmp(profile.access_code, "12345678") == 0,
+          "reloaded profile 0");
+    check(!reloaded.get(1, profile), "empty slot");
+    check(reloaded.get(2, profile) && strcmp(profile.host, "printer.lan") == 0,
+          "reloaded profile 2");
+
+    // 修改时断电 (只写入一半)：重新加载后为修改前的内容
+    nvs_mock_cut_after(0, true);
+    check(reloaded.save(0, "Renamed", "10.0.0.6", "SERIAL1", "12345678") != ESP_OK,
+          "save after power cut");
+    nvs_mock_restore();
+    PrinterProfiles after_cut;
+    after_cut.load(nvs);
+    check(after_cut.get(0, profile) && strcmp(profile.host, "10.0.0.5") == 0,
+          "torn save should keep the old profile");
+    check(after_cut.save(0, "Renamed", "10.0.0.6", "SERIAL1", "12345678") == ESP_OK,
+          "save after torn write");
+
+    // 删除时在第一个槽位删除后断电：仍是删除前的内容；完整删除后不再出现
+    check(after_cut.save(0, "Renamed", "10.0.0.7", "SERIAL1", "12345678") == ESP_OK,
+          "second save (both slots used)");
+    nvs_mock_cut_after(1, false);
+    check(after_cut.remove(0) != ESP_OK, "remove after power cut");
+    nvs_mock_restore();
+    PrinterProfiles after_remove;
+    after_remove.load(nvs);
+    check(after_remove.get(0, profile) && strcmp(profile.host, "10.0.0.7") == 0,
+          "interrupted remove should keep the profile");
+    check(after_remove.remove(0) == ESP_OK && after_remove.remove(1) == ESP_OK, "remove");
+    PrinterProfiles removed;
+    removed.load(nvs);
+    check(!removed.get(0, profile) && removed.get(2, profile), "removed profile reloaded");
+}
+
+static void test_set_printer() {
+    BambuStatus status;
+    // 本机没有监听的端口，客户端停留在重连中
+    BambuMQTT mqtt("127.0.0.1", "12345678", "SERIAL1", status, nullptr);
+    check(mqtt.setPrinter("127.0.0.2", "12345678", "SERIAL2"), "set before start");
+    check(strcmp(mqtt.getIP(), "127.0.0.2") == 0 && !mqtt.isConnected(),
+          "set before start should only store");
+    mqtt.start();
+    char too_long[64];
+    memset(too_long, 'x', sizeof(too_long) - 1);
+    too_long[sizeof(too_long) - 1] = '\0';
+    check(!mqtt.setPrinter(too_long, "12345678", "SERIAL3"), "host too long accepted");
+    check(!mqtt.setPrinter("127.0.0.3", "12345678", ""), "empty serial accepted");
+    check(strcmp(mqtt.getIP(), "127.0.0.2") == 0 && strcmp(mqtt.getSerial(), "SERIAL2") == 0,
+          "rejected parameters changed the connection");
+    status.tray_now = 3;
+    check(mqtt.setPrinter("127.0.0.2", "12345678", "SERIAL2") && status.tray_now == 3,
+          "unchanged printer reconnected");
+    check(mqtt.setPrinter("127.0.0.3", "87654321", "SERIAL3"), "switch printer");
+    check(mqtt.isConnected() && strcmp(mqtt.getSerial(), "SERIAL3") == 0 &&
+              strcmp(mqtt.getPassword(), "87654321") == 0,
+          "client not restarted with new parameters");
+    check(status.tray_now == BAMBU_TRAY_NONE, "status of the previous printer kept");
+    mqtt.stop();
+
+    // 出厂设置为空：启动后不连接，配置后才连接
+    BambuMQTT empty("", "", "", status, nullptr);
+    empty.start();
+    check(!empty.isConnected(), "unconfigured printer connected");
+    check(!empty.setPrinter("", "", ""), "empty printer accepted");
+    check(empty.setPrinter("127.0.0.2", "12345678", "SERIAL2") && empty.isConnected(),
+          "configured printer not connected after start");
+    empty.stop();
+    check(empty.setPrinter("127.0.0.3", "12345678", "SERIAL3") && !empty.isConnected(),
+          "stopped printer reconnected");
+}
+
+int main() {
+    esp_log_level_set("*", ESP_LOG_NONE);
+    test_parse();
+    test_cache();
+    test_listen();
+    test_profiles();
+    test_set_printer();
+    if (failures) {
+        printf("FAILED: %d checks\n", failures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
@@ -0,0 +1,309 @@
+// 多打印机测试：FilamentScheduler 把共用的电机按请求先后分配给各会话 (排队、轮到时开始、
+// 不再请求时跳过、会话关闭时放弃、没有任何上报时由定时器检查超时)；PrinterSessions
+// 按档案位掩码打开 / 更新 / 关闭会话并报告关闭或换了打印机的会话，按空闲堆预算限制会话数，
+// 主机上单个会话对象的堆占用不超过预算
+//
+// 用法: printer_sessions_test
+
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "filament_scheduler.h"
+#include "nvs_flash.h"
+#include "printer_sessions.h"
+#include "report_bench.h"
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// 换料相关字段都标记为变化的一次上报
+static BambuStatus report(int stg_cur, int32_t ams_status, uint8_t tray_now, uint8_t tray_tar) {
+    BambuStatus status;
+    status.stg_cur = stg_cur;
+    status.ams_status = ams_status;
+    status.tray_now = tray_now;
+    status.tray_tar = tray_tar;
+    status.dirty = BAMBU_FIELD_STG_CUR | BAMBU_FIELD_AMS_STATUS | BAMBU_FIELD_TRAY_NOW |
+                   BAMBU_FIELD_TRAY_TAR;
+    return status;
+}
+
+// sim_data/sample_reports.jsonl 中一次 1 -> 2 换料的各阶段
+static const BambuStatus PRINTING = report(0, 0, 1, 1);
+static const BambuStatus REQUEST = report(BAMBU_STAGE_CHANGING_FILAMENT, 0x100, 1, 2);
+static const BambuStatus UNLOADED = report(BAMBU_STAGE_FILAMENT_UNLOADING, 0x104, 255, 2);
+static const BambuStatus LOADED = report(BAMBU_STAGE_FILAMENT_LOADING, 0x106, 2, 2);
+static const BambuStatus DONE = report(0, 0, 2, 2);
+
+static int phase_calls = 0;
+static int last_session = -2;
+
+static void on_phase(void *ctx, size_t session, const FilamentChanger &changer) {
+    phase_calls++;
+    last_session = (int)session;
+}
+
+static void run_change(FilamentScheduler &scheduler, size_t session) {
+    scheduler.onStatus(session, UNLOADED);
+    scheduler.onStatus(session, LOADED);
+    scheduler.onStatus(session, DONE);
+}
+
+static FilamentManager &filaments() {
+    static FilamentManager manager;
+    static bool ready = false;
+    if (!ready) {
+        nvs_mock_reset();
+        static NVSManager nvs;
+        nvs.init();
+        manager.init(nvs);
+        ready = true;
+    }
+    return manager;
+}
+
+static void test_single() {
+    FilamentChanger changer(filaments(), nullptr, nullptr);
+    FilamentScheduler scheduler(changer);
+    scheduler.setPhaseCallback(on_phase, nullptr);
+    phase_calls = 0;
+
+    scheduler.onStatus(0, PRINTING);
+    check(scheduler.owner() == -1 && phase_calls == 0, "idle printer took the motors");
+    scheduler.onStatus(0, REQUEST);
+    check(scheduler.owner() == 0 && changer.phase() == FILAMENT_PHASE_RETRACT,
+          "single printer change not started");
+    check(last_session == 0, "phase callback session");
+    run_change(scheduler, 0);
+    check(scheduler.owner() == -1 && changer.phase() == FILAMENT_PHASE_IDLE,
+          "motors not released after change");
+    check(changer.stats().completed == 1 && phase_calls == 4, "single change phases");
+
+    // 与单打印机时相同：字段未变化的重复上报不会重新开始
+    BambuStatus stale = REQUEST;
+    stale.dirty = 0;
+    scheduler.onStatus(0, stale);
+    check(changer.phase() == FILAMENT_PHASE_IDLE, "unchanged report restarted a change");
+}
+
+static void test_queue() {
+    FilamentChanger changer(filaments(), nullptr, nullptr);
+    FilamentScheduler scheduler(changer);
+    scheduler.setPhaseCallback(on_phase, nullptr);
+
+    scheduler.onStatus(0, REQUEST);
+    scheduler.onStatus(1, REQUEST);
+    scheduler.onStatus(2, REQUEST);
+    scheduler.onStatus(1, REQUEST); // 重复请求不重复排队
+    check(scheduler.owner() == 0 && scheduler.waiting() == 2, "requests not queued");
+
+    // 排队中的打印机的上报不影响占用者
+    scheduler.onStatus(1, UNLOADED);
+    check(changer.phase() == FILAMENT_PHASE_RETRACT, "waiting printer drove the changer");
+
+    run_change(scheduler, 0);
+    check(scheduler.owner() == 1 && changer.phase() == FILAMENT_PHASE_IDLE,
+          "next printer not granted");
+    check(last_session == 0, "finish reported for the previous owner");
+
+    // 轮到后第一条上报即开始，不要求字段变化
+    scheduler.onStatus(2, REQUEST);
+    check(scheduler.owner() == 1, "queue order");
+    BambuStatus waiting = REQUEST;
+    waiting.dirty = 0;
+    scheduler.onStatus(1, waiting);
+    check(changer.phase() == FILAMENT_PHASE_RETRACT && last_session == 1,
+          "granted printer did not start");
+    run_change(scheduler, 1);
+    check(scheduler.owner() == 2, "third printer not granted");
+
+    // 等待期间打印机放弃了换料
+    scheduler.onStatus(2, DONE);
+    check(scheduler.owner() == -1 && changer.phase() == FILAMENT_PHASE_IDLE,
+          "printer that gave up kept the motors");
+
+    FilamentScheduler::Stats stats = scheduler.stats();
+    check(stats.granted == 2 && stats.queued == 2 && stats.skipped == 1, "scheduler stats");
+    check(stats.max_depth == 2, "max queue depth");
+    check(changer.stats().completed == 2 && changer.stats().aborted == 0, "changer stats");
+}
+
+static void test_release() {
+    FilamentChanger changer(filaments(), nullptr, nullptr);
+    FilamentScheduler scheduler(changer);
+    scheduler.setPhaseCallback(on_phase, nullptr);
+
+    scheduler.onStatus(1, REQUEST);
+    scheduler.onStatus(2, REQUEST);
+    scheduler.onStatus(3, REQUEST);
+    scheduler.release(3);
+    check(scheduler.waiting() == 1, "released session still queued");
+    scheduler.release(1);
+    check(changer.phase() == FILAMENT_PHASE_IDLE && changer.stats().aborted == 1,
+          "owner change not aborted");
+    check(scheduler.owner() == 2 && last_session == 1, "motors not passed on after release");
+    scheduler.onStatus(2, REQUEST);
+    check(changer.phase() == FILAMENT_PHASE_RETRACT, "next printer did not start");
+}
+
+static void test_poll() {
+    FilamentChanger changer(filaments(), nullptr, nullptr);
+    FilamentScheduler scheduler(changer);
+    scheduler.setPhaseCallback(on_phase, nullptr);
+
+    // 占用者和排队的打印机都不再上报：超时只能由 poll() 发现
+    scheduler.onStatus(1, REQUEST);
+    scheduler.onStatus(2, REQUEST);
+    esp_mock_advance_time((FILAMENT_CHANGER_PHASE_TIMEOUT_MS + 1000) * 1000LL);
+    scheduler.poll();
+    check(changer.phase() == FILAMENT_PHASE_IDLE && changer.stats().aborted == 1,
+          "phase timeout not detected without reports");
+    check(scheduler.owner() == 2 && last_session == 1, "motors not passed on after timeout");
+    esp_mock_advance_time((FILAMENT_SCHEDULER_GRANT_TIMEOUT_MS + 1000) * 1000LL);
+    scheduler.poll();
+    check(scheduler.owner() == -1 && scheduler.stats().skipped == 1,
+          "silent granted printer not skipped");
+
+    // start() 的定时器调用 poll()
+    scheduler.onStatus(1, REQUEST);
+    check(scheduler.owner() == 1, "printer did not start after timeout");
+    check(scheduler.start(10) && scheduler.start(10), "poll timer not started");
+    esp_mock_advance_time((FILAMENT_CHANGER_PHASE_TIMEOUT_MS + 1000) * 1000LL);
+    int64_t deadline = esp_timer_get_time() + 1000000;
+    while (scheduler.owner() != -1 && esp_timer_get_time() < deadline) {
+        vTaskDelay(1);
+    }
+    scheduler.stop();
+    check(scheduler.owner() == -1 && changer.stats().aborted == 2, "poll timer did not run");
+}
+
+static void test_sessions() {
+    nvs_mock_reset();
+    NVSManager nvs;
+    nvs.init();
+    PrinterProfiles profiles;
+    profiles.load(nvs);
+    profiles.save(0, "A", "127.0.0.2", "SERIAL-A", "11111111");
+    profiles.save(1, "B", "127.0.0.3", "SERIAL-B", "22222222");
+    profiles.save(2, "C", "127.0.0.4", "SERIAL-C", "33333333");
+    profiles.save(3, "Primary", "127.0.0.1", "SERIAL-P", "44444444");
+
+    BambuStatus status;
+    auto primary = std::make_shared<BambuMQTT>("127.0.0.1", "44444444", "SERIAL-P", status,
+                                               nullptr);
+    const size_t cost = PRINTER_SESSION_HEAP_COST;
+    const size_t reserve = PRINTER_SESSION_HEAP_RESERVE;
+    PrinterSessions sessions(primary);
+
+    // 启动前打开的会话还没有分配任何连接资源，预算按个数累计
+    esp_mock_set_free_heap_size(reserve + 2 * cost);
+    check(sessions.apply(profiles, 0xF) == 2, "heap budget not applied");
+    check(sessions.count() == 3, "session count");
+    check(sessions.profileOf(0) == -1 && sessions.profileOf(1) == 0 &&
+              sessions.profileOf(2) == 1,
+          "sessions opened in profile order");
+    check(sessions.get(0) == primary, "session 0 is the primary connection");
+
+    // 与当前打印机序列号相同的档案不重复连接
+    esp_mock_set_free_heap_size(UINT32_MAX);
+    check(sessions.apply(profiles, 0xF) == 3 && sessions.count() == 4, "remaining profile");
+    for (size_t i = 0; i < PRINTER_SESSION_MAX; i++) {
+        check(sessions.profileOf(i) != 3, "primary printer opened twice");
+    }
+
+    // 档案的地址变化 (DHCP) 时沿用原来的会话
+    std::shared_ptr<BambuMQTT> session_b = sessions.get(2);
+    profiles.save(1, "B", "127.0.0.13", "SERIAL-B", "22222222");
+    sessions.apply(profiles, 0xF);
+    check(sessions.get(2) == session_b && strcmp(session_b->getIP(), "127.0.0.13") == 0,
+          "session not updated in place");
+
+    // 取消的槽位关闭，调用者持有的连接仍然有效
+    check(sessions.apply(profiles, 0x1) == 1 && sessions.count() == 2, "sessions not closed");
+    check(!sessions.get(2) && strcmp(session_b->getSerial(), "SERIAL-B") == 0,
+          "closed session released too early");
+    session_b.reset();
+
+    // 主机上的对象占用 (环形缓冲区、待回复表、状态) 须在预算内，设备上另有 TLS 和任务栈
+    sessions.apply(profiles, 0);
+    bench_heap_reset_peak();
+    sessions.apply(profiles, 0x1);
+    int64_t used = bench_heap_used();
+    printf("TEST printer_session_heap object_bytes=%lld budget=%zu\n", (long long)used, cost);
+    check(used > 0 && (size_t)used < cost / 2, "session object exceeds the heap budget");
+    sessions.apply(profiles, 0);
+}
+
+// 同一次 apply() 中关闭的会话又打开给另一个档案：占用电机的旧打印机须经 released 放弃换料，
+// 否则新打印机的上报会继续推进旧打印机的换料
+static void test_reopen() {
+    nvs_mock_reset();
+    NVSManager nvs;
+    nvs.init();
+    PrinterProfiles profiles;
+    profiles.load(nvs);
+    profiles.save(1, "B", "127.0.0.3", "SERIAL-B", "22222222");
+    profiles.save(2, "C", "127.0.0.4", "SERIAL-C", "33333333");
+
+    BambuStatus status;
+    auto primary = std::make_shared<BambuMQTT>("127.0.0.1", "44444444", "SERIAL-P", status,
+                                               nullptr);
+    PrinterSessions sessions(primary);
+    FilamentChanger changer(filaments(), nullptr, nullptr);
+    FilamentScheduler scheduler(changer);
+    esp_mock_set_free_heap_size(UINT32_MAX);
+
+    uint32_t released = ~0u;
+    check(sessions.apply(profiles, 1u << 1, &released) == 1 && released == 0, "open slot 1");
+    scheduler.onStatus(1, REQUEST);
+    check(scheduler.owner() == 1, "session 1 did not take the motors");
+
+    check(sessions.apply(profiles, 1u << 2, &released) == 1 && sessions.profileOf(1) == 2,
+          "session 1 not reused for slot 2");
+    check(released == 1u << 1, "reopened session not reported");
+    for (size_t session = 0; session < PRINTER_SESSION_MAX; session++) {
+        if (released & (1u << session)) {
+            scheduler.release(session);
+        }
+    }
+    check(scheduler.owner() == -1 && changer.phase() == FILAMENT_PHASE_IDLE &&
+              changer.stats().aborted == 1,
+          "change of the closed printer not aborted");
+    scheduler.onStatus(1, PRINTING);
+    check(scheduler.owner() == -1 && changer.phase() == FILAMENT_PHASE_IDLE,
+          "new printer took over the old change");
+
+    // 只换地址 (同一台打印机) 的会话不算放弃，换成另一台打印机的算
+    profiles.save(2, "C", "127.0.0.14", "SERIAL-C", "33333333");
+    sessions.apply(profiles, 1u << 2, &released);
+    check(released == 0, "address change reported as released");
+    profiles.save(2, "D", "127.0.0.5", "SERIAL-D", "55555555");
+    sessions.apply(profiles, 1u << 2, &released);
+    check(released == 1u << 1 && sessions.profileOf(1) == 2, "switched printer not reported");
+    sessions.apply(profiles, 0, &released);
+    check(released == 1u << 1 && sessions.count() == 1, "closed session not reported");
+}
+
+int main() {
+    esp_log_level_set("*", ESP_LOG_NONE);
+    test_single();
+    test_queue();
+    test_release();
+    test_poll();
+    test_sessions();
+    test_reopen();
+    if (failures) {
+        printf("FAILED: %d checks\n", failures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
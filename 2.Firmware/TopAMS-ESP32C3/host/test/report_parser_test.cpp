@@ -0,0 +1,70 @@
+// 上报解析测试：JsonStream 的空字符串值不沿用上一个值，ReportParser 的托盘字段和命令回复、
+// FilamentMeta 的颜色按空字符串处理
+//
+// 用法: report_parser_test
+
+#include "model/filament_meta.h"
+#include "report_parser.h"
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static bool parse(ReportParser &parser, const char *json) {
+    return parser.feed(json, strlen(json), 0, strlen(json)) == ReportParser::Result::Complete;
+}
+
+static void test_empty_tray_fields() {
+    BambuStatus status;
+    ReportParser parser(status);
+    check(parse(parser, R"({"print":{"ams":{"ams":[{"tray":[)"
+                        R"({"tray_type":"ABS","tray_color":"FF0000FF"}]}]}}})"),
+          "parse tray");
+    check(strcmp(status.ams[0].trays[0].type, "ABS") == 0, "tray_type");
+
+    // 空托盘上报空字符串，不能沿用前一个字段的值
+    check(parse(parser, R"({"print":{"ams":{"ams":[{"tray":[)"
+                        R"({"tray_type":"ABS","tray_color":""}]}]}}})"),
+          "parse empty color");
+    check(status.ams[0].trays[0].color[0] == '\0', "empty tray_color kept previous token");
+    check(parse(parser, R"({"print":{"ams":{"ams":[{"tray":[{"tray_type":""}]}]}}})"),
+          "parse empty type");
+    check(status.ams[0].trays[0].type[0] == '\0', "empty tray_type");
+}
+
+static void test_empty_reply_fields() {
+    BambuStatus status;
+    ReportParser parser(status);
+    check(parse(parser, R"({"print":{"sequence_id":"7","command":"","result":""}})"),
+          "parse reply");
+    const ReportReply &reply = parser.reply();
+    check(reply.has_sequence_id && reply.sequence_id == 7, "sequence_id");
+    check(reply.command[0] == '\0', "empty command kept previous token");
+    check(reply.result[0] == '\0', "empty result kept previous token");
+}
+
+static void test_empty_meta_color() {
+    FilamentMeta meta;
+    check(meta.parse(R"({"type":"FFFFFF","color":""})"), "parse metadata");
+    check(!(meta.fields & FILAMENT_META_HAS_COLOR), "empty color parsed from previous token");
+    check(strcmp(meta.type, "FFFFFF") == 0, "metadata type");
+}
+
+int main() {
+    test_empty_tray_fields();
+    test_empty_reply_fields();
+    test_empty_meta_color();
+    if (failures) {
+        printf("FAILED: %d checks\n", failures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
@@ -0,0 +1,286 @@
+// SettingsStore 组记录的断电测试：依次执行旧数据迁移和一系列修改，在每一次 NVS 写入处断电
+// (可选只写入一半)，重新加载后每个组必须是某一次完整修改后的值：最后一次成功的修改，
+// 或断电时正在进行的那一次，不能出现组内一部分已更新的情况。同样的断电点下对比之前
+// 分别写入 wifi_ssid / wifi_pass 的做法
+//
+// 用法: settings_fault_test
+
+#include "esp_log.h"
+#include "nvs_flash.h"
+#include "settings_store.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+enum TestSetting {
+    TEST_SSID,
+    TEST_PASS,
+    TEST_HOST,
+    TEST_SERIAL,
+    TEST_CODE,
+    TEST_PORT,
+    TEST_COUNT,
+};
+
+enum TestGroup {
+    TEST_GROUP_NONE,
+    TEST_GROUP_WIFI,
+    TEST_GROUP_PRINTER,
+    TEST_GROUP_COUNT,
+};
+
+static const SettingGroupDef TEST_GROUPS[TEST_GROUP_COUNT] = {
+    {nullptr, 0},
+    {"wifi", 1},
+    {"printer", 1},
+};
+
+static const SettingDef TEST_DEFS[TEST_COUNT] = {
+    {"wifi_ssid", SETTING_TYPE_STR, 33, "", 0, TEST_GROUP_WIFI},
+    {"wifi_pass", SETTING_TYPE_STR, 65, "", 0, TEST_GROUP_WIFI},
+    {"printer_host", SETTING_TYPE_STR, 40, "", 0, TEST_GROUP_PRINTER},
+    {"printer_serial", SETTING_TYPE_STR, 20, "", 0, TEST_GROUP_PRINTER},
+    {"printer_code", SETTING_TYPE_STR, 16, "", 0, TEST_GROUP_PRINTER},
+    {"mqtt_port", SETTING_TYPE_I32, 0, "", 8883, TEST_GROUP_NONE},
+};
+
+// 一次修改：组和组内各项的新值 (按组内顺序)，op 0 为 load() 时的迁移
+struct Step {
+    TestGroup group;
+    const char *values[3];
+    int32_t port;
+};
+
+static const Step STEPS[] = {
+    {TEST_GROUP_WIFI, {"HomeAP", "secret-password"}, 0}, // 旧版本的 blob，load() 时迁移
+    {TEST_GROUP_WIFI, {"OfficeAP", "office-password"}, 0},
+    {TEST_GROUP_PRINTER, {"10.0.0.5", "01S00A000000001", "12345678"}, 0},
+    {TEST_GROUP_WIFI, {"CafeAP", ""}, 0},
+    {TEST_GROUP_NONE, {}, 1883},
+    {TEST_GROUP_PRINTER, {"printer.lan", "01S00A000000002", "87654321"}, 0},
+    {TEST_GROUP_WIFI, {"HomeAP-5G", "another-password"}, 0},
+};
+#define STEP_COUNT (sizeof(STEPS) / sizeof(STEPS[0]))
+
+static int failures = 0;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static size_t first_id(TestGroup group) {
+    return group == TEST_GROUP_WIFI ? TEST_SSID : TEST_HOST;
+}
+
+static size_t group_size(TestGroup group) { return group == TEST_GROUP_WIFI ? 2 : 3; }
+
+static void seed_legacy(NVSManager &nvs) {
+    char ssid[32] = {};
+    char password[64] = {};
+    strcpy(ssid, STEPS[0].values[0]);
+    strcpy(password, STEPS[0].values[1]);
+    nvs.set("wifi_ssid", ssid);
+    nvs.set("wifi_pass", password);
+    nvs.commit();
+}
+
+static esp_err_t apply(SettingsStore &store, const Step &step) {
+    if (step.group == TEST_GROUP_NONE) {
+        return store.set(TEST_PORT, step.port);
+    }
+    store.beginBatch();
+    for (size_t i = 0; i < group_size(step.group); i++) {
+        store.set(first_id(step.group) + i, step.values[i]);
+    }
+    return store.commitBatch();
+}
+
+// 组的值与第 step 次修改后的值相同；step 为 -1 表示默认值
+static bool group_matches(SettingsStore &store, TestGroup group, int step) {
+    for (size_t i = 0; i < group_size(group); i++) {
+        const char *expected = step < 0 ? "" : STEPS[step].values[i];
+        if (strcmp(store.str(first_id(group) + i), expected) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool port_matches(SettingsStore &store, int step) {
+    return store.i32(TEST_PORT) == (step < 0 ? 8883 : STEPS[step].port);
+}
+
+/**
+ * @brief 执行所有修改，写入 cut 次后断电，重新加载后检查每个组
+ * @return 不断电时的写入次数
+ */
+static uint32_t run(int cut, bool torn, int &mixed, int &stale) {
+    nvs_mock_reset();
+    NVSManager nvs;
+    nvs.init();
+    seed_legacy(nvs);
+    uint32_t writes_before = nvs_mock_write_count();
+    if (cut >= 0) {
+        nvs_mock_cut_after(cut, torn);
+    }
+
+    // 各组最后一次成功的修改和之后第一次失败的修改
+    int committed[TEST_GROUP_COUNT] = {-1, -1, -1};
+    int pending[TEST_GROUP_COUNT] = {-1, -1, -1};
+    {
+        SettingsStore store(TEST_DEFS, TEST_COUNT, TEST_GROUPS, TEST_GROUP_COUNT);
+        for (size_t i = 0; i < STEP_COUNT; i++) {
+            TestGroup group = STEPS[i].group;
+            esp_err_t err = i == 0 ? store.load(nvs) : apply(store, STEPS[i]);
+            if (err == ESP_OK) {
+                committed[group] = i;
+                pending[group] = -1;
+            } else if (pending[group] < 0) {
+                pending[group] = i;
+            }
+        }
+    }
+    uint32_t writes = nvs_mock_write_count() - writes_before;
+    nvs_mock_restore();
+
+    // 重新上电
+    SettingsStore store(TEST_DEFS, TEST_COUNT, TEST_GROUPS, TEST_GROUP_COUNT);
+    check(store.load(nvs) == ESP_OK, "reload after cut");
+    for (int group = TEST_GROUP_WIFI; group < TEST_GROUP_COUNT; group++) {
+        TestGroup g = (TestGroup)group;
+        // 迁移前的旧数据也是一组完整的值
+        int oldest = g == TEST_GROUP_WIFI ? 0 : -1;
+        int last = committed[g] < 0 ? oldest : committed[g];
+        if (group_matches(store, g, last) ||
+            (pending[g] >= 0 && group_matches(store, g, pending[g]))) {
+            continue;
+        }
+        bool known = false;
+        for (int i = -1; i < (int)STEP_COUNT && !known; i++) {
+            known = (i < 0 || STEPS[i].group == g) && group_matches(store, g, i);
+        }
+        if (known) {
+            stale++;
+        } else {
+            mixed++;
+        }
+        fprintf(stderr, "cut=%d torn=%d: %s is %s\n", cut, torn, TEST_GROUPS[group].name,
+                known ? "older than the last commit" : "partially updated");
+    }
+    int last_port = committed[TEST_GROUP_NONE];
+    check(port_matches(store, last_port) ||
+              (pending[TEST_GROUP_NONE] >= 0 && port_matches(store, pending[TEST_GROUP_NONE])),
+          "ungrouped setting lost");
+    // 重新加载后迁移完成，旧格式的键已删除
+    char buffer[64];
+    size_t length = sizeof(buffer);
+    check(nvs.getBlob("wifi_ssid", buffer, length) == ESP_ERR_NVS_NOT_FOUND &&
+              nvs.getStr("wifi_ssid", buffer, sizeof(buffer)) == ESP_ERR_NVS_NOT_FOUND,
+          "legacy key left after reload");
+    return writes;
+}
+
+// 之前的做法：两个键分别写入后提交
+static bool run_legacy(int cut, uint32_t &writes) {
+    nvs_mock_reset();
+    NVSManager nvs;
+    nvs.init();
+    seed_legacy(nvs);
+    uint32_t writes_before = nvs_mock_write_count();
+    if (cut >= 0) {
+        nvs_mock_cut_after(cut, false);
+    }
+    for (size_t i = 1; i < STEP_COUNT; i++) {
+        if (STEPS[i].group != TEST_GROUP_WIFI) {
+            continue;
+        }
+        char ssid[32] = {};
+        char password[64] = {};
+        strcpy(ssid, STEPS[i].values[0]);
+        strcpy(password, STEPS[i].values[1]);
+        nvs.set("wifi_ssid", ssid);
+        nvs.set("wifi_pass", password);
+        nvs.commit();
+    }
+    writes = nvs_mock_write_count() - writes_before;
+    nvs_mock_restore();
+
+    char ssid[32];
+    char password[64];
+    nvs.get("wifi_ssid", ssid);
+    nvs.get("wifi_pass", password);
+    for (size_t i = 0; i < STEP_COUNT; i++) {
+        if (STEPS[i].group == TEST_GROUP_WIFI && strcmp(ssid, STEPS[i].values[0]) == 0 &&
+            strcmp(password, STEPS[i].values[1]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main() {
+    esp_log_level_set("*", ESP_LOG_NONE);
+
+    // 不断电时的写入次数，之后在每一次写入处断电
+    int mixed = 0;
+    int stale = 0;
+    int total = run(-1, false, mixed, stale);
+    check(mixed == 0 && stale == 0, "uninterrupted run");
+    int cuts = 0;
+    for (int torn = 0; torn < 2; torn++) {
+        for (int cut = 0; cut <= total; cut++) {
+            run(cut, torn, mixed, stale);
+            cuts++;
+        }
+    }
+
+    uint32_t legacy_total = 0;
+    run_legacy(-1, legacy_total);
+    int legacy_mixed = 0;
+    for (uint32_t cut = 0; cut <= legacy_total; cut++) {
+        uint32_t writes;
+        legacy_mixed += run_legacy(cut, writes) ? 0 : 1;
+    }
+
+    printf("TEST settings_fault writes=%d cuts=%d mixed=%d stale=%d legacy_writes=%" PRIu32
+           " legacy_cuts=%" PRIu32 " legacy_mixed=%d\n",
+           total, cuts, mixed, stale, legacy_total, legacy_total + 1, legacy_mixed);
+    check(mixed == 0, "group partially updated after power loss");
+    check(stale == 0, "group rolled back past the last commit");
+
+    // 两个槽位都损坏：使用默认值，之后的写入可以正常读回
+    nvs_mock_reset();
+    NVSManager nvs;
+    nvs.init();
+    uint8_t garbage[40];
+    memset(garbage, 0xA5, sizeof(garbage));
+    nvs.set("wifi.0", garbage);
+    nvs.set("wifi.1", garbage);
+    SettingsStore store(TEST_DEFS, TEST_COUNT, TEST_GROUPS, TEST_GROUP_COUNT);
+    check(store.load(nvs) == ESP_OK, "load with corrupted record");
+    check(group_matches(store, TEST_GROUP_WIFI, -1), "corrupted record should use defaults");
+    check(apply(store, STEPS[1]) == ESP_OK, "write after corrupted record");
+    SettingsStore reloaded(TEST_DEFS, TEST_COUNT, TEST_GROUPS, TEST_GROUP_COUNT);
+    reloaded.load(nvs);
+    check(group_matches(reloaded, TEST_GROUP_WIFI, 1), "record after corruption");
+
+    // 批量修改回滚：缓存恢复为 NVS 中的值，不写入
+    uint32_t writes_before = nvs_mock_write_count();
+    check(reloaded.beginBatch(), "begin batch");
+    check(!reloaded.beginBatch(), "nested batch should fail");
+    reloaded.set(TEST_SSID, "Uncommitted");
+    check(strcmp(reloaded.str(TEST_SSID), "Uncommitted") == 0, "batch value visible");
+    reloaded.rollbackBatch();
+    check(group_matches(reloaded, TEST_GROUP_WIFI, 1), "rollback did not restore");
+    check(nvs_mock_write_count() == writes_before, "rollback should not write");
+
+    if (failures) {
+        printf("FAILED: %d checks\n", failures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
@@ -0,0 +1,227 @@
+// SettingsStore 测试：load() 对每个已声明的键只读取一次、之后的读取不访问 NVS 且不分配内存、
+// 值未变化时不写入、旧版本 blob 迁移为字符串、load() 失败后首次读取时从 NVS 读取、
+// 反复 load() / set() 堆占用不增长。与之前每次 get<const char *>() 的读取方式对比
+//
+// 用法: settings_test [-n reads]
+
+#include "esp_log.h"
+#include "nvs_flash.h"
+#include "report_bench.h"
+#include "settings_store.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum TestSetting {
+    TEST_SSID,
+    TEST_PASS,
+    TEST_HOST,
+    TEST_PORT,
+    TEST_AUTO,
+    TEST_NAME, // NVS 中没有，使用默认值
+    TEST_COUNT,
+};
+
+static const SettingDef TEST_DEFS[TEST_COUNT] = {
+    {"wifi_ssid", SETTING_TYPE_STR, 33, "", 0},
+    {"wifi_pass", SETTING_TYPE_STR, 65, "", 0},
+    {"printer_host", SETTING_TYPE_STR, 16, "192.168.1.1", 0},
+    {"mqtt_port", SETTING_TYPE_I32, 0, "", 8883},
+    {"auto_load", SETTING_TYPE_BOOL, 0, "", 1},
+    {"device_name", SETTING_TYPE_STR, 24, "TopAMS", 0},
+};
+
+static int failures = 0;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// 旧版本固件的写法：WifiManager 以定长 char 数组 (blob) 保存
+static void seed_legacy(NVSManager &nvs) {
+    char ssid[32] = "HomeAP";
+    char password[64] = "secret-password";
+    nvs.set("wifi_ssid", ssid);
+    nvs.set("wifi_pass", password);
+    nvs.set<const char *>("printer_host", "10.0.0.42");
+    nvs.set<int32_t>("mqtt_port", 1883);
+    nvs.set("auto_load", false);
+    nvs.set<const char *>("unrelated", "ignored");
+    nvs.commit();
+}
+
+static bool same_values(SettingsStore &a, SettingsStore &b) {
+    for (size_t id = 0; id < TEST_COUNT; id++) {
+        switch (TEST_DEFS[id].type) {
+            case SETTING_TYPE_STR:
+                if (strcmp(a.str(id), b.str(id)) != 0) {
+                    return false;
+                }
+                break;
+            case SETTING_TYPE_I32:
+                if (a.i32(id) != b.i32(id)) {
+                    return false;
+                }
+                break;
+            case SETTING_TYPE_BOOL:
+                if (a.flag(id) != b.flag(id)) {
+                    return false;
+                }
+                break;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int reads = 10000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        if (opt == 'n') {
+            reads = atoi(optarg);
+        } else {
+            fprintf(stderr, "usage: %s [-n reads]\n", argv[0]);
+            return 2;
+        }
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    static NVSManager nvs;
+    static SettingsStore store(TEST_DEFS, TEST_COUNT);
+    nvs.init();
+    seed_legacy(nvs);
+
+    // load(): 一次遍历，每个已声明的键读取一次，旧的 blob 改写为字符串
+    uint32_t reads_before = nvs_mock_read_count();
+    check(store.load(nvs) == ESP_OK, "load");
+    uint32_t load_reads = nvs_mock_read_count() - reads_before;
+    SettingsStore::Stats stats = store.stats();
+    printf("TEST settings_load keys=%d loaded=%" PRIu32 " nvs_reads=%" PRIu32
+           " migrated=%" PRIu32 "\n",
+           TEST_COUNT, stats.loaded, load_reads, stats.writes);
+    check(stats.loaded == 5, "loaded key count");
+    check(load_reads == 5, "one NVS read per stored key");
+    check(stats.writes == 2, "legacy blobs should be rewritten");
+    check(strcmp(store.str(TEST_SSID), "HomeAP") == 0, "legacy ssid");
+    check(strcmp(store.str(TEST_PASS), "secret-password") == 0, "legacy password");
+    check(strcmp(store.str(TEST_HOST), "10.0.0.42") == 0, "host");
+    check(store.i32(TEST_PORT) == 1883, "port");
+    check(!store.flag(TEST_AUTO), "bool");
+    check(strcmp(store.str(TEST_NAME), "TopAMS") == 0, "default value");
+    char migrated[33];
+    check(nvs.getStr("wifi_ssid", migrated, sizeof(migrated)) == ESP_OK &&
+              strcmp(migrated, "HomeAP") == 0,
+          "ssid not migrated to string");
+
+    // 已缓存的读取：不访问 NVS，不分配内存
+    reads_before = nvs_mock_read_count();
+    uint32_t allocs_before = bench_alloc_count();
+    size_t total = 0;
+    int64_t start = bench_time_ns();
+    for (int i = 0; i < reads; i++) {
+        total += strlen(store.str(TEST_HOST)) + store.i32(TEST_PORT);
+    }
+    int64_t cached_ns = bench_time_ns() - start;
+    uint32_t cached_reads = nvs_mock_read_count() - reads_before;
+    uint32_t cached_allocs = bench_alloc_count() - allocs_before;
+
+    // 之前的读取方式：每次 get<const char *>() 查询长度再读取，并分配缓冲区
+    reads_before = nvs_mock_read_count();
+    allocs_before = bench_alloc_count();
+    start = bench_time_ns();
+    for (int i = 0; i < reads; i++) {
+        const char *host = nullptr;
+        int32_t port = 0;
+        nvs.get("printer_host", host);
+        nvs.get("mqtt_port", port);
+        total += strlen(host) + port;
+        delete[] host;
+    }
+    int64_t legacy_ns = bench_time_ns() - start;
+    uint32_t legacy_reads = nvs_mock_read_count() - reads_before;
+    uint32_t legacy_allocs = bench_alloc_count() - allocs_before;
+
+    printf("TEST settings_get reads=%d cached_ns=%.1f nvs_reads=%" PRIu32 " allocs=%" PRIu32
+           " legacy_ns=%.1f legacy_nvs_reads=%" PRIu32 " legacy_allocs=%" PRIu32
+           " (checksum %zu)\n",
+           reads, (double)cached_ns / reads, cached_reads, cached_allocs,
+           (double)legacy_ns / reads, legacy_reads, legacy_allocs, total);
+    check(cached_reads == 0, "cached reads should not touch NVS");
+    check(cached_allocs == 0, "cached reads should not allocate");
+
+    // 写入：值未变化时跳过，变化时写入一次
+    uint32_t writes_before = nvs_mock_write_count();
+    check(store.set(TEST_SSID, "HomeAP") == ESP_OK, "set unchanged ssid");
+    check(store.set(TEST_PORT, (int32_t)1883) == ESP_OK, "set unchanged port");
+    check(nvs_mock_write_count() == writes_before, "unchanged values written");
+    check(store.set(TEST_SSID, "OfficeAP") == ESP_OK, "set ssid");
+    check(store.set(TEST_AUTO, true) == ESP_OK, "set bool");
+    check(nvs_mock_write_count() - writes_before == 2, "one write per changed value");
+    stats = store.stats();
+    check(stats.writes_avoided == 2, "writes avoided");
+
+    // 错误：超长、类型不符、编号越界，缓存不变
+    char too_long[40];
+    memset(too_long, 'x', sizeof(too_long) - 1);
+    too_long[sizeof(too_long) - 1] = '\0';
+    check(store.set(TEST_SSID, too_long) == ESP_ERR_INVALID_SIZE, "too long accepted");
+    check(store.set(TEST_PORT, "1883") == ESP_ERR_INVALID_ARG, "type mismatch accepted");
+    check(store.set(TEST_COUNT, (int32_t)1) == ESP_ERR_INVALID_ARG, "bad id accepted");
+    check(strcmp(store.str(TEST_SSID), "OfficeAP") == 0, "cache changed by failed set");
+    check(strcmp(store.str(TEST_PORT), "") == 0 && store.i32(TEST_SSID) == 0,
+          "typed getter on wrong type");
+    check(store.find("mqtt_port") == TEST_PORT && store.find("unrelated") == -1, "find");
+
+    // 重新加载后与缓存一致，没有需要迁移的项
+    static SettingsStore reloaded(TEST_DEFS, TEST_COUNT);
+    check(reloaded.load(nvs) == ESP_OK, "reload");
+    check(same_values(store, reloaded), "reload mismatch");
+    check(reloaded.stats().writes == 0, "reload should not write");
+
+    // load() 在 NVS 打开前调用：遍历失败，各项在首次读取时从 NVS 读取，之后命中缓存
+    static NVSManager late_nvs;
+    static SettingsStore late(TEST_DEFS, TEST_COUNT);
+    check(late.load(late_nvs) != ESP_OK, "load before init should fail");
+    late_nvs.init();
+    check(same_values(store, late), "read-through mismatch");
+    SettingsStore::Stats late_stats = late.stats();
+    reads_before = nvs_mock_read_count();
+    check(same_values(store, late), "cached read-through mismatch");
+    printf("TEST settings_read_through misses=%" PRIu32 " hits=%" PRIu32
+           " nvs_reads_after=%" PRIu32 "\n",
+           late_stats.misses, late.stats().hits, nvs_mock_read_count() - reads_before);
+    check(late_stats.misses == TEST_COUNT, "one miss per setting");
+    check(nvs_mock_read_count() == reads_before, "read-through should cache");
+
+    // 反复 load() / set()，堆占用回到基线
+    store.load(nvs);
+    store.set(TEST_HOST, "10.0.0.43");
+    store.set(TEST_HOST, "10.0.0.42");
+    bench_heap_reset_peak();
+    char host[16];
+    for (int i = 0; i < 200; i++) {
+        snprintf(host, sizeof(host), "10.0.%d.%d", i % 8, i % 250);
+        store.set(TEST_HOST, host);
+        store.set(TEST_PORT, (int32_t)(1000 + i));
+        store.load(nvs);
+    }
+    int64_t growth = bench_heap_used();
+    printf("TEST settings_heap cycles=200 heap_growth=%lld heap_peak=%zu\n", (long long)growth,
+           bench_heap_peak());
+    check(growth <= 0, "heap grew across load/set cycles");
+    check(strcmp(store.str(TEST_HOST), host) == 0 && store.i32(TEST_PORT) == 1199,
+          "values after cycles");
+    check(store.stats().failures == 0, "write failures");
+
+    if (failures) {
+        printf("FAILED: %d checks\n", failures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
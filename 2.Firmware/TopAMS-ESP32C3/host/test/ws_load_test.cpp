@@ -0,0 +1,665 @@
+// WebSocket 帧处理负载测试：多个客户端交替发送耗材请求，统计每秒处理帧数、每帧分配次数和
+// 堆占用，并校验响应内容。*_legacy 为之前逐帧 calloc + cJSON + std::string 的实现，
+// *_pool 为 WSFramePool 的预分配缓冲区 + 原地解析。httpd 在单个任务中逐帧调用处理函数，
+// 这里同样在一个线程中按轮转顺序处理各客户端的帧。之后校验 CBOR 子协议的协商 (含多个子协议)、
+// 解析和收发。
+//
+// 用法: ws_load_test [-c clients] [-n frames_per_client]
+
+#include "cJSON.h"
+#include "esp_log.h"
+#include "filament_manager.h"
+#include "ws_dispatch.h"
+#include "report_bench.h"
+#include "ws_cbor_json.h"
+#include "ws_filament.h"
+#include "ws_frame.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+
+using BambuCmd::Writer;
+
+#define MAX_CLIENTS 8
+#define REQUEST_SIZE 512
+
+// 每个客户端按顺序循环发送的请求
+enum RequestKind : uint8_t {
+    REQ_LIST,
+    REQ_UPDATE,
+    REQ_REMOVE,
+    REQ_ADD,
+    REQ_UNKNOWN,
+    REQ_INVALID,
+    REQ_KIND_COUNT,
+};
+
+static const RequestKind sequence[] = {REQ_LIST, REQ_UPDATE, REQ_LIST,    REQ_REMOVE,
+                                       REQ_ADD,  REQ_LIST,   REQ_UNKNOWN, REQ_INVALID};
+
+struct Client {
+    int fd;
+    int motor_id;
+    int id;
+    char metadata[128]; // 最近一次写入的元数据
+    char request[REQUEST_SIZE];
+    size_t request_len;
+    char response[WS_FRAME_TX_SIZE];
+    size_t response_len;
+};
+
+struct LoadResult {
+    uint32_t frames;
+    double frames_per_sec;
+    double allocs_per_frame;
+    size_t peak_heap;
+    int64_t heap_growth;
+};
+
+static Client clients[MAX_CLIENTS];
+static int failures = 0;
+
+static void check(bool condition, const char *what, int client) {
+    if (!condition) {
+        fprintf(stderr, "FAIL: %s (client %d)\n", what, client);
+        failures++;
+    }
+}
+
+static void on_send(void *ctx, int fd, const httpd_ws_frame_t *frame) {
+    Client &client = *static_cast<Client *>(ctx);
+    size_t len = frame->len;
+    if (len > sizeof(client.response) - 1) {
+        len = sizeof(client.response) - 1;
+    }
+    memcpy(client.response, frame->payload, len);
+    client.response[len] = '\0';
+    client.response_len = len;
+}
+
+// 元数据中带引号和非 ASCII 字符，验证转义往返
+static void build_request(Client &client, RequestKind kind, uint32_t n) {
+    Writer w(client.request);
+    switch (kind) {
+        case REQ_LIST:
+            w.raw(R"({"type": "filament", "action": "list", "id": )").num(client.id).chr('}');
+            break;
+        case REQ_UPDATE:
+            snprintf(client.metadata, sizeof(client.metadata),
+                     "{\"type\":\"PLA\",\"color\":\"FF0000FF\",\"note\":\"caf\xc3\xa9 \\\"%" PRIu32
+                     "\\\"\"}",
+                     n);
+            w.raw(R"({"type": "filament", "action": "update", "id": )").num(client.id);
+            w.raw(R"(, "metadata": )").str(client.metadata).chr('}');
+            break;
+        case REQ_REMOVE:
+            w.raw(R"({"type": "filament", "action": "remove", "id": )").num(client.id).chr('}');
+            break;
+        case REQ_ADD:
+            snprintf(client.metadata, sizeof(client.metadata), "{\"type\":\"PETG\"}");
+            w.raw(R"({"type": "filament", "action": "add", "motor_id": )").num(client.motor_id);
+            w.raw(R"(, "metadata": )").str(client.metadata).chr('}');
+            break;
+        case REQ_UNKNOWN:
+            w.raw(R"({"type": "filament", "action": "explode", "id": )").num(client.id).chr('}');
+            break;
+        default:
+            w.raw(R"({"type": "filament", "action": )");
+            break;
+    }
+    client.request_len = w.length();
+}
+
+static void verify_response(FilamentManager &manager, Client &client, RequestKind kind, int index) {
+    // 解析后比较 (legacy 的响应带空格和缩进)
+    static WSJson json;
+    static char copy[WS_FRAME_TX_SIZE];
+    memcpy(copy, client.response, client.response_len);
+    if (!json.parse(copy, client.response_len)) {
+        check(false, "response not JSON", index);
+        return;
+    }
+    WSJsonValue root = json.root();
+    bool success = false;
+    switch (kind) {
+        case REQ_LIST: {
+            FilamentManager::Reader table = manager.read();
+            const Filament *filament = table->getFilamentById(client.id);
+            check(filament != nullptr && strcmp(filament->metadata, client.metadata) == 0,
+                  "stored metadata mismatch", index);
+            // 响应中的元数据是转义后的 JSON 字符串
+            int id = 0;
+            const char *metadata = root["metadata"].str();
+            check(metadata != nullptr && strcmp(metadata, client.metadata) == 0,
+                  "list metadata mismatch", index);
+            check(root["id"].toInt(id) && id == client.id, "list id mismatch", index);
+            break;
+        }
+        case REQ_UPDATE:
+        case REQ_REMOVE:
+            check(root.size() == 1 && root["success"].toBool(success) && success,
+                  "update / remove failed", index);
+            break;
+        case REQ_ADD:
+            check(root["success"].toBool(success) && success && root["id"].toInt(client.id),
+                  "add failed", index);
+            break;
+        case REQ_UNKNOWN:
+            check(root.size() == 1 && root["error"].view() == "Unknown action", "unknown action",
+                  index);
+            break;
+        default:
+            check(root.size() == 1 && root["error"].view() == "Invalid JSON", "invalid json",
+                  index);
+            break;
+    }
+}
+
+static WSDispatcher dispatcher;
+
+// 之前的处理流程：读取长度、calloc、cJSON 解析、std::string 响应
+static void legacy_filament(FilamentManager &manager, cJSON *root, std::string &response) {
+    cJSON *action = cJSON_GetObjectItem(root, "action");
+    cJSON *id = cJSON_GetObjectItem(root, "id");
+    cJSON *motor_id = cJSON_GetObjectItem(root, "motor_id");
+    cJSON *metadata = cJSON_GetObjectItem(root, "metadata");
+    std::string_view action_char = cJSON_IsString(action) ? action->valuestring : "";
+    if (action_char == "add" && cJSON_IsNumber(motor_id) && cJSON_IsString(metadata)) {
+        int new_id = manager.addFilament(motor_id->valueint, metadata->valuestring);
+        response = R"({"success": true, "id": )" + std::to_string(new_id) + "}";
+    } else if (action_char == "remove" && cJSON_IsNumber(id)) {
+        manager.removeFilament(id->valueint);
+        response = R"({"success": true})";
+    } else if (action_char == "update" && cJSON_IsNumber(id)) {
+        manager.updateFilament(id->valueint, -1,
+                               cJSON_IsString(metadata) ? metadata->valuestring : "");
+        response = R"({"success": true})";
+    } else if (action_char == "list" && cJSON_IsNumber(id)) {
+        FilamentManager::Reader table = manager.read();
+        const Filament *filament = table->getFilamentById(id->valueint);
+        cJSON *filament_json = cJSON_CreateObject();
+        cJSON_AddNumberToObject(filament_json, "id", filament->id);
+        cJSON_AddNumberToObject(filament_json, "motor_id", filament->motor_id);
+        cJSON_AddStringToObject(filament_json, "metadata", filament->metadata);
+        char *json_str = cJSON_Print(filament_json);
+        response = json_str;
+        cJSON_free(json_str);
+        cJSON_Delete(filament_json);
+    } else {
+        response = R"({"error": "Unknown action"})";
+    }
+}
+
+static esp_err_t legacy_handle(FilamentManager &manager, httpd_req_t *req) {
+    httpd_ws_frame_t ws_pkt;
+    memset(&ws_pkt, 0, sizeof(ws_pkt));
+    esp_err_t ret = httpd_ws_recv_frame(req, &ws_pkt, 0);
+    if (ret != ESP_OK || ws_pkt.len == 0) {
+        return ret;
+    }
+    uint8_t *buf = (uint8_t *)calloc(1, ws_pkt.len + 1);
+    ws_pkt.payload = buf;
+    ret = httpd_ws_recv_frame(req, &ws_pkt, ws_pkt.len);
+    if (ret == ESP_OK) {
+        std::string response;
+        cJSON *root = cJSON_Parse(reinterpret_cast<const char *>(buf));
+        if (root == nullptr) {
+            response = R"({"error": "Invalid JSON"})";
+        } else {
+            legacy_filament(manager, root, response);
+            cJSON_Delete(root);
+        }
+        httpd_ws_frame_t response_pkt;
+        memset(&response_pkt, 0, sizeof(response_pkt));
+        response_pkt.type = HTTPD_WS_TYPE_TEXT;
+        response_pkt.payload = (uint8_t *)response.c_str();
+        response_pkt.len = response.length();
+        ret = httpd_ws_send_frame(req, &response_pkt);
+    }
+    free(buf);
+    return ret;
+}
+
+static LoadResult run_load(FilamentManager &manager, WSFramePool *pool, int client_count,
+                           uint32_t frames_per_client) {
+    for (int i = 0; i < client_count; i++) {
+        Client &client = clients[i];
+        client.fd = 50 + i;
+        client.motor_id = i;
+        snprintf(client.metadata, sizeof(client.metadata), "{\"type\":\"PLA\"}");
+        client.id = manager.addFilament(i, client.metadata);
+        check(client.id > 0, "initial add", i);
+    }
+
+    httpd_req_t req;
+    memset(&req, 0, sizeof(req));
+    req.method = HTTP_POST;
+    req.mock_type = HTTPD_WS_TYPE_TEXT;
+    req.mock_send = on_send;
+
+    LoadResult result = {};
+    int64_t elapsed_ns = 0;
+    uint32_t allocs = 0;
+    bench_heap_reset_peak();
+    for (uint32_t n = 0; n < frames_per_client; n++) {
+        RequestKind kind = sequence[n % (sizeof(sequence) / sizeof(sequence[0]))];
+        for (int i = 0; i < client_count; i++) {
+            Client &client = clients[i];
+            build_request(client, kind, n);
+            client.response_len = 0;
+            req.mock_fd = client.fd;
+            req.mock_payload = reinterpret_cast<const uint8_t *>(client.request);
+            req.mock_len = client.request_len;
+            req.mock_ctx = &client;
+
+            uint32_t allocs_before = bench_alloc_count();
+            int64_t start = bench_time_ns();
+            esp_err_t ret = pool ? pool->handle(&req, WS_HANDLER(WSDispatcher::handle), &dispatcher)
+                                 : legacy_handle(manager, &req);
+            elapsed_ns += bench_time_ns() - start;
+            allocs += bench_alloc_count() - allocs_before;
+
+            check(ret == ESP_OK && client.response_len > 0, "no response", i);
+            verify_response(manager, client, kind, i);
+            result.frames++;
+        }
+    }
+
+    result.frames_per_sec = elapsed_ns ? result.frames * 1e9 / elapsed_ns : 0;
+    result.allocs_per_frame = result.frames ? (double)allocs / result.frames : 0;
+    result.peak_heap = bench_heap_peak();
+    result.heap_growth = bench_heap_used();
+    for (int i = 0; i < client_count; i++) {
+        manager.removeFilament(clients[i].id);
+        if (pool) {
+            pool->release(clients[i].fd);
+        }
+    }
+    return result;
+}
+
+static void print_result(const char *mode, int client_count, const LoadResult &result) {
+    printf("TEST ws_load_%s clients=%d frames=%" PRIu32
+           " frames_per_sec=%.0f allocs_per_frame=%.2f peak_heap=%zu\n",
+           mode, client_count, result.frames, result.frames_per_sec, result.allocs_per_frame,
+           result.peak_heap);
+}
+
+// 原地解析的边界情况
+static void test_parser() {
+    static WSJson json;
+    char text[] = R"({"s": "a\"b\\cé😀", "n": -12.7, "b": true, "a": [1, "x", {}],)"
+                  R"( "o": {"k": null}})";
+    check(json.parse(text, strlen(text)), "parse", -1);
+    WSJsonValue root = json.root();
+    check(strcmp(root["s"].str(), "a\"b\\c\xc3\xa9\xf0\x9f\x98\x80") == 0, "unescape", -1);
+    int n = 0;
+    check(root["n"].toInt(n) && n == -12, "number", -1);
+    bool b = false;
+    check(root["b"].toBool(b) && b, "bool", -1);
+    check(root["a"].size() == 3 && root["a"].first().next().view() == "x", "array", -1);
+    check(root["o"]["k"].type() == WS_JSON_NULL && !root["o"]["missing"], "nested", -1);
+    check(!root["missing"]["deeper"].isString(), "missing chain", -1);
+
+    const char *invalid[] = {"", "{", R"({"a" 1})", R"({"a": [1,]})", R"({"a": tru})",
+                             R"({"a": "x)", R"({"a": 01x})", "{} {}"};
+    for (const char *s : invalid) {
+        char copy[32];
+        strcpy(copy, s);
+        check(!json.parse(copy, strlen(copy)), "invalid accepted", -1);
+    }
+
+    // 超出 token 数
+    char many[WS_JSON_MAX_TOKENS * 2 + 8];
+    size_t len = 0;
+    many[len++] = '[';
+    for (int i = 0; i < WS_JSON_MAX_TOKENS; i++) {
+        many[len++] = '1';
+        many[len++] = ',';
+    }
+    many[len - 1] = ']';
+    check(!json.parse(many, len) && json.overflow(), "token overflow", -1);
+}
+
+// CBOR 解析：键编号、定长 / 不定长容器、各种数值，以及从 JSON 转换后的往返
+static void test_cbor_parser() {
+    static WSJson json;
+    // {1: "filament", "x": [-5, 1.5 (f16), 2.25 (f32)], 3: 300, 99: true}，外层为定长对象
+    const uint8_t doc[] = {0xA4, 0x01, 0x68, 'f',  'i',  'l',  'a',  'm',  'e',  'n',  't',
+                           0x61, 'x',  0x9F, 0x24, 0xF9, 0x3E, 0x00, 0xFA, 0x40, 0x10, 0x00,
+                           0x00, 0xFF, 0x03, 0x19, 0x01, 0x2C, 0x18, 0x63, 0xF5};
+    char buf[sizeof(doc) + 1];
+    memcpy(buf, doc, sizeof(doc));
+    check(json.parseCbor(buf, sizeof(doc)), "cbor parse", -1);
+    WSJsonValue root = json.root();
+    check(root.size() == 4 && strcmp(root["type"].str(), "filament") == 0, "cbor key id", -1);
+    int n = 0;
+    WSJsonValue x = root["x"];
+    check(x.size() == 3 && x.first().toInt(n) && n == -5, "cbor negative", -1);
+    check(x.first().next().toInt(n) && n == 1, "cbor half float", -1);
+    check(x.first().next().next().toInt(n) && n == 2, "cbor float", -1);
+    check(root["id"].toInt(n) && n == 300, "cbor uint16", -1);
+    int keys = 0;
+    for (WSJsonValue member = root.first(); member; member = member.next()) {
+        keys++;
+    }
+    check(keys == 4 && !root[""], "cbor unknown key", -1);
+
+    const uint8_t invalid[][4] = {{0xBF, 0x01}, {0xA1, 0xF5, 0x01}, {0x5F, 0xFF}, {0xA0, 0x00}};
+    const size_t invalid_len[] = {2, 3, 2, 2};
+    for (size_t i = 0; i < sizeof(invalid_len) / sizeof(invalid_len[0]); i++) {
+        memcpy(buf, invalid[i], invalid_len[i]);
+        check(!json.parseCbor(buf, invalid_len[i]), "invalid cbor accepted", -1);
+    }
+
+    // 连续的标签逐个跳过，不随标签数递归 (一帧内的 1535 个标签曾耗尽 httpd 任务栈)
+    static char tagged[WS_FRAME_RX_SIZE];
+    size_t tags = sizeof(tagged) - 1;
+    memset(tagged, 0xC6, tags);
+    tagged[tags] = 0x00;
+    check(json.parseCbor(tagged, tags + 1) && json.root().toInt(n) && n == 0, "chained tags",
+          -1);
+    memset(tagged, 0xC6, tags);
+    check(!json.parseCbor(tagged, tags), "tags without a value accepted", -1);
+
+    // 转换后再解析，字符串转义还原
+    char text[] = R"({"success": true, "ids": [1, -2], "message": "a\"bé\n", "n": null,)"
+                  R"( "unknown_key": 2.5})";
+    char cbor[128];
+    CborWriter w(cbor, sizeof(cbor));
+    check(ws_cbor_from_json(text, w), "json to cbor", -1);
+    check(json.parseCbor(cbor, w.length()), "cbor roundtrip", -1);
+    root = json.root();
+    bool b = false;
+    check(root["success"].toBool(b) && b && root["ids"].size() == 2, "roundtrip values", -1);
+    check(strcmp(root["message"].str(), "a\"b\xc3\xa9\n") == 0, "roundtrip escapes", -1);
+    check(root["n"].type() == WS_JSON_NULL && root["unknown_key"].toInt(n) && n == 2,
+          "roundtrip text key", -1);
+    CborWriter small(cbor, 8);
+    check(!ws_cbor_from_json(text, small), "cbor overflow", -1);
+}
+
+// 以 CBOR 子协议握手的连接：请求和响应都是二进制帧，内容与 JSON 相同
+static void test_cbor_client(WSFramePool &pool, FilamentManager &manager) {
+    static Client client;
+    httpd_req_t req;
+    memset(&req, 0, sizeof(req));
+    req.method = HTTP_GET;
+    req.mock_fd = 98;
+    req.mock_protocol = WS_PROTOCOL_CBOR;
+    pool.open(&req);
+    check(pool.encoding(98) == WS_ENCODING_CBOR, "cbor negotiated", -1);
+
+    const char *metadata = "{\"type\":\"PLA\",\"note\":\"caf\xc3\xa9\"}";
+    CborWriter w(client.request, sizeof(client.request));
+    w.beginMap().key(WS_KEY_type).str("filament").key(WS_KEY_action).str("add");
+    w.key(WS_KEY_motor_id).num(7).key(WS_KEY_metadata).str(metadata).end();
+    req.method = HTTP_POST;
+    req.mock_type = HTTPD_WS_TYPE_BINARY;
+    req.mock_payload = reinterpret_cast<const uint8_t *>(client.request);
+    req.mock_len = w.length();
+    req.mock_send = on_send;
+    req.mock_ctx = &client;
+    check(pool.handle(&req, WS_HANDLER(WSDispatcher::handle), &dispatcher) == ESP_OK, "cbor add",
+          -1);
+
+    static WSJson json;
+    int id = 0;
+    bool success = false;
+    check(json.parseCbor(client.response, client.response_len), "cbor response", -1);
+    check(json.root()["success"].toBool(success) && success && json.root()["id"].toInt(id),
+          "cbor add response", -1);
+    {
+        FilamentManager::Reader table = manager.read();
+        const Filament *filament = table->getFilamentById(id);
+        check(filament != nullptr && strcmp(filament->metadata, metadata) == 0, "cbor metadata",
+              -1);
+    }
+
+    // 响应由处理函数直接编码为 CBOR，元数据中的引号不经过 JSON 转义
+    w = CborWriter(client.request, sizeof(client.request));
+    w.beginMap().key(WS_KEY_type).str("filament").key(WS_KEY_action).str("list");
+    w.key(WS_KEY_id).num(id).end();
+    req.mock_len = w.length();
+    check(pool.handle(&req, WS_HANDLER(WSDispatcher::handle), &dispatcher) == ESP_OK &&
+              json.parseCbor(client.response, client.response_len),
+          "cbor list", -1);
+    const char *listed = json.root()["metadata"].str();
+    check(listed != nullptr && strcmp(listed, metadata) == 0, "cbor list metadata", -1);
+
+    // 二进制帧中的无效文档
+    client.request[0] = 0x5F;
+    req.mock_len = 1;
+    pool.handle(&req, WS_HANDLER(WSDispatcher::handle), &dispatcher);
+    check(json.parseCbor(client.response, client.response_len) &&
+              json.root()["error"].view() == "Invalid CBOR",
+          "invalid cbor response", -1);
+    manager.removeFilament(id);
+    pool.release(98);
+    check(pool.encoding(98) == WS_ENCODING_JSON, "encoding released", -1);
+}
+
+// 客户端提供多个子协议时，列表中有 CBOR 子协议即按 CBOR 收发 (httpd 在握手中确认了它)
+static void test_protocols(WSFramePool &pool) {
+    static const struct {
+        const char *offered;
+        WSEncoding encoding;
+    } CASES[] = {
+        {WS_PROTOCOL_CBOR ", json", WS_ENCODING_CBOR},
+        {"json," WS_PROTOCOL_CBOR, WS_ENCODING_CBOR},
+        {"json , " WS_PROTOCOL_CBOR " ", WS_ENCODING_CBOR},
+        {"json", WS_ENCODING_JSON},
+        {WS_PROTOCOL_CBOR "x, json", WS_ENCODING_JSON},
+        {"", WS_ENCODING_JSON},
+        {nullptr, WS_ENCODING_JSON},
+    };
+    httpd_req_t req;
+    memset(&req, 0, sizeof(req));
+    req.method = HTTP_GET;
+    req.mock_fd = 97;
+    for (const auto &item : CASES) {
+        req.mock_protocol = item.offered;
+        pool.open(&req);
+        check(pool.encoding(97) == item.encoding, item.offered ? item.offered : "no protocol", -1);
+        pool.release(97);
+    }
+}
+
+template <typename Enc> static void handle_echo(void *ctx, const WSArgs &args, Enc &response) {
+    response.beginMap().key(WS_KEY_key).str(static_cast<const char *>(ctx));
+    response.key(WS_KEY_value).num(args.toInt(0, -1)).end();
+}
+
+static const WSParam ECHO_PARAMS[] = {
+    {"value", WS_PARAM_INT, false},
+};
+
+static const WSCommand ECHO_COMMANDS[] = {
+    {"a", WS_HANDLER(handle_echo), WS_PARAMS(ECHO_PARAMS)},
+    {"b", WS_HANDLER(handle_echo), WS_PARAMS(ECHO_PARAMS)},
+};
+
+static const WSCommand ECHO_EXTRA[] = {
+    {"c", WS_HANDLER(handle_echo), nullptr, 0},
+};
+
+// 两个对象的成员相同，只比较字符串和整数值
+static bool same_members(const WSJsonValue &a, const WSJsonValue &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (WSJsonValue key = a.first(); key; key = key.next()) {
+        WSJsonValue x = key.value();
+        WSJsonValue y = b[key.view()];
+        int xi = 0;
+        int yi = 0;
+        bool same = x.isString() ? y.isString() && x.view() == y.view()
+                                 : x.toInt(xi) && y.toInt(yi) && xi == yi;
+        if (!same) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 分发表：查找、selector、参数校验和注册冲突，两种编码的响应
+static void test_dispatcher() {
+    static WSDispatcher d;
+    static const WSModule echo = {"echo", "key", "Unknown key", ECHO_COMMANDS, 2};
+    static const WSModule extra = {"echo", "key", nullptr, ECHO_EXTRA, 1};
+    static const WSModule conflict = {"echo", "action", nullptr, ECHO_EXTRA, 1};
+    check(d.add(echo, (void *)"echo"), "dispatcher add", -1);
+    check(d.add(extra, (void *)"extra"), "dispatcher add to type", -1);
+    check(!d.add(extra, nullptr), "dispatcher duplicate", -1);
+    check(!d.add(conflict, nullptr), "dispatcher selector mismatch", -1);
+    check(d.commandCount() == 3, "dispatcher count", -1);
+
+    const struct {
+        const char *request;
+        const char *response;
+    } cases[] = {
+        {R"({"type": "echo", "key": "a", "value": 3})", R"({"key":"echo","value":3})"},
+        {R"({"type": "echo", "key": "b"})", R"({"key":"echo","value":-1})"},
+        {R"({"type": "echo", "key": "c", "value": "x"})", R"({"key":"extra","value":-1})"},
+        {R"({"type": "echo", "key": "a", "value": "x"})", R"({"error":"Invalid parameters"})"},
+        {R"({"type": "echo", "key": "d"})", R"({"error":"Unknown key"})"},
+        {R"({"type": "echo"})", R"({"error":"Missing or invalid key"})"},
+        {R"({"type": "other"})", R"({"error":"Unknown type"})"},
+        {R"({"key": "a"})", R"({"error":"Missing or invalid action"})"},
+    };
+    static WSJson json;
+    static WSJson cbor_json;
+    static char text[128];
+    char out[128];
+    char cbor[128];
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        size_t len = strlen(cases[i].request);
+        memcpy(text, cases[i].request, len);
+        check(json.parse(text, len), "dispatcher parse", (int)i);
+        WSJsonWriter w(out, sizeof(out));
+        d.dispatch(1, json.root(), w);
+        check(w.ok() && std::string_view(w.data(), w.length()) == cases[i].response,
+              "dispatcher response", (int)i);
+        // 同一处理函数的 CBOR 实例输出相同的成员
+        CborWriter c(cbor, sizeof(cbor));
+        d.dispatch(1, json.root(), c);
+        check(c.ok() && cbor_json.parseCbor(cbor, c.length()), "dispatcher cbor", (int)i);
+        check(json.parse(out, w.length()) && same_members(json.root(), cbor_json.root()),
+              "dispatcher cbor response", (int)i);
+    }
+}
+
+// batch 的每个操作按对应单条命令的参数表校验，任一无效时全部回滚
+static void test_filament_batch(FilamentManager &manager) {
+    int id = manager.addFilament(15, R"({"type":"PLA"})");
+    check(id > 0, "batch fixture", -1);
+    char ok_response[64];
+    snprintf(ok_response, sizeof(ok_response), R"({"success":true,"ids":[%d]})", id);
+    const struct {
+        const char *ops; // %d 替换为 id
+        const char *response;
+    } cases[] = {
+        {R"([{"action": "add", "motor_id": 14, "metadata": "{}"}, )"
+         R"({"action": "update", "id": "x"}])",
+         R"({"error":"Invalid parameters","index":1})"},
+        {R"([{"action": "update", "id": %d, "metadata": 5}])",
+         R"({"error":"Invalid parameters","index":0})"},
+        {R"([{"action": "add", "motor_id": 14}])", R"({"error":"Invalid parameters","index":0})"},
+        {R"([{"action": "move", "id": %d}])", R"({"error":"Unknown action","index":0})"},
+        {R"([{"id": %d}])", R"({"error":"Missing or invalid action","index":0})"},
+        {R"([{"action": "update", "id": %d, "motor_id": 13}])", ok_response},
+    };
+    static WSJson json;
+    static char text[256];
+    char ops[160];
+    char out[128];
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        snprintf(ops, sizeof(ops), cases[i].ops, id);
+        int len = snprintf(text, sizeof(text),
+                           R"({"type": "filament", "action": "batch", "ops": %s})", ops);
+        check(json.parse(text, len), "batch parse", (int)i);
+        WSJsonWriter w(out, sizeof(out));
+        dispatcher.dispatch(1, json.root(), w);
+        check(w.ok() && std::string_view(w.data(), w.length()) == cases[i].response,
+              "batch response", (int)i);
+    }
+    FilamentManager::Reader table = manager.read();
+    check(table->getFilamentByMotorId(14) == nullptr, "invalid batch not rolled back", -1);
+    const Filament *filament = table->getFilamentById(id);
+    check(filament != nullptr && filament->motor_id == 13 &&
+              strcmp(filament->metadata, R"({"type":"PLA"})") == 0,
+          "batch update", -1);
+}
+
+// 超过接收缓冲区的帧返回错误，httpd 随后关闭连接
+static void test_oversize(WSFramePool &pool, FilamentManager &manager) {
+    static char big[WS_FRAME_RX_SIZE + 16];
+    memset(big, ' ', sizeof(big));
+    httpd_req_t req;
+    memset(&req, 0, sizeof(req));
+    req.mock_fd = 99;
+    req.mock_type = HTTPD_WS_TYPE_TEXT;
+    req.mock_payload = reinterpret_cast<const uint8_t *>(big);
+    req.mock_len = sizeof(big);
+    check(pool.handle(&req, WS_HANDLER(WSDispatcher::handle), &dispatcher) == ESP_ERR_INVALID_SIZE,
+          "oversize frame", -1);
+    pool.release(99);
+}
+
+int main(int argc, char **argv) {
+    int client_count = 6;
+    uint32_t frames_per_client = 20000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:")) != -1) {
+        switch (opt) {
+            case 'c':
+                client_count = atoi(optarg);
+                break;
+            case 'n':
+                frames_per_client = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-c clients] [-n frames_per_client]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (client_count < 1 || client_count > MAX_CLIENTS) {
+        fprintf(stderr, "clients must be in [1, %d]\n", MAX_CLIENTS);
+        return 2;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    test_parser();
+    test_cbor_parser();
+
+    static FilamentManager legacy_manager;
+    LoadResult legacy = run_load(legacy_manager, nullptr, client_count, frames_per_client);
+    print_result("legacy", client_count, legacy);
+
+    test_dispatcher();
+
+    static FilamentManager manager;
+    static WSFilamentModule filaments = {&manager, nullptr, nullptr};
+    check(ws_filament_register(dispatcher, filaments), "register filament", -1);
+    static WSFramePool pool;
+    LoadResult result = run_load(manager, &pool, client_count, frames_per_client);
+    print_result("pool", client_count, result);
+    check(pool.stats().in_use == 0, "frame buffers not released", -1);
+    check(result.allocs_per_frame == 0, "frame path allocated", -1);
+    check(result.heap_growth == 0, "heap did not return to baseline", -1);
+    test_oversize(pool, manager);
+    test_cbor_client(pool, manager);
+    test_protocols(pool);
+    test_filament_batch(manager);
+
+    if (failures) {
+        printf("FAILED: %d checks\n", failures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
@@ -5,9 +5,11 @@
 
 #pragma once
 
-// 带参数模板的格式化函数
-#include <sstream>
-#include <string>
+#include <atomic>
+#include <limits>
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
 
 namespace BambuCmd {
 /*
@@ -202,106 +204,338 @@ constexpr const char *BUZZER_SET_ALARM =
 constexpr const char *BUZZER_SET_BEEPING =
     R"({"print":{"sequence_id":"0","command":"buzzer_ctrl","mode":2,"reason":""}})";
 
+/**
+ * @brief 命令构造器，写入调用者提供的定长缓冲区，不分配堆内存
+ *
+ * 所有方法均为 constexpr，可以在编译期验证输出。缓冲区不足时截断并标记溢出，
+ * 此时 ok() 返回 false，调用者不应发送该命令。输出始终以 '\0' 结尾。
+ */
+class Writer {
+public:
+    constexpr Writer(char *buf, size_t size) : buf_(buf), size_(size), len_(0), overflow_(false) {
+        if (size_ > 0) {
+            buf_[0] = '\0';
+        }
+    }
+
+    template <size_t N> constexpr explicit Writer(char (&buf)[N]) : Writer(buf, N) {}
+
+    constexpr Writer &raw(std::string_view s) {
+        for (char c : s) {
+            put(c);
+        }
+        return *this;
+    }
+
+    // 写入带引号的 JSON 字符串，转义引号、反斜杠和控制字符
+    constexpr Writer &str(std::string_view s) {
+        constexpr char hex[] = "0123456789abcdef";
+        put('"');
+        for (char c : s) {
+            switch (c) {
+                case '"':
+                    raw("\\\"");
+                    break;
+                case '\\':
+                    raw("\\\\");
+                    break;
+                case '\n':
+                    raw("\\n");
+                    break;
+                case '\r':
+                    raw("\\r");
+                    break;
+                case '\t':
+                    raw("\\t");
+                    break;
+                case '\b':
+                    raw("\\b");
+                    break;
+                case '\f':
+                    raw("\\f");
+                    break;
+                default:
+                    if (static_cast<uint8_t>(c) < 0x20) {
+                        raw("\\u00");
+                        put(hex[(c >> 4) & 0xF]);
+                        put(hex[c & 0xF]);
+                    } else {
+                        put(c);
+                    }
+                    break;
+            }
+        }
+        put('"');
+        return *this;
+    }
+
+    constexpr Writer &num(long v) {
+        // 按 long 的实际宽度 (设备上 32 位，主机上 64 位)，符号单独写入
+        char digits[std::numeric_limits<unsigned long>::digits10 + 1] = {};
+        size_t n = 0;
+        unsigned long u = v < 0 ? 0ul - static_cast<unsigned long>(v) : static_cast<unsigned long>(v);
+        do {
+            digits[n++] = static_cast<char>('0' + u % 10);
+            u /= 10;
+        } while (u > 0);
+        if (v < 0) {
+            put('-');
+        }
+        while (n > 0) {
+            put(digits[--n]);
+        }
+        return *this;
+    }
+
+    constexpr Writer &boolean(bool v) { return raw(v ? "true" : "false"); }
+
+    constexpr Writer &chr(char c) {
+        put(c);
+        return *this;
+    }
+
+    // "sequence_id":"<seq>"，打印机回复中会原样带回
+    constexpr Writer &seq(uint32_t seq) {
+        raw(R"("sequence_id":")");
+        num(seq);
+        return raw("\"");
+    }
+
+    constexpr const char *c_str() const { return buf_; }
+    constexpr size_t length() const { return len_; }
+    constexpr std::string_view view() const { return std::string_view(buf_, len_); }
+    constexpr bool ok() const { return !overflow_; }
+
+private:
+    constexpr void put(char c) {
+        if (len_ + 1 < size_) {
+            buf_[len_++] = c;
+            buf_[len_] = '\0';
+        } else {
+            overflow_ = true;
+        }
+    }
+
+    char *buf_;
+    size_t size_;
+    size_t len_;
+    bool overflow_;
+};
+
+/**
+ * @brief 生成下一个 sequence_id
+ */
+inline uint32_t NextSequenceId() {
+    static std::atomic<uint32_t> next_seq{1};
+    return next_seq.fetch_add(1, std::memory_order_relaxed);
+}
+
+// 无参数命令: {"<group>":{"sequence_id":"<seq>","command":"<command>"}}
+// 例如 SimpleCmd(w, "pushing", "pushall") 对应 PUSH_ALL
+constexpr bool SimpleCmd(Writer &w, std::string_view group, std::string_view command,
+                         uint32_t seq) {
+    w.raw("{").str(group).raw(":{").seq(seq).raw(R"(,"command":)").str(command).raw("}}");
+    return w.ok();
+}
+
+inline bool SimpleCmd(Writer &w, std::string_view group, std::string_view command) {
+    return SimpleCmd(w, group, command, NextSequenceId());
+}
+
 // SPEED_PROFILE_TEMPLATE: param
-inline std::string SpeedProfileCmd(const std::string &param) {
-    std::ostringstream oss;
-    oss << R"({"print":{"sequence_id":"0","command":"print_speed","param":")" << param << R"("}})";
-    return oss.str();
+constexpr bool SpeedProfileCmd(Writer &w, std::string_view param, uint32_t seq) {
+    w.raw(R"({"print":{)").seq(seq).raw(R"(,"command":"print_speed","param":)").str(param);
+    w.raw("}}");
+    return w.ok();
+}
+
+inline bool SpeedProfileCmd(Writer &w, std::string_view param) {
+    return SpeedProfileCmd(w, param, NextSequenceId());
+}
+
+// SEND_GCODE_TEMPLATE: param，gcode 中的换行等字符会被转义
+constexpr bool SendGcodeCmd(Writer &w, std::string_view gcode, uint32_t seq) {
+    w.raw(R"({"print":{)").seq(seq).raw(R"(,"command":"gcode_line","param":)").str(gcode);
+    w.raw("}}");
+    return w.ok();
 }
 
-// SEND_GCODE_TEMPLATE: param
-inline std::string SendGcodeCmd(const std::string &gcode) {
-    std::ostringstream oss;
-    oss << R"({"print":{"sequence_id":"0","command":"gcode_line","param":")" << gcode << R"("}})";
-    return oss.str();
+inline bool SendGcodeCmd(Writer &w, std::string_view gcode) {
+    return SendGcodeCmd(w, gcode, NextSequenceId());
 }
 
 // // UPGRADE_CONFIRM_TEMPLATE: model, version, hash, stamp
-// inline std::string UpgradeConfirmCmd(const std::string& model, const std::string& version, const std::string& hash, const std::string& stamp) {
-//     std::ostringstream oss;
-//     oss << R"({"upgrade":{"command":"upgrade_confirm","module":"ota","reason":"","result":"success","sequence_id":"0","src_id":2,"upgrade_type":4,"url":"https://public-cdn.bblmw.com/upgrade/device/)"
-//         << model << "/" << version << "/product/" << hash << "/" << stamp << R"(.json.sig","version":")" << version << R"("}})";
-//     return oss.str();
+// constexpr bool UpgradeConfirmCmd(Writer &w, std::string_view model, std::string_view version,
+//                                  std::string_view hash, std::string_view stamp, uint32_t seq) {
+//     w.raw(R"({"upgrade":{"command":"upgrade_confirm","module":"ota","reason":"","result":"success",)")
+//         .seq(seq)
+//         .raw(R"(,"src_id":2,"upgrade_type":4,"url":"https://public-cdn.bblmw.com/upgrade/device/)")
+//         .raw(model).chr('/').raw(version).raw("/product/").raw(hash).chr('/').raw(stamp)
+//         .raw(R"(.json.sig","version":)").str(version).raw("}}");
+//     return w.ok();
 // }
 
 // // PRINT_PROJECT_FILE_TEMPLATE: param, url, bed_type, timelapse, bed_leveling, flow_cali, vibration_cali, layer_inspect, use_ams, ams_mapping, subtask_name, profile_id, project_id, subtask_id, task_id
-// inline std::string PrintProjectFileCmd(
-//     const std::string& param,
-//     const std::string& url,
-//     const std::string& bed_type = "auto",
-//     bool timelapse = false,
-//     bool bed_leveling = true,
-//     bool flow_cali = true,
-//     bool vibration_cali = true,
-//     bool layer_inspect = true,
-//     bool use_ams = false,
-//     const std::string& ams_mapping = "[0]",
-//     const std::string& subtask_name = "",
-//     const std::string& profile_id = "0",
-//     const std::string& project_id = "0",
-//     const std::string& subtask_id = "0",
-//     const std::string& task_id = "0"
-// ) {
-//     std::ostringstream oss;
-//     oss << R"({"print":{"sequence_id":0,"command":"project_file","param":")" << param
-//         << R"(","url":")" << url
-//         << R"(","bed_type":")" << bed_type
-//         << R"(","timelapse":)" << (timelapse ? "true" : "false")
-//         << R"(,"bed_leveling":)" << (bed_leveling ? "true" : "false")
-//         << R"(,"flow_cali":)" << (flow_cali ? "true" : "false")
-//         << R"(,"vibration_cali":)" << (vibration_cali ? "true" : "false")
-//         << R"(,"layer_inspect":)" << (layer_inspect ? "true" : "false")
-//         << R"(,"use_ams":)" << (use_ams ? "true" : "false")
-//         << R"(,"ams_mapping":)" << ams_mapping
-//         << R"(,"subtask_name":")" << subtask_name
-//         << R"(","profile_id":")" << profile_id
-//         << R"(","project_id":")" << project_id
-//         << R"(","subtask_id":")" << subtask_id
-//         << R"(","task_id":")" << task_id
-//         << R"("}})";
-//     return oss.str();
+// constexpr bool PrintProjectFileCmd(Writer &w, std::string_view param, std::string_view url,
+//                                    std::string_view bed_type, bool timelapse, bool bed_leveling,
+//                                    bool flow_cali, bool vibration_cali, bool layer_inspect,
+//                                    bool use_ams, std::string_view ams_mapping,
+//                                    std::string_view subtask_name, uint32_t seq) {
+//     w.raw(R"({"print":{)").seq(seq).raw(R"(,"command":"project_file","param":)").str(param)
+//         .raw(R"(,"url":)").str(url)
+//         .raw(R"(,"bed_type":)").str(bed_type)
+//         .raw(R"(,"timelapse":)").boolean(timelapse)
+//         .raw(R"(,"bed_leveling":)").boolean(bed_leveling)
+//         .raw(R"(,"flow_cali":)").boolean(flow_cali)
+//         .raw(R"(,"vibration_cali":)").boolean(vibration_cali)
+//         .raw(R"(,"layer_inspect":)").boolean(layer_inspect)
+//         .raw(R"(,"use_ams":)").boolean(use_ams)
+//         .raw(R"(,"ams_mapping":)").raw(ams_mapping)
+//         .raw(R"(,"subtask_name":)").str(subtask_name)
+//         .raw(R"(,"profile_id":"0","project_id":"0","subtask_id":"0","task_id":"0"}})");
+//     return w.ok();
 // }
 
 // // SKIP_OBJECTS_TEMPLATE: obj_list (json array string)
-// inline std::string SkipObjectsCmd(const std::string& obj_list_json) {
-//     std::ostringstream oss;
-//     oss << R"({"print":{"sequence_id":"0","command":"skip_objects","obj_list":)" << obj_list_json << "}}";
-//     return oss.str();
+// constexpr bool SkipObjectsCmd(Writer &w, std::string_view obj_list_json, uint32_t seq) {
+//     w.raw(R"({"print":{)").seq(seq).raw(R"(,"command":"skip_objects","obj_list":)")
+//         .raw(obj_list_json).raw("}}");
+//     return w.ok();
 // }
 
 // SWITCH_AMS_TEMPLATE: target, curr_temp, tar_temp
-inline std::string SwitchAmsCmd(int target, int curr_temp, int tar_temp) {
-    std::ostringstream oss;
-    oss << R"({"print":{"command":"ams_change_filament","sequence_id":"0","target":)" << target
-        << R"(,"curr_temp":)" << curr_temp << R"(,"tar_temp":)" << tar_temp << "}}";
-    return oss.str();
+constexpr bool SwitchAmsCmd(Writer &w, int target, int curr_temp, int tar_temp, uint32_t seq) {
+    w.raw(R"({"print":{"command":"ams_change_filament",)").seq(seq);
+    w.raw(R"(,"target":)").num(target);
+    w.raw(R"(,"curr_temp":)").num(curr_temp);
+    w.raw(R"(,"tar_temp":)").num(tar_temp).raw("}}");
+    return w.ok();
+}
+
+inline bool SwitchAmsCmd(Writer &w, int target, int curr_temp, int tar_temp) {
+    return SwitchAmsCmd(w, target, curr_temp, tar_temp, NextSequenceId());
 }
 
 // AMS_FILAMENT_SETTING_TEMPLATE: ams_id, tray_id, tray_info_idx, tray_color, nozzle_temp_min, nozzle_temp_max, tray_type
-inline std::string AmsFilamentSettingCmd(int ams_id, int tray_id, const std::string &tray_info_idx,
-                                         const std::string &tray_color, int nozzle_temp_min,
-                                         int nozzle_temp_max, const std::string &tray_type) {
-    std::ostringstream oss;
-    oss << R"({"print":{"sequence_id":"0","command":"ams_filament_setting","ams_id":)" << ams_id
-        << R"(,"tray_id":)" << tray_id << R"(,"tray_info_idx":")" << tray_info_idx
-        << R"(","tray_color":")" << tray_color << R"(","nozzle_temp_min":)" << nozzle_temp_min
-        << R"(,"nozzle_temp_max":)" << nozzle_temp_max << R"(,"tray_type":")" << tray_type
-        << R"("}})";
-    return oss.str();
-}
-
-// MOVE_AXIS_GCODE: axis, distance, speed
-inline std::string MoveAxisGcode(char axis, int distance, int speed) {
-    std::ostringstream oss;
-    oss << "M211 S\nM211 X1 Y1 Z1\nM1002 push_ref_mode\nG91 \nG1 " << axis << distance << ".0 F"
-        << speed << "\nM1002 pop_ref_mode\nM211 R\n";
-    return oss.str();
+constexpr bool AmsFilamentSettingCmd(Writer &w, int ams_id, int tray_id,
+                                     std::string_view tray_info_idx, std::string_view tray_color,
+                                     int nozzle_temp_min, int nozzle_temp_max,
+                                     std::string_view tray_type, uint32_t seq) {
+    w.raw(R"({"print":{)").seq(seq).raw(R"(,"command":"ams_filament_setting")");
+    w.raw(R"(,"ams_id":)").num(ams_id);
+    w.raw(R"(,"tray_id":)").num(tray_id);
+    w.raw(R"(,"tray_info_idx":)").str(tray_info_idx);
+    w.raw(R"(,"tray_color":)").str(tray_color);
+    w.raw(R"(,"nozzle_temp_min":)").num(nozzle_temp_min);
+    w.raw(R"(,"nozzle_temp_max":)").num(nozzle_temp_max);
+    w.raw(R"(,"tray_type":)").str(tray_type).raw("}}");
+    return w.ok();
+}
+
+inline bool AmsFilamentSettingCmd(Writer &w, int ams_id, int tray_id,
+                                  std::string_view tray_info_idx, std::string_view tray_color,
+                                  int nozzle_temp_min, int nozzle_temp_max,
+                                  std::string_view tray_type) {
+    return AmsFilamentSettingCmd(w, ams_id, tray_id, tray_info_idx, tray_color, nozzle_temp_min,
+                                 nozzle_temp_max, tray_type, NextSequenceId());
+}
+
+// MOVE_AXIS_GCODE: axis, distance, speed (纯 G-code，配合 SendGcodeCmd 使用)
+constexpr bool MoveAxisGcode(Writer &w, char axis, int distance, int speed) {
+    w.raw("M211 S\nM211 X1 Y1 Z1\nM1002 push_ref_mode\nG91 \nG1 ").chr(axis).num(distance);
+    w.raw(".0 F").num(speed).raw("\nM1002 pop_ref_mode\nM211 R\n");
+    return w.ok();
 }
 
 // EXTRUDER_GCODE: distance
-inline std::string ExtruderGcode(int distance) {
-    std::ostringstream oss;
-    oss << "M83 \nG0 E" << distance << ".0 F900\n";
-    return oss.str();
+constexpr bool ExtruderGcode(Writer &w, int distance) {
+    w.raw("M83 \nG0 E").num(distance).raw(".0 F900\n");
+    return w.ok();
+}
+
+// 编译期校验: sequence_id 为 0 时输出与上面的模板常量一致
+namespace detail {
+constexpr bool golden_switch_ams() {
+    char buf[160] = {};
+    Writer w(buf);
+    return SwitchAmsCmd(w, 255, 0, 0, 0) && w.view() == SWITCH_AMS_TEMPLATE;
+}
+
+constexpr bool golden_filament_setting() {
+    char buf[256] = {};
+    Writer w(buf);
+    return AmsFilamentSettingCmd(w, 0, 0, "", "000000FF", 0, 0, "PLA", 0) &&
+           w.view() == AMS_FILAMENT_SETTING_TEMPLATE;
+}
+
+constexpr bool golden_simple() {
+    char buf[96] = {};
+    Writer w(buf);
+    return SimpleCmd(w, "pushing", "pushall", 0) && w.view() == PUSH_ALL;
+}
+
+constexpr bool golden_gcode() {
+    char buf[128] = {};
+    Writer w(buf);
+    return SendGcodeCmd(w, "", 0) && w.view() == SEND_GCODE_TEMPLATE;
+}
+
+constexpr bool golden_speed() {
+    char buf[128] = {};
+    Writer w(buf);
+    return SpeedProfileCmd(w, "", 0) && w.view() == SPEED_PROFILE_TEMPLATE;
+}
+
+constexpr bool golden_move_axis() {
+    char buf[128] = {};
+    Writer w(buf);
+    return MoveAxisGcode(w, 'Z', -10, 600) &&
+           w.view() == "M211 S\nM211 X1 Y1 Z1\nM1002 push_ref_mode\nG91 \nG1 Z-10.0 F600\n"
+                       "M1002 pop_ref_mode\nM211 R\n";
+}
+
+constexpr bool golden_extruder() {
+    char buf[32] = {};
+    Writer w(buf);
+    return ExtruderGcode(w, 5) && w.view() == "M83 \nG0 E5.0 F900\n";
+}
+
+// 引号、反斜杠、换行和其他控制字符
+constexpr bool golden_escape() {
+    char buf[128] = {};
+    Writer w(buf);
+    return SendGcodeCmd(w, "M117 \"a\\b\"\nG28\t\x01", 0) &&
+           w.view() == R"({"print":{"sequence_id":"0","command":"gcode_line",)"
+                       R"("param":"M117 \"a\\b\"\nG28\t\u0001"}})";
+}
+
+constexpr bool golden_num_limits() {
+    char buf[48] = {};
+    Writer w(buf);
+    w.num(std::numeric_limits<long>::min()).chr(' ').num(std::numeric_limits<long>::max());
+    std::string_view expected = sizeof(long) == 8
+                                    ? "-9223372036854775808 9223372036854775807"
+                                    : "-2147483648 2147483647";
+    return w.ok() && w.view() == expected;
+}
+
+// 缓冲区不足时截断，ok() 为 false，输出仍以 '\0' 结尾
+constexpr bool golden_overflow() {
+    char buf[16] = {};
+    Writer w(buf);
+    return !SimpleCmd(w, "pushing", "pushall", 0) && w.length() == sizeof(buf) - 1 &&
+           buf[sizeof(buf) - 1] == '\0';
 }
+} // namespace detail
+
+static_assert(detail::golden_switch_ams());
+static_assert(detail::golden_filament_setting());
+static_assert(detail::golden_simple());
+static_assert(detail::golden_gcode());
+static_assert(detail::golden_speed());
+static_assert(detail::golden_move_axis());
+static_assert(detail::golden_extruder());
+static_assert(detail::golden_escape());
+static_assert(detail::golden_num_limits());
+static_assert(detail::golden_overflow());
 } // namespace BambuCmd
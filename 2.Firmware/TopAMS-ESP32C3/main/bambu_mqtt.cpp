@@ -1,10 +1,13 @@
 #include "bambu_mqtt.h"
-#include "cJSON.h"
+#include "bambu_command.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "mqtt_client.h"
 #include <cstdio>
 #include <stdint.h>
+#include <strings.h>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
 #include <string_view>
 
@@ -24,94 +27,46 @@ void BambuMQTT::mqtt_event_handler(void *handler_args, esp_event_base_t base, in
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
             self->mqtt_status_ = BAMBU_MQTT_STATUS_CONNECTED;
+            if (self->connected_us_ == 0) {
+                self->connected_us_ = esp_timer_get_time();
+                ESP_LOGI(TAG, "First connected %ld ms after boot",
+                         static_cast<long>(self->connected_us_ / 1000));
+            }
 
             // Subscribe to the report topic
             // topic: device/serial/report
-            char topic[128];
-            snprintf(topic, sizeof(topic), "%s/%s/%s", BAMBU_MQTT_TOPIC_BASE, self->serial_,
-                     BAMBU_MQTT_TOPIC_REPORT);
-            ESP_LOGI(TAG, "Subscribing to topic: %s", topic);
-            msg_id = esp_mqtt_client_subscribe(client, topic, 1);
+            ESP_LOGI(TAG, "Subscribing to topic: %s", self->report_topic_);
+            msg_id = esp_mqtt_client_subscribe(client, self->report_topic_, 1);
             if (msg_id < 0) {
                 ESP_LOGE(TAG, "Failed to subscribe to topic: %s",
                          BAMBU_MQTT_TOPIC_BASE "/" BAMBU_MQTT_TOPIC_REPORT);
             } else {
                 ESP_LOGI(TAG, "Subscribed to topic successfully, msg_id=%d", msg_id);
             }
+            if (self->resync_) {
+                // 切换打印机后状态已清空，请求一次完整上报；在 MQTT 任务中直接发布，不取锁
+                char request[BAMBU_CMD_MAX_LEN];
+                char topic[128];
+                BambuCmd::Writer w(request);
+                BambuCmd::SimpleCmd(w, "pushing", "pushall");
+                snprintf(topic, sizeof(topic), "%s/%s/%s", BAMBU_MQTT_TOPIC_BASE, self->serial_,
+                         BAMBU_MQTT_TOPIC_REQUEST);
+                if (esp_mqtt_client_publish(client, topic, request, 0, 1, 0) >= 0) {
+                    self->resync_ = false;
+                }
+            }
             break;
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
             self->mqtt_status_ = BAMBU_MQTT_STATUS_DISCONNECTED;
             break;
         case MQTT_EVENT_DATA:
-            ESP_LOGI(TAG, "MQTT_EVENT_DATA");
-            // printf("TOPIC=%.*s\r\n", event->topic_len, event->topic);
-            // printf("DATA=%.*s\r\n", event->data_len, event->data);
-            ESP_LOGI(TAG, "Received data on topic: %.*s", event->topic_len, event->topic);
+            // 只入队并立即返回，避免慢速消费者拖延 keepalive
             if (event->data_len > 0) {
-                // WARNING: 直接 Log 数据可能导致数据泄漏，日志过长，刷新过快等问题
-                ESP_LOGI(TAG, "Data: %.*s", event->data_len, event->data);
-                if (event->topic_len > 0) {
-                    std::string_view topic(event->topic, event->topic_len);
-                    std::string_view data(event->data, event->data_len);
-                    // ESP_LOGI(TAG, "Topic: %.*s", (int)topic.size(), topic.data());
-                    // ESP_LOGI(TAG, "Data: %.*s", (int)data.size(), data.data());
-                    if (self->info_cb_) {
-                        self->info_cb_(topic.data(), data.data());
-                    }
+                if (self->ring_.push(event->data, event->data_len, event->current_data_offset,
+                                     event->total_data_len)) {
+                    xTaskNotifyGive(self->ingest_task_);
                 }
-
-                // Try to parser data
-                // 尝试解析基本信息，尽管不是必须的
-                /*
-                {
-                    "print": {
-                        "nozzle_temper": 26.78125,
-                        "bed_temper": 27.65625,
-                        "wifi_signal": "-29dBm",
-                        "command": "push_status",
-                        "msg": 1,
-                        "sequence_id": "2511"
-                    }
-                }
-                */
-                cJSON *root = cJSON_Parse((const char *)event->data);
-                if (root) {
-                    cJSON *print = cJSON_GetObjectItem(root, "print");
-                    if (print) {
-                        cJSON *nozzle_temper = cJSON_GetObjectItem(print, "nozzle_temper");
-                        cJSON *bed_temper = cJSON_GetObjectItem(print, "bed_temper");
-                        cJSON *wifi_signal = cJSON_GetObjectItem(print, "wifi_signal");
-                        cJSON *command = cJSON_GetObjectItem(print, "command");
-                        cJSON *msg = cJSON_GetObjectItem(print, "msg");
-                        cJSON *sequence_id = cJSON_GetObjectItem(print, "sequence_id");
-
-                        if (nozzle_temper) {
-                            self->status_.nozzle_temper = nozzle_temper->valuedouble;
-                        }
-                        if (bed_temper) {
-                            self->status_.bed_temper = bed_temper->valuedouble;
-                        }
-                        if (wifi_signal) {
-                            snprintf(self->status_.wifi_signal, sizeof(self->status_.wifi_signal),
-                                     "%s", wifi_signal->valuestring);
-                        }
-                        // ESP_LOGI(TAG, "Nozzle Temperature: %.2f", self->status_.nozzle_temper);
-                        // ESP_LOGI(TAG, "Bed Temperature: %.2f", self->status_.bed_temper);
-                        // ESP_LOGI(TAG, "WiFi Signal: %s", self->status_.wifi_signal.c_str());
-                    }
-                    // char* json_data = cJSON_Print(root);
-                    // if (json_data) {
-                    //     ESP_LOGI(TAG, "Parsed JSON data: %s", json_data);
-                    //     free(json_data);
-                    // } else {
-                    //     ESP_LOGE(TAG, "Failed to print JSON data");
-                    // }
-                    cJSON_Delete(root);
-                }
-
-            } else {
-                ESP_LOGI(TAG, "No data received");
             }
             break;
         case MQTT_EVENT_ERROR:
@@ -124,16 +79,176 @@ void BambuMQTT::mqtt_event_handler(void *handler_args, esp_event_base_t base, in
     }
 }
 
+void BambuMQTT::handle_report(const char *data, size_t len, size_t offset, size_t total) {
+    ESP_LOGD(TAG, "Received data on topic: %s", report_topic_);
+    // WARNING: 直接 Log 数据可能导致数据泄漏，日志过长，刷新过快等问题，只在 VERBOSE 级别输出
+    ESP_LOGV(TAG, "Data: %.*s", (int)len, data);
+    if (info_cb_) {
+        info_cb_(report_topic_, data, len, offset, total);
+    }
+
+    // 流式解析基本信息，不构建 cJSON 树
+    // 大消息会分多次 MQTT_EVENT_DATA 到达，按分片依次送入解析器
+    xSemaphoreTake(status_lock_, portMAX_DELAY);
+    ReportParser::Result result = parser_.feed(data, len, offset, total);
+    xSemaphoreGive(status_lock_);
+    if (result == ReportParser::Result::Error) {
+        ESP_LOGW(TAG, "Failed to parse report payload (%d bytes)", (int)total);
+    } else if (result == ReportParser::Result::Complete) {
+        handle_reply(parser_.reply());
+        if (status_cb_ && status_.dirty != 0) {
+            status_cb_(status_ctx_, status_);
+        }
+    }
+}
+
+void BambuMQTT::handle_reply(const ReportReply &reply) {
+    // push_status 的 sequence_id 是打印机自己的计数，与请求无关
+    if (!reply.has_sequence_id || strcmp(reply.command, "push_status") == 0) {
+        return;
+    }
+    BambuCommandResult result = BAMBU_CMD_RESULT_SUCCESS;
+    if (reply.result[0] != '\0' && strcasecmp(reply.result, "success") != 0) {
+        result = BAMBU_CMD_RESULT_FAILED;
+    }
+    if (commands_.complete(reply.sequence_id, result)) {
+        ESP_LOGI(TAG, "Command %s (sequence_id=%" PRIu32 ") completed: %s", reply.command,
+                 reply.sequence_id, reply.result[0] ? reply.result : "no result");
+    }
+}
+
+int BambuMQTT::republish(void *ctx, const char *payload) {
+    return static_cast<BambuMQTT *>(ctx)->publish_message(payload);
+}
+
+void BambuMQTT::ingest_task(void *arg) {
+    BambuMQTT *self = static_cast<BambuMQTT *>(arg);
+    PayloadRing<BAMBU_MQTT_RING_SIZE>::Slice slice;
+    while (self->ingest_running_) {
+        // 有待回复命令时定期醒来检查超时
+        TickType_t wait = self->commands_.pending() > 0 ? pdMS_TO_TICKS(BAMBU_MQTT_COMMAND_POLL_MS)
+                                                        : portMAX_DELAY;
+        ulTaskNotifyTake(pdTRUE, wait);
+        while (self->ring_.peek(slice)) {
+            self->handle_report(slice.data, slice.len, slice.offset, slice.total);
+            self->ring_.pop();
+        }
+        if (self->commands_.pending() > 0) {
+            self->commands_.poll(republish, self);
+        }
+    }
+    self->ingest_task_ = nullptr;
+    vTaskDelete(nullptr);
+}
+
 BambuMQTT::BambuMQTT(const char *ip, const char *password, const char *serial,
-                     const BambuStatus &status, InfoCallback cb)
-    : client_(nullptr), ip_(ip), serial_(serial), password_(password), info_cb_(cb),
-      status_(status) {
+                     BambuStatus &status, InfoCallback cb)
+    : client_(nullptr), info_cb_(cb), status_(status), parser_(status_) {
+    copyParam(ip_, sizeof(ip_), ip);
+    copyParam(serial_, sizeof(serial_), serial);
+    copyParam(password_, sizeof(password_), password);
+    lock_ = xSemaphoreCreateMutex();
+    client_lock_ = xSemaphoreCreateMutex();
+    status_lock_ = xSemaphoreCreateMutex();
     ESP_LOGI(TAG, "BambuMQTT constructed: ip=%s, serial=%s, password=%s", ip_, serial_, password_);
 }
 
-BambuMQTT::~BambuMQTT() { stop(); }
+BambuMQTT::~BambuMQTT() {
+    stop();
+    vSemaphoreDelete(status_lock_);
+    vSemaphoreDelete(client_lock_);
+    vSemaphoreDelete(lock_);
+}
+
+bool BambuMQTT::copyParam(char *dst, size_t size, const char *src) {
+    if (src == nullptr || strlen(src) >= size) {
+        return false;
+    }
+    strcpy(dst, src);
+    return true;
+}
 
 void BambuMQTT::start() {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    started_ = true;
+    startLocked();
+    xSemaphoreGive(lock_);
+}
+
+void BambuMQTT::stop() {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    started_ = false;
+    stopLocked();
+    xSemaphoreGive(lock_);
+}
+
+bool BambuMQTT::setPrinter(const char *ip, const char *password, const char *serial,
+                           bool *switched) {
+    if (switched) {
+        *switched = false;
+    }
+    if (ip == nullptr || password == nullptr || serial == nullptr || ip[0] == '\0' ||
+        serial[0] == '\0' || strlen(ip) >= sizeof(ip_) || strlen(serial) >= sizeof(serial_) ||
+        strlen(password) >= sizeof(password_)) {
+        return false;
+    }
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    if (strcmp(ip, ip_) == 0 && strcmp(serial, serial_) == 0 && strcmp(password, password_) == 0) {
+        xSemaphoreGive(lock_);
+        return true;
+    }
+    bool running = client_ != nullptr;
+    if (running) {
+        stopLocked();
+    }
+    if (switched) {
+        *switched = strcmp(serial, serial_) != 0;
+    }
+    xSemaphoreTake(status_lock_, portMAX_DELAY);
+    strcpy(ip_, ip);
+    strcpy(serial_, serial);
+    strcpy(password_, password);
+    xSemaphoreGive(status_lock_);
+    ESP_LOGI(TAG, "Printer changed: ip=%s, serial=%s", ip_, serial_);
+    if (running) {
+        // ingest 任务已退出，丢弃上一台打印机未处理的分片和状态
+        PayloadRing<BAMBU_MQTT_RING_SIZE>::Slice slice;
+        while (ring_.peek(slice)) {
+            ring_.pop();
+        }
+        xSemaphoreTake(status_lock_, portMAX_DELAY);
+        status_ = BambuStatus();
+        xSemaphoreGive(status_lock_);
+        resync_ = true;
+    }
+    if (started_) {
+        startLocked();
+    }
+    xSemaphoreGive(lock_);
+    return true;
+}
+
+void BambuMQTT::summary(Summary &out) const {
+    xSemaphoreTake(status_lock_, portMAX_DELAY);
+    strcpy(out.ip, ip_);
+    strcpy(out.serial, serial_);
+    strcpy(out.gcode_state, status_.gcode_state);
+    out.tray_now = status_.tray_now;
+    xSemaphoreGive(status_lock_);
+    out.connected = isConnected();
+}
+
+void BambuMQTT::startLocked() {
+    if (client_) {
+        return; // 重复的 IP_EVENT_STA_GOT_IP
+    }
+    if (ip_[0] == '\0' || serial_[0] == '\0') {
+        ESP_LOGI(TAG, "Printer not configured, waiting for setPrinter()");
+        return;
+    }
+    // 连接参数可能已由 setPrinter() 修改，主题在连接时生成
+    snprintf(report_topic_, sizeof(report_topic_), "%s/%s/%s", BAMBU_MQTT_TOPIC_BASE, serial_,
+             BAMBU_MQTT_TOPIC_REPORT);
     char broker_uri[128];
     snprintf(broker_uri, sizeof(broker_uri), "mqtts://%s:%d", ip_, BAMBU_MQTT_DEFAULT_PORT);
 
@@ -148,33 +263,64 @@ void BambuMQTT::start() {
 
     // 关键优化配置
     // Thanks to original Top-AMS Project
-    mqtt_cfg.buffer.size = 4096;                  // 增大接收缓冲区
-    mqtt_cfg.buffer.out_size = 2048;              // 发送缓冲区
-    mqtt_cfg.network.reconnect_timeout_ms = 5000; // 5秒重连
-    mqtt_cfg.task.stack_size = 6144;              // 增大任务栈
-    mqtt_cfg.task.priority = 5;                   // 提高任务优先级
+    mqtt_cfg.buffer.size = BAMBU_MQTT_RX_BUFFER_SIZE; // 分片流式解析，无需容纳整条消息
+    mqtt_cfg.buffer.out_size = 2048;                  // 发送缓冲区
+    mqtt_cfg.network.reconnect_timeout_ms = 5000;     // 5秒重连
+    mqtt_cfg.task.stack_size = 6144;                  // 增大任务栈
+    mqtt_cfg.task.priority = 5;                       // 提高任务优先级
 
-    // WARNING: 直接 Log 数据可能导致关键隐私数据泄漏
-    ESP_LOGI(TAG, "Connecting to MQTT broker at %s, pwd %s", broker_uri, password_);
+    ESP_LOGI(TAG, "Connecting to MQTT broker at %s", broker_uri);
 
-    client_ = esp_mqtt_client_init(&mqtt_cfg);
-    esp_mqtt_client_register_event(client_, (esp_mqtt_event_id_t)ESP_EVENT_ANY_ID,
+    if (!ingest_task_) {
+        ingest_running_ = true;
+        if (xTaskCreate(ingest_task, "bambu_ingest", BAMBU_MQTT_INGEST_STACK_SIZE, this,
+                        BAMBU_MQTT_INGEST_PRIORITY, &ingest_task_) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create ingest task");
+            ingest_running_ = false;
+            return;
+        }
+    }
+
+    esp_mqtt_client_handle_t client = esp_mqtt_client_init(&mqtt_cfg);
+    esp_mqtt_client_register_event(client, (esp_mqtt_event_id_t)ESP_EVENT_ANY_ID,
                                    mqtt_event_handler, this);
-    esp_mqtt_client_start(client_);
+    esp_mqtt_client_start(client);
+    xSemaphoreTake(client_lock_, portMAX_DELAY);
+    client_ = client;
+    xSemaphoreGive(client_lock_);
     ESP_LOGI(TAG, "BambuMQTT client started");
 }
 
-void BambuMQTT::stop() {
-    if (client_) {
-        esp_mqtt_client_stop(client_);
-        esp_mqtt_client_destroy(client_);
-        client_ = nullptr;
+void BambuMQTT::stopLocked() {
+    // 先取出句柄再停止，停止期间的 publish_message() 直接返回失败
+    xSemaphoreTake(client_lock_, portMAX_DELAY);
+    esp_mqtt_client_handle_t client = client_;
+    client_ = nullptr;
+    xSemaphoreGive(client_lock_);
+    if (client) {
+        esp_mqtt_client_stop(client);
+        esp_mqtt_client_destroy(client);
+        mqtt_status_ = BAMBU_MQTT_STATUS_DISCONNECTED;
         ESP_LOGI(TAG, "BambuMQTT client stopped");
     }
+    if (ingest_task_) {
+        ingest_running_ = false;
+        xTaskNotifyGive(ingest_task_);
+        while (ingest_task_) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        commands_.cancelAll();
+        IngestStats stats = ring_.stats();
+        ESP_LOGI(TAG, "Ingest stats: pushed=%" PRIu32 ", dropped=%" PRIu32 ", high water=%" PRIu32
+                      "/%" PRIu32,
+                 stats.pushed, stats.dropped, stats.high_water, stats.capacity);
+    }
 }
 
 int BambuMQTT::publish_message(const char *message) {
+    xSemaphoreTake(client_lock_, portMAX_DELAY);
     if (!client_) {
+        xSemaphoreGive(client_lock_);
         ESP_LOGE(TAG, "MQTT client not initialized");
         return -1;
     }
@@ -184,6 +330,7 @@ int BambuMQTT::publish_message(const char *message) {
     ESP_LOGI(TAG, "Publishing message to topic: %s", topic);
     ESP_LOGI(TAG, "Message: %s", message);
     int msg_id = esp_mqtt_client_publish(client_, topic, message, 0, 1, 0);
+    xSemaphoreGive(client_lock_);
 
     if (msg_id < 0) {
         ESP_LOGE(TAG, "Failed to publish message: %s", message);
@@ -193,3 +340,21 @@ int BambuMQTT::publish_message(const char *message) {
     ESP_LOGI(TAG, "Message published successfully: %s", message);
     return msg_id;
 }
+
+bool BambuMQTT::send_command(std::string_view payload, uint32_t sequence_id,
+                             BambuCommandCallback cb, void *ctx, uint32_t timeout_ms,
+                             uint8_t retries) {
+    // 先登记再发送，避免回复先于登记到达
+    if (!commands_.add(sequence_id, payload, cb, ctx, timeout_ms, retries)) {
+        return false;
+    }
+    if (publish_message(payload.data()) < 0) {
+        commands_.complete(sequence_id, BAMBU_CMD_RESULT_CANCELLED);
+        return false;
+    }
+    if (ingest_task_) {
+        // 唤醒 ingest 任务切换到定时检查
+        xTaskNotifyGive(ingest_task_);
+    }
+    return true;
+}
@@ -1,16 +1,38 @@
 #pragma once
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 #include "mqtt_client.h"
 
+#include "command_tracker.h"
 #include "model/bambu_status.h"
+#include "payload_ring.h"
+#include "report_parser.h"
 
 #define BAMBU_MQTT_DEFAULT_USER "bblp"
 #define BAMBU_MQTT_DEFAULT_PORT 8883
 
+// 连接参数的最大长度 (含 '\0')，与 settings.def 中的打印机设置一致
+#define BAMBU_MQTT_HOST_SIZE 40
+#define BAMBU_MQTT_SERIAL_SIZE 20
+#define BAMBU_MQTT_PASSWORD_SIZE 16
+
 #define BAMBU_MQTT_TOPIC_BASE "device"
 #define BAMBU_MQTT_TOPIC_REPORT "report"
 #define BAMBU_MQTT_TOPIC_REQUEST "request"
 
+// 接收缓冲区大小，超出的上报会被拆分为多个 MQTT_EVENT_DATA 分片
+#define BAMBU_MQTT_RX_BUFFER_SIZE 1024
+
+// MQTT 任务与解析任务之间的分片环形缓冲区大小 (2 的幂)
+#define BAMBU_MQTT_RING_SIZE 8192
+#define BAMBU_MQTT_INGEST_STACK_SIZE 4096
+#define BAMBU_MQTT_INGEST_PRIORITY 4
+
+// 有待回复命令时 ingest 任务的超时检查周期
+#define BAMBU_MQTT_COMMAND_POLL_MS 100
+
 enum BambuMQTTStatus {
     BAMBU_MQTT_STATUS_DISCONNECTED = 0,
     BAMBU_MQTT_STATUS_CONNECTED,
@@ -19,35 +41,142 @@ enum BambuMQTTStatus {
 
 class BambuMQTT {
 public:
-    using InfoCallback = void (*)(const char *topic, const char *payload);
+    // 上报的原始分片，data 不以 '\0' 结尾；大消息分多次回调，offset / total 为在整条消息中的位置
+    using InfoCallback = void (*)(const char *topic, const char *data, size_t len, size_t offset,
+                                  size_t total);
+    using IngestStats = PayloadRing<BAMBU_MQTT_RING_SIZE>::Stats;
+    using StatusCallback = void (*)(void *ctx, const BambuStatus &status);
 
-    BambuMQTT(const char *ip, const char *password, const char *serial, const BambuStatus &status,
+    /**
+     * @brief 连接参数复制到对象内，构造后可由 setPrinter() 修改
+     * @param cb 可以为 nullptr，在 ingest 任务中对每个分片调用
+     */
+    BambuMQTT(const char *ip, const char *password, const char *serial, BambuStatus &status,
               InfoCallback cb);
     ~BambuMQTT();
 
+    /**
+     * @brief 连接打印机；地址或序列号为空时只记录已启动，由之后的 setPrinter() 连接
+     */
     void start();
     void stop();
 
+    /**
+     * @brief 切换到另一台打印机
+     *
+     * 参数与当前相同时不做任何事。已连接时断开当前连接 (待回复的命令以 CANCELLED 完成)，
+     * 清空状态，用新参数重新连接，连接后请求一次完整状态；已启动但因未配置而没有连接时
+     * 用新参数连接；未启动时只保存参数。
+     * 会阻塞到旧连接的任务退出，不能在状态回调或命令回调中调用。
+     * @param switched 可以为 nullptr，序列号变化 (换成另一台打印机) 时置为 true，否则为 false
+     * @return false 参数过长或为空，连接不变
+     */
+    bool setPrinter(const char *ip, const char *password, const char *serial,
+                    bool *switched = nullptr);
+
     int publish_message(const char *message);
 
+    /**
+     * @brief 发送一条带 sequence_id 的命令，收到对应回复、超时或连接停止时回调
+     *
+     * 命令负载被保存用于超时重发，调用者不必等待上一条命令完成即可继续发送。
+     * @param payload 以 '\0' 结尾的命令 JSON，sequence_id 必须与负载中的一致
+     * @param cb 完成回调，在 ingest 任务中执行，可以为 nullptr
+     * @return true 已发送并登记, false 发送失败或待回复表已满（不会回调）
+     */
+    bool send_command(std::string_view payload, uint32_t sequence_id, BambuCommandCallback cb,
+                      void *ctx, uint32_t timeout_ms = BAMBU_CMD_DEFAULT_TIMEOUT_MS,
+                      uint8_t retries = BAMBU_CMD_DEFAULT_RETRIES);
+
+    size_t pendingCommands() const { return commands_.pending(); }
+
+    /**
+     * @brief 设置状态回调，每条上报合并后若有字段变化则在 ingest 任务中调用
+     *
+     * 回调中可通过 BambuStatus::changed() 只处理本次变化的字段，需在 start() 前设置
+     */
+    void setStatusCallback(StatusCallback cb, void *ctx) {
+        status_cb_ = cb;
+        status_ctx_ = ctx;
+    }
+
     esp_mqtt_client_handle_t getClient() const { return client_; }
     const char *getIP() const { return ip_; }
     const char *getSerial() const { return serial_; }
     const char *getPassword() const { return password_; }
+    const BambuStatus &getStatus() const { return status_; }
+
+    // 连接参数和状态中用于显示的部分
+    struct Summary {
+        char ip[BAMBU_MQTT_HOST_SIZE];
+        char serial[BAMBU_MQTT_SERIAL_SIZE];
+        char gcode_state[sizeof(BambuStatus::gcode_state)];
+        uint8_t tray_now;
+        bool connected;
+    };
+
+    /**
+     * @brief 在 status_lock_ 下复制 Summary，可在任意任务中调用
+     *
+     * getIP() / getSerial() / getStatus() 只能在 ingest 任务或已停止时读取，
+     * 其他任务读到的可能是合并或 setPrinter() 中途的值。
+     */
+    void summary(Summary &out) const;
 
     bool isConnected() const { return client_ != nullptr; }
 
+    /**
+     * @brief 接收环形缓冲区统计 (分片数、丢弃数、最高占用)，用于调整缓冲区大小
+     */
+    IngestStats getIngestStats() const { return ring_.stats(); }
+
+    /**
+     * @brief 第一次连接到打印机的时间 (esp_timer，自启动起的微秒)，用于统计启动耗时
+     * @return 尚未连接过时返回 0
+     */
+    int64_t firstConnectedUs() const { return connected_us_; }
+
 private:
     esp_mqtt_client_handle_t client_;
-    const char *ip_;
-    const char *serial_;
-    const char *password_;
+    char ip_[BAMBU_MQTT_HOST_SIZE] = {};
+    char serial_[BAMBU_MQTT_SERIAL_SIZE] = {};
+    char password_[BAMBU_MQTT_PASSWORD_SIZE] = {};
     InfoCallback info_cb_;
+    StatusCallback status_cb_ = nullptr;
+    void *status_ctx_ = nullptr;
+
+    char report_topic_[128];
+
+    BambuStatus &status_;
+    ReportParser parser_;
+    CommandTracker commands_;
 
-    BambuStatus status_;
+    // esp-mqtt 任务只负责入队，解析、日志和回调在 ingest 任务中完成
+    PayloadRing<BAMBU_MQTT_RING_SIZE> ring_;
+    TaskHandle_t ingest_task_ = nullptr;
+    volatile bool ingest_running_ = false;
 
     BambuMQTTStatus mqtt_status_ = BAMBU_MQTT_STATUS_DISCONNECTED;
+    volatile bool resync_ = false; // 切换打印机后，连接时发送 pushall
+    bool started_ = false;         // start() 之后、stop() 之前，lock_ 保护
+    int64_t connected_us_ = 0;
+
+    // lock_ 串行化 start / stop / setPrinter；client_lock_ 保护 client_ 的发布与销毁，
+    // 只在短时间内持有，ingest 任务重发命令时不会与等待其退出的 stop() 死锁
+    SemaphoreHandle_t lock_;
+    SemaphoreHandle_t client_lock_;
+    SemaphoreHandle_t status_lock_; // 保护 status_ 的合并和 ip_ / serial_ 的修改
+
+    void startLocked();
+    void stopLocked();
+    static bool copyParam(char *dst, size_t size, const char *src);
+
+    void handle_report(const char *data, size_t len, size_t offset, size_t total);
+    void handle_reply(const ReportReply &reply);
+
+    static int republish(void *ctx, const char *payload);
 
     static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id,
                                    void *event_data);
+    static void ingest_task(void *arg);
 };
@@ -0,0 +1,102 @@
+#include "command_tracker.h"
+#include "esp_log.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "[CommandTracker]";
+
+CommandTracker::CommandTracker() : entries_{}, pending_(0), lock_(xSemaphoreCreateMutex()) {}
+
+CommandTracker::~CommandTracker() {
+    cancelAll();
+    vSemaphoreDelete(lock_);
+}
+
+bool CommandTracker::add(uint32_t sequence_id, std::string_view payload, BambuCommandCallback cb,
+                         void *ctx, uint32_t timeout_ms, uint8_t retries) {
+    if (payload.size() >= BAMBU_CMD_MAX_LEN) {
+        ESP_LOGE(TAG, "Command payload too long: %d", (int)payload.size());
+        return false;
+    }
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    for (Entry &entry : entries_) {
+        if (entry.active) {
+            continue;
+        }
+        entry.sequence_id = sequence_id;
+        entry.timeout = pdMS_TO_TICKS(timeout_ms);
+        entry.deadline = xTaskGetTickCount() + entry.timeout;
+        entry.retries_left = retries;
+        entry.cb = cb;
+        entry.ctx = ctx;
+        entry.len = payload.size();
+        memcpy(entry.payload, payload.data(), payload.size());
+        entry.payload[payload.size()] = '\0';
+        entry.active = true;
+        pending_++;
+        xSemaphoreGive(lock_);
+        return true;
+    }
+    xSemaphoreGive(lock_);
+    ESP_LOGW(TAG, "Pending command table full, sequence_id=%" PRIu32, sequence_id);
+    return false;
+}
+
+bool CommandTracker::complete(uint32_t sequence_id, BambuCommandResult result) {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    for (Entry &entry : entries_) {
+        if (entry.active && entry.sequence_id == sequence_id) {
+            finish(entry, result);
+            return true;
+        }
+    }
+    xSemaphoreGive(lock_);
+    return false;
+}
+
+void CommandTracker::poll(PublishFn publish, void *publish_ctx) {
+    TickType_t now = xTaskGetTickCount();
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    for (Entry &entry : entries_) {
+        if (!entry.active || (int32_t)(now - entry.deadline) < 0) {
+            continue;
+        }
+        if (entry.retries_left == 0) {
+            ESP_LOGW(TAG, "Command timed out, sequence_id=%" PRIu32, entry.sequence_id);
+            finish(entry, BAMBU_CMD_RESULT_TIMEOUT);
+            // finish() 释放了锁，重新获取后继续扫描
+            xSemaphoreTake(lock_, portMAX_DELAY);
+            continue;
+        }
+        entry.retries_left--;
+        entry.deadline = now + entry.timeout;
+        ESP_LOGI(TAG, "Retrying command, sequence_id=%" PRIu32 ", retries left=%d",
+                 entry.sequence_id, entry.retries_left);
+        publish(publish_ctx, entry.payload);
+    }
+    xSemaphoreGive(lock_);
+}
+
+void CommandTracker::cancelAll() {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    for (Entry &entry : entries_) {
+        if (entry.active) {
+            finish(entry, BAMBU_CMD_RESULT_CANCELLED);
+            xSemaphoreTake(lock_, portMAX_DELAY);
+        }
+    }
+    xSemaphoreGive(lock_);
+}
+
+// 调用时持有锁，返回前释放锁，回调在锁外执行
+void CommandTracker::finish(Entry &entry, BambuCommandResult result) {
+    BambuCommandCallback cb = entry.cb;
+    void *ctx = entry.ctx;
+    uint32_t sequence_id = entry.sequence_id;
+    entry.active = false;
+    pending_--;
+    xSemaphoreGive(lock_);
+    if (cb) {
+        cb(ctx, sequence_id, result);
+    }
+}
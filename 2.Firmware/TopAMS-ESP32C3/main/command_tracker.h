@@ -0,0 +1,86 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+
+#define BAMBU_CMD_MAX_PENDING 8
+#define BAMBU_CMD_MAX_LEN 384
+#define BAMBU_CMD_DEFAULT_TIMEOUT_MS 5000
+#define BAMBU_CMD_DEFAULT_RETRIES 2
+
+enum BambuCommandResult {
+    BAMBU_CMD_RESULT_SUCCESS = 0, // 打印机回复 result 为 success，或回复中没有 result 字段
+    BAMBU_CMD_RESULT_FAILED,      // 打印机回复 result 为其他值
+    BAMBU_CMD_RESULT_TIMEOUT,     // 重试次数用尽仍未收到回复
+    BAMBU_CMD_RESULT_CANCELLED,   // 连接停止，未完成的命令被取消
+};
+
+/**
+ * @brief 打印机命令完成回调
+ * @param ctx 注册时传入的上下文
+ * @param sequence_id 命令的 sequence_id
+ * @param result 完成结果
+ */
+using BambuCommandCallback = void (*)(void *ctx, uint32_t sequence_id, BambuCommandResult result);
+
+/**
+ * @brief 待回复命令表，按 sequence_id 关联请求与打印机在 report 主题上的回复
+ *
+ * 定长表，不分配堆内存。每条命令保存原始负载用于超时重发。
+ * 所有方法可以在不同任务中调用，回调在锁外执行。
+ */
+class CommandTracker {
+public:
+    using PublishFn = int (*)(void *ctx, const char *payload);
+
+    CommandTracker();
+    ~CommandTracker();
+
+    /**
+     * @brief 登记一条已发送的命令
+     * @return true 成功, false 表已满或负载过长
+     */
+    bool add(uint32_t sequence_id, std::string_view payload, BambuCommandCallback cb, void *ctx,
+             uint32_t timeout_ms, uint8_t retries);
+
+    /**
+     * @brief 收到回复，完成对应命令
+     * @return true 找到并完成, false 没有对应的待回复命令
+     */
+    bool complete(uint32_t sequence_id, BambuCommandResult result);
+
+    /**
+     * @brief 处理超时：还有重试次数的重新发送，否则以 TIMEOUT 完成
+     */
+    void poll(PublishFn publish, void *publish_ctx);
+
+    /**
+     * @brief 取消所有待回复命令
+     */
+    void cancelAll();
+
+    size_t pending() const { return pending_; }
+
+private:
+    struct Entry {
+        uint32_t sequence_id;
+        TickType_t deadline;
+        TickType_t timeout;
+        uint8_t retries_left;
+        bool active;
+        BambuCommandCallback cb;
+        void *ctx;
+        uint16_t len;
+        char payload[BAMBU_CMD_MAX_LEN];
+    };
+
+    void finish(Entry &entry, BambuCommandResult result);
+
+    Entry entries_[BAMBU_CMD_MAX_PENDING];
+    std::atomic<size_t> pending_;
+    SemaphoreHandle_t lock_;
+};
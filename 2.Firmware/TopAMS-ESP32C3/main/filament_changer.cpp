@@ -0,0 +1,199 @@
+#include "filament_changer.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "[FilamentChanger]";
+
+// 影响换料流程的字段，其余字段变化不推进状态
+static constexpr uint32_t CHANGE_FIELDS = BAMBU_FIELD_AMS_STATUS | BAMBU_FIELD_TRAY_NOW |
+                                          BAMBU_FIELD_TRAY_TAR | BAMBU_FIELD_STG_CUR;
+
+// ams_status 高字节为主状态，1 表示正在换料
+static bool ams_changing(const BambuStatus &status) { return (status.ams_status >> 8) == 1; }
+
+static bool stage_changing(const BambuStatus &status) {
+    return status.stg_cur == BAMBU_STAGE_CHANGING_FILAMENT ||
+           status.stg_cur == BAMBU_STAGE_FILAMENT_UNLOADING ||
+           status.stg_cur == BAMBU_STAGE_FILAMENT_LOADING;
+}
+
+FilamentChanger::FilamentChanger(FilamentManager &filaments, FilamentMotorFn motor,
+                                 void *motor_ctx)
+    : filaments_(filaments), motor_(motor), motor_ctx_(motor_ctx) {}
+
+bool FilamentChanger::wants(const BambuStatus &status) {
+    return status.tray_tar != status.tray_now && (ams_changing(status) || stage_changing(status));
+}
+
+bool FilamentChanger::expired() const {
+    return phase_ != FILAMENT_PHASE_IDLE &&
+           esp_timer_get_time() - phase_start_us_ > FILAMENT_CHANGER_PHASE_TIMEOUT_MS * 1000LL;
+}
+
+void FilamentChanger::poll() {
+    if (expired()) {
+        abort("phase timeout");
+    }
+}
+
+bool FilamentChanger::request(const BambuStatus &status) {
+    if (phase_ != FILAMENT_PHASE_IDLE || !wants(status)) {
+        return false;
+    }
+    begin(status);
+    return true;
+}
+
+void FilamentChanger::onStatus(const BambuStatus &status) {
+    if (expired()) {
+        abort("phase timeout");
+        return;
+    }
+    if (!status.changed(CHANGE_FIELDS)) {
+        return;
+    }
+
+    switch (phase_) {
+        case FILAMENT_PHASE_IDLE:
+            if (wants(status)) {
+                begin(status);
+            }
+            break;
+        case FILAMENT_PHASE_RETRACT:
+            if (status.tray_now == BAMBU_TRAY_NONE ||
+                status.stg_cur == BAMBU_STAGE_FILAMENT_LOADING) {
+                drive(from_motor_, FILAMENT_MOTOR_STOP);
+                if (to_tray_ == BAMBU_TRAY_NONE) {
+                    // 仅退料
+                    enter(FILAMENT_PHASE_VERIFY);
+                } else {
+                    enter(FILAMENT_PHASE_FEED);
+                    drive(to_motor_, FILAMENT_MOTOR_FEED);
+                }
+            }
+            break;
+        case FILAMENT_PHASE_FEED:
+            if (status.tray_now == to_tray_) {
+                drive(to_motor_, FILAMENT_MOTOR_STOP);
+                enter(FILAMENT_PHASE_VERIFY);
+            }
+            break;
+        case FILAMENT_PHASE_VERIFY:
+            if (!ams_changing(status) && !stage_changing(status)) {
+                finish();
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void FilamentChanger::begin(const BambuStatus &status) {
+    from_tray_ = status.tray_now;
+    to_tray_ = status.tray_tar;
+    from_motor_ = motorFor(status, from_tray_);
+    to_motor_ = motorFor(status, to_tray_);
+    change_start_us_ = esp_timer_get_time();
+    ESP_LOGI(TAG, "Filament change started: tray %d -> %d (motor %d -> %d)", from_tray_, to_tray_,
+             from_motor_, to_motor_);
+
+    if (from_tray_ != BAMBU_TRAY_NONE) {
+        enter(FILAMENT_PHASE_RETRACT);
+        drive(from_motor_, FILAMENT_MOTOR_RETRACT);
+    } else {
+        enter(FILAMENT_PHASE_FEED);
+        drive(to_motor_, FILAMENT_MOTOR_FEED);
+    }
+}
+
+void FilamentChanger::enter(FilamentChangePhase phase) {
+    int64_t now = esp_timer_get_time();
+    if (phase_ != FILAMENT_PHASE_IDLE) {
+        record(stats_.phases[phase_], phase_start_us_);
+        ESP_LOGI(TAG, "Phase %s done in %" PRIu32 " ms", phaseName(phase_),
+                 stats_.phases[phase_].last_ms);
+    }
+    phase_ = phase;
+    phase_start_us_ = now;
+}
+
+void FilamentChanger::finish() {
+    enter(FILAMENT_PHASE_IDLE);
+    record(stats_.total, change_start_us_);
+    stats_.completed++;
+    ESP_LOGI(TAG, "Filament change %d -> %d completed in %" PRIu32 " ms", from_tray_, to_tray_,
+             stats_.total.last_ms);
+}
+
+void FilamentChanger::abort(const char *reason) {
+    if (phase_ == FILAMENT_PHASE_IDLE) {
+        return;
+    }
+    ESP_LOGW(TAG, "Filament change aborted in phase %s: %s", phaseName(phase_), reason);
+    drive(from_motor_, FILAMENT_MOTOR_STOP);
+    drive(to_motor_, FILAMENT_MOTOR_STOP);
+    phase_ = FILAMENT_PHASE_IDLE;
+    stats_.aborted++;
+}
+
+// 优先使用以托盘编号登记的电机，其次按打印机上报的托盘材料 (类型 + 颜色) 查找
+int FilamentChanger::motorFor(const BambuStatus &status, uint8_t tray) const {
+    if (tray == BAMBU_TRAY_NONE) {
+        return -1;
+    }
+    // 不等待 Web 端的修改，修改中读到的是上一个版本
+    FilamentManager::Reader table = filaments_.read();
+    if (table->getFilamentByMotorId(tray)) {
+        return tray;
+    }
+    int ams_id = tray / BAMBU_TRAYS_PER_AMS;
+    if (ams_id >= BAMBU_MAX_AMS) {
+        return -1;
+    }
+    const BambuTray &info = status.ams[ams_id].trays[tray % BAMBU_TRAYS_PER_AMS];
+    uint32_t color;
+    if (info.type[0] == '\0' || !FilamentMeta::parseColor(info.color, color)) {
+        return -1;
+    }
+    const Filament *filament = table->findFilamentByMaterial(info.type, color);
+    return filament ? filament->motor_id : -1;
+}
+
+void FilamentChanger::drive(int motor_id, FilamentMotorAction action) {
+    // 未登记耗材的托盘不由 TopAMS 供料
+    if (motor_id < 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "Motor %d action %d", motor_id, action);
+    if (motor_) {
+        motor_(motor_ctx_, motor_id, action);
+    }
+}
+
+void FilamentChanger::record(PhaseStats &stats, int64_t start_us) {
+    uint32_t ms = static_cast<uint32_t>((esp_timer_get_time() - start_us) / 1000);
+    if (stats.count == 0 || ms < stats.min_ms) {
+        stats.min_ms = ms;
+    }
+    if (ms > stats.max_ms) {
+        stats.max_ms = ms;
+    }
+    stats.last_ms = ms;
+    stats.total_ms += ms;
+    stats.count++;
+}
+
+const char *FilamentChanger::phaseName(FilamentChangePhase phase) {
+    switch (phase) {
+        case FILAMENT_PHASE_IDLE:
+            return "idle";
+        case FILAMENT_PHASE_RETRACT:
+            return "retract";
+        case FILAMENT_PHASE_FEED:
+            return "feed";
+        case FILAMENT_PHASE_VERIFY:
+            return "verify";
+        default:
+            return "unknown";
+    }
+}
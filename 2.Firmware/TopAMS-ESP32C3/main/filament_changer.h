@@ -0,0 +1,123 @@
+#pragma once
+
+#include "filament_manager.h"
+#include "model/bambu_status.h"
+#include <stdint.h>
+
+// 单个阶段的超时，超时后停止电机并放弃本次换料
+#define FILAMENT_CHANGER_PHASE_TIMEOUT_MS 120000
+
+// stg_cur 中与换料相关的阶段码
+#define BAMBU_STAGE_CHANGING_FILAMENT 4
+#define BAMBU_STAGE_FILAMENT_UNLOADING 22
+#define BAMBU_STAGE_FILAMENT_LOADING 24
+
+enum FilamentMotorAction {
+    FILAMENT_MOTOR_STOP = 0,
+    FILAMENT_MOTOR_FEED,    // 向打印机送料
+    FILAMENT_MOTOR_RETRACT, // 从打印机回抽
+};
+
+enum FilamentChangePhase {
+    FILAMENT_PHASE_IDLE = 0,
+    FILAMENT_PHASE_RETRACT, // 打印机退料，旧耗材电机回抽，直到 tray_now 清空
+    FILAMENT_PHASE_FEED,    // 新耗材电机送料，直到 tray_now == 目标托盘
+    FILAMENT_PHASE_VERIFY,  // 电机已停，等待打印机结束换料流程
+    FILAMENT_PHASE_COUNT,
+};
+
+/**
+ * @brief 电机驱动回调
+ * @param ctx 注册时传入的上下文
+ * @param motor_id 电机编号，对应 Filament::motor_id
+ * @param action 动作
+ */
+using FilamentMotorFn = void (*)(void *ctx, int motor_id, FilamentMotorAction action);
+
+/**
+ * @brief 换料引擎，根据打印机上报驱动对应的电机完成 回抽 -> 送料 -> 确认
+ *
+ * 不延时，只在 onStatus() 收到合并后的上报增量时推进状态；阶段超时另由 poll() 检查
+ * (FilamentScheduler 的定时器定期调用)。
+ * 换料开始时确定电机：托盘编号 (ams_id * 4 + tray_id) 上登记了耗材时即用该电机，
+ * 否则按上报中该托盘的类型和颜色在 FilamentManager 的材料索引中查找。
+ * 找不到对应耗材的托盘不驱动电机，只记录阶段耗时。
+ * 每个阶段记录耗时统计，用于测量和缩短换料时间。
+ */
+class FilamentChanger {
+public:
+    struct PhaseStats {
+        uint32_t count;
+        uint32_t last_ms;
+        uint32_t min_ms;
+        uint32_t max_ms;
+        uint64_t total_ms;
+    };
+
+    struct Stats {
+        PhaseStats phases[FILAMENT_PHASE_COUNT]; // IDLE 项不使用
+        PhaseStats total;                        // 整次换料耗时
+        uint32_t completed;
+        uint32_t aborted;
+    };
+
+    FilamentChanger(FilamentManager &filaments, FilamentMotorFn motor, void *motor_ctx);
+
+    /**
+     * @brief 处理一次合并后的状态，只在换料相关字段变化时推进
+     */
+    void onStatus(const BambuStatus &status);
+
+    /**
+     * @brief 空闲且打印机正在请求换料时立即开始，不要求本次上报中字段有变化
+     *
+     * 用于排队的打印机轮到时，它的换料请求早已上报过。
+     * @return true 已开始换料
+     */
+    bool request(const BambuStatus &status);
+
+    /**
+     * @brief 检查阶段超时，超时时放弃本次换料；onStatus() 中也会检查
+     */
+    void poll();
+
+    /**
+     * @brief 停止电机并回到空闲状态
+     */
+    void abort(const char *reason);
+
+    FilamentChangePhase phase() const { return phase_; }
+    int fromMotor() const { return from_motor_; }
+    int toMotor() const { return to_motor_; }
+    const Stats &stats() const { return stats_; }
+
+    static const char *phaseName(FilamentChangePhase phase);
+
+    /**
+     * @brief 打印机是否在请求换料 (目标托盘与当前不同且处于换料流程中)
+     */
+    static bool wants(const BambuStatus &status);
+
+private:
+    bool expired() const;
+    void begin(const BambuStatus &status);
+    void enter(FilamentChangePhase phase);
+    void finish();
+    int motorFor(const BambuStatus &status, uint8_t tray) const;
+    void drive(int motor_id, FilamentMotorAction action);
+    static void record(PhaseStats &stats, int64_t start_us);
+
+    FilamentManager &filaments_;
+    FilamentMotorFn motor_;
+    void *motor_ctx_;
+
+    FilamentChangePhase phase_ = FILAMENT_PHASE_IDLE;
+    uint8_t from_tray_ = BAMBU_TRAY_NONE;
+    uint8_t to_tray_ = BAMBU_TRAY_NONE;
+    int from_motor_ = -1; // -1 表示不驱动
+    int to_motor_ = -1;
+    int64_t change_start_us_ = 0;
+    int64_t phase_start_us_ = 0;
+
+    Stats stats_ = {};
+};
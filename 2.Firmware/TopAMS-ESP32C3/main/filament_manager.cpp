@@ -1,25 +1,77 @@
 #include "cJSON.h"
 #include <algorithm>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
 
 #include "esp_log.h"
+#include "esp_rom_crc.h"
 
 #include "filament_manager.h"
-#include "instance.h"
+#include "json_stream.h"
 
 static const char *TAG = "[FilamentManager]";
 
-FilamentManager::FilamentManager() : next_id(1) {}
-FilamentManager::~FilamentManager() {
-    // 保存数据到存储
-    if (!saveToStorage()) {
-        ESP_LOGE(TAG, "Failed to save filaments on destruction");
+static_assert(FILAMENT_ID_TABLE_SIZE >= 2 * FILAMENT_MAX_COUNT &&
+                  (FILAMENT_ID_TABLE_SIZE & (FILAMENT_ID_TABLE_SIZE - 1)) == 0,
+              "FILAMENT_ID_TABLE_SIZE must be a power of two >= 2 * FILAMENT_MAX_COUNT");
+static_assert(FILAMENT_MATERIAL_INDEX_SIZE >= 2 * FILAMENT_MAX_COUNT &&
+                  (FILAMENT_MATERIAL_INDEX_SIZE & (FILAMENT_MATERIAL_INDEX_SIZE - 1)) == 0,
+              "FILAMENT_MATERIAL_INDEX_SIZE must be a power of two >= 2 * FILAMENT_MAX_COUNT");
+
+static constexpr size_t ID_MASK = FILAMENT_ID_TABLE_SIZE - 1;
+
+// 修改耗材表期间持有互斥锁，写回在持久化任务中执行；批量修改中本任务可以再次取得
+class ManagerLock {
+public:
+    explicit ManagerLock(SemaphoreHandle_t mutex) : mutex_(mutex) {
+        xSemaphoreTakeRecursive(mutex_, portMAX_DELAY);
+    }
+    ~ManagerLock() { xSemaphoreGiveRecursive(mutex_); }
+
+private:
+    SemaphoreHandle_t mutex_;
+};
+
+FilamentManager::Table::Table() : next_id(1) { reset(); }
+
+// 整体复制，元数据指针指向 other 的存储区，换算到本表的存储区
+void FilamentManager::Table::copyFrom(const Table &other) {
+    std::copy(std::begin(other.slots), std::end(other.slots), slots);
+    std::copy(std::begin(other.id_table), std::end(other.id_table), id_table);
+    std::copy(std::begin(other.material_index), std::end(other.material_index), material_index);
+    count = other.count;
+    next_id = other.next_id;
+    metadata_arena = other.metadata_arena;
+    for (auto &filament : slots) {
+        if (filament.id != 0) {
+            filament.metadata =
+                metadata_arena.data() + (filament.metadata - other.metadata_arena.data());
+        }
     }
 }
 
-void FilamentManager::init() {
-    filaments.clear();
-    id_to_index.clear();
-    next_id = 1;
+FilamentManager::Reader::~Reader() { readers_.fetch_sub(1, std::memory_order_release); }
+
+FilamentManager::FilamentManager()
+    : current(0), readers{}, mutex(xSemaphoreCreateRecursiveMutex()) {}
+
+// 丢弃未提交的批量修改，写入其他尚未保存的修改
+FilamentManager::~FilamentManager() {
+    rollbackBatch();
+    flush();
+    vSemaphoreDelete(mutex);
+}
+
+void FilamentManager::init(NVSManager &nvs_manager, PersistService *persist_service) {
+    ManagerLock lock(mutex);
+    nvs = &nvs_manager;
+    persist = persist_service;
+    if (persist != nullptr && persist_client < 0) {
+        persist_client = persist->registerClient("filaments", persist_flush, this);
+    }
+    dirty_slots = 0;
 
     // 从存储加载数据
     if (!loadFromStorage()) {
@@ -27,112 +79,271 @@ void FilamentManager::init() {
     }
 }
 
+FilamentManager::Reader FilamentManager::read() const {
+    while (true) {
+        uint8_t index = current.load();
+        readers[index].fetch_add(1);
+        // 计数后版本仍未切换时，修改者一定能看到该计数，不会改写这个版本
+        if (current.load() == index) {
+            return Reader(readers[index], tables[index]);
+        }
+        readers[index].fetch_sub(1);
+    }
+}
+
+// 调用前持有 mutex：等待副本上的读者退出，再以当前版本初始化副本
+FilamentManager::Table &FilamentManager::beginWrite() {
+    uint8_t next = current.load(std::memory_order_relaxed) ^ 1;
+    // 读者只在查找期间持有旧版本，通常不需要等待
+    while (readers[next].load() != 0) {
+        vTaskDelay(1);
+    }
+    tables[next].copyFrom(tables[next ^ 1]);
+    return tables[next];
+}
+
+// 切换到 beginWrite() 返回的副本；不调用时本次修改被丢弃
+void FilamentManager::publish() { current.store(current.load(std::memory_order_relaxed) ^ 1); }
+
+// 以下调用前持有 mutex：批量修改中为尚未发布的副本，否则与 published() / beginWrite() /
+// publish() 相同，单个修改在批量修改中只改副本
+const FilamentManager::Table &FilamentManager::latest() const {
+    return batching ? tables[current.load(std::memory_order_relaxed) ^ 1] : published();
+}
+
+FilamentManager::Table &FilamentManager::beginEdit() {
+    return batching ? tables[current.load(std::memory_order_relaxed) ^ 1] : beginWrite();
+}
+
+void FilamentManager::endEdit() {
+    if (!batching) {
+        publish();
+    }
+}
+
 int FilamentManager::addFilament(int motor_id, const char *metadata) {
-    if (getFilamentByMotorId(motor_id) != nullptr) {
+    ManagerLock lock(mutex);
+    if (!Table::validMotorId(motor_id)) {
+        ESP_LOGW(TAG, "Motor ID %d out of range", motor_id);
+        return -1;
+    }
+    if (latest().slots[motor_id].id != 0) {
         ESP_LOGW(TAG, "Motor ID %d is already in use", motor_id);
         return -1;
     }
-    int new_id = generateId();
-    Filament filament(new_id, motor_id, metadata);
-    filaments.push_back(filament);
-    id_to_index[new_id] = filaments.size() - 1;
-    saveToStorage();
+    int slot = latest().allocateSlot();
+    if (slot < 0) {
+        ESP_LOGW(TAG, "Filament table full (max %d)", FILAMENT_MAX_COUNT);
+        return -1;
+    }
+    Table &table = beginEdit();
+    const char *stored = table.storeMetadata(metadata);
+    if (stored == nullptr) {
+        return -1;
+    }
+    int new_id = table.generateId();
+    table.insertFilament(new_id, motor_id, stored, slot);
+    table.rebuildMaterialIndex();
+    endEdit();
+    markDirty(slot);
     return new_id;
 }
 
 bool FilamentManager::removeFilament(int id) {
-    auto it = id_to_index.find(id);
-    if (it == id_to_index.end()) {
+    ManagerLock lock(mutex);
+    int pos = latest().findId(id);
+    if (pos < 0) {
         return false;
     }
-    size_t index = it->second;
-    filaments.erase(filaments.begin() + index);
-    id_to_index.erase(it);
-    updateIndexMapping();
+    Table &table = beginEdit();
+    Filament &filament = table.slots[table.id_table[pos].motor_id];
+    uint8_t slot = filament.storage_slot;
+    table.releaseMetadata(filament.metadata);
+    filament = Filament();
+    table.eraseId(id);
+    table.count--;
+    table.rebuildMaterialIndex();
+    endEdit();
+    markDirty(slot);
     return true;
 }
 
 bool FilamentManager::updateFilament(int id, int motor_id, const char *metadata) {
-    auto it = id_to_index.find(id);
-    if (it == id_to_index.end()) {
+    ManagerLock lock(mutex);
+    int pos = latest().findId(id);
+    if (pos < 0) {
         return false;
     }
-    size_t index = it->second;
-    Filament &filament = filaments[index];
-    if (motor_id != -1 && motor_id != filament.motor_id) {
-        if (getFilamentByMotorId(motor_id) != nullptr) {
-            ESP_LOGW(TAG, "Motor ID %d is already in use", motor_id);
+    Table &table = beginEdit();
+    int current_motor = table.id_table[pos].motor_id;
+    if (motor_id != -1 && motor_id != current_motor) {
+        if (!Table::validMotorId(motor_id) || table.slots[motor_id].id != 0) {
+            ESP_LOGW(TAG, "Motor ID %d is out of range or already in use", motor_id);
+            return false;
+        }
+    }
+    Filament &filament = table.slots[current_motor];
+    if (metadata != nullptr && metadata[0] != '\0' && strcmp(metadata, filament.metadata) != 0) {
+        // 先释放旧值再写入，存储区满时也能替换为不更长的元数据；
+        // 失败时放回旧值，批量修改中的副本之后还会继续使用
+        char previous[FILAMENT_METADATA_MAX];
+        snprintf(previous, sizeof(previous), "%s", filament.metadata);
+        table.releaseMetadata(filament.metadata);
+        const char *stored = table.storeMetadata(metadata);
+        if (stored == nullptr) {
+            filament.metadata = table.storeMetadata(previous);
             return false;
         }
-        filament.motor_id = motor_id;
+        filament.metadata = stored;
+        filament.meta.parse(stored);
     }
-    if (metadata != nullptr && metadata[0] != '\0') {
-        filament.metadata = metadata;
+    if (motor_id != -1 && motor_id != current_motor) {
+        // 移动到新电机的槽位
+        table.slots[motor_id] = filament;
+        table.slots[motor_id].motor_id = motor_id;
+        filament = Filament();
+        table.id_table[pos].motor_id = motor_id;
+        current_motor = motor_id;
     }
-    saveToStorage();
+    table.rebuildMaterialIndex();
+    endEdit();
+    markDirty(table.slots[current_motor].storage_slot);
     return true;
 }
 
-const Filament *FilamentManager::getFilamentById(int id) const {
-    auto it = id_to_index.find(id);
-    if (it == id_to_index.end()) {
-        return nullptr;
+bool FilamentManager::setMetadataValue(int id, const char *key, const char *value) {
+    cJSON *json;
+    {
+        // 修改前释放 Reader，否则下一次修改可能等待自己
+        Reader table = read();
+        const Filament *filament = table->getFilamentById(id);
+        if (filament == nullptr) {
+            return false;
+        }
+        json = cJSON_Parse(filament->metadata);
+    }
+    if (json == nullptr) {
+        json = cJSON_CreateObject();
     }
-    size_t index = it->second;
-    return &filaments[index];
+    cJSON_DeleteItemFromObject(json, key);
+    cJSON_AddStringToObject(json, key, value);
+    // 直接输出到栈上的缓冲区，超过 FILAMENT_METADATA_MAX 时失败
+    char metadata[FILAMENT_METADATA_MAX];
+    bool printed = cJSON_PrintPreallocated(json, metadata, sizeof(metadata), false);
+    cJSON_Delete(json);
+    if (!printed) {
+        ESP_LOGW(TAG, "Metadata of filament %d would exceed %d bytes", id, FILAMENT_METADATA_MAX);
+        return false;
+    }
+    return updateFilament(id, -1, metadata);
+}
+
+const Filament *FilamentManager::Table::getFilamentById(int id) const {
+    int pos = findId(id);
+    return pos < 0 ? nullptr : &slots[id_table[pos].motor_id];
 }
 
-const Filament *FilamentManager::getFilamentByMotorId(int motor_id) const {
-    auto it = std::find_if(filaments.begin(), filaments.end(),
-                           [motor_id](const Filament &f) { return f.motor_id == motor_id; });
-    if (it != filaments.end()) {
-        return &(*it);
+const Filament *FilamentManager::Table::getFilamentByMotorId(int motor_id) const {
+    if (!validMotorId(motor_id) || slots[motor_id].id == 0) {
+        return nullptr;
     }
-    return nullptr;
+    return &slots[motor_id];
 }
 
-const std::vector<Filament> &FilamentManager::getAllFilaments() const { return filaments; }
+// 比较写入时保存的键值哈希，不解析 JSON
+size_t FilamentManager::Table::findFilamentsByMetadata(const char *key, const char *value,
+                                                       const Filament **out, size_t max) const {
+    uint32_t key_hash = json_path_hash(key);
+    uint32_t value_hash = json_path_hash(value);
+    size_t found = 0;
+    forEach([&](const Filament &filament) {
+        if (found < max && filament.meta.matches(key_hash, value_hash)) {
+            out[found++] = &filament;
+        }
+    });
+    return found;
+}
 
-std::vector<const Filament *> FilamentManager::findFilamentsByMetadata(const char *key,
-                                                                       const char *value) const {
-    std::vector<const Filament *> result;
-    for (const auto &filament : filaments) {
-        if (filament.getMetadataValue(key) == value) {
-            result.push_back(&filament);
+const Filament *FilamentManager::Table::findFilamentByMaterial(const char *type,
+                                                               uint32_t color) const {
+    uint32_t hash = FilamentMeta::materialHash(type, color);
+    for (size_t i = 0; i < FILAMENT_MATERIAL_INDEX_SIZE; i++) {
+        const MaterialSlot &slot = material_index[(hash + i) & (FILAMENT_MATERIAL_INDEX_SIZE - 1)];
+        if (slot.index < 0) {
+            return nullptr;
+        }
+        const Filament &filament = slots[slot.index];
+        if (slot.hash == hash && filament.meta.color == color &&
+            strcasecmp(filament.meta.type, type) == 0) {
+            return &filament;
         }
     }
-    return result;
+    return nullptr;
 }
 
-size_t FilamentManager::getCount() const { return filaments.size(); }
+size_t FilamentManager::getCount() const { return read()->getCount(); }
 
+// 只清空内存中的表，之前的修改先写入
 void FilamentManager::clear() {
-    filaments.clear();
-    id_to_index.clear();
+    ManagerLock lock(mutex);
+    flushLocked(nullptr);
+    beginEdit().reset();
+    endEdit();
+    dirty_slots = 0;
+    batch_dirty = 0;
+}
+
+void FilamentManager::Table::reset() {
+    for (auto &filament : slots) {
+        filament = Filament();
+    }
+    for (auto &slot : id_table) {
+        slot = {0, -1};
+    }
+    count = 0;
     next_id = 1;
+    metadata_arena.clear();
+    rebuildMaterialIndex();
 }
 
 const char *FilamentManager::toJson() const {
     cJSON *json_array = cJSON_CreateArray();
-    for (const auto &filament : filaments) {
+    forEach([json_array](const Filament &filament) {
         cJSON *filament_json = cJSON_CreateObject();
         cJSON_AddNumberToObject(filament_json, "id", filament.id);
         cJSON_AddNumberToObject(filament_json, "motor_id", filament.motor_id);
         cJSON_AddStringToObject(filament_json, "metadata", filament.metadata);
         cJSON_AddItemToArray(json_array, filament_json);
-    }
+    });
     char *json_string = cJSON_PrintUnformatted(json_array);
     // cJSON_free(json_string);
     cJSON_Delete(json_array);
     return json_string;
 }
 
+// 替换内存中的表，不写入存储；之前的修改先写入
 bool FilamentManager::fromJson(const char *json_string) {
+    ManagerLock lock(mutex);
+    flushLocked(nullptr);
+    bool success = beginEdit().loadJson(json_string);
+    endEdit();
+    dirty_slots = 0;
+    batch_dirty = 0;
+    return success;
+}
+
+bool FilamentManager::flush(size_t *bytes) {
+    ManagerLock lock(mutex);
+    return flushLocked(bytes);
+}
+
+bool FilamentManager::Table::loadJson(const char *json_string) {
     cJSON *json_array = cJSON_Parse(json_string);
     if (json_array == nullptr || !cJSON_IsArray(json_array)) {
+        cJSON_Delete(json_array);
         return false;
     }
-    clear();
+    reset();
     int array_size = cJSON_GetArraySize(json_array);
     bool success = true;
     for (int i = 0; i < array_size; i++) {
@@ -149,64 +360,350 @@ bool FilamentManager::fromJson(const char *json_string) {
             int id = id_obj->valueint;
             int motor_id = motor_id_obj->valueint;
             const char *metadata = metadata_obj->valuestring;
-            if (id_to_index.find(id) != id_to_index.end()) {
-                success = false;
-                continue;
-            }
-            if (getFilamentByMotorId(motor_id) != nullptr) {
+            // valuestring 随 json_array 释放，需要复制
+            int slot = allocateSlot();
+            const char *stored = slot < 0 ? nullptr : storeMetadata(metadata);
+            if (stored == nullptr || !insertFilament(id, motor_id, stored, slot)) {
                 success = false;
                 continue;
             }
-            Filament filament(id, motor_id, metadata);
-            filaments.push_back(filament);
-            id_to_index[id] = filaments.size() - 1;
-            if (id >= next_id) {
-                next_id = id + 1;
-            }
         } else {
             success = false;
         }
     }
     if (!success) {
-        clear();
+        reset();
     }
+    rebuildMaterialIndex();
     cJSON_Delete(json_array);
     return success;
 }
 
-int FilamentManager::generateId() {
-    while (id_to_index.find(next_id) != id_to_index.end()) {
+int FilamentManager::Table::findId(int id) const {
+    if (id <= 0) {
+        return -1;
+    }
+    // id 连续分配，直接取低位即可均匀分布
+    size_t pos = id & ID_MASK;
+    for (size_t i = 0; i < FILAMENT_ID_TABLE_SIZE; i++) {
+        if (id_table[pos].id == id) {
+            return pos;
+        }
+        if (id_table[pos].id == 0) {
+            return -1;
+        }
+        pos = (pos + 1) & ID_MASK;
+    }
+    return -1;
+}
+
+void FilamentManager::Table::insertId(int id, int motor_id) {
+    size_t pos = id & ID_MASK;
+    while (id_table[pos].id != 0) {
+        pos = (pos + 1) & ID_MASK;
+    }
+    id_table[pos] = {id, static_cast<int8_t>(motor_id)};
+}
+
+// 线性探测的删除：把后续探测链上的条目前移，不留墓碑
+void FilamentManager::Table::eraseId(int id) {
+    int found = findId(id);
+    if (found < 0) {
+        return;
+    }
+    size_t hole = found;
+    size_t pos = hole;
+    while (true) {
+        pos = (pos + 1) & ID_MASK;
+        if (id_table[pos].id == 0) {
+            break;
+        }
+        size_t home = id_table[pos].id & ID_MASK;
+        // home 不在 (hole, pos] 区间内时，该条目可以前移到 hole
+        if (((pos - home) & ID_MASK) >= ((pos - hole) & ID_MASK)) {
+            id_table[hole] = id_table[pos];
+            hole = pos;
+        }
+    }
+    id_table[hole] = {0, -1};
+}
+
+// 校验 id 和电机编号后写入槽位，元数据已存入存储区
+bool FilamentManager::Table::insertFilament(int id, int motor_id, const char *stored,
+                                            uint8_t storage_slot) {
+    if (id <= 0 || !validMotorId(motor_id) || slots[motor_id].id != 0 || findId(id) >= 0) {
+        ESP_LOGW(TAG, "Invalid or duplicate filament id %d / motor %d", id, motor_id);
+        releaseMetadata(stored);
+        return false;
+    }
+    slots[motor_id] = Filament(id, motor_id, stored, storage_slot);
+    insertId(id, motor_id);
+    count++;
+    if (id >= next_id) {
+        next_id = id + 1;
+    }
+    return true;
+}
+
+int FilamentManager::Table::generateId() {
+    while (findId(next_id) >= 0) {
         next_id++;
     }
     return next_id++;
 }
 
-void FilamentManager::updateIndexMapping() {
-    id_to_index.clear();
-    for (size_t i = 0; i < filaments.size(); i++) {
-        id_to_index[filaments[i].id] = i;
+// 最多 FILAMENT_MAX_COUNT 条，每次变更后整体重建；相同材料只保留第一条
+void FilamentManager::Table::rebuildMaterialIndex() {
+    for (auto &slot : material_index) {
+        slot.index = -1;
+    }
+    for (size_t i = 0; i < FILAMENT_MAX_COUNT; i++) {
+        const FilamentMeta &meta = slots[i].meta;
+        if (slots[i].id == 0 ||
+            (meta.fields & (FILAMENT_META_HAS_TYPE | FILAMENT_META_HAS_COLOR)) !=
+                (FILAMENT_META_HAS_TYPE | FILAMENT_META_HAS_COLOR) ||
+            findFilamentByMaterial(meta.type, meta.color) != nullptr) {
+            continue;
+        }
+        uint32_t hash = FilamentMeta::materialHash(meta.type, meta.color);
+        size_t pos = hash & (FILAMENT_MATERIAL_INDEX_SIZE - 1);
+        while (material_index[pos].index >= 0) {
+            pos = (pos + 1) & (FILAMENT_MATERIAL_INDEX_SIZE - 1);
+        }
+        material_index[pos] = {hash, static_cast<int8_t>(i)};
+    }
+}
+
+int FilamentManager::Table::allocateSlot() const {
+    uint32_t used = 0;
+    forEach([&used](const Filament &filament) { used |= 1u << filament.storage_slot; });
+    for (int slot = 0; slot < FILAMENT_MAX_COUNT; slot++) {
+        if (!(used & (1u << slot))) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+const char *FilamentManager::Table::storeMetadata(const char *metadata) {
+    size_t len = strlen(metadata);
+    if (len >= FILAMENT_METADATA_MAX) {
+        ESP_LOGW(TAG, "Metadata too long (max %d)", FILAMENT_METADATA_MAX - 1);
+        return nullptr;
+    }
+    const char *stored = metadata_arena.store(metadata, len);
+    if (stored == nullptr) {
+        ESP_LOGW(TAG, "Metadata storage full (%d/%d bytes)", (int)metadata_arena.used(),
+                 (int)metadata_arena.capacity());
+    }
+    return stored;
+}
+
+void FilamentManager::Table::releaseMetadata(const char *metadata) {
+    size_t moved = metadata_arena.release(metadata);
+    // 存储区压缩后，位于其后的元数据整体前移
+    for (auto &filament : slots) {
+        if (filament.id != 0 && filament.metadata > metadata) {
+            filament.metadata -= moved;
+        }
     }
 }
 
+void FilamentManager::recordKey(uint8_t slot, char (&key)[16]) {
+    snprintf(key, sizeof(key), "fil_%u", slot);
+}
+
+uint32_t FilamentManager::recordCrc(const FilamentRecord &record) {
+    return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(&record),
+                            offsetof(FilamentRecord, crc));
+}
+
 bool FilamentManager::loadFromStorage() {
-    const char *json_data;
-    esp_err_t err = Instance::get().nvs_manager->get<const char *>(nvs_key, json_data);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Loaded filaments data from storage");
-        ESP_LOGI(TAG, "Filaments JSON: %s", json_data);
-        return fromJson(json_data);
-    }
-    ESP_LOGW(TAG, "No filament data found in storage");
-    return false;
-}
-
-bool FilamentManager::saveToStorage() const {
-    ESP_LOGI(TAG, "Saving filaments to storage");
-    const char *json_data = toJson();
-    esp_err_t err = Instance::get().nvs_manager->set<const char *>(nvs_key, json_data);
-    if (err == ESP_OK) {
-        return Instance::get().nvs_manager->commit() == ESP_OK;
-    }
-    ESP_LOGE(TAG, "Failed to save filaments to storage: %s", esp_err_to_name(err));
-    return false;
+    // 旧版本固件保存的 JSON 优先迁移，迁移中断时记录可能不完整
+    if (migrateFromJson()) {
+        return true;
+    }
+    Table &table = beginWrite();
+    table.reset();
+
+    // 每条记录直接读入定长结构，无需解析
+    static FilamentRecord record;
+    char key[16];
+    bool found = false;
+    for (uint8_t slot = 0; slot < FILAMENT_MAX_COUNT; slot++) {
+        recordKey(slot, key);
+        if (nvs->get<FilamentRecord>(key, record) != ESP_OK) {
+            continue;
+        }
+        found = true;
+        if (record.magic != FILAMENT_STORE_MAGIC || record.version != FILAMENT_STORE_VERSION ||
+            record.metadata_len >= FILAMENT_METADATA_MAX || record.crc != recordCrc(record)) {
+            ESP_LOGE(TAG, "Filament record %s is corrupted or has unknown version, skipped", key);
+            continue;
+        }
+        record.metadata[record.metadata_len] = '\0';
+        const char *stored = table.storeMetadata(record.metadata);
+        if (stored != nullptr) {
+            table.insertFilament(record.id, record.motor_id, stored, slot);
+        }
+    }
+    table.rebuildMaterialIndex();
+    publish();
+    if (found) {
+        ESP_LOGI(TAG, "Loaded %d filaments from storage", (int)table.count);
+    } else {
+        ESP_LOGW(TAG, "No filament data found in storage");
+    }
+    return found;
+}
+
+bool FilamentManager::migrateFromJson() {
+    const char *json_data = nullptr;
+    if (nvs->get<const char *>(legacy_nvs_key, json_data) != ESP_OK) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Migrating filaments from JSON storage");
+    Table &table = beginWrite();
+    bool success = table.loadJson(json_data);
+    delete[] json_data;
+    if (!success) {
+        // 保留旧数据，避免迁移失败导致丢失
+        ESP_LOGE(TAG, "Failed to parse legacy filament JSON, keeping it");
+        return false;
+    }
+    publish();
+    // 迁移需在删除旧数据前同步写入，不经过持久化任务
+    table.forEach(
+        [this](const Filament &filament) { dirty_slots |= 1u << filament.storage_slot; });
+    if (!flushLocked(nullptr)) {
+        return false;
+    }
+    nvs->erase(legacy_nvs_key);
+    ESP_LOGI(TAG, "Migrated %d filaments to binary records", (int)table.count);
+    return true;
+}
+
+// 取得的 mutex 到 commitBatch() / rollbackBatch() 时才释放，其他任务的修改在此之前等待
+bool FilamentManager::beginBatch() {
+    xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+    if (batching) {
+        xSemaphoreGiveRecursive(mutex);
+        ESP_LOGW(TAG, "Batch already in progress");
+        return false;
+    }
+    beginWrite();
+    batching = true;
+    batch_dirty = 0;
+    return true;
+}
+
+// 读者从旧表一次切换到完整的新表
+void FilamentManager::commitBatch() {
+    ManagerLock lock(mutex);
+    if (!batching) {
+        return;
+    }
+    batching = false;
+    publish();
+    dirty_slots |= batch_dirty;
+    batch_dirty = 0;
+    if (dirty_slots != 0) {
+        schedulePersist();
+    }
+    xSemaphoreGiveRecursive(mutex);
+}
+
+// 副本未发布，直接丢弃；当前版本和它的待写记录不变
+void FilamentManager::rollbackBatch() {
+    ManagerLock lock(mutex);
+    if (!batching) {
+        return;
+    }
+    batching = false;
+    batch_dirty = 0;
+    xSemaphoreGiveRecursive(mutex);
+}
+
+void FilamentManager::markDirty(uint8_t slot) {
+    if (batching) {
+        batch_dirty |= 1u << slot;
+        return;
+    }
+    dirty_slots |= 1u << slot;
+    schedulePersist();
+}
+
+void FilamentManager::schedulePersist() {
+    if (persist != nullptr && persist_client >= 0) {
+        persist->markDirty(persist_client);
+    } else {
+        flushLocked(nullptr);
+    }
+}
+
+bool FilamentManager::persist_flush(void *ctx, size_t *bytes) {
+    return static_cast<FilamentManager *>(ctx)->flush(bytes);
+}
+
+// 逐条写入或删除待写的记录，最后提交一次；失败的记录保持待写
+bool FilamentManager::flushLocked(size_t *bytes) {
+    if (nvs == nullptr) {
+        dirty_slots = 0;
+        return true;
+    }
+    // 批量修改中的记录在 commitBatch() 后才计入 dirty_slots
+    if (dirty_slots == 0) {
+        return true;
+    }
+    // 持有 mutex 时当前版本不会改变
+    const Filament *by_slot[FILAMENT_MAX_COUNT] = {};
+    published().forEach(
+        [&by_slot](const Filament &filament) { by_slot[filament.storage_slot] = &filament; });
+
+    bool success = true;
+    size_t written = 0;
+    char key[16];
+    for (uint8_t slot = 0; slot < FILAMENT_MAX_COUNT; slot++) {
+        if (!(dirty_slots & (1u << slot))) {
+            continue;
+        }
+        esp_err_t err;
+        if (by_slot[slot] != nullptr) {
+            err = writeRecord(*by_slot[slot]);
+            written += err == ESP_OK ? sizeof(FilamentRecord) : 0;
+        } else {
+            // 尚未写入过的记录不存在，erase() 视为成功
+            recordKey(slot, key);
+            err = nvs->erase(key, false);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write filament record %u: %s", slot, esp_err_to_name(err));
+            success = false;
+            continue;
+        }
+        dirty_slots &= ~(1u << slot);
+    }
+    if (nvs->commit() != ESP_OK) {
+        success = false;
+    }
+    if (bytes != nullptr) {
+        *bytes += written;
+    }
+    return success;
+}
+
+esp_err_t FilamentManager::writeRecord(const Filament &filament) {
+    static FilamentRecord record;
+    memset(&record, 0, sizeof(record));
+    record.magic = FILAMENT_STORE_MAGIC;
+    record.version = FILAMENT_STORE_VERSION;
+    record.id = filament.id;
+    record.motor_id = filament.motor_id;
+    record.metadata_len = strlen(filament.metadata);
+    memcpy(record.metadata, filament.metadata, record.metadata_len);
+    record.crc = recordCrc(record);
+
+    char key[16];
+    recordKey(filament.storage_slot, key);
+    return nvs->set<FilamentRecord>(key, record);
 }
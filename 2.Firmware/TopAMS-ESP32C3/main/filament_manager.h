@@ -1,43 +1,227 @@
 #pragma once
 
+#include "metadata_arena.h"
 #include "model/filament.h"
-#include <map>
+#include "nvs_manager.h"
+#include "persist_service.h"
+#include <atomic>
 #include <memory>
+#include <stdint.h>
 #include <string>
-#include <vector>
+
+#define FILAMENT_MAX_COUNT 16             // 最多耗材数，电机编号范围 [0, FILAMENT_MAX_COUNT)
+#define FILAMENT_METADATA_MAX 256         // 单条元数据最大长度 (含结尾 '\0')
+#define FILAMENT_METADATA_ARENA_SIZE 2048 // 所有耗材元数据共用的存储区大小
+#define FILAMENT_ID_TABLE_SIZE 32         // id 哈希表槽数，2 的幂且不小于 2 * FILAMENT_MAX_COUNT
+#define FILAMENT_MATERIAL_INDEX_SIZE 32   // 材料索引槽数，2 的幂且不小于 2 * FILAMENT_MAX_COUNT
+#define FILAMENT_STORE_VERSION 1          // 二进制记录格式版本，结构变化时递增
+#define FILAMENT_STORE_MAGIC 0x4C494646   // "FFIL" (小端)
 
 /**
  * @brief 3D打印耗材管理类
+ *
+ * 每条耗材以定长二进制记录保存在独立的 NVS 键 (fil_<槽位>) 中，带版本和 CRC，
+ * 增改删只写对应的一条记录。旧版本的整表 JSON (键 "filaments") 在首次加载时迁移。
+ * 耗材保存在按电机编号索引的定长数组中，id 通过线性探测哈希表映射到电机编号，
+ * 按 id / 电机编号查找均为 O(1)，增删改不分配内存。
+ * 元数据复制到表内的定长存储区，Filament::metadata 指向该区。
+ * 元数据在写入时解析为 FilamentMeta，并按 (类型, 颜色) 建立开放寻址索引，
+ * 换料时按材料查找耗材为 O(1) 且不分配内存。
+ * init() 传入 PersistService 时，增改删只标记记录待写，由持久化任务合并后写入并提交一次；
+ * 否则每次修改后立即写入。
+ *
+ * 多任务访问 (RCU)：耗材表有两个版本，读者经 read() 取得当前版本，不加锁也不会被修改阻塞；
+ * 修改在互斥锁内把当前版本复制到另一个版本上执行，完成后原子地切换当前版本。
+ * 下一次修改需要等上上个版本的读者全部退出，读者应只短暂持有 Reader，持有期间不要修改。
+ * 批量修改的所有操作都在这个副本上执行，提交时只切换一次，读者看不到执行到一半的批量修改。
  */
 class FilamentManager {
-private:
-    std::vector<Filament> filaments;   // 耗材列表
-    std::map<int, size_t> id_to_index; // ID到索引的映射，用于快速查找
-    int next_id;                       // 下一个可用的ID
-
 public:
+    /**
+     * @brief 耗材表的一个版本，发布后只读
+     */
+    class Table {
+    public:
+        Table();
+
+        const Filament *getFilamentById(int id) const;
+        const Filament *getFilamentByMotorId(int motor_id) const;
+
+        /**
+         * @brief 按电机编号顺序遍历所有耗材
+         * @param fn 形如 void(const Filament &) 的可调用对象
+         */
+        template <typename Fn> void forEach(Fn fn) const {
+            for (const auto &filament : slots) {
+                if (filament.id != 0) {
+                    fn(filament);
+                }
+            }
+        }
+
+        /**
+         * @brief 查找顶层键 key 的值 (原文) 等于 value 的耗材，按电机编号顺序
+         * @return 找到的数量，最多写入 max 个
+         */
+        size_t findFilamentsByMetadata(const char *key, const char *value, const Filament **out,
+                                       size_t max) const;
+
+        /**
+         * @brief 按材料类型 (不区分大小写) 和颜色查找耗材，有多条时返回电机编号最小的
+         * @param color RRGGBBAA
+         * @return 耗材指针，不存在时返回 nullptr
+         */
+        const Filament *findFilamentByMaterial(const char *type, uint32_t color) const;
+        size_t getCount() const { return count; }
+
+    private:
+        friend class FilamentManager;
+
+        struct IdSlot {
+            int32_t id;       // 0 为空槽
+            int8_t motor_id;
+        };
+
+        struct MaterialSlot {
+            uint32_t hash;
+            int8_t index; // 电机编号，-1 为空槽
+        };
+
+        Filament slots[FILAMENT_MAX_COUNT];                         // 按电机编号索引，空槽 id 为 0
+        IdSlot id_table[FILAMENT_ID_TABLE_SIZE];                    // id -> 电机编号
+        MaterialSlot material_index[FILAMENT_MATERIAL_INDEX_SIZE];  // (类型, 颜色) -> 电机编号
+        size_t count;                                               // 已登记的耗材数
+        int next_id;                                                // 下一个可用的ID
+        MetadataArena<FILAMENT_METADATA_ARENA_SIZE> metadata_arena; // 元数据存储区
+
+        static bool validMotorId(int motor_id) {
+            return motor_id >= 0 && motor_id < FILAMENT_MAX_COUNT;
+        }
+        void copyFrom(const Table &other);
+        int findId(int id) const;
+        void insertId(int id, int motor_id);
+        void eraseId(int id);
+        bool insertFilament(int id, int motor_id, const char *stored, uint8_t storage_slot);
+        int generateId();
+        int allocateSlot() const;
+        const char *storeMetadata(const char *metadata);
+        void releaseMetadata(const char *metadata);
+        void rebuildMaterialIndex();
+        void reset();
+        bool loadJson(const char *json_string);
+    };
+
+    /**
+     * @brief 当前版本的只读引用，析构前该版本不会被修改，其中的 Filament 指针保持有效
+     */
+    class Reader {
+    public:
+        ~Reader();
+        Reader(const Reader &) = delete;
+        Reader &operator=(const Reader &) = delete;
+
+        const Table *operator->() const { return table_; }
+        const Table &operator*() const { return *table_; }
+
+    private:
+        friend class FilamentManager;
+        Reader(std::atomic<uint32_t> &readers, const Table &table)
+            : readers_(readers), table_(&table) {}
+
+        std::atomic<uint32_t> &readers_;
+        const Table *table_;
+    };
+
     FilamentManager();
     ~FilamentManager();
 
-    void init();
+    /**
+     * @brief 从 NVS 加载耗材，需在其他任务使用前调用
+     * @param persist_service 延迟写入服务，为空时每次修改立即写入
+     */
+    void init(NVSManager &nvs_manager, PersistService *persist_service = nullptr);
+
+    /**
+     * @brief 取得当前版本，任意任务均可调用，不会阻塞
+     */
+    Reader read() const;
 
     int addFilament(int motor_id, const char *metadata = "{}");
     bool removeFilament(int id);
     bool updateFilament(int id, int motor_id = -1, const char *metadata = "");
-    const Filament *getFilamentById(int id) const;
-    const Filament *getFilamentByMotorId(int motor_id) const;
-    const std::vector<Filament> &getAllFilaments() const;
-    std::vector<const Filament *> findFilamentsByMetadata(const char *key, const char *value) const;
+    bool setMetadataValue(int id, const char *key, const char *value);
+
+    /**
+     * @brief 在当前版本上遍历所有耗材，遍历期间持有 Reader
+     * @param fn 形如 void(const Filament &) 的可调用对象
+     */
+    template <typename Fn> void forEach(Fn fn) const { read()->forEach(fn); }
+
     size_t getCount() const;
     void clear();
     const char *toJson() const;
     bool fromJson(const char *json_string);
 
+    /**
+     * @brief 写入所有待写的记录并提交一次
+     * @param bytes 不为空时累加写入的字节数
+     * @return false 有记录写入失败，保持待写状态
+     */
+    bool flush(size_t *bytes = nullptr);
+
+    /**
+     * @brief 开始批量修改
+     *
+     * 之后本任务的增删改在耗材表的私有副本上执行，读者仍看到 beginBatch() 时的版本；
+     * commitBatch() 一次发布副本并合并为一次写入，rollbackBatch() 丢弃副本。
+     * 批量修改期间持有互斥锁，其他任务的修改 (和其他批量修改) 等待其结束，不会被回滚。
+     * 失败的单个操作可能已部分修改副本，之后应回滚。
+     * @return false 本任务已在批量修改中
+     */
+    bool beginBatch();
+    void commitBatch();
+    void rollbackBatch();
+
 private:
-    int generateId();
-    void updateIndexMapping();
+    /**
+     * @brief NVS 中的定长耗材记录，crc 覆盖之前的所有字段
+     */
+    struct FilamentRecord {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t metadata_len;
+        int32_t id;
+        int32_t motor_id;
+        char metadata[FILAMENT_METADATA_MAX];
+        uint32_t crc;
+    };
+
+    Table tables[2];                          // 当前版本和下一次修改的副本
+    std::atomic<uint8_t> current;             // 读者看到的版本
+    mutable std::atomic<uint32_t> readers[2]; // 各版本的读者数
+    bool batching = false;                    // 批量修改中，副本尚未发布
+    uint32_t batch_dirty = 0;                 // 批量修改中修改的记录，提交后待写
+    NVSManager *nvs = nullptr;                // init() 前为空
+    PersistService *persist = nullptr;        // 为空时修改后立即写入
+    int persist_client = -1;
+    uint32_t dirty_slots = 0;                 // 待写入的记录，按存储槽位
+    SemaphoreHandle_t mutex;                  // 修改与写回互斥 (递归，批量修改期间持有)
+
+    const Table &published() const { return tables[current.load(std::memory_order_relaxed)]; }
+    Table &beginWrite();
+    void publish();
+    const Table &latest() const;
+    Table &beginEdit();
+    void endEdit();
+    void markDirty(uint8_t slot);
+    void schedulePersist();
+    bool flushLocked(size_t *bytes);
+    static bool persist_flush(void *ctx, size_t *bytes);
     bool loadFromStorage();
-    bool saveToStorage() const;
+    bool migrateFromJson();
+    esp_err_t writeRecord(const Filament &filament);
+    static void recordKey(uint8_t slot, char (&key)[16]);
+    static uint32_t recordCrc(const FilamentRecord &record);
 
-    const char *nvs_key = "filaments";
+    const char *legacy_nvs_key = "filaments"; // 旧版整表 JSON
 };
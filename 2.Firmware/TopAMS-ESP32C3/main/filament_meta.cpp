@@ -0,0 +1,94 @@
+#include "json_stream.h"
+#include "model/filament_meta.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr uint32_t KEY_TYPE = json_path_hash("type");
+static constexpr uint32_t KEY_COLOR = json_path_hash("color");
+static constexpr uint32_t KEY_NOZZLE_TEMP_MIN = json_path_hash("nozzle_temp_min");
+static constexpr uint32_t KEY_NOZZLE_TEMP_MAX = json_path_hash("nozzle_temp_max");
+
+static void on_event(void *ctx, const JsonStream &stream, JsonEvent event,
+                     std::string_view value) {
+    FilamentMeta &meta = *static_cast<FilamentMeta *>(ctx);
+    // 只处理根对象下的标量
+    if (stream.depth() != 1 || event < JsonEvent::String) {
+        return;
+    }
+    uint32_t key = stream.pathHash();
+    // 超长的值被截断，哈希不可靠，不参与匹配
+    if (!stream.truncated() && meta.entry_count < FILAMENT_META_MAX_KEYS) {
+        meta.entries[meta.entry_count++] = {key, json_path_hash(value)};
+    }
+
+    if (key == KEY_TYPE && event == JsonEvent::String) {
+        size_t len = value.size() < FILAMENT_META_TYPE_LEN ? value.size()
+                                                            : FILAMENT_META_TYPE_LEN - 1;
+        for (size_t i = 0; i < len; i++) {
+            meta.type[i] = toupper(static_cast<unsigned char>(value[i]));
+        }
+        meta.type[len] = '\0';
+        meta.fields |= FILAMENT_META_HAS_TYPE;
+    } else if (key == KEY_COLOR && event == JsonEvent::String) {
+        if (FilamentMeta::parseColor(value.data(), meta.color)) {
+            meta.fields |= FILAMENT_META_HAS_COLOR;
+        }
+    } else if (key == KEY_NOZZLE_TEMP_MIN && !value.empty()) {
+        // 数字或数字字符串均可，value 以 '\0' 结尾
+        meta.nozzle_temp_min = static_cast<int16_t>(atoi(value.data()));
+        meta.fields |= FILAMENT_META_HAS_NOZZLE_TEMP_MIN;
+    } else if (key == KEY_NOZZLE_TEMP_MAX && !value.empty()) {
+        meta.nozzle_temp_max = static_cast<int16_t>(atoi(value.data()));
+        meta.fields |= FILAMENT_META_HAS_NOZZLE_TEMP_MAX;
+    }
+}
+
+bool FilamentMeta::parse(const char *metadata) {
+    memset(this, 0, sizeof(*this));
+    if (metadata == nullptr || metadata[0] == '\0') {
+        return false;
+    }
+    JsonStream stream(on_event, this);
+    return stream.feed(metadata, strlen(metadata)) && stream.done();
+}
+
+bool FilamentMeta::matches(uint32_t key_hash, uint32_t value_hash) const {
+    for (uint8_t i = 0; i < entry_count; i++) {
+        if (entries[i].key == key_hash) {
+            return entries[i].value == value_hash;
+        }
+    }
+    return false;
+}
+
+bool FilamentMeta::parseColor(const char *text, uint32_t &color) {
+    if (text[0] == '#') {
+        text++;
+    }
+    size_t len = strlen(text);
+    if (len != 6 && len != 8) {
+        return false;
+    }
+    uint32_t value = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (!isxdigit(static_cast<unsigned char>(text[i]))) {
+            return false;
+        }
+        char c = text[i];
+        value = (value << 4) | (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+    }
+    color = len == 6 ? (value << 8) | 0xFF : value;
+    return true;
+}
+
+uint32_t FilamentMeta::materialHash(const char *type, uint32_t color) {
+    uint32_t hash = 2166136261u;
+    for (const char *p = type; *p; p++) {
+        hash = (hash ^ static_cast<uint8_t>(toupper(static_cast<unsigned char>(*p)))) * 16777619u;
+    }
+    for (int shift = 0; shift < 32; shift += 8) {
+        hash = (hash ^ ((color >> shift) & 0xFF)) * 16777619u;
+    }
+    return hash;
+}
@@ -0,0 +1,206 @@
+#include "filament_scheduler.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "[FilamentScheduler]";
+
+class SchedulerLock {
+public:
+    explicit SchedulerLock(SemaphoreHandle_t mutex) : mutex_(mutex) {
+        xSemaphoreTake(mutex_, portMAX_DELAY);
+    }
+    ~SchedulerLock() { xSemaphoreGive(mutex_); }
+
+private:
+    SemaphoreHandle_t mutex_;
+};
+
+FilamentScheduler::FilamentScheduler(FilamentChanger &changer)
+    : changer_(changer), queue_{}, mutex_(xSemaphoreCreateMutex()) {
+    esp_timer_create_args_t args = {};
+    args.callback = timer_callback;
+    args.arg = this;
+    args.name = "fil_sched";
+    if (esp_timer_create(&args, &timer_) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create poll timer");
+        timer_ = nullptr;
+    }
+}
+
+FilamentScheduler::~FilamentScheduler() {
+    if (timer_) {
+        stop();
+        esp_timer_delete(timer_);
+    }
+    vSemaphoreDelete(mutex_);
+}
+
+bool FilamentScheduler::start(uint32_t period_ms) {
+    SchedulerLock lock(mutex_);
+    if (running_) {
+        return true;
+    }
+    if (timer_ == nullptr || esp_timer_start_periodic(timer_, period_ms * 1000ULL) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start poll timer");
+        return false;
+    }
+    running_ = true;
+    return true;
+}
+
+// 不持有锁停止，进行中的 poll() 需要取得锁才能结束
+void FilamentScheduler::stop() {
+    if (running_ && timer_) {
+        esp_timer_stop(timer_);
+    }
+    running_ = false;
+}
+
+void FilamentScheduler::timer_callback(void *arg) {
+    static_cast<FilamentScheduler *>(arg)->poll();
+}
+
+void FilamentScheduler::poll() {
+    SchedulerLock lock(mutex_);
+    FilamentChangePhase before = changer_.phase();
+    int previous = owner_;
+    expire(esp_timer_get_time());
+    notify(before, previous, previous);
+}
+
+// 占用者断开后不再有它的上报：换料阶段超时，或轮到后一直没有上报
+void FilamentScheduler::expire(int64_t now_us) {
+    changer_.poll();
+    if (owner_ >= 0 && !started_ &&
+        now_us - granted_us_ > FILAMENT_SCHEDULER_GRANT_TIMEOUT_MS * 1000LL) {
+        ESP_LOGW(TAG, "Session %d did not report, skipped", owner_);
+        stats_.skipped++;
+        owner_ = -1;
+        grantNext(now_us);
+    }
+    if (owner_ >= 0 && started_ && changer_.phase() == FILAMENT_PHASE_IDLE) {
+        owner_ = -1;
+        grantNext(now_us);
+    }
+}
+
+// 换料中为当前占用者，回到空闲时为刚结束的占用者 (没有时为 session)
+void FilamentScheduler::notify(FilamentChangePhase before, int previous, int session) {
+    if (cb_ && changer_.phase() != before) {
+        int driver = previous >= 0 ? previous : session;
+        if (changer_.phase() != FILAMENT_PHASE_IDLE) {
+            driver = owner_;
+        }
+        cb_(ctx_, driver, changer_);
+    }
+}
+
+void FilamentScheduler::onStatus(size_t session, const BambuStatus &status) {
+    SchedulerLock lock(mutex_);
+    FilamentChangePhase before = changer_.phase();
+    int previous = owner_;
+    int64_t now = esp_timer_get_time();
+
+    if (owner_ == (int)session && started_) {
+        changer_.onStatus(status);
+    } else if (owner_ == (int)session) {
+        if (changer_.request(status)) {
+            started_ = true;
+            stats_.granted++;
+            uint32_t wait_ms = static_cast<uint32_t>((now - waited_since_us_) / 1000);
+            stats_.max_wait_ms = wait_ms > stats_.max_wait_ms ? wait_ms : stats_.max_wait_ms;
+        } else {
+            ESP_LOGI(TAG, "Session %u no longer requests a tray", (unsigned)session);
+            stats_.skipped++;
+            owner_ = -1;
+        }
+    } else {
+        // 定时器之外，其他打印机的上报也顺带检查超时
+        expire(now);
+        if (owner_ < 0 && waiting_ == 0) {
+            changer_.onStatus(status);
+            if (changer_.phase() != FILAMENT_PHASE_IDLE) {
+                owner_ = session;
+                started_ = true;
+                stats_.granted++;
+            }
+        } else if (owner_ != (int)session && FilamentChanger::wants(status)) {
+            enqueue(session, now);
+        }
+    }
+
+    if (owner_ >= 0 && started_ && changer_.phase() == FILAMENT_PHASE_IDLE) {
+        owner_ = -1;
+    }
+    if (owner_ < 0) {
+        grantNext(now);
+    }
+    notify(before, previous, (int)session);
+}
+
+void FilamentScheduler::release(size_t session) {
+    SchedulerLock lock(mutex_);
+    FilamentChangePhase before = changer_.phase();
+    remove(session);
+    if (owner_ == (int)session) {
+        changer_.abort("printer session closed");
+        owner_ = -1;
+        grantNext(esp_timer_get_time());
+    }
+    notify(before, (int)session, (int)session);
+}
+
+void FilamentScheduler::enqueue(size_t session, int64_t now_us) {
+    for (size_t i = 0; i < waiting_; i++) {
+        if (queue_[i].session == session) {
+            return;
+        }
+    }
+    if (waiting_ == PRINTER_SESSION_MAX) {
+        return;
+    }
+    queue_[waiting_++] = {static_cast<uint8_t>(session), now_us};
+    stats_.queued++;
+    if (waiting_ > stats_.max_depth) {
+        stats_.max_depth = static_cast<uint8_t>(waiting_);
+    }
+    ESP_LOGI(TAG, "Session %u waits for session %d (%u waiting)", (unsigned)session, owner_,
+             (unsigned)waiting_);
+}
+
+void FilamentScheduler::remove(size_t session) {
+    size_t n = 0;
+    for (size_t i = 0; i < waiting_; i++) {
+        if (queue_[i].session != session) {
+            queue_[n++] = queue_[i];
+        }
+    }
+    waiting_ = n;
+}
+
+void FilamentScheduler::grantNext(int64_t now_us) {
+    if (waiting_ == 0) {
+        return;
+    }
+    owner_ = queue_[0].session;
+    started_ = false;
+    granted_us_ = now_us;
+    waited_since_us_ = queue_[0].since_us;
+    remove(owner_);
+    ESP_LOGI(TAG, "Session %d granted", owner_);
+}
+
+int FilamentScheduler::owner() const {
+    SchedulerLock lock(mutex_);
+    return owner_;
+}
+
+size_t FilamentScheduler::waiting() const {
+    SchedulerLock lock(mutex_);
+    return waiting_;
+}
+
+FilamentScheduler::Stats FilamentScheduler::stats() const {
+    SchedulerLock lock(mutex_);
+    return stats_;
+}
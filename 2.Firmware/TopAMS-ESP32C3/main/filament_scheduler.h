@@ -0,0 +1,104 @@
+#pragma once
+
+#include "esp_timer.h"
+#include "filament_changer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "printer_sessions.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// 轮到的打印机在该时间内没有上报则跳过，避免断开的打印机一直占用电机
+#define FILAMENT_SCHEDULER_GRANT_TIMEOUT_MS 10000
+// 定时检查换料阶段超时和轮到的打印机是否上报的周期
+#define FILAMENT_SCHEDULER_POLL_MS 1000
+
+/**
+ * @brief 多台打印机共用一组电机时的换料调度
+ *
+ * 同一时间只有一台打印机 (会话) 占用 FilamentChanger。空闲时第一台请求换料的打印机占用，
+ * 之后只有它的上报推进换料，直到回到空闲 (完成或放弃)。期间其他打印机的换料请求按先后
+ * 排队；轮到时用该打印机的下一条上报开始换料，若此时它已不再请求换料 (打印机自行超时
+ * 或取消) 则跳过。占用者断开后不再有它的上报，阶段超时和轮到后不上报由 start() 创建的
+ * 定时器每 FILAMENT_SCHEDULER_POLL_MS 检查一次 (poll())，不依赖任何打印机的上报。
+ * onStatus() 在各会话的 ingest 任务中调用，poll() 在 esp_timer 任务中调用，内部互斥。
+ */
+class FilamentScheduler {
+public:
+    struct Stats {
+        uint32_t granted;     // 开始的换料次数
+        uint32_t queued;      // 因电机被占用而排队的次数
+        uint32_t skipped;     // 轮到时已不再请求换料或没有上报
+        uint32_t max_wait_ms; // 排队到开始换料的最长等待
+        uint8_t max_depth;    // 最长队列
+    };
+
+    /**
+     * @brief 换料阶段变化时在调度锁内调用
+     * @param session 推进或放弃本次换料的会话
+     */
+    using PhaseCallback = void (*)(void *ctx, size_t session, const FilamentChanger &changer);
+
+    explicit FilamentScheduler(FilamentChanger &changer);
+    ~FilamentScheduler();
+
+    void setPhaseCallback(PhaseCallback cb, void *ctx) {
+        cb_ = cb;
+        ctx_ = ctx;
+    }
+
+    /**
+     * @brief 处理一个会话合并后的上报
+     */
+    void onStatus(size_t session, const BambuStatus &status);
+
+    /**
+     * @brief 会话关闭或切换打印机时调用，放弃它占用的换料并移出队列
+     */
+    void release(size_t session);
+
+    /**
+     * @brief 检查换料阶段超时和轮到的打印机是否超时未上报，定时器和测试调用
+     */
+    void poll();
+
+    /**
+     * @brief 启动定时调用 poll() 的周期定时器，已启动时不做任何事
+     */
+    bool start(uint32_t period_ms = FILAMENT_SCHEDULER_POLL_MS);
+    void stop();
+
+    /**
+     * @return 占用电机的会话，空闲时返回 -1
+     */
+    int owner() const;
+    size_t waiting() const;
+    Stats stats() const;
+
+private:
+    struct Waiter {
+        uint8_t session;
+        int64_t since_us;
+    };
+
+    FilamentChanger &changer_;
+    int owner_ = -1;
+    bool started_ = false; // false 时 owner_ 刚轮到，等待它的下一条上报
+    int64_t granted_us_ = 0;
+    int64_t waited_since_us_ = 0;
+    Waiter queue_[PRINTER_SESSION_MAX];
+    size_t waiting_ = 0;
+    Stats stats_ = {};
+    PhaseCallback cb_ = nullptr;
+    void *ctx_ = nullptr;
+    SemaphoreHandle_t mutex_;
+    esp_timer_handle_t timer_ = nullptr;
+    bool running_ = false;
+
+    void expire(int64_t now_us);
+    void notify(FilamentChangePhase before, int previous, int session);
+    void enqueue(size_t session, int64_t now_us);
+    void remove(size_t session);
+    void grantNext(int64_t now_us);
+    static void timer_callback(void *arg);
+};
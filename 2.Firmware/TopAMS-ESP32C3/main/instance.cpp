@@ -1,15 +1,58 @@
 #include "instance.h"
 #include "esp_mac.h"
+#include "ws_printer.h"
+#include "ws_system.h"
+#include <string.h>
+
+static_assert(WS_PUSH_MAX_SESSIONS == PRINTER_SESSION_MAX, "WSPush must cover every session");
 
 Instance::Instance() {
-    // bambu_mqtt = new BambuMQTT("192.168.1.199", "56154859", "03919D530105226", bambu_status, nullptr);
     // wifi_manager = new WifiManager();
-    bambu_mqtt = std::make_shared<BambuMQTT>("192.168.1.199", "56154859", "03919D530105226",
-                                             bambu_status, nullptr);
-    wifi_manager = std::make_shared<WifiManager>();
-    ws_server = std::make_shared<WSServer>();
     nvs_manager = std::make_shared<NVSManager>();
+    settings = std::make_shared<SettingsStore>();
+    // 连接参数在 init() 加载设置后由 applyPrinter() 填入
+    bambu_mqtt = std::make_shared<BambuMQTT>("", "", "", bambu_status, nullptr);
+    printer_profiles = std::make_shared<PrinterProfiles>();
+    // 只缓存广播供 WebSocket 列出：广播没有认证，连接又不校验证书，按广播改写打印机地址会把
+    // 访问码发给任意主机。保存的打印机换了 IP 时由用户经 use_discovered 确认后更新
+    printer_discovery = std::make_shared<PrinterDiscovery>();
+    wifi_manager = std::make_shared<WifiManager>();
+    persist_service = std::make_shared<PersistService>();
+    // 唯一的耗材表，WebSocket 命令 (httpd 任务) 和换料 (ingest 任务) 共用
     filament_manager = std::make_shared<FilamentManager>();
+    ws_server = std::make_shared<WSServer>(*filament_manager);
+    // 不接电机驱动 (FilamentMotorFn 为空)：换料只跟踪阶段、记录耗时并经 WebSocket 推送，
+    // 电机动作只写日志
+    filament_changer = std::make_shared<FilamentChanger>(*filament_manager, nullptr, nullptr);
+    // 所有打印机共用一组电机，换料由调度器分配给请求托盘的打印机
+    filament_scheduler = std::make_shared<FilamentScheduler>(*filament_changer);
+    filament_scheduler->setPhaseCallback(
+        [](void *ctx, size_t session, const FilamentChanger &changer) {
+            Instance *self = static_cast<Instance *>(ctx);
+            WSPush::MotorState state = {};
+            state.phase = changer.phase();
+            state.from_motor = changer.fromMotor();
+            state.to_motor = changer.toMotor();
+            state.completed = changer.stats().completed;
+            state.aborted = changer.stats().aborted;
+            state.session = static_cast<int8_t>(session);
+            self->ws_server->getPush().publishMotors(state);
+        },
+        this);
+    printer_sessions = std::make_shared<PrinterSessions>(bambu_mqtt);
+    // 在各会话的 ingest 任务中执行：先推进换料状态，再把该会话的变化推送给 WebSocket
+    printer_sessions->setStatusCallback(
+        [](void *ctx, size_t session, const BambuStatus &status) {
+            Instance *self = static_cast<Instance *>(ctx);
+            self->filament_scheduler->onStatus(session, status);
+            self->ws_server->getPush().onStatus(session, status);
+        },
+        this);
+    // WebSocket 命令：订阅和耗材由 WSServer 注册，其余模块在这里注册
+    WSDispatcher &dispatcher = ws_server->getDispatcher();
+    ws_system_register(dispatcher);
+    wifi_manager->registerCommands(dispatcher);
+    ws_printer_register(dispatcher);
     esp_efuse_mac_get_default(mac_address);
 
     // set device name based on MAC address
@@ -21,12 +64,54 @@ Instance::Instance() {
 void Instance::init() {
     // bambu_mqtt->start();
     nvs_manager->init();
+    // 一次遍历读入所有设置项，之后的读取不再访问 NVS
+    settings->load(*nvs_manager);
+    printer_profiles->load(*nvs_manager);
+    applyPrinter();
     wifi_manager->init();
     // ws_server->start();
-    filament_manager->init();
+    filament_manager->init(*nvs_manager, persist_service.get());
+    persist_service->start();
+    // 换料超时不依赖打印机的上报
+    filament_scheduler->start();
+}
+
+bool Instance::applyPrinter() {
+    bool switched = false;
+    bool applied = bambu_mqtt->setPrinter(settings->str(SETTING_PRINTER_HOST),
+                                          settings->str(SETTING_PRINTER_CODE),
+                                          settings->str(SETTING_PRINTER_SERIAL), &switched);
+    if (switched) {
+        releaseSession(0);
+    }
+    // 附加会话中与新的当前打印机相同的关闭，之前因此跳过的打开；
+    // 当前打印机未配置时附加会话同样打开
+    applyFanout();
+    return applied;
+}
+
+size_t Instance::applyFanout() {
+    uint32_t released = 0;
+    size_t opened = printer_sessions->apply(
+        *printer_profiles, (uint32_t)settings->i32(SETTING_PRINTER_FANOUT), &released);
+    for (size_t session = 1; session < PRINTER_SESSION_MAX; session++) {
+        if (released & (1u << session)) {
+            releaseSession(session);
+        }
+    }
+    return opened;
+}
+
+// 会话关闭或换成另一台打印机：放弃它占用的换料，推送的快照也不再沿用之前的状态
+void Instance::releaseSession(size_t session) {
+    filament_scheduler->release(session);
+    ws_server->getPush().removeSession(session);
 }
 
 void Instance::deinit() {
-    bambu_mqtt->stop();
+    printer_discovery->stop();
+    filament_scheduler->stop();
+    printer_sessions->stop();
+    persist_service->stop();
     // wifi_manager->deinit();
 }
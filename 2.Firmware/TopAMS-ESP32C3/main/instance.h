@@ -1,9 +1,16 @@
 #pragma once
 
 #include "bambu_mqtt.h"
+#include "filament_changer.h"
 #include "filament_manager.h"
+#include "filament_scheduler.h"
 #include "mdns_service.h"
 #include "nvs_manager.h"
+#include "persist_service.h"
+#include "printer_discovery.h"
+#include "printer_profiles.h"
+#include "printer_sessions.h"
+#include "settings_store.h"
 #include "wifi_manager.h"
 #include "ws_server.h"
 #include <memory>
@@ -18,12 +25,33 @@ public:
     void init();
     void deinit();
 
+    /**
+     * @brief 按设置项 SETTING_PRINTER_* 切换 MQTT 连接，已连接时断开并重新连接，
+     *        随后按 applyFanout() 调整附加会话
+     * @return false 设置项不完整 (出厂时为空)，会话 0 不连接，附加会话照常调整
+     */
+    bool applyPrinter();
+
+    /**
+     * @brief 按设置项 SETTING_PRINTER_FANOUT 打开或关闭附加的打印机会话
+     * @return 打开的附加会话数
+     */
+    size_t applyFanout();
+
     std::shared_ptr<BambuMQTT> bambu_mqtt;
     std::shared_ptr<WifiManager> wifi_manager;
     std::shared_ptr<WSServer> ws_server;
     std::shared_ptr<NVSManager> nvs_manager;
+    std::shared_ptr<SettingsStore> settings;
+    std::shared_ptr<PersistService> persist_service;
     std::shared_ptr<FilamentManager> filament_manager;
     std::shared_ptr<MDnsService> mdns_service;
+    std::shared_ptr<FilamentChanger> filament_changer;
+    std::shared_ptr<PrinterProfiles> printer_profiles;
+    std::shared_ptr<PrinterDiscovery> printer_discovery;
+    // 会话 0 为 bambu_mqtt，其余为同时连接的保存的打印机
+    std::shared_ptr<PrinterSessions> printer_sessions;
+    std::shared_ptr<FilamentScheduler> filament_scheduler;
 
     BambuStatus bambu_status;
 
@@ -39,4 +67,6 @@ public:
 private:
     // 私有构造函数，在这里初始化服务
     Instance();
+
+    void releaseSession(size_t session);
 };
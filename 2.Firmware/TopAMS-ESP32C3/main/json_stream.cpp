@@ -0,0 +1,341 @@
+#include "json_stream.h"
+
+static constexpr uint32_t fnv_step(uint32_t hash, char c) {
+    return (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+}
+
+static bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+static bool is_literal_char(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           c == '-' || c == '+' || c == '.';
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+JsonStream::JsonStream(Handler handler, void *ctx) : handler_(handler), ctx_(ctx) { reset(); }
+
+void JsonStream::reset() {
+    state_ = State::Value;
+    in_key_ = false;
+    unicode_digits_ = 0;
+    unicode_cp_ = 0;
+    depth_ = 0;
+    value_hash_ = json_path_hash("");
+    key_hash_ = value_hash_;
+    token_len_ = 0;
+    token_[0] = '\0';
+    token_truncated_ = false;
+}
+
+bool JsonStream::feed(const char *data, size_t len) {
+    if (state_ == State::Error) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (!step(data[i])) {
+            state_ = State::Error;
+            return false;
+        }
+    }
+    return true;
+}
+
+int JsonStream::arrayIndex(size_t n) const {
+    for (size_t i = depth_; i > 0; i--) {
+        const Frame &frame = frames_[i - 1];
+        if (!frame.array) {
+            continue;
+        }
+        if (n == 0) {
+            return frame.index;
+        }
+        n--;
+    }
+    return -1;
+}
+
+bool JsonStream::step(char c) {
+    switch (state_) {
+        case State::Value:
+            if (is_space(c)) {
+                return true;
+            }
+            if (depth_ > 0 && frames_[depth_ - 1].array) {
+                if (c == ']' && frames_[depth_ - 1].index < 0) {
+                    return pop(true);
+                }
+                beginElement();
+            }
+            if (c == '{') {
+                emit(JsonEvent::ObjectBegin);
+                if (!push(false)) {
+                    return false;
+                }
+                state_ = State::Key;
+                return true;
+            }
+            if (c == '[') {
+                emit(JsonEvent::ArrayBegin);
+                return push(true);
+            }
+            // 空字符串不会写入 token，需清空上一个值，否则 value.data() 仍指向旧内容
+            token_len_ = 0;
+            token_[0] = '\0';
+            token_truncated_ = false;
+            if (c == '"') {
+                in_key_ = false;
+                state_ = State::String;
+                return true;
+            }
+            if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+                appendToken(c);
+                state_ = State::Literal;
+                return true;
+            }
+            return false;
+
+        case State::Key:
+            if (is_space(c)) {
+                return true;
+            }
+            if (c == '}' && frames_[depth_ - 1].index < 0) {
+                return pop(false);
+            }
+            if (c != '"') {
+                return false;
+            }
+            key_hash_ = frames_[depth_ - 1].hash;
+            if (!frames_[depth_ - 1].root) {
+                key_hash_ = fnv_step(key_hash_, '.');
+            }
+            in_key_ = true;
+            state_ = State::String;
+            return true;
+
+        case State::Colon:
+            if (is_space(c)) {
+                return true;
+            }
+            if (c != ':') {
+                return false;
+            }
+            state_ = State::Value;
+            return true;
+
+        case State::String:
+            if (c == '"') {
+                finishString();
+                return true;
+            }
+            if (c == '\\') {
+                state_ = State::Escape;
+                return true;
+            }
+            if (static_cast<uint8_t>(c) < 0x20) {
+                return false;
+            }
+            if (in_key_) {
+                key_hash_ = fnv_step(key_hash_, c);
+            } else {
+                appendToken(c);
+            }
+            return true;
+
+        case State::Escape: {
+            char decoded;
+            switch (c) {
+                case '"':
+                case '\\':
+                case '/':
+                    decoded = c;
+                    break;
+                case 'b':
+                    decoded = '\b';
+                    break;
+                case 'f':
+                    decoded = '\f';
+                    break;
+                case 'n':
+                    decoded = '\n';
+                    break;
+                case 'r':
+                    decoded = '\r';
+                    break;
+                case 't':
+                    decoded = '\t';
+                    break;
+                case 'u':
+                    unicode_digits_ = 0;
+                    unicode_cp_ = 0;
+                    state_ = State::Unicode;
+                    return true;
+                default:
+                    return false;
+            }
+            if (in_key_) {
+                key_hash_ = fnv_step(key_hash_, decoded);
+            } else {
+                appendToken(decoded);
+            }
+            state_ = State::String;
+            return true;
+        }
+
+        case State::Unicode: {
+            int v = hex_value(c);
+            if (v < 0) {
+                return false;
+            }
+            unicode_cp_ = (unicode_cp_ << 4) | static_cast<uint32_t>(v);
+            if (++unicode_digits_ == 4) {
+                appendCodepoint(unicode_cp_);
+                state_ = State::String;
+            }
+            return true;
+        }
+
+        case State::Literal:
+            if (is_literal_char(c)) {
+                appendToken(c);
+                return true;
+            }
+            if (!finishLiteral()) {
+                return false;
+            }
+            // 分隔符需要在新状态下重新处理
+            return step(c);
+
+        case State::AfterValue:
+            if (is_space(c)) {
+                return true;
+            }
+            if (c == ',') {
+                state_ = frames_[depth_ - 1].array ? State::Value : State::Key;
+                return true;
+            }
+            if (c == '}') {
+                return pop(false);
+            }
+            if (c == ']') {
+                return pop(true);
+            }
+            return false;
+
+        case State::Done:
+            return is_space(c);
+
+        case State::Error:
+            return false;
+    }
+    return false;
+}
+
+bool JsonStream::push(bool array) {
+    if (depth_ >= MAX_DEPTH) {
+        return false;
+    }
+    frames_[depth_] = {value_hash_, -1, array, depth_ == 0};
+    depth_++;
+    state_ = State::Value;
+    return true;
+}
+
+bool JsonStream::pop(bool array) {
+    if (depth_ == 0 || frames_[depth_ - 1].array != array) {
+        return false;
+    }
+    depth_--;
+    value_hash_ = frames_[depth_].hash;
+    emit(array ? JsonEvent::ArrayEnd : JsonEvent::ObjectEnd);
+    endValue();
+    return true;
+}
+
+void JsonStream::beginElement() {
+    Frame &frame = frames_[depth_ - 1];
+    frame.index++;
+    value_hash_ = fnv_step(fnv_step(frame.hash, '['), ']');
+}
+
+void JsonStream::endValue() { state_ = depth_ == 0 ? State::Done : State::AfterValue; }
+
+void JsonStream::emit(JsonEvent event) {
+    if (handler_) {
+        bool scalar = event >= JsonEvent::String;
+        handler_(ctx_, *this, event, std::string_view(token_, scalar ? token_len_ : 0));
+    }
+}
+
+void JsonStream::appendToken(char c) {
+    if (token_len_ < MAX_TOKEN) {
+        token_[token_len_++] = c;
+        token_[token_len_] = '\0';
+    } else {
+        token_truncated_ = true;
+    }
+}
+
+void JsonStream::appendCodepoint(uint32_t cp) {
+    char buf[3];
+    size_t n;
+    if (cp < 0x80) {
+        buf[0] = static_cast<char>(cp);
+        n = 1;
+    } else if (cp < 0x800) {
+        buf[0] = static_cast<char>(0xC0 | (cp >> 6));
+        buf[1] = static_cast<char>(0x80 | (cp & 0x3F));
+        n = 2;
+    } else {
+        // 代理对不做合并，按单个码点编码
+        buf[0] = static_cast<char>(0xE0 | (cp >> 12));
+        buf[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        buf[2] = static_cast<char>(0x80 | (cp & 0x3F));
+        n = 3;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (in_key_) {
+            key_hash_ = fnv_step(key_hash_, buf[i]);
+        } else {
+            appendToken(buf[i]);
+        }
+    }
+}
+
+void JsonStream::finishString() {
+    if (in_key_) {
+        in_key_ = false;
+        frames_[depth_ - 1].index++;
+        value_hash_ = key_hash_;
+        state_ = State::Colon;
+        return;
+    }
+    emit(JsonEvent::String);
+    endValue();
+}
+
+bool JsonStream::finishLiteral() {
+    std::string_view token(token_, token_len_);
+    if (token == "true" || token == "false") {
+        emit(JsonEvent::Bool);
+    } else if (token == "null") {
+        emit(JsonEvent::Null);
+    } else if (token[0] == '-' || (token[0] >= '0' && token[0] <= '9')) {
+        emit(JsonEvent::Number);
+    } else {
+        return false;
+    }
+    endValue();
+    return true;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+
+/**
+ * @brief JSON 事件类型
+ */
+enum class JsonEvent : uint8_t {
+    ObjectBegin,
+    ObjectEnd,
+    ArrayBegin,
+    ArrayEnd,
+    String,
+    Number,
+    Bool,
+    Null,
+};
+
+/**
+ * @brief 计算 JSON 路径哈希 (FNV-1a)
+ *
+ * 路径格式: 对象键以 '.' 分隔，数组元素写作 "[]"，例如 "print.ams.ams[].tray[].tray_color"
+ */
+constexpr uint32_t json_path_hash(std::string_view path, uint32_t hash = 2166136261u) {
+    for (char c : path) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief 无堆分配的流式 JSON 解析器 (SAX 风格)
+ *
+ * 逐字节推进的状态机，不构建 DOM。每遇到一个值就通过回调上报事件和当前路径哈希，
+ * 调用者用编译期计算的路径表匹配需要的字段。键名只参与哈希计算，不做保存；
+ * 标量值写入固定大小的 token 缓冲区，超长部分被截断（truncated() 可查询）。
+ */
+class JsonStream {
+public:
+    static constexpr size_t MAX_DEPTH = 10;
+    static constexpr size_t MAX_TOKEN = 64;
+
+    using Handler = void (*)(void *ctx, const JsonStream &stream, JsonEvent event,
+                             std::string_view value);
+
+    JsonStream(Handler handler, void *ctx);
+
+    /**
+     * @brief 重置解析器，开始新文档
+     */
+    void reset();
+
+    /**
+     * @brief 输入一段数据
+     * @return true 成功, false 语法错误或嵌套过深
+     */
+    bool feed(const char *data, size_t len);
+
+    bool done() const { return state_ == State::Done; }
+    bool failed() const { return state_ == State::Error; }
+
+    /**
+     * @brief 当前值的路径哈希，与 json_path_hash() 的结果可直接比较
+     */
+    uint32_t pathHash() const { return value_hash_; }
+
+    /**
+     * @brief 当前所在容器的嵌套深度（根对象为 1）
+     */
+    size_t depth() const { return depth_; }
+
+    /**
+     * @brief 由内向外第 n 层数组中的当前下标
+     * @return 下标，不存在时返回 -1
+     */
+    int arrayIndex(size_t n = 0) const;
+
+    /**
+     * @brief 刚结束的容器中的元素个数，仅在 ObjectEnd / ArrayEnd 事件中有效
+     */
+    size_t elementCount() const { return frames_[depth_].index + 1; }
+
+    bool truncated() const { return token_truncated_; }
+
+private:
+    enum class State : uint8_t {
+        Value,
+        Key,
+        Colon,
+        AfterValue,
+        String,
+        Escape,
+        Unicode,
+        Literal,
+        Done,
+        Error,
+    };
+
+    struct Frame {
+        uint32_t hash;
+        int16_t index; // 数组为当前下标，对象为已读取的键数 - 1
+        bool array;
+        bool root;
+    };
+
+    bool step(char c);
+    bool push(bool array);
+    bool pop(bool array);
+    void beginElement();
+    void endValue();
+    void emit(JsonEvent event);
+    void appendToken(char c);
+    void appendCodepoint(uint32_t cp);
+    void finishString();
+    bool finishLiteral();
+
+    Handler handler_;
+    void *ctx_;
+
+    State state_;
+    bool in_key_;
+    uint8_t unicode_digits_;
+    uint32_t unicode_cp_;
+
+    Frame frames_[MAX_DEPTH];
+    size_t depth_;
+    uint32_t value_hash_;
+    uint32_t key_hash_;
+
+    char token_[MAX_TOKEN + 1];
+    size_t token_len_;
+    bool token_truncated_;
+};
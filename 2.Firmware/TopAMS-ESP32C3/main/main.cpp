@@ -34,7 +34,8 @@ extern "C" void app_main(void) {
         IP_EVENT, IP_EVENT_STA_GOT_IP,
         [](void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
             ESP_LOGI(TAG, "WiFi connected, IP event received");
-            Instance::get().bambu_mqtt->start(); // 启动 MQTT 客户端
+            Instance::get().printer_sessions->start(); // 连接所有打印机
+            Instance::get().printer_discovery->start();
             Instance::get().ws_server->start();  // 启动 WebSocket 服务器
             Instance::get().mdns_service->init();
             Instance::get().mdns_service->addService();
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * @brief 定长字符串区，集中保存所有耗材的元数据
+ *
+ * 字符串 (含结尾 '\0') 在缓冲区内紧密排列，store() 追加到末尾，release() 删除后把后面的
+ * 字符串整体前移，缓冲区中不会留下空洞，也不使用堆。
+ * 前移会使位于被删除字符串之后的指针失效，调用者需要按 release() 的返回值修正。
+ *
+ * @tparam Capacity 缓冲区字节数
+ */
+template <size_t Capacity> class MetadataArena {
+public:
+    MetadataArena() : used_(0) {}
+
+    /**
+     * @brief 复制一个字符串到末尾
+     * @return 字符串在区内的地址，空间不足时返回 nullptr
+     */
+    const char *store(const char *str, size_t len) {
+        if (len + 1 > Capacity - used_) {
+            return nullptr;
+        }
+        char *dst = buffer_ + used_;
+        memcpy(dst, str, len);
+        dst[len] = '\0';
+        used_ += len + 1;
+        return dst;
+    }
+
+    /**
+     * @brief 删除一个字符串并压缩
+     * @return 释放的字节数，地址大于 str 的字符串都前移了这么多；str 不属于本区时返回 0
+     */
+    size_t release(const char *str) {
+        if (!owns(str)) {
+            return 0;
+        }
+        char *dst = buffer_ + (str - buffer_);
+        size_t size = strlen(dst) + 1;
+        char *next = dst + size;
+        memmove(dst, next, buffer_ + used_ - next);
+        used_ -= size;
+        return size;
+    }
+
+    bool owns(const char *str) const { return str >= buffer_ && str < buffer_ + used_; }
+
+    void clear() { used_ = 0; }
+
+    const char *data() const { return buffer_; }
+
+    size_t used() const { return used_; }
+    size_t capacity() const { return Capacity; }
+
+private:
+    char buffer_[Capacity];
+    size_t used_;
+};
@@ -1,5 +1,144 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#define BAMBU_MAX_AMS 4
+#define BAMBU_TRAYS_PER_AMS 4
+#define BAMBU_MAX_HMS 8
+
+#define BAMBU_TRAY_NONE 255 // tray_now / tray_tar 未装载耗材
+
+/**
+ * @brief BambuStatus 字段脏位，每次合并上报时只置位实际发生变化的字段
+ */
+enum BambuStatusField : uint32_t {
+    BAMBU_FIELD_NOZZLE_TEMPER = 1u << 0,
+    BAMBU_FIELD_NOZZLE_TARGET = 1u << 1,
+    BAMBU_FIELD_BED_TEMPER = 1u << 2,
+    BAMBU_FIELD_BED_TARGET = 1u << 3,
+    BAMBU_FIELD_WIFI_SIGNAL = 1u << 4,
+    BAMBU_FIELD_GCODE_STATE = 1u << 5,
+    BAMBU_FIELD_PRINT_STAGE = 1u << 6,
+    BAMBU_FIELD_STG_CUR = 1u << 7,
+    BAMBU_FIELD_PERCENT = 1u << 8,
+    BAMBU_FIELD_REMAINING_TIME = 1u << 9,
+    BAMBU_FIELD_LAYER = 1u << 10,
+    BAMBU_FIELD_PRINT_ERROR = 1u << 11,
+    BAMBU_FIELD_FANS = 1u << 12,
+    BAMBU_FIELD_AMS_STATUS = 1u << 13,
+    BAMBU_FIELD_TRAY_NOW = 1u << 14,
+    BAMBU_FIELD_TRAY_TAR = 1u << 15,
+    BAMBU_FIELD_TRAY_PRE = 1u << 16,
+    BAMBU_FIELD_AMS_UNIT = 1u << 17,
+    BAMBU_FIELD_AMS_TRAY = 1u << 18, // 具体托盘见 BambuStatus::tray_dirty
+    BAMBU_FIELD_HMS = 1u << 19,
+};
+
+/**
+ * @brief AMS 托盘信息
+ */
+struct BambuTray {
+    char type[16];  // 耗材类型，如 "PLA"
+    char color[12]; // RRGGBBAA
+    int16_t nozzle_temp_min;
+    int16_t nozzle_temp_max;
+    int8_t remain; // 剩余百分比，未知为 -1
+};
+
+/**
+ * @brief AMS 单元信息
+ */
+struct BambuAms {
+    float temp;
+    int8_t humidity;
+    BambuTray trays[BAMBU_TRAYS_PER_AMS];
+};
+
+/**
+ * @brief HMS 健康告警
+ */
+struct BambuHms {
+    uint32_t attr;
+    uint32_t code;
+};
+
+/**
+ * @brief 打印机状态，由 push_status 上报增量合并而来
+ *
+ * 打印机在首次 pushall 之后只发送变化的字段，ReportParser 只合并消息中出现的字段。
+ * dirty / tray_dirty 记录最近一次合并的上报中实际变化的字段，消费者据此只处理变化部分。
+ * 常用的温度、阶段字段放在前面，AMS 与 HMS 数组放在最后。
+ */
 struct BambuStatus {
-    char wifi_signal[16];
-    float nozzle_temper;
-    float bed_temper;
+    float nozzle_temper = 0;
+    float nozzle_target_temper = 0;
+    float bed_temper = 0;
+    float bed_target_temper = 0;
+
+    int16_t mc_print_stage = 0;
+    int16_t stg_cur = -1;
+    int8_t mc_percent = 0;
+    int32_t mc_remaining_time = 0; // 分钟
+    int32_t layer_num = 0;
+    int32_t total_layer_num = 0;
+    uint32_t print_error = 0;
+
+    uint8_t cooling_fan_speed = 0;
+    uint8_t big_fan1_speed = 0;
+    uint8_t big_fan2_speed = 0;
+    uint8_t heatbreak_fan_speed = 0;
+
+    int32_t ams_status = 0;
+    uint8_t tray_now = BAMBU_TRAY_NONE;
+    uint8_t tray_tar = BAMBU_TRAY_NONE;
+    uint8_t tray_pre = BAMBU_TRAY_NONE;
+    uint8_t ams_count = 0;
+    uint8_t hms_count = 0;
+
+    char gcode_state[16] = {};
+    char wifi_signal[16] = {};
+
+    uint32_t dirty = 0;      // BambuStatusField 位掩码
+    uint16_t tray_dirty = 0; // 位序号 = ams_id * BAMBU_TRAYS_PER_AMS + tray_id
+
+    BambuAms ams[BAMBU_MAX_AMS] = {};
+    BambuHms hms[BAMBU_MAX_HMS] = {};
+
+    /**
+     * @brief 合并一个字段，值变化时置位对应脏位
+     */
+    template <typename T> void merge(T &field, T value, uint32_t bit) {
+        if (field != value) {
+            field = value;
+            dirty |= bit;
+        }
+    }
+
+    void merge(char *field, size_t size, const char *value, size_t len, uint32_t bit) {
+        if (len >= size) {
+            len = size - 1;
+        }
+        if (strncmp(field, value, len) != 0 || field[len] != '\0') {
+            memcpy(field, value, len);
+            field[len] = '\0';
+            dirty |= bit;
+        }
+    }
+
+    void markTray(int ams_id, int tray_id) {
+        tray_dirty |= 1u << (ams_id * BAMBU_TRAYS_PER_AMS + tray_id);
+        dirty |= BAMBU_FIELD_AMS_TRAY;
+    }
+
+    bool changed(uint32_t fields) const { return (dirty & fields) != 0; }
+
+    bool trayChanged(int ams_id, int tray_id) const {
+        return (tray_dirty & (1u << (ams_id * BAMBU_TRAYS_PER_AMS + tray_id))) != 0;
+    }
+
+    void clearDirty() {
+        dirty = 0;
+        tray_dirty = 0;
+    }
 };
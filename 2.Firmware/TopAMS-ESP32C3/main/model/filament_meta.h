@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+#define FILAMENT_META_MAX_KEYS 8  // 保存的顶层键值对数量上限
+#define FILAMENT_META_TYPE_LEN 16 // 材料类型长度 (含结尾 '\0')
+
+// 已解析的常用字段
+enum FilamentMetaField : uint8_t {
+    FILAMENT_META_HAS_TYPE = 1u << 0,            // "type"，如 "PETG"
+    FILAMENT_META_HAS_COLOR = 1u << 1,           // "color"，RRGGBB 或 RRGGBBAA，可带 '#'
+    FILAMENT_META_HAS_NOZZLE_TEMP_MIN = 1u << 2, // "nozzle_temp_min"
+    FILAMENT_META_HAS_NOZZLE_TEMP_MAX = 1u << 3, // "nozzle_temp_max"
+};
+
+/**
+ * @brief 预解析的耗材元数据
+ *
+ * 元数据写入时解析一次，之后的查询只比较整数，不再解析 JSON、不分配内存。
+ * 顶层的标量键值以 FNV-1a 哈希保存 (键与 json_path_hash() 一致，值为原始文本，数字不做
+ * 格式化)，嵌套的对象和数组被忽略。类型、颜色和温度另外保存为类型化的字段。
+ */
+struct FilamentMeta {
+    struct Entry {
+        uint32_t key;
+        uint32_t value;
+    };
+
+    Entry entries[FILAMENT_META_MAX_KEYS];
+    uint8_t entry_count;
+    uint8_t fields;                    // FilamentMetaField 位掩码
+    int16_t nozzle_temp_min;
+    int16_t nozzle_temp_max;
+    uint32_t color;                    // RRGGBBAA
+    char type[FILAMENT_META_TYPE_LEN]; // 大写
+
+    /**
+     * @brief 解析元数据 JSON
+     * @return false 不是合法的 JSON 对象，此时只保留解析成功的部分
+     */
+    bool parse(const char *metadata);
+
+    /**
+     * @brief 查询顶层键的值是否等于 value
+     */
+    bool matches(uint32_t key_hash, uint32_t value_hash) const;
+
+    /**
+     * @brief 解析颜色 "RRGGBB" / "RRGGBBAA" / "#RRGGBB"，没有透明度时补 FF
+     */
+    static bool parseColor(const char *text, uint32_t &color);
+
+    /**
+     * @brief 材料索引的键，类型不区分大小写
+     */
+    static uint32_t materialHash(const char *type, uint32_t color);
+};
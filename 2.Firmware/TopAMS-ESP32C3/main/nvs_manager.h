@@ -2,6 +2,7 @@
 #pragma once
 
 #include "esp_log.h"
+#include "esp_rom_crc.h"
 #include <cstring>
 #include <iostream>
 #include <nvs.h>
@@ -13,12 +14,36 @@
 
 #define NVS_TAG "[NVSManager]"
 
+#define NVS_RECORD_MAGIC 0x4E524543 // "NREC"
+#define NVS_RECORD_MAX 256          // 记录数据的最大长度 (不含头部)
+#define NVS_RECORD_NAME_MAX 13      // 记录名的最大长度，槽位的键为 <名称>.0 / <名称>.1
+
 class NVSManager {
 private:
     nvs_handle_t nvs_handle;
     const char *namespace_name;
     bool is_initialized;
 
+    struct RecordHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t length; // 数据长度
+        uint32_t generation;
+        uint32_t crc; // 覆盖之前的字段和数据
+    };
+
+    static void recordKey(const char *name, int8_t slot, char (&key)[NVS_KEY_NAME_MAX_SIZE]) {
+        // 槽位只有 0 / 1，写成一个字符，"<名称>.<槽位>" 最长 NVS_RECORD_NAME_MAX + 2
+        static_assert(NVS_RECORD_NAME_MAX + 3 <= NVS_KEY_NAME_MAX_SIZE, "record key too long");
+        snprintf(key, sizeof(key), "%.*s.%c", NVS_RECORD_NAME_MAX, name, '0' + (slot & 1));
+    }
+
+    static uint32_t recordCrc(const RecordHeader &header, const void *data) {
+        uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(&header),
+                                        offsetof(RecordHeader, crc));
+        return esp_rom_crc32_le(crc, static_cast<const uint8_t *>(data), header.length);
+    }
+
 public:
     NVSManager() : nvs_handle(0), namespace_name(DEFAULT_NAMESPACE), is_initialized(false) {}
 
@@ -165,10 +190,11 @@ public:
             size_t required_size = 0;
             err = nvs_get_str(nvs_handle, key, nullptr, &required_size);
             if (err == ESP_OK && required_size > 0) {
+                // 调用者需要 delete[]；长度已知的值用 getStr()，设置项用 SettingsStore
                 char *buffer = new char[required_size];
                 err = nvs_get_str(nvs_handle, key, buffer, &required_size);
                 if (err == ESP_OK) {
-                    value = buffer; // 注意：调用者需要负责释放内存
+                    value = buffer;
                 } else {
                     delete[] buffer;
                 }
@@ -207,6 +233,183 @@ public:
         return ESP_OK;
     }
 
+    /**
+     * @brief 读取字符串到调用者的缓冲区，只调用一次 nvs_get_str()，不分配内存
+     * @param size 缓冲区大小 (含结尾 '\0')
+     * @return ESP_ERR_NVS_INVALID_LENGTH 缓冲区不足
+     */
+    esp_err_t getStr(const char *key, char *out, size_t size) {
+        if (!is_initialized) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        return nvs_get_str(nvs_handle, key, out, &size);
+    }
+
+    /**
+     * @brief 读取变长 blob
+     * @param length 输入缓冲区大小，输出实际长度
+     */
+    esp_err_t getBlob(const char *key, void *out, size_t &length) {
+        if (!is_initialized) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        return nvs_get_blob(nvs_handle, key, out, &length);
+    }
+
+    /**
+     * @brief 用已打开的句柄遍历命名空间中的所有键，只读取键名和类型
+     * @param fn 形如 void(const char *key, nvs_type_t type) 的可调用对象
+     */
+    template <typename Fn> esp_err_t forEachKey(Fn fn) {
+        if (!is_initialized) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        nvs_iterator_t it = nullptr;
+        esp_err_t err = nvs_entry_find_in_handle(nvs_handle, NVS_TYPE_ANY, &it);
+        while (err == ESP_OK) {
+            nvs_entry_info_t info;
+            nvs_entry_info(it, &info);
+            fn(static_cast<const char *>(info.key), info.type);
+            err = nvs_entry_next(&it);
+        }
+        nvs_release_iterator(it);
+        return err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : err;
+    }
+
+    /**
+     * @brief 记录的当前槽位和代数，由 readRecord() 填写，writeRecord() 更新
+     */
+    struct RecordState {
+        uint32_t generation = 0;
+        int8_t slot = -1; // -1 表示两个槽位都没有完整的记录
+    };
+
+    /**
+     * @brief 读取带版本的记录
+     *
+     * 一条记录由多个值打包而成，保存在两个槽位中：每次写入另一个槽位并递增代数，读取时取
+     * 校验通过、代数最大的一个。写入中途断电时另一个槽位不受影响，读到的是上一次完整的记录，
+     * 不会出现一部分值已更新的情况。
+     * @param length 输入缓冲区大小，输出数据长度
+     * @param state 输出当前的槽位和代数，之后的 writeRecord() 须使用
+     * @return ESP_ERR_NVS_NOT_FOUND 两个槽位都不存在，ESP_ERR_INVALID_CRC 都不完整，
+     *         ESP_ERR_INVALID_VERSION 最新的记录版本不同 (state 仍指向该记录)，
+     *         ESP_ERR_NVS_INVALID_LENGTH 缓冲区不足；其他错误时 state 无效
+     */
+    esp_err_t readRecord(const char *name, uint16_t version, void *data, size_t &length,
+                         RecordState &state) {
+        if (!is_initialized) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        uint8_t buffer[sizeof(RecordHeader) + NVS_RECORD_MAX];
+        RecordHeader newest = {};
+        size_t capacity = length;
+        bool found = false;
+        state = RecordState();
+        esp_err_t result = ESP_ERR_NVS_NOT_FOUND;
+        for (int8_t slot = 0; slot < 2; slot++) {
+            char key[NVS_KEY_NAME_MAX_SIZE];
+            recordKey(name, slot, key);
+            size_t size = sizeof(buffer);
+            esp_err_t err = nvs_get_blob(nvs_handle, key, buffer, &size);
+            if (err == ESP_ERR_NVS_NOT_FOUND) {
+                continue;
+            }
+            if (err != ESP_OK && err != ESP_ERR_NVS_INVALID_LENGTH) {
+                state = RecordState();
+                return err; // 读取出错时无法确定哪个槽位较新
+            }
+            RecordHeader header;
+            if (err != ESP_OK || size < sizeof(header)) {
+                result = found ? result : ESP_ERR_INVALID_CRC;
+                continue;
+            }
+            memcpy(&header, buffer, sizeof(header));
+            if (header.magic != NVS_RECORD_MAGIC || header.length != size - sizeof(header) ||
+                header.crc != recordCrc(header, buffer + sizeof(header))) {
+                ESP_LOGW(NVS_TAG, "Record slot '%s' is incomplete, ignored", key);
+                result = found ? result : ESP_ERR_INVALID_CRC;
+                continue;
+            }
+            // 代数按差值比较，回绕后仍然有序
+            if (found && (int32_t)(header.generation - newest.generation) <= 0) {
+                continue;
+            }
+            found = true;
+            newest = header;
+            state.generation = header.generation;
+            state.slot = slot;
+            if (header.version != version) {
+                result = ESP_ERR_INVALID_VERSION;
+            } else if (header.length > capacity) {
+                result = ESP_ERR_NVS_INVALID_LENGTH;
+            } else {
+                memcpy(data, buffer + sizeof(header), header.length);
+                length = header.length;
+                result = ESP_OK;
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief 写入记录到 state 之外的槽位并提交，成功后更新 state
+     * @param state 须来自同一记录的 readRecord()，否则可能覆盖较新的记录
+     */
+    esp_err_t writeRecord(const char *name, uint16_t version, const void *data, size_t length,
+                          RecordState &state) {
+        if (!is_initialized) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        if (length > NVS_RECORD_MAX) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        uint8_t buffer[sizeof(RecordHeader) + NVS_RECORD_MAX];
+        RecordHeader header = {NVS_RECORD_MAGIC, version, (uint16_t)length, state.generation + 1,
+                               0};
+        header.crc = recordCrc(header, data);
+        memcpy(buffer, &header, sizeof(header));
+        memcpy(buffer + sizeof(header), data, length);
+
+        int8_t slot = state.slot == 0 ? 1 : 0;
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        recordKey(name, slot, key);
+        esp_err_t err = nvs_set_blob(nvs_handle, key, buffer, sizeof(header) + length);
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs_handle);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(NVS_TAG, "Record write failed for '%s': %s", key, esp_err_to_name(err));
+            return err;
+        }
+        state.generation = header.generation;
+        state.slot = slot;
+        return ESP_OK;
+    }
+
+    /**
+     * @brief 删除记录的两个槽位并提交
+     *
+     * 先删除较旧的槽位，中途断电时读到的仍是删除前的记录。成功后 state 复位。
+     */
+    esp_err_t eraseRecord(const char *name, RecordState &state) {
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        int8_t current = state.slot < 0 ? 0 : state.slot;
+        recordKey(name, current == 0 ? 1 : 0, key);
+        esp_err_t err = erase(key, false);
+        if (err == ESP_OK) {
+            recordKey(name, current, key);
+            err = erase(key, false);
+        }
+        if (err == ESP_OK) {
+            err = commit();
+        }
+        if (err == ESP_OK) {
+            state = RecordState();
+        }
+        return err;
+    }
+
     /**
      * @brief 提交更改到 NVS
      * @return esp_err_t 错误码
@@ -226,11 +429,12 @@ public:
     }
 
     /**
-     * @brief 删除指定键
+     * @brief 删除指定键，键不存在时视为成功
      * @param key 键名
+     * @param do_commit 是否立即提交，批量修改时可由调用者最后统一 commit()
      * @return true 成功, false 失败
      */
-    esp_err_t erase(const char *key) {
+    esp_err_t erase(const char *key, bool do_commit = true) {
         if (!is_initialized) {
             ESP_LOGE(NVS_TAG, "NVS not initialized");
             return ESP_ERR_INVALID_STATE;
@@ -241,6 +445,9 @@ public:
             ESP_LOGE(NVS_TAG, "NVS erase failed for key '%s': %s", key, esp_err_to_name(err));
             return err;
         }
+        if (!do_commit) {
+            return ESP_OK;
+        }
 
         err = nvs_commit(nvs_handle);
         if (err != ESP_OK) {
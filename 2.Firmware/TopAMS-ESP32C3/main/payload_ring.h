@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief 单生产者 / 单消费者无锁环形缓冲区，按记录保存原始负载分片
+ *
+ * 每条记录 = 头部 + 数据，按 4 字节对齐并且在缓冲区内连续存放，消费者可以直接
+ * 读取数据指针而无需拷贝。尾部空间不足时写入填充标记并回绕到开头。
+ * head_ / tail_ 为单调递增的 32 位计数，Capacity 必须是 2 的幂。
+ *
+ * @tparam Capacity 缓冲区字节数
+ */
+template <size_t Capacity> class PayloadRing {
+    static_assert(Capacity >= 64 && (Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of two");
+
+public:
+    struct Slice {
+        const char *data;
+        size_t len;
+        uint32_t offset; // 分片在消息中的偏移
+        uint32_t total;  // 消息总长度
+    };
+
+    struct Stats {
+        uint32_t pushed;
+        uint32_t dropped;
+        uint32_t high_water; // 最大占用字节数
+        uint32_t capacity;
+    };
+
+    PayloadRing() : head_(0), tail_(0), pushed_(0), dropped_(0), high_water_(0) {}
+
+    /**
+     * @brief 写入一个分片（仅生产者调用）
+     * @return true 成功, false 空间不足，分片被丢弃
+     */
+    bool push(const char *data, size_t len, uint32_t offset, uint32_t total) {
+        size_t record = align(sizeof(Header) + len);
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t tail = tail_.load(std::memory_order_acquire);
+        size_t pos = head & (Capacity - 1);
+        size_t pad = Capacity - pos < record ? Capacity - pos : 0;
+
+        if (len >= PAD || record + pad > Capacity - (head - tail)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (pad > 0) {
+            if (pad >= sizeof(Header)) {
+                header(pos)->len = PAD;
+            }
+            head += pad;
+            pos = 0;
+        }
+
+        Header *hdr = header(pos);
+        hdr->len = static_cast<uint16_t>(len);
+        hdr->offset = offset;
+        hdr->total = total;
+        memcpy(buffer_ + pos + sizeof(Header), data, len);
+        head += record;
+        head_.store(head, std::memory_order_release);
+
+        pushed_.fetch_add(1, std::memory_order_relaxed);
+        uint32_t used = head - tail;
+        if (used > high_water_.load(std::memory_order_relaxed)) {
+            high_water_.store(used, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    /**
+     * @brief 读取最早的分片但不移除（仅消费者调用）
+     * @return true 有数据, false 缓冲区为空
+     */
+    bool peek(Slice &slice) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        uint32_t head = head_.load(std::memory_order_acquire);
+        if (tail == head) {
+            return false;
+        }
+        size_t pos = tail & (Capacity - 1);
+        if (Capacity - pos < sizeof(Header) || header(pos)->len == PAD) {
+            // 跳过尾部填充
+            tail += Capacity - pos;
+            tail_.store(tail, std::memory_order_release);
+            if (tail == head) {
+                return false;
+            }
+            pos = 0;
+        }
+        const Header *hdr = header(pos);
+        slice.data = reinterpret_cast<const char *>(buffer_ + pos + sizeof(Header));
+        slice.len = hdr->len;
+        slice.offset = hdr->offset;
+        slice.total = hdr->total;
+        return true;
+    }
+
+    /**
+     * @brief 移除 peek() 返回的分片（仅消费者调用）
+     */
+    void pop() {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        const Header *hdr = header(tail & (Capacity - 1));
+        tail_.store(tail + align(sizeof(Header) + hdr->len), std::memory_order_release);
+    }
+
+    Stats stats() const {
+        return {pushed_.load(std::memory_order_relaxed), dropped_.load(std::memory_order_relaxed),
+                high_water_.load(std::memory_order_relaxed), static_cast<uint32_t>(Capacity)};
+    }
+
+private:
+    struct Header {
+        uint16_t len;
+        uint16_t reserved;
+        uint32_t offset;
+        uint32_t total;
+    };
+
+    static constexpr uint16_t PAD = 0xFFFF;
+
+    static constexpr size_t align(size_t n) { return (n + 3) & ~static_cast<size_t>(3); }
+
+    Header *header(size_t pos) { return reinterpret_cast<Header *>(buffer_ + pos); }
+
+    alignas(4) uint8_t buffer_[Capacity];
+    std::atomic<uint32_t> head_;
+    std::atomic<uint32_t> tail_;
+
+    std::atomic<uint32_t> pushed_;
+    std::atomic<uint32_t> dropped_;
+    std::atomic<uint32_t> high_water_;
+};
@@ -0,0 +1,194 @@
+#include "persist_service.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include <inttypes.h>
+
+static const char *TAG = "[PersistService]";
+
+// esp_register_shutdown_handler 不带上下文参数，只有一个实例可以注册
+static PersistService *shutdown_service = nullptr;
+
+PersistService::PersistService()
+    : clients_{}, client_count_(0), dirty_(0), first_dirty_us_(0), last_dirty_us_(0),
+      debounce_ms_(PERSIST_DEBOUNCE_MS), max_delay_ms_(PERSIST_MAX_DELAY_MS), stats_{},
+      lock_(xSemaphoreCreateMutex()), flush_lock_(xSemaphoreCreateMutex()), task_(nullptr),
+      running_(false) {}
+
+PersistService::~PersistService() {
+    stop();
+    vSemaphoreDelete(lock_);
+    vSemaphoreDelete(flush_lock_);
+}
+
+int PersistService::registerClient(const char *name, FlushFn fn, void *ctx) {
+    if (client_count_ >= PERSIST_MAX_CLIENTS) {
+        ESP_LOGE(TAG, "Too many clients, %s not registered", name);
+        return -1;
+    }
+    clients_[client_count_] = {name, fn, ctx};
+    return client_count_++;
+}
+
+void PersistService::markDirty(int client) {
+    if (client < 0 || client >= (int)client_count_) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    if (dirty_ == 0) {
+        first_dirty_us_ = now;
+    }
+    dirty_ |= 1u << client;
+    last_dirty_us_ = now;
+    stats_.requests++;
+    xSemaphoreGive(lock_);
+    if (task_) {
+        // 唤醒任务重新计算写回时间
+        xTaskNotifyGive(task_);
+    }
+}
+
+void PersistService::setWindow(uint32_t debounce_ms, uint32_t max_delay_ms) {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    debounce_ms_ = debounce_ms;
+    max_delay_ms_ = max_delay_ms < debounce_ms ? debounce_ms : max_delay_ms;
+    xSemaphoreGive(lock_);
+    if (task_) {
+        xTaskNotifyGive(task_);
+    }
+}
+
+void PersistService::start() {
+    if (task_) {
+        return;
+    }
+    running_ = true;
+    if (xTaskCreate(persist_task, "persist", PERSIST_TASK_STACK_SIZE, this, PERSIST_TASK_PRIORITY,
+                    &task_) != pdPASS) {
+        // 没有任务时修改只在 flush() 时写回
+        ESP_LOGE(TAG, "Failed to create persist task");
+        running_ = false;
+        task_ = nullptr;
+    }
+    if (shutdown_service == nullptr) {
+        shutdown_service = this;
+        esp_err_t err = esp_register_shutdown_handler(shutdown_handler);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to register shutdown handler: %s", esp_err_to_name(err));
+        }
+    }
+}
+
+void PersistService::stop() {
+    if (task_) {
+        running_ = false;
+        xTaskNotifyGive(task_);
+        while (task_) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+    }
+    flush();
+    if (shutdown_service == this) {
+        esp_unregister_shutdown_handler(shutdown_handler);
+        shutdown_service = nullptr;
+    }
+}
+
+bool PersistService::flush() {
+    xSemaphoreTake(flush_lock_, portMAX_DELAY);
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    uint32_t pending = dirty_;
+    dirty_ = 0;
+    xSemaphoreGive(lock_);
+
+    uint32_t failed = 0;
+    uint32_t commits = 0;
+    size_t bytes = 0;
+    for (size_t i = 0; i < client_count_; i++) {
+        if (!(pending & (1u << i))) {
+            continue;
+        }
+        if (clients_[i].fn(clients_[i].ctx, &bytes)) {
+            commits++;
+        } else {
+            ESP_LOGE(TAG, "Failed to flush %s, will retry", clients_[i].name);
+            failed |= 1u << i;
+        }
+    }
+
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    stats_.commits += commits;
+    stats_.failures += __builtin_popcount(failed);
+    stats_.bytes_written += bytes;
+    stats_.commits_avoided = stats_.requests - stats_.commits;
+    if (failed) {
+        // 失败的客户端在下一个静默窗口后重试
+        int64_t now = esp_timer_get_time();
+        if (dirty_ == 0) {
+            first_dirty_us_ = now;
+        }
+        dirty_ |= failed;
+        last_dirty_us_ = now;
+    }
+    xSemaphoreGive(lock_);
+    xSemaphoreGive(flush_lock_);
+
+    if (pending) {
+        ESP_LOGI(TAG, "Flushed %" PRIu32 " clients, %u bytes", commits, (unsigned)bytes);
+    }
+    return failed == 0;
+}
+
+bool PersistService::pending() const {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    bool pending = dirty_ != 0;
+    xSemaphoreGive(lock_);
+    return pending;
+}
+
+PersistService::Stats PersistService::stats() const {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    Stats stats = stats_;
+    xSemaphoreGive(lock_);
+    return stats;
+}
+
+// 最后一次修改静默 debounce_ms 后或首次修改 max_delay_ms 后，取较早者；没有修改时返回 -1
+int64_t PersistService::dueTime() const {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    int64_t due = -1;
+    if (dirty_ != 0) {
+        int64_t quiet = last_dirty_us_ + debounce_ms_ * 1000LL;
+        int64_t deadline = first_dirty_us_ + max_delay_ms_ * 1000LL;
+        due = quiet < deadline ? quiet : deadline;
+    }
+    xSemaphoreGive(lock_);
+    return due;
+}
+
+void PersistService::persist_task(void *arg) {
+    PersistService *self = static_cast<PersistService *>(arg);
+    while (self->running_) {
+        TickType_t wait = portMAX_DELAY;
+        int64_t due = self->dueTime();
+        if (due >= 0) {
+            int64_t now = esp_timer_get_time();
+            if (due <= now) {
+                self->flush();
+                continue;
+            }
+            wait = pdMS_TO_TICKS((due - now + 999) / 1000);
+        }
+        ulTaskNotifyTake(pdTRUE, wait ? wait : 1);
+    }
+    self->task_ = nullptr;
+    vTaskDelete(nullptr);
+}
+
+// 即使没有待写的修改也调用 flush()，以等待持久化任务中正在进行的写回完成
+void PersistService::shutdown_handler() {
+    if (shutdown_service) {
+        shutdown_service->flush();
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define PERSIST_MAX_CLIENTS 4
+#define PERSIST_DEBOUNCE_MS 500   // 最后一次修改后静默多久写入
+#define PERSIST_MAX_DELAY_MS 5000 // 首次修改后最迟多久写入，持续修改时也不会无限推迟
+#define PERSIST_TASK_STACK_SIZE 4096
+#define PERSIST_TASK_PRIORITY 1
+
+/**
+ * @brief 延迟合并的持久化服务
+ *
+ * 各模块修改内存中的状态后调用 markDirty()，由低优先级任务在修改静默 debounce_ms 后
+ * (最迟首次修改后 max_delay_ms) 统一调用模块的写回回调，一次批量修改只提交一次 NVS。
+ * start() 时注册关机回调，esp_restart() (包括 OTA 完成后的重启) 前写回所有未保存的修改；
+ * 主动重启前也可以直接调用 flush()。
+ */
+class PersistService {
+public:
+    /**
+     * @brief 写回回调，在持久化任务或 flush() 的调用者中执行
+     * @param bytes 累加本次写入 NVS 的字节数
+     * @return false 写入失败，稍后重试
+     */
+    using FlushFn = bool (*)(void *ctx, size_t *bytes);
+
+    struct Stats {
+        uint32_t requests;        // markDirty() 次数，即不合并时的提交次数
+        uint32_t commits;         // 实际的写回次数
+        uint32_t commits_avoided; // requests - commits
+        uint32_t failures;        // 写回失败次数
+        uint64_t bytes_written;
+    };
+
+    PersistService();
+    ~PersistService();
+
+    /**
+     * @brief 注册写回回调，需在 start() 前调用
+     * @return 客户端编号，传给 markDirty()；已满时返回 -1
+     */
+    int registerClient(const char *name, FlushFn fn, void *ctx);
+
+    /**
+     * @brief 标记客户端有未保存的修改，可在任意任务中调用
+     */
+    void markDirty(int client);
+
+    void setWindow(uint32_t debounce_ms, uint32_t max_delay_ms);
+
+    void start();
+    void stop();
+
+    /**
+     * @brief 立即写回所有未保存的修改，返回前写入已完成
+     * @return false 有客户端写回失败
+     */
+    bool flush();
+
+    bool pending() const;
+    Stats stats() const;
+
+private:
+    struct Client {
+        const char *name;
+        FlushFn fn;
+        void *ctx;
+    };
+
+    static void persist_task(void *arg);
+    static void shutdown_handler();
+    int64_t dueTime() const;
+
+    Client clients_[PERSIST_MAX_CLIENTS];
+    size_t client_count_;
+    uint32_t dirty_;         // 按客户端编号的位掩码
+    int64_t first_dirty_us_; // 本轮首次修改时间
+    int64_t last_dirty_us_;  // 最后一次修改时间
+    uint32_t debounce_ms_;
+    uint32_t max_delay_ms_;
+    Stats stats_;
+    SemaphoreHandle_t lock_;       // 保护上面的状态
+    SemaphoreHandle_t flush_lock_; // 串行化写回，关机时等待正在进行的写回完成
+    TaskHandle_t task_;
+    volatile bool running_;
+};
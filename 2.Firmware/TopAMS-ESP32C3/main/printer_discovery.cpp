@@ -0,0 +1,219 @@
+#include "printer_discovery.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <string_view>
+
+static const char *TAG = "[PrinterDiscovery]";
+
+#define SSDP_MULTICAST_ADDR "239.255.255.250"
+
+// 去掉首尾空白后复制，超长时截断
+static void copy_value(char *dst, size_t size, std::string_view value) {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+        value.remove_prefix(1);
+    }
+    while (!value.empty() && strchr(" \t\r", value.back())) {
+        value.remove_suffix(1);
+    }
+    size_t len = value.size() < size ? value.size() : size - 1;
+    memcpy(dst, value.data(), len);
+    dst[len] = '\0';
+}
+
+static bool header_is(std::string_view name, const char *expected) {
+    return name.size() == strlen(expected) && strncasecmp(name.data(), expected, name.size()) == 0;
+}
+
+bool PrinterDiscovery::parse(const char *data, size_t len, Printer &out) {
+    out = Printer();
+    std::string_view packet(data, len);
+    size_t eol = packet.find('\n');
+    std::string_view start = packet.substr(0, eol);
+    if (start.substr(0, 6) != "NOTIFY" && start.substr(0, 8) != "HTTP/1.1") {
+        return false;
+    }
+    bool bambu = false;
+    char urn[48] = {};
+    char connect[8] = {};
+    while (eol != std::string_view::npos) {
+        packet.remove_prefix(eol + 1);
+        eol = packet.find('\n');
+        std::string_view line = packet.substr(0, eol);
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            continue;
+        }
+        std::string_view name = line.substr(0, colon);
+        std::string_view value = line.substr(colon + 1);
+        if (header_is(name, "NT") || header_is(name, "ST")) {
+            copy_value(urn, sizeof(urn), value);
+            bambu = strcmp(urn, PRINTER_DISCOVERY_URN) == 0;
+        } else if (header_is(name, "Location")) {
+            copy_value(out.host, sizeof(out.host), value);
+        } else if (header_is(name, "USN")) {
+            copy_value(out.serial, sizeof(out.serial), value);
+        } else if (header_is(name, "DevModel.bambu.com")) {
+            copy_value(out.model, sizeof(out.model), value);
+        } else if (header_is(name, "DevName.bambu.com")) {
+            copy_value(out.name, sizeof(out.name), value);
+        } else if (header_is(name, "DevConnect.bambu.com")) {
+            copy_value(connect, sizeof(connect), value);
+        }
+    }
+    out.lan_only = strcasecmp(connect, "lan") == 0;
+    return bambu && out.serial[0] != '\0';
+}
+
+PrinterDiscovery::PrinterDiscovery(uint16_t port)
+    : port_(port), printers_{}, mutex_(xSemaphoreCreateMutex()) {}
+
+PrinterDiscovery::~PrinterDiscovery() {
+    stop();
+    vSemaphoreDelete(mutex_);
+}
+
+bool PrinterDiscovery::handlePacket(const char *data, size_t len, const char *from,
+                                    int64_t now_ms) {
+    Printer printer;
+    if (!parse(data, len, printer)) {
+        return false;
+    }
+    if (printer.host[0] == '\0' && from) {
+        copy_value(printer.host, sizeof(printer.host), from);
+    }
+    printer.seen_ms = now_ms;
+
+    bool changed = true;
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+    size_t index = count_;
+    for (size_t i = 0; i < count_; i++) {
+        if (strcmp(printers_[i].serial, printer.serial) == 0) {
+            index = i;
+            changed = strcmp(printers_[i].host, printer.host) != 0;
+            break;
+        }
+    }
+    if (index == count_ && count_ == PRINTER_DISCOVERY_MAX) {
+        // 已满，替换最久未见的
+        index = 0;
+        for (size_t i = 1; i < count_; i++) {
+            if (printers_[i].seen_ms < printers_[index].seen_ms) {
+                index = i;
+            }
+        }
+    } else if (index == count_) {
+        count_++;
+    }
+    printers_[index] = printer;
+    xSemaphoreGive(mutex_);
+
+    if (changed) {
+        ESP_LOGI(TAG, "Printer %s (%s) at %s", printer.serial, printer.model, printer.host);
+        if (cb_) {
+            cb_(ctx_, printer);
+        }
+    }
+    return true;
+}
+
+size_t PrinterDiscovery::list(Printer *out, size_t max) const {
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    Printer found[PRINTER_DISCOVERY_MAX];
+    size_t n = 0;
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+    for (size_t i = 0; i < count_; i++) {
+        if (now_ms - printers_[i].seen_ms > PRINTER_DISCOVERY_TTL_MS) {
+            continue;
+        }
+        // 按 seen_ms 降序插入
+        size_t pos = n++;
+        for (; pos > 0 && found[pos - 1].seen_ms < printers_[i].seen_ms; pos--) {
+            found[pos] = found[pos - 1];
+        }
+        found[pos] = printers_[i];
+    }
+    xSemaphoreGive(mutex_);
+    n = n < max ? n : max;
+    memcpy(out, found, n * sizeof(Printer));
+    return n;
+}
+
+bool PrinterDiscovery::start() {
+    if (task_) {
+        return true;
+    }
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket: errno %d", errno);
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port_);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        ESP_LOGE(TAG, "Failed to bind UDP %u: errno %d", port_, errno);
+        close(sock);
+        return false;
+    }
+    // 部分固件版本发送到多播地址，其余为广播，加入失败时只能收到广播
+    struct ip_mreq mreq = {};
+    mreq.imr_multiaddr.s_addr = inet_addr(SSDP_MULTICAST_ADDR);
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        ESP_LOGW(TAG, "Failed to join %s: errno %d", SSDP_MULTICAST_ADDR, errno);
+    }
+    // 定期醒来检查 running_
+    struct timeval timeout = {1, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    sock_ = sock;
+    running_ = true;
+    if (xTaskCreate(listen_task, "printer_ssdp", PRINTER_DISCOVERY_STACK_SIZE, this,
+                    PRINTER_DISCOVERY_PRIORITY, &task_) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create listen task");
+        running_ = false;
+        close(sock);
+        sock_ = -1;
+        return false;
+    }
+    ESP_LOGI(TAG, "Listening for printers on UDP %u", port_);
+    return true;
+}
+
+void PrinterDiscovery::stop() {
+    if (!task_) {
+        return;
+    }
+    running_ = false;
+    while (task_) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+void PrinterDiscovery::listen_task(void *arg) {
+    PrinterDiscovery *self = static_cast<PrinterDiscovery *>(arg);
+    char packet[PRINTER_DISCOVERY_PACKET_SIZE];
+    while (self->running_) {
+        struct sockaddr_in from = {};
+        socklen_t from_len = sizeof(from);
+        int len = recvfrom(self->sock_, packet, sizeof(packet), 0, (struct sockaddr *)&from,
+                           &from_len);
+        if (len <= 0) {
+            continue; // 超时
+        }
+        char from_ip[16];
+        inet_ntop(AF_INET, &from.sin_addr, from_ip, sizeof(from_ip));
+        self->handlePacket(packet, len, from_ip, esp_timer_get_time() / 1000);
+    }
+    close(self->sock_);
+    self->sock_ = -1;
+    self->task_ = nullptr;
+    vTaskDelete(nullptr);
+}
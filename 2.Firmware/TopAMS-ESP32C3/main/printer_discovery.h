@@ -0,0 +1,86 @@
+#pragma once
+
+#include "bambu_mqtt.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define PRINTER_DISCOVERY_PORT 2021         // 打印机广播 SSDP NOTIFY 的端口
+#define PRINTER_DISCOVERY_MAX 8             // 缓存的打印机数，满时替换最久未见的
+#define PRINTER_DISCOVERY_TTL_MS 60000      // 超过该时间未再收到广播的打印机不再列出
+#define PRINTER_DISCOVERY_PACKET_SIZE 768   // 单个 SSDP 报文的最大长度，超出部分被截断
+#define PRINTER_DISCOVERY_STACK_SIZE 4096
+#define PRINTER_DISCOVERY_PRIORITY 2
+#define PRINTER_DISCOVERY_URN "urn:bambulab-com:device:3dprinter:1"
+
+/**
+ * @brief 被动监听局域网中 Bambu 打印机的 SSDP 广播，缓存最近见到的打印机
+ *
+ * 打印机定期向 UDP 2021 发送 NOTIFY (NT 为 PRINTER_DISCOVERY_URN)，头部包含 IP (Location)、
+ * 序列号 (USN)、型号和名称。监听任务解析后更新缓存，新出现的打印机或 IP 变化时调用回调。
+ * 访问码不在广播中，须由用户在打印机屏幕上查看后填写。
+ */
+class PrinterDiscovery {
+public:
+    struct Printer {
+        char host[BAMBU_MQTT_HOST_SIZE];
+        char serial[BAMBU_MQTT_SERIAL_SIZE];
+        char model[16];
+        char name[32];
+        bool lan_only;   // DevConnect.bambu.com 为 lan (局域网模式)
+        int64_t seen_ms; // 最后一次收到广播的时间 (esp_timer)
+    };
+
+    /**
+     * @brief 发现新打印机或已知打印机的 IP 变化时在监听任务中调用
+     */
+    using FoundCallback = void (*)(void *ctx, const Printer &printer);
+
+    explicit PrinterDiscovery(uint16_t port = PRINTER_DISCOVERY_PORT);
+    ~PrinterDiscovery();
+
+    void setCallback(FoundCallback cb, void *ctx) {
+        cb_ = cb;
+        ctx_ = ctx;
+    }
+
+    /**
+     * @brief 创建监听任务，已启动时不做任何事；须在取得 IP 后调用
+     */
+    bool start();
+    void stop();
+
+    /**
+     * @brief 复制未过期的打印机，按最后见到的时间从新到旧
+     * @return 复制的个数
+     */
+    size_t list(Printer *out, size_t max) const;
+
+    /**
+     * @brief 处理一个 SSDP 报文，监听任务和测试调用
+     * @param from 发送方 IP，报文没有 Location 时使用
+     * @return false 不是 Bambu 打印机的报文
+     */
+    bool handlePacket(const char *data, size_t len, const char *from, int64_t now_ms);
+
+    /**
+     * @brief 解析 SSDP 报文 (NOTIFY 或 M-SEARCH 的回复)，不修改缓存
+     */
+    static bool parse(const char *data, size_t len, Printer &out);
+
+private:
+    uint16_t port_;
+    Printer printers_[PRINTER_DISCOVERY_MAX];
+    size_t count_ = 0;
+    SemaphoreHandle_t mutex_;
+    FoundCallback cb_ = nullptr;
+    void *ctx_ = nullptr;
+
+    TaskHandle_t task_ = nullptr;
+    volatile bool running_ = false;
+    int sock_ = -1;
+
+    static void listen_task(void *arg);
+};
@@ -0,0 +1,141 @@
+#include "printer_profiles.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "[PrinterProfiles]";
+
+class ProfilesLock {
+public:
+    explicit ProfilesLock(SemaphoreHandle_t mutex) : mutex_(mutex) {
+        xSemaphoreTake(mutex_, portMAX_DELAY);
+    }
+    ~ProfilesLock() { xSemaphoreGive(mutex_); }
+
+private:
+    SemaphoreHandle_t mutex_;
+};
+
+// 字段以 '\0' 结尾，记录损坏时不会越界读取
+static bool terminated(const char *field, size_t size) { return memchr(field, '\0', size); }
+
+static bool copy_field(char *dst, size_t size, const char *src, bool required) {
+    if (src == nullptr || strlen(src) >= size || (required && src[0] == '\0')) {
+        return false;
+    }
+    memset(dst, 0, size);
+    strcpy(dst, src);
+    return true;
+}
+
+PrinterProfiles::PrinterProfiles() : slots_{}, mutex_(xSemaphoreCreateMutex()) {}
+
+PrinterProfiles::~PrinterProfiles() { vSemaphoreDelete(mutex_); }
+
+void PrinterProfiles::recordName(size_t slot, char (&name)[NVS_RECORD_NAME_MAX + 1]) {
+    snprintf(name, sizeof(name), PRINTER_PROFILE_RECORD, (unsigned)slot);
+}
+
+esp_err_t PrinterProfiles::load(NVSManager &nvs) {
+    ProfilesLock lock(mutex_);
+    nvs_ = &nvs;
+    esp_err_t result = ESP_OK;
+    int count = 0;
+    for (size_t i = 0; i < PRINTER_PROFILE_MAX; i++) {
+        Slot &slot = slots_[i];
+        char name[NVS_RECORD_NAME_MAX + 1];
+        recordName(i, name);
+        PrinterProfile profile;
+        size_t length = sizeof(profile);
+        esp_err_t err = nvs.readRecord(name, PRINTER_PROFILE_VERSION, &profile, length,
+                                       slot.record);
+        slot.used = err == ESP_OK && length == sizeof(profile) &&
+                    terminated(profile.name, sizeof(profile.name)) &&
+                    terminated(profile.host, sizeof(profile.host)) &&
+                    terminated(profile.serial, sizeof(profile.serial)) &&
+                    terminated(profile.access_code, sizeof(profile.access_code));
+        if (slot.used) {
+            slot.profile = profile;
+            count++;
+        } else if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND &&
+                   err != ESP_ERR_INVALID_VERSION && err != ESP_ERR_INVALID_CRC) {
+            ESP_LOGE(TAG, "Failed to read profile %u: %s", (unsigned)i, esp_err_to_name(err));
+            result = err;
+        }
+    }
+    ESP_LOGI(TAG, "Loaded %d printer profiles", count);
+    return result;
+}
+
+bool PrinterProfiles::get(size_t slot, PrinterProfile &out) const {
+    if (slot >= PRINTER_PROFILE_MAX) {
+        return false;
+    }
+    ProfilesLock lock(mutex_);
+    if (!slots_[slot].used) {
+        return false;
+    }
+    out = slots_[slot].profile;
+    return true;
+}
+
+esp_err_t PrinterProfiles::save(size_t slot, const char *name, const char *host,
+                                const char *serial, const char *access_code) {
+    if (slot >= PRINTER_PROFILE_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    PrinterProfile profile;
+    if (!copy_field(profile.name, sizeof(profile.name), name, false) ||
+        !copy_field(profile.host, sizeof(profile.host), host, true) ||
+        !copy_field(profile.serial, sizeof(profile.serial), serial, true) ||
+        !copy_field(profile.access_code, sizeof(profile.access_code), access_code, false)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    ProfilesLock lock(mutex_);
+    if (nvs_ == nullptr) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    Slot &entry = slots_[slot];
+    if (entry.used && memcmp(&entry.profile, &profile, sizeof(profile)) == 0) {
+        return ESP_OK;
+    }
+    char record[NVS_RECORD_NAME_MAX + 1];
+    recordName(slot, record);
+    esp_err_t err = nvs_->writeRecord(record, PRINTER_PROFILE_VERSION, &profile, sizeof(profile),
+                                      entry.record);
+    if (err != ESP_OK) {
+        return err;
+    }
+    entry.profile = profile;
+    entry.used = true;
+    ESP_LOGI(TAG, "Saved profile %u: %s (%s)", (unsigned)slot, profile.serial, profile.host);
+    return ESP_OK;
+}
+
+esp_err_t PrinterProfiles::remove(size_t slot) {
+    if (slot >= PRINTER_PROFILE_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ProfilesLock lock(mutex_);
+    if (nvs_ == nullptr) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    Slot &entry = slots_[slot];
+    char record[NVS_RECORD_NAME_MAX + 1];
+    recordName(slot, record);
+    esp_err_t err = nvs_->eraseRecord(record, entry.record);
+    if (err == ESP_OK) {
+        entry.used = false;
+    }
+    return err;
+}
+
+int PrinterProfiles::find(std::string_view serial) const {
+    ProfilesLock lock(mutex_);
+    for (size_t i = 0; i < PRINTER_PROFILE_MAX; i++) {
+        if (slots_[i].used && serial == slots_[i].profile.serial) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "bambu_mqtt.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs_manager.h"
+#include <stddef.h>
+#include <string_view>
+
+#define PRINTER_PROFILE_MAX 4        // 保存的打印机数
+#define PRINTER_PROFILE_NAME_SIZE 24 // 显示名称最大长度 (含 '\0')
+#define PRINTER_PROFILE_RECORD "printer_p%u"
+#define PRINTER_PROFILE_VERSION 1 // PrinterProfile 的布局改变时递增
+
+/**
+ * @brief 一台打印机的连接参数，按原样打包为 NVS 记录
+ */
+struct PrinterProfile {
+    char name[PRINTER_PROFILE_NAME_SIZE];
+    char host[BAMBU_MQTT_HOST_SIZE];
+    char serial[BAMBU_MQTT_SERIAL_SIZE];
+    char access_code[BAMBU_MQTT_PASSWORD_SIZE];
+};
+
+/**
+ * @brief 保存的打印机列表
+ *
+ * 每个槽位一条 NVSManager 记录 (两个槽位 + 代数)，写入或删除中途断电时读到的是修改前的
+ * 完整内容。load() 后全部缓存在内存中，读取不访问 NVS。当前连接的打印机保存在设置项
+ * SETTING_PRINTER_* 中，选择某个槽位时由调用者复制过去。
+ * 所有方法互斥，可以在不同任务中调用。
+ */
+class PrinterProfiles {
+public:
+    PrinterProfiles();
+    ~PrinterProfiles();
+
+    /**
+     * @brief 读取所有槽位，不完整或版本不同的记录视为空
+     */
+    esp_err_t load(NVSManager &nvs);
+
+    /**
+     * @return false 槽位为空或越界
+     */
+    bool get(size_t slot, PrinterProfile &out) const;
+
+    /**
+     * @return ESP_ERR_INVALID_ARG 槽位越界，ESP_ERR_INVALID_SIZE 字段过长或为空，
+     *         ESP_ERR_INVALID_STATE 未 load()，其他为 NVS 写入错误 (缓存不变)
+     */
+    esp_err_t save(size_t slot, const char *name, const char *host, const char *serial,
+                   const char *access_code);
+    esp_err_t remove(size_t slot);
+
+    /**
+     * @brief 按序列号查找
+     * @return 不存在时返回 -1
+     */
+    int find(std::string_view serial) const;
+
+private:
+    struct Slot {
+        PrinterProfile profile;
+        NVSManager::RecordState record;
+        bool used;
+    };
+
+    Slot slots_[PRINTER_PROFILE_MAX];
+    NVSManager *nvs_ = nullptr;
+    SemaphoreHandle_t mutex_;
+
+    static void recordName(size_t slot, char (&name)[NVS_RECORD_NAME_MAX + 1]);
+};
@@ -0,0 +1,171 @@
+#include "printer_sessions.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include <string.h>
+
+static const char *TAG = "[PrinterSessions]";
+
+class SessionsLock {
+public:
+    explicit SessionsLock(SemaphoreHandle_t mutex) : mutex_(mutex) {
+        xSemaphoreTake(mutex_, portMAX_DELAY);
+    }
+    ~SessionsLock() { xSemaphoreGive(mutex_); }
+
+private:
+    SemaphoreHandle_t mutex_;
+};
+
+PrinterSessions::Session::Session(const PrinterProfile &profile)
+    : mqtt(profile.host, profile.access_code, profile.serial, status, nullptr) {}
+
+PrinterSessions::PrinterSessions(std::shared_ptr<BambuMQTT> primary, size_t heap_cost,
+                                 size_t heap_reserve)
+    : slots_{}, heap_cost_(heap_cost), heap_reserve_(heap_reserve),
+      mutex_(xSemaphoreCreateMutex()) {
+    for (size_t i = 0; i < PRINTER_SESSION_MAX; i++) {
+        routes_[i] = {this, static_cast<uint8_t>(i)};
+        slots_[i].profile = -1;
+    }
+    slots_[0].mqtt = std::move(primary);
+    slots_[0].mqtt->setStatusCallback(onStatus, &routes_[0]);
+}
+
+PrinterSessions::~PrinterSessions() {
+    stop();
+    vSemaphoreDelete(mutex_);
+}
+
+void PrinterSessions::onStatus(void *ctx, const BambuStatus &status) {
+    Route *route = static_cast<Route *>(ctx);
+    PrinterSessions *self = route->self;
+    if (self->cb_) {
+        self->cb_(self->ctx_, route->index, status);
+    }
+}
+
+void PrinterSessions::open(size_t index, size_t slot, const PrinterProfile &profile) {
+    std::shared_ptr<Session> session = std::make_shared<Session>(profile);
+    session->mqtt.setStatusCallback(onStatus, &routes_[index]);
+    // 别名指针：调用者只看到连接，状态随连接一起释放
+    slots_[index].mqtt = std::shared_ptr<BambuMQTT>(session, &session->mqtt);
+    slots_[index].profile = static_cast<int8_t>(slot);
+    if (started_) {
+        slots_[index].mqtt->start();
+    }
+    ESP_LOGI(TAG, "Session %u: profile %u (%s at %s)", (unsigned)index, (unsigned)slot,
+             profile.serial, profile.host);
+}
+
+size_t PrinterSessions::apply(const PrinterProfiles &profiles, uint32_t mask,
+                              uint32_t *released) {
+    SessionsLock lock(mutex_);
+    uint32_t closed = 0;
+    const char *primary_serial = slots_[0].mqtt->getSerial();
+    PrinterProfile profile;
+
+    // 先关闭，释放的内存可用于新会话
+    bool covered[PRINTER_PROFILE_MAX] = {};
+    for (size_t i = 1; i < PRINTER_SESSION_MAX; i++) {
+        Slot &entry = slots_[i];
+        if (!entry.mqtt) {
+            continue;
+        }
+        bool switched = false;
+        if ((mask & (1u << entry.profile)) && profiles.get(entry.profile, profile) &&
+            strcmp(profile.serial, primary_serial) != 0 &&
+            entry.mqtt->setPrinter(profile.host, profile.access_code, profile.serial,
+                                   &switched)) {
+            covered[entry.profile] = true;
+            closed |= switched ? 1u << i : 0;
+            continue;
+        }
+        ESP_LOGI(TAG, "Session %u closed", (unsigned)i);
+        closed |= 1u << i;
+        entry.mqtt->stop();
+        entry.mqtt.reset();
+        entry.profile = -1;
+    }
+
+    // 启动前的会话还没有分配 TLS 缓冲和任务栈，同样计入预算
+    size_t free_heap = esp_get_free_heap_size();
+    size_t committed = heap_reserve_;
+    size_t opened = 0;
+    for (size_t i = 1; i < PRINTER_SESSION_MAX; i++) {
+        if (slots_[i].mqtt) {
+            committed += started_ ? 0 : heap_cost_;
+            opened++;
+        }
+    }
+    for (size_t slot = 0; slot < PRINTER_PROFILE_MAX; slot++) {
+        if (!(mask & (1u << slot)) || covered[slot] || !profiles.get(slot, profile) ||
+            strcmp(profile.serial, primary_serial) == 0) {
+            continue;
+        }
+        size_t index = 1;
+        while (index < PRINTER_SESSION_MAX && slots_[index].mqtt) {
+            index++;
+        }
+        if (index == PRINTER_SESSION_MAX) {
+            ESP_LOGW(TAG, "No free session for profile %u", (unsigned)slot);
+            break;
+        }
+        if (free_heap < committed + heap_cost_) {
+            ESP_LOGW(TAG, "Not enough heap for profile %u: free %u, need %u", (unsigned)slot,
+                     (unsigned)free_heap, (unsigned)(committed + heap_cost_));
+            break;
+        }
+        committed += heap_cost_;
+        open(index, slot, profile);
+        opened++;
+    }
+    if (released) {
+        *released = closed;
+    }
+    return opened;
+}
+
+void PrinterSessions::start() {
+    SessionsLock lock(mutex_);
+    started_ = true;
+    for (Slot &entry : slots_) {
+        if (entry.mqtt) {
+            entry.mqtt->start();
+        }
+    }
+}
+
+void PrinterSessions::stop() {
+    SessionsLock lock(mutex_);
+    started_ = false;
+    for (Slot &entry : slots_) {
+        if (entry.mqtt) {
+            entry.mqtt->stop();
+        }
+    }
+}
+
+std::shared_ptr<BambuMQTT> PrinterSessions::get(size_t session) const {
+    if (session >= PRINTER_SESSION_MAX) {
+        return nullptr;
+    }
+    SessionsLock lock(mutex_);
+    return slots_[session].mqtt;
+}
+
+int PrinterSessions::profileOf(size_t session) const {
+    if (session >= PRINTER_SESSION_MAX) {
+        return -1;
+    }
+    SessionsLock lock(mutex_);
+    return slots_[session].profile;
+}
+
+size_t PrinterSessions::count() const {
+    SessionsLock lock(mutex_);
+    size_t n = 0;
+    for (const Slot &entry : slots_) {
+        n += entry.mqtt != nullptr;
+    }
+    return n;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "bambu_mqtt.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "printer_profiles.h"
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PRINTER_SESSION_MAX 4 // 含会话 0 (当前打印机)，与 PRINTER_PROFILE_MAX 相同
+// 每个附加会话预计占用的堆：TLS 收发缓冲和握手 (~36 KB)、esp-mqtt 任务栈和缓冲区、
+// ingest 任务栈，以及 BambuMQTT + BambuStatus 对象 (环形缓冲区和待回复表)
+#define PRINTER_SESSION_HEAP_COST (56 * 1024)
+// 打开附加会话后仍须保留的空闲堆，留给 Wi-Fi、httpd 和 WebSocket 推送
+#define PRINTER_SESSION_HEAP_RESERVE (40 * 1024)
+
+/**
+ * @brief 同时连接的多台打印机，每台一个会话 (独立的 MQTT 连接、状态和待回复命令表)
+ *
+ * 会话 0 为 Instance::bambu_mqtt (设置项 SETTING_PRINTER_*)，始终存在；其余会话按
+ * PrinterProfiles 槽位的位掩码打开，与会话 0 序列号相同的槽位跳过。
+ * 打开附加会话前按 PRINTER_SESSION_HEAP_COST 估算占用，空闲堆不足以同时保留
+ * PRINTER_SESSION_HEAP_RESERVE 时不再打开，已打开的会话不受影响。
+ * 所有会话的上报通过同一个回调送出，回调在各会话自己的 ingest 任务中执行，附带会话编号。
+ * 打开 / 关闭之间互斥；get() 返回共享指针，会话关闭后调用者持有的连接仍然有效。
+ */
+class PrinterSessions {
+public:
+    using StatusCallback = void (*)(void *ctx, size_t session, const BambuStatus &status);
+
+    /**
+     * @param primary 会话 0，其状态回调由本对象接管
+     */
+    explicit PrinterSessions(std::shared_ptr<BambuMQTT> primary,
+                             size_t heap_cost = PRINTER_SESSION_HEAP_COST,
+                             size_t heap_reserve = PRINTER_SESSION_HEAP_RESERVE);
+    ~PrinterSessions();
+
+    /**
+     * @brief 设置上报回调，需在 start() 和 apply() 前设置
+     */
+    void setStatusCallback(StatusCallback cb, void *ctx) {
+        cb_ = cb;
+        ctx_ = ctx;
+    }
+
+    /**
+     * @brief 按 mask (bit n 为槽位 n) 打开、更新或关闭附加会话
+     *
+     * 不在 mask 中或档案已删除的会话先关闭；档案的连接参数变化时用 setPrinter() 重新连接；
+     * 新会话在 start() 之后打开时立即连接。会阻塞到关闭的会话的任务退出，
+     * 不能在状态回调中调用。
+     * @param released 可以为 nullptr，写入关闭或换成另一台打印机的会话 (bit n 为会话 n)，
+     *        同一次调用中关闭后又打开给其他档案的会话也在其中；调用者据此放弃这些会话的换料和状态
+     * @return 打开的附加会话数，堆不足或会话已满时少于 mask 中的槽位数
+     */
+    size_t apply(const PrinterProfiles &profiles, uint32_t mask, uint32_t *released = nullptr);
+
+    /**
+     * @brief 连接所有会话，取得 IP 后调用
+     */
+    void start();
+    void stop();
+
+    /**
+     * @return 会话不存在时返回 nullptr
+     */
+    std::shared_ptr<BambuMQTT> get(size_t session) const;
+
+    /**
+     * @return 会话对应的 PrinterProfiles 槽位，会话 0 和不存在的会话返回 -1
+     */
+    int profileOf(size_t session) const;
+
+    /**
+     * @return 已打开的会话数，含会话 0
+     */
+    size_t count() const;
+
+private:
+    // 附加会话的状态与连接一起分配，BambuMQTT 持有状态的引用
+    struct Session {
+        BambuStatus status;
+        BambuMQTT mqtt;
+
+        explicit Session(const PrinterProfile &profile);
+    };
+
+    // 状态回调的上下文，地址在对象的生命周期内不变
+    struct Route {
+        PrinterSessions *self;
+        uint8_t index;
+    };
+
+    struct Slot {
+        std::shared_ptr<BambuMQTT> mqtt;
+        int8_t profile; // -1 为会话 0 或空
+    };
+
+    Slot slots_[PRINTER_SESSION_MAX];
+    Route routes_[PRINTER_SESSION_MAX];
+    size_t heap_cost_;
+    size_t heap_reserve_;
+    bool started_ = false;
+    StatusCallback cb_ = nullptr;
+    void *ctx_ = nullptr;
+    SemaphoreHandle_t mutex_;
+
+    void open(size_t index, size_t slot, const PrinterProfile &profile);
+    static void onStatus(void *ctx, const BambuStatus &status);
+};
@@ -0,0 +1,385 @@
+#include "report_parser.h"
+#include <array>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace {
+
+/**
+ * @brief 传给字段写入函数的当前值
+ */
+struct ReportValue {
+    const JsonStream &stream;
+    JsonEvent event;
+    std::string_view text; // 以 '\0' 结尾，可以直接交给 strtol / strtof
+
+    // 打印机上报中很多数值以字符串形式出现，如 "tray_now": "255"
+    bool scalar() const { return event == JsonEvent::Number || event == JsonEvent::String; }
+    long asInt() const { return strtol(text.data(), nullptr, 10); }
+    unsigned long asUint() const { return strtoul(text.data(), nullptr, 10); }
+    float asFloat() const { return strtof(text.data(), nullptr); }
+};
+
+using FieldSetter = void (*)(BambuStatus &s, const ReportValue &v);
+
+struct ReportField {
+    uint32_t hash;
+    FieldSetter apply;
+};
+
+// "print.ams.ams[].tray[]" 中的 AMS 与托盘下标
+bool tray_index(const ReportValue &v, int &ams_id, int &tray_id) {
+    ams_id = v.stream.arrayIndex(1);
+    tray_id = v.stream.arrayIndex(0);
+    return ams_id >= 0 && ams_id < BAMBU_MAX_AMS && tray_id >= 0 &&
+           tray_id < BAMBU_TRAYS_PER_AMS;
+}
+
+template <typename F> void merge_tray(BambuStatus &s, const ReportValue &v, F &&apply) {
+    int ams_id, tray_id;
+    if (!v.scalar() || !tray_index(v, ams_id, tray_id)) {
+        return;
+    }
+    BambuTray &tray = s.ams[ams_id].trays[tray_id];
+    if (apply(tray)) {
+        s.markTray(ams_id, tray_id);
+    }
+}
+
+template <typename T> bool update(T &field, T value) {
+    if (field == value) {
+        return false;
+    }
+    field = value;
+    return true;
+}
+
+/*
+{
+    "print": {
+        "nozzle_temper": 26.78125,
+        "bed_temper": 27.65625,
+        "wifi_signal": "-29dBm",
+        "gcode_state": "RUNNING",
+        "mc_print_stage": "2",
+        "ams": {
+            "ams": [{"id": "0", "humidity": "5", "temp": "0.0",
+                     "tray": [{"id": "0", "tray_type": "PLA", "tray_color": "FFFFFFFF", ...}]}],
+            "tray_now": "255", "tray_tar": "255", "tray_pre": "255"
+        },
+        "hms": [{"attr": 50336000, "code": 131073}],
+        "command": "push_status",
+        "msg": 1,
+        "sequence_id": "2511"
+    }
+}
+*/
+constexpr ReportField REPORT_FIELDS[] = {
+    {json_path_hash("print.nozzle_temper"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.nozzle_temper, v.asFloat(), BAMBU_FIELD_NOZZLE_TEMPER);
+         }
+     }},
+    {json_path_hash("print.nozzle_target_temper"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.nozzle_target_temper, v.asFloat(), BAMBU_FIELD_NOZZLE_TARGET);
+         }
+     }},
+    {json_path_hash("print.bed_temper"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.bed_temper, v.asFloat(), BAMBU_FIELD_BED_TEMPER);
+         }
+     }},
+    {json_path_hash("print.bed_target_temper"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.bed_target_temper, v.asFloat(), BAMBU_FIELD_BED_TARGET);
+         }
+     }},
+    {json_path_hash("print.wifi_signal"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.event == JsonEvent::String) {
+             s.merge(s.wifi_signal, sizeof(s.wifi_signal), v.text.data(), v.text.size(),
+                     BAMBU_FIELD_WIFI_SIGNAL);
+         }
+     }},
+    {json_path_hash("print.gcode_state"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.event == JsonEvent::String) {
+             s.merge(s.gcode_state, sizeof(s.gcode_state), v.text.data(), v.text.size(),
+                     BAMBU_FIELD_GCODE_STATE);
+         }
+     }},
+    {json_path_hash("print.mc_print_stage"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.mc_print_stage, (int16_t)v.asInt(), BAMBU_FIELD_PRINT_STAGE);
+         }
+     }},
+    {json_path_hash("print.stg_cur"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.stg_cur, (int16_t)v.asInt(), BAMBU_FIELD_STG_CUR);
+         }
+     }},
+    {json_path_hash("print.mc_percent"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.mc_percent, (int8_t)v.asInt(), BAMBU_FIELD_PERCENT);
+         }
+     }},
+    {json_path_hash("print.mc_remaining_time"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.mc_remaining_time, (int32_t)v.asInt(), BAMBU_FIELD_REMAINING_TIME);
+         }
+     }},
+    {json_path_hash("print.layer_num"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.layer_num, (int32_t)v.asInt(), BAMBU_FIELD_LAYER);
+         }
+     }},
+    {json_path_hash("print.total_layer_num"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.total_layer_num, (int32_t)v.asInt(), BAMBU_FIELD_LAYER);
+         }
+     }},
+    {json_path_hash("print.print_error"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.print_error, (uint32_t)v.asUint(), BAMBU_FIELD_PRINT_ERROR);
+         }
+     }},
+    {json_path_hash("print.cooling_fan_speed"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.cooling_fan_speed, (uint8_t)v.asInt(), BAMBU_FIELD_FANS);
+         }
+     }},
+    {json_path_hash("print.big_fan1_speed"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.big_fan1_speed, (uint8_t)v.asInt(), BAMBU_FIELD_FANS);
+         }
+     }},
+    {json_path_hash("print.big_fan2_speed"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.big_fan2_speed, (uint8_t)v.asInt(), BAMBU_FIELD_FANS);
+         }
+     }},
+    {json_path_hash("print.heatbreak_fan_speed"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.heatbreak_fan_speed, (uint8_t)v.asInt(), BAMBU_FIELD_FANS);
+         }
+     }},
+    {json_path_hash("print.ams_status"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.ams_status, (int32_t)v.asInt(), BAMBU_FIELD_AMS_STATUS);
+         }
+     }},
+    {json_path_hash("print.ams.tray_now"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.tray_now, (uint8_t)v.asInt(), BAMBU_FIELD_TRAY_NOW);
+         }
+     }},
+    {json_path_hash("print.ams.tray_tar"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.tray_tar, (uint8_t)v.asInt(), BAMBU_FIELD_TRAY_TAR);
+         }
+     }},
+    {json_path_hash("print.ams.tray_pre"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.scalar()) {
+             s.merge(s.tray_pre, (uint8_t)v.asInt(), BAMBU_FIELD_TRAY_PRE);
+         }
+     }},
+    {json_path_hash("print.ams.ams"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.event == JsonEvent::ArrayEnd) {
+             size_t count = v.stream.elementCount();
+             s.merge(s.ams_count, (uint8_t)(count < BAMBU_MAX_AMS ? count : BAMBU_MAX_AMS),
+                     BAMBU_FIELD_AMS_UNIT);
+         }
+     }},
+    {json_path_hash("print.ams.ams[].humidity"),
+     [](BambuStatus &s, const ReportValue &v) {
+         int ams_id = v.stream.arrayIndex(0);
+         if (v.scalar() && ams_id >= 0 && ams_id < BAMBU_MAX_AMS) {
+             s.merge(s.ams[ams_id].humidity, (int8_t)v.asInt(), BAMBU_FIELD_AMS_UNIT);
+         }
+     }},
+    {json_path_hash("print.ams.ams[].temp"),
+     [](BambuStatus &s, const ReportValue &v) {
+         int ams_id = v.stream.arrayIndex(0);
+         if (v.scalar() && ams_id >= 0 && ams_id < BAMBU_MAX_AMS) {
+             s.merge(s.ams[ams_id].temp, v.asFloat(), BAMBU_FIELD_AMS_UNIT);
+         }
+     }},
+    {json_path_hash("print.ams.ams[].tray[].tray_type"),
+     [](BambuStatus &s, const ReportValue &v) {
+         merge_tray(s, v, [&](BambuTray &tray) {
+             if (v.text == tray.type) {
+                 return false;
+             }
+             snprintf(tray.type, sizeof(tray.type), "%s", v.text.data());
+             return true;
+         });
+     }},
+    {json_path_hash("print.ams.ams[].tray[].tray_color"),
+     [](BambuStatus &s, const ReportValue &v) {
+         merge_tray(s, v, [&](BambuTray &tray) {
+             if (v.text == tray.color) {
+                 return false;
+             }
+             snprintf(tray.color, sizeof(tray.color), "%s", v.text.data());
+             return true;
+         });
+     }},
+    {json_path_hash("print.ams.ams[].tray[].nozzle_temp_min"),
+     [](BambuStatus &s, const ReportValue &v) {
+         merge_tray(s, v, [&](BambuTray &tray) {
+             return update(tray.nozzle_temp_min, (int16_t)v.asInt());
+         });
+     }},
+    {json_path_hash("print.ams.ams[].tray[].nozzle_temp_max"),
+     [](BambuStatus &s, const ReportValue &v) {
+         merge_tray(s, v, [&](BambuTray &tray) {
+             return update(tray.nozzle_temp_max, (int16_t)v.asInt());
+         });
+     }},
+    {json_path_hash("print.ams.ams[].tray[].remain"),
+     [](BambuStatus &s, const ReportValue &v) {
+         merge_tray(s, v, [&](BambuTray &tray) { return update(tray.remain, (int8_t)v.asInt()); });
+     }},
+    {json_path_hash("print.hms"),
+     [](BambuStatus &s, const ReportValue &v) {
+         if (v.event == JsonEvent::ArrayEnd) {
+             size_t count = v.stream.elementCount();
+             s.merge(s.hms_count, (uint8_t)(count < BAMBU_MAX_HMS ? count : BAMBU_MAX_HMS),
+                     BAMBU_FIELD_HMS);
+         }
+     }},
+    {json_path_hash("print.hms[].attr"),
+     [](BambuStatus &s, const ReportValue &v) {
+         int i = v.stream.arrayIndex(0);
+         if (v.scalar() && i >= 0 && i < BAMBU_MAX_HMS) {
+             s.merge(s.hms[i].attr, (uint32_t)v.asUint(), BAMBU_FIELD_HMS);
+         }
+     }},
+    {json_path_hash("print.hms[].code"),
+     [](BambuStatus &s, const ReportValue &v) {
+         int i = v.stream.arrayIndex(0);
+         if (v.scalar() && i >= 0 && i < BAMBU_MAX_HMS) {
+             s.merge(s.hms[i].code, (uint32_t)v.asUint(), BAMBU_FIELD_HMS);
+         }
+     }},
+};
+
+enum class ReplyField : uint8_t { Command, SequenceId, Result };
+
+struct ReplyPath {
+    uint32_t hash;
+    ReplyField field;
+};
+
+constexpr uint32_t reply_hash(std::string_view group, std::string_view key) {
+    return json_path_hash(key, json_path_hash(".", json_path_hash(group)));
+}
+
+// {"print":{"command":"ams_change_filament","sequence_id":"12","result":"success",...}}
+constexpr auto REPLY_FIELDS = [] {
+    constexpr std::string_view groups[] = {"print", "system", "info", "pushing"};
+    std::array<ReplyPath, std::size(groups) * 3> table{};
+    size_t n = 0;
+    for (std::string_view group : groups) {
+        table[n++] = {reply_hash(group, "command"), ReplyField::Command};
+        table[n++] = {reply_hash(group, "sequence_id"), ReplyField::SequenceId};
+        table[n++] = {reply_hash(group, "result"), ReplyField::Result};
+    }
+    return table;
+}();
+
+} // namespace
+
+ReportParser::ReportParser(BambuStatus &status)
+    : status_(status), pending_(status), reply_{}, stream_(on_event, this), received_(0),
+      discarding_(false) {}
+
+bool ReportParser::parse(const char *data, size_t len) {
+    return feed(data, len, 0, len) == Result::Complete;
+}
+
+ReportParser::Result ReportParser::feed(const char *data, size_t len, size_t offset,
+                                        size_t total) {
+    if (offset == 0) {
+        // 新消息开始，丢弃上一条未完成的消息
+        pending_ = status_;
+        pending_.clearDirty();
+        reply_ = {};
+        stream_.reset();
+        received_ = 0;
+        discarding_ = false;
+    } else if (discarding_) {
+        return offset + len >= total ? Result::Error : Result::Pending;
+    }
+
+    if (offset != received_ || !stream_.feed(data, len)) {
+        // 分片不连续或格式错误，忽略本条消息的剩余分片
+        discarding_ = true;
+        return offset + len >= total ? Result::Error : Result::Pending;
+    }
+    received_ += len;
+
+    if (received_ < total) {
+        return Result::Pending;
+    }
+    if (!stream_.done()) {
+        return Result::Error;
+    }
+    status_ = pending_;
+    return Result::Complete;
+}
+
+void ReportParser::on_event(void *ctx, const JsonStream &stream, JsonEvent event,
+                            std::string_view value) {
+    ReportParser *self = static_cast<ReportParser *>(ctx);
+    uint32_t hash = stream.pathHash();
+    for (const ReportField &field : REPORT_FIELDS) {
+        if (field.hash == hash) {
+            field.apply(self->pending_, ReportValue{stream, event, value});
+            return;
+        }
+    }
+    if (event != JsonEvent::String && event != JsonEvent::Number) {
+        return;
+    }
+    ReportReply &reply = self->reply_;
+    for (const ReplyPath &path : REPLY_FIELDS) {
+        if (path.hash != hash) {
+            continue;
+        }
+        switch (path.field) {
+            case ReplyField::Command:
+                snprintf(reply.command, sizeof(reply.command), "%s", value.data());
+                break;
+            case ReplyField::SequenceId:
+                reply.sequence_id = strtoul(value.data(), nullptr, 10);
+                reply.has_sequence_id = true;
+                break;
+            case ReplyField::Result:
+                snprintf(reply.result, sizeof(reply.result), "%s", value.data());
+                break;
+        }
+        return;
+    }
+}
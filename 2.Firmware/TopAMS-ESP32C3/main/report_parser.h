@@ -0,0 +1,71 @@
+#pragma once
+
+#include "json_stream.h"
+#include "model/bambu_status.h"
+
+/**
+ * @brief 上报中的命令信息，取自 print / system / info / pushing 对象
+ *
+ * 打印机对请求的回复同样发布在 report 主题上，并带回请求中的 sequence_id。
+ * push_status 也带有 sequence_id，但那是打印机自己的计数，需要按 command 区分。
+ */
+struct ReportReply {
+    char command[32];
+    char result[16];
+    uint32_t sequence_id;
+    bool has_sequence_id;
+};
+
+/**
+ * @brief 打印机上报 (device/<serial>/report) 解析器
+ *
+ * 基于 JsonStream 流式解析，按编译期路径表把关心的字段直接写入 BambuStatus，
+ * 不构建 cJSON 树，解析过程中不分配堆内存。打印机在 pushall 之后只发送增量上报，
+ * 消息中未出现的字段保持原值；每条消息合并完成后 BambuStatus::dirty 为本条消息
+ * 实际改变的字段。
+ */
+class ReportParser {
+public:
+    enum class Result {
+        Pending,  // 消息尚未接收完整
+        Complete, // 消息解析完成，已写入 BambuStatus
+        Error,    // 格式错误或分片丢失，本条消息被丢弃
+    };
+
+    explicit ReportParser(BambuStatus &status);
+
+    /**
+     * @brief 解析一条完整的上报消息
+     * @return true 成功, false JSON 格式错误
+     */
+    bool parse(const char *data, size_t len);
+
+    /**
+     * @brief 输入一个 MQTT 分片
+     *
+     * 较大的上报 (如 pushall 的完整回复) 会被 esp-mqtt 拆成多个 MQTT_EVENT_DATA，
+     * 每个分片直接送入可恢复的 JsonStream，不需要整条消息大小的接收缓冲区。
+     * 解析结果先写入暂存副本，整条消息完整且合法后才提交到 BambuStatus。
+     *
+     * @param offset 分片在消息中的偏移 (current_data_offset)
+     * @param total 消息总长度 (total_data_len)
+     */
+    Result feed(const char *data, size_t len, size_t offset, size_t total);
+
+    /**
+     * @brief 最近一条完整消息中的命令信息，在 feed() 返回 Complete 后有效
+     */
+    const ReportReply &reply() const { return reply_; }
+
+private:
+    static void on_event(void *ctx, const JsonStream &stream, JsonEvent event,
+                         std::string_view value);
+
+    BambuStatus &status_;
+    BambuStatus pending_;
+    ReportReply reply_;
+    JsonStream stream_;
+
+    size_t received_;
+    bool discarding_;
+};
@@ -0,0 +1,591 @@
+#include "settings_store.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "[Settings]";
+
+const SettingGroupDef SETTING_GROUPS[SETTING_GROUP_COUNT] = {
+    {nullptr, 0},
+#define SETTING_GROUP(name, record, version) {record, version},
+#define SETTING_STR(name, group, key, value, size)
+#define SETTING_I32(name, group, key, value)
+#define SETTING_BOOL(name, group, key, value)
+#include "settings.def"
+#undef SETTING_GROUP
+#undef SETTING_STR
+#undef SETTING_I32
+#undef SETTING_BOOL
+};
+
+const SettingDef SETTING_DEFS[SETTING_COUNT] = {
+#define SETTING_GROUP(name, record, version)
+#define SETTING_STR(name, group, key, value, size)                                                \
+    {key, SETTING_TYPE_STR, size, value, 0, SETTING_GROUP_##group},
+#define SETTING_I32(name, group, key, value)                                                      \
+    {key, SETTING_TYPE_I32, 0, "", value, SETTING_GROUP_##group},
+#define SETTING_BOOL(name, group, key, value)                                                     \
+    {key, SETTING_TYPE_BOOL, 0, "", value, SETTING_GROUP_##group},
+#include "settings.def"
+#undef SETTING_GROUP
+#undef SETTING_STR
+#undef SETTING_I32
+#undef SETTING_BOOL
+};
+
+class SettingsLock {
+public:
+    explicit SettingsLock(SemaphoreHandle_t mutex) : mutex_(mutex) {
+        xSemaphoreTake(mutex_, portMAX_DELAY);
+    }
+    ~SettingsLock() { xSemaphoreGive(mutex_); }
+
+private:
+    SemaphoreHandle_t mutex_;
+};
+
+SettingsStore::SettingsStore(const SettingDef *defs, size_t count, const SettingGroupDef *groups,
+                             size_t group_count)
+    : defs_(defs), count_(0), group_defs_(groups), group_count_(group_count), entries_{},
+      groups_{}, strings_{}, mutex_(xSemaphoreCreateMutex()), hits_(0), misses_(0) {
+    // 按声明顺序分配字符串缓存，超出缓存或组记录容量的项不登记
+    size_t offset = 0;
+    size_t record_sizes[SETTINGS_MAX_GROUPS] = {};
+    for (; count_ < count && count_ < SETTINGS_MAX_COUNT; count_++) {
+        const SettingDef &def = defs[count_];
+        size_t size = def.type == SETTING_TYPE_STR ? def.size : 0;
+        if (offset + size > SETTINGS_CACHE_SIZE) {
+            break;
+        }
+        if (def.group != SETTING_GROUP_NONE) {
+            if (def.group >= group_count || def.group >= SETTINGS_MAX_GROUPS ||
+                record_sizes[def.group] + encodedSize(def) > NVS_RECORD_MAX) {
+                break;
+            }
+            record_sizes[def.group] += encodedSize(def);
+            used_groups_ |= 1u << def.group;
+        }
+        entries_[count_].offset = offset;
+        offset += size;
+        setDefault(count_);
+    }
+    if (count_ < count) {
+        ESP_LOGE(TAG, "Settings table exceeds cache, only %d of %d registered", (int)count_,
+                 (int)count);
+    }
+}
+
+SettingsStore::~SettingsStore() { vSemaphoreDelete(mutex_); }
+
+bool SettingsStore::valid(size_t id, SettingType type) const {
+    return id < count_ && defs_[id].type == type;
+}
+
+void SettingsStore::setDefault(size_t id) {
+    const SettingDef &def = defs_[id];
+    Entry &entry = entries_[id];
+    if (def.type == SETTING_TYPE_STR) {
+        strncpy(strings_ + entry.offset, def.default_str, def.size - 1);
+        strings_[entry.offset + def.size - 1] = '\0';
+    } else {
+        entry.value = def.default_int;
+    }
+    entry.state = STATE_DEFAULT;
+}
+
+// type 为遍历时看到的类型，NVS_TYPE_ANY 表示按声明的类型尝试读取
+bool SettingsStore::readEntry(size_t id, nvs_type_t type) {
+    const SettingDef &def = defs_[id];
+    Entry &entry = entries_[id];
+    bool any = type == NVS_TYPE_ANY;
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    switch (def.type) {
+        case SETTING_TYPE_STR: {
+            char *out = strings_ + entry.offset;
+            if (any || type == NVS_TYPE_STR) {
+                err = nvs_->getStr(def.key, out, def.size);
+            }
+            if (err == ESP_ERR_NVS_NOT_FOUND && (any || type == NVS_TYPE_BLOB)) {
+                // 旧版本以定长 char 数组的 blob 保存
+                size_t len = def.size - 1;
+                err = nvs_->getBlob(def.key, out, len);
+                if (err == ESP_OK) {
+                    out[len] = '\0';
+                    entry.legacy = true;
+                    entry.dirty = true;
+                }
+            }
+            break;
+        }
+        case SETTING_TYPE_I32:
+            if (any || type == NVS_TYPE_I32) {
+                err = nvs_->get<int32_t>(def.key, entry.value);
+            }
+            break;
+        case SETTING_TYPE_BOOL: {
+            uint8_t value;
+            if (any || type == NVS_TYPE_U8) {
+                err = nvs_->get<uint8_t>(def.key, value);
+            }
+            if (err == ESP_OK) {
+                entry.value = value != 0;
+            }
+            break;
+        }
+    }
+    if (err != ESP_OK) {
+        if (err != ESP_ERR_NVS_NOT_FOUND || !any) {
+            ESP_LOGW(TAG, "Setting %s unreadable (%s), using default", def.key,
+                     err == ESP_ERR_NVS_NOT_FOUND ? "type mismatch" : esp_err_to_name(err));
+        }
+        // 读取失败时缓冲区可能已被改写
+        setDefault(id);
+        return false;
+    }
+    if (def.group != SETTING_GROUP_NONE) {
+        // 组内的项单独保存是旧格式，写入组记录后删除
+        entry.legacy = true;
+        entry.dirty = true;
+    }
+    entry.state = STATE_STORED;
+    return true;
+}
+
+size_t SettingsStore::encodedSize(const SettingDef &def) {
+    switch (def.type) {
+        case SETTING_TYPE_STR:
+            return def.size; // 1 字节长度 + 不含 '\0' 的内容
+        case SETTING_TYPE_I32:
+            return sizeof(int32_t);
+        default:
+            return 1;
+    }
+}
+
+// 组内的项按声明顺序打包：字符串为长度 + 内容，整数为 4 字节，布尔为 1 字节
+size_t SettingsStore::encodeGroup(uint8_t group) {
+    size_t pos = 0;
+    for (size_t id = 0; id < count_; id++) {
+        const SettingDef &def = defs_[id];
+        if (def.group != group) {
+            continue;
+        }
+        const Entry &entry = entries_[id];
+        if (def.type == SETTING_TYPE_STR) {
+            const char *value = strings_ + entry.offset;
+            size_t len = strlen(value);
+            record_[pos++] = len;
+            memcpy(record_ + pos, value, len);
+            pos += len;
+        } else if (def.type == SETTING_TYPE_I32) {
+            memcpy(record_ + pos, &entry.value, sizeof(int32_t));
+            pos += sizeof(int32_t);
+        } else {
+            record_[pos++] = entry.value != 0;
+        }
+    }
+    return pos;
+}
+
+// 先校验整条记录再写入缓存，记录有误时缓存不变
+bool SettingsStore::decodeGroup(uint8_t group, size_t length) {
+    size_t pos = 0;
+    for (size_t id = 0; id < count_; id++) {
+        const SettingDef &def = defs_[id];
+        if (def.group != group) {
+            continue;
+        }
+        size_t size = encodedSize(def);
+        if (def.type == SETTING_TYPE_STR) {
+            if (pos >= length || record_[pos] >= def.size) {
+                return false;
+            }
+            size = 1 + record_[pos];
+        }
+        if (pos + size > length) {
+            return false;
+        }
+        pos += size;
+    }
+    if (pos != length) {
+        return false;
+    }
+
+    pos = 0;
+    for (size_t id = 0; id < count_; id++) {
+        const SettingDef &def = defs_[id];
+        if (def.group != group) {
+            continue;
+        }
+        Entry &entry = entries_[id];
+        size_t size = def.type == SETTING_TYPE_STR ? 1 + record_[pos] : encodedSize(def);
+        if (!entry.dirty) {
+            if (def.type == SETTING_TYPE_STR) {
+                char *out = strings_ + entry.offset;
+                memcpy(out, record_ + pos + 1, size - 1);
+                out[size - 1] = '\0';
+            } else if (def.type == SETTING_TYPE_I32) {
+                memcpy(&entry.value, record_ + pos, sizeof(int32_t));
+            } else {
+                entry.value = record_[pos] != 0;
+            }
+            entry.state = STATE_STORED;
+        }
+        pos += size;
+    }
+    return true;
+}
+
+bool SettingsStore::readGroup(uint8_t group) {
+    Group &state = groups_[group];
+    const SettingGroupDef &def = group_defs_[group];
+    size_t length = sizeof(record_);
+    esp_err_t err = nvs_->readRecord(def.name, def.version, record_, length, state.record);
+    state.known = err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND || err == ESP_ERR_INVALID_CRC ||
+                  err == ESP_ERR_INVALID_VERSION || err == ESP_ERR_NVS_INVALID_LENGTH;
+    state.stored = err == ESP_OK && decodeGroup(group, length);
+    if (err == ESP_OK && !state.stored) {
+        ESP_LOGW(TAG, "Settings record %s is malformed, using defaults", def.name);
+    } else if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGW(TAG, "Settings record %s unreadable (%s)", def.name, esp_err_to_name(err));
+    }
+    return state.stored;
+}
+
+esp_err_t SettingsStore::writeGroup(uint8_t group) {
+    Group &state = groups_[group];
+    if (!state.known) {
+        // 不知道哪个槽位较新时不能写入，否则可能覆盖较新的记录
+        readGroup(group);
+        if (!state.known) {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    if (!state.stored) {
+        // 没有组记录时，尚未读取的项先从旧格式读取，避免整组写入时以默认值覆盖
+        for (size_t id = 0; id < count_; id++) {
+            if (defs_[id].group == group && entries_[id].state == STATE_UNKNOWN) {
+                readEntry(id, NVS_TYPE_ANY);
+            }
+        }
+    }
+    const SettingGroupDef &def = group_defs_[group];
+    size_t length = encodeGroup(group);
+    esp_err_t err = nvs_->writeRecord(def.name, def.version, record_, length, state.record);
+    if (err == ESP_OK) {
+        state.stored = true;
+    }
+    return err;
+}
+
+esp_err_t SettingsStore::load(NVSManager &nvs) {
+    SettingsLock lock(mutex_);
+    nvs_ = &nvs;
+    for (size_t id = 0; id < count_; id++) {
+        if (!entries_[id].dirty) {
+            setDefault(id);
+            entries_[id].state = STATE_UNKNOWN;
+            entries_[id].legacy = false;
+        }
+    }
+    loaded_ = 0;
+    for (uint8_t group = 1; group < group_count_ && group < SETTINGS_MAX_GROUPS; group++) {
+        if ((used_groups_ & (1u << group)) == 0 || !readGroup(group)) {
+            continue;
+        }
+        for (size_t id = 0; id < count_; id++) {
+            if (defs_[id].group == group && !entries_[id].dirty) {
+                loaded_++;
+            }
+        }
+    }
+    esp_err_t err = nvs.forEachKey([this](const char *key, nvs_type_t type) {
+        int id = find(key);
+        if (id < 0) {
+            return;
+        }
+        Entry &entry = entries_[id];
+        uint8_t group = defs_[id].group;
+        if (group != SETTING_GROUP_NONE && groups_[group].stored) {
+            entry.legacy = true; // 已有组记录，删除迁移时遗留的键
+            return;
+        }
+        if (entry.dirty && !entry.legacy) {
+            return; // 待写的项以缓存为准
+        }
+        if (type == NVS_TYPE_BLOB && entry.state == STATE_STORED) {
+            // 字符串和旧的 blob 并存时以字符串为准，写回时删除 blob
+            entry.legacy = true;
+            entry.dirty = true;
+            return;
+        }
+        bool first = entry.state == STATE_UNKNOWN;
+        if (readEntry(id, type) && first) {
+            loaded_++;
+        }
+    });
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to iterate NVS (%s), settings will be read on demand",
+                 esp_err_to_name(err));
+        return err;
+    }
+    bool erased = false;
+    for (size_t id = 0; id < count_; id++) {
+        Entry &entry = entries_[id];
+        if (entry.state == STATE_UNKNOWN) {
+            entry.state = STATE_DEFAULT;
+        }
+        if (entry.legacy && !entry.dirty && nvs.erase(defs_[id].key, false) == ESP_OK) {
+            entry.legacy = false;
+            erased = true;
+        }
+    }
+    if (erased) {
+        nvs.commit();
+    }
+    ESP_LOGI(TAG, "Loaded %d of %d settings", (int)loaded_, (int)count_);
+    // 迁移旧格式，以及 load() 前修改的项
+    return flushLocked();
+}
+
+// 未知的项在持锁后再确认一次，避免两个任务重复读取
+void SettingsStore::ensureLoaded(size_t id) {
+    if (entries_[id].state != STATE_UNKNOWN || nvs_ == nullptr) {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    SettingsLock lock(mutex_);
+    if (entries_[id].state == STATE_UNKNOWN) {
+        uint8_t group = defs_[id].group;
+        if (group == SETTING_GROUP_NONE || !readGroup(group)) {
+            readEntry(id, NVS_TYPE_ANY);
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+const char *SettingsStore::str(size_t id) {
+    if (!valid(id, SETTING_TYPE_STR)) {
+        return "";
+    }
+    ensureLoaded(id);
+    return strings_ + entries_[id].offset;
+}
+
+int32_t SettingsStore::i32(size_t id) {
+    if (!valid(id, SETTING_TYPE_I32)) {
+        return 0;
+    }
+    ensureLoaded(id);
+    return entries_[id].value;
+}
+
+bool SettingsStore::flag(size_t id) {
+    if (!valid(id, SETTING_TYPE_BOOL)) {
+        return false;
+    }
+    ensureLoaded(id);
+    return entries_[id].value != 0;
+}
+
+esp_err_t SettingsStore::set(size_t id, const char *value) {
+    if (!valid(id, SETTING_TYPE_STR) || value == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t len = strlen(value);
+    if (len >= defs_[id].size) {
+        ESP_LOGW(TAG, "Setting %s too long (max %d)", defs_[id].key, defs_[id].size - 1);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    SettingsLock lock(mutex_);
+    Entry &entry = entries_[id];
+    char *cached = strings_ + entry.offset;
+    if (entry.state != STATE_UNKNOWN && !entry.dirty && strcmp(cached, value) == 0) {
+        writes_avoided_++;
+        return ESP_OK;
+    }
+    memcpy(cached, value, len + 1);
+    return markDirty(id);
+}
+
+esp_err_t SettingsStore::set(size_t id, int32_t value) {
+    if (!valid(id, SETTING_TYPE_I32)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    SettingsLock lock(mutex_);
+    Entry &entry = entries_[id];
+    if (entry.state != STATE_UNKNOWN && !entry.dirty && entry.value == value) {
+        writes_avoided_++;
+        return ESP_OK;
+    }
+    entry.value = value;
+    return markDirty(id);
+}
+
+esp_err_t SettingsStore::set(size_t id, bool value) {
+    if (!valid(id, SETTING_TYPE_BOOL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    SettingsLock lock(mutex_);
+    Entry &entry = entries_[id];
+    if (entry.state != STATE_UNKNOWN && !entry.dirty && (entry.value != 0) == value) {
+        writes_avoided_++;
+        return ESP_OK;
+    }
+    entry.value = value;
+    return markDirty(id);
+}
+
+esp_err_t SettingsStore::markDirty(size_t id) {
+    entries_[id].state = STATE_STORED;
+    entries_[id].dirty = true;
+    return batch_ ? ESP_OK : flushLocked();
+}
+
+esp_err_t SettingsStore::flush() {
+    SettingsLock lock(mutex_);
+    return flushLocked();
+}
+
+bool SettingsStore::beginBatch() {
+    SettingsLock lock(mutex_);
+    if (batch_) {
+        ESP_LOGW(TAG, "Batch already in progress");
+        return false;
+    }
+    // 之前的修改先写入，失败的项随批量修改一起提交或回滚
+    if (nvs_ != nullptr) {
+        flushLocked();
+    }
+    batch_ = true;
+    return true;
+}
+
+esp_err_t SettingsStore::commitBatch() {
+    SettingsLock lock(mutex_);
+    if (!batch_) {
+        return ESP_OK;
+    }
+    batch_ = false;
+    return flushLocked();
+}
+
+void SettingsStore::rollbackBatch() {
+    SettingsLock lock(mutex_);
+    if (!batch_) {
+        return;
+    }
+    batch_ = false;
+    for (size_t id = 0; id < count_; id++) {
+        Entry &entry = entries_[id];
+        if (!entry.dirty) {
+            continue;
+        }
+        entry.dirty = false;
+        setDefault(id);
+        if (nvs_ != nullptr) {
+            entry.state = STATE_UNKNOWN; // 下次读取时从 NVS 恢复
+        }
+    }
+}
+
+esp_err_t SettingsStore::writeEntry(size_t id) {
+    const SettingDef &def = defs_[id];
+    Entry &entry = entries_[id];
+    if (entry.legacy) {
+        // 同名不同类型的条目在 NVS 中并存，先删除旧的 blob
+        esp_err_t err = nvs_->erase(def.key, false);
+        if (err != ESP_OK) {
+            return err;
+        }
+        entry.legacy = false;
+    }
+    switch (def.type) {
+        case SETTING_TYPE_STR:
+            return nvs_->set<const char *>(def.key, strings_ + entry.offset);
+        case SETTING_TYPE_I32:
+            return nvs_->set<int32_t>(def.key, entry.value);
+        default:
+            return nvs_->set<uint8_t>(def.key, entry.value != 0);
+    }
+}
+
+// 单独保存的项逐项写入后提交一次，每个组写入一条记录；失败的项保持待写
+esp_err_t SettingsStore::flushLocked() {
+    if (nvs_ == nullptr) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t result = ESP_OK;
+    bool written = false;
+    uint32_t groups = 0;
+    for (size_t id = 0; id < count_; id++) {
+        Entry &entry = entries_[id];
+        if (!entry.dirty) {
+            continue;
+        }
+        if (defs_[id].group != SETTING_GROUP_NONE) {
+            groups |= 1u << defs_[id].group;
+            continue;
+        }
+        esp_err_t err = writeEntry(id);
+        if (err != ESP_OK) {
+            failures_++;
+            result = err;
+            continue;
+        }
+        entry.dirty = false;
+        written = true;
+        writes_++;
+    }
+    if (written) {
+        esp_err_t err = nvs_->commit();
+        if (err != ESP_OK) {
+            failures_++;
+            result = err;
+        }
+    }
+
+    for (uint8_t group = 1; groups != 0; group++) {
+        if ((groups & (1u << group)) == 0) {
+            continue;
+        }
+        groups &= ~(1u << group);
+        esp_err_t err = writeGroup(group);
+        if (err != ESP_OK) {
+            failures_++;
+            result = err;
+            continue;
+        }
+        writes_++;
+        // 组记录写入后才删除旧格式的数据，删除失败时下次 load() 再删除
+        bool erased = false;
+        for (size_t id = 0; id < count_; id++) {
+            Entry &entry = entries_[id];
+            if (defs_[id].group != group) {
+                continue;
+            }
+            entry.dirty = false;
+            if (entry.legacy && nvs_->erase(defs_[id].key, false) == ESP_OK) {
+                entry.legacy = false;
+                erased = true;
+            }
+        }
+        if (erased) {
+            nvs_->commit();
+        }
+    }
+    return result;
+}
+
+int SettingsStore::find(std::string_view key) const {
+    for (size_t id = 0; id < count_; id++) {
+        if (key == defs_[id].key) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+SettingsStore::Stats SettingsStore::stats() const {
+    return {hits_.load(std::memory_order_relaxed), misses_.load(std::memory_order_relaxed),
+            loaded_, writes_, writes_avoided_, failures_};
+}
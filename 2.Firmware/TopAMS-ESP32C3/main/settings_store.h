@@ -0,0 +1,205 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs_manager.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+
+#define SETTINGS_MAX_COUNT 24   // 设置项数上限
+#define SETTINGS_MAX_GROUPS 8   // 设置组数上限 (含 SETTING_GROUP_NONE)
+#define SETTINGS_CACHE_SIZE 512 // 所有字符串设置项的缓存总字节数
+
+enum SettingType : uint8_t {
+    SETTING_TYPE_STR,
+    SETTING_TYPE_I32,
+    SETTING_TYPE_BOOL,
+};
+
+/**
+ * @brief 设置项的声明
+ */
+struct SettingDef {
+    const char *key; // NVS 键，组内的项用于迁移单独保存的旧数据
+    SettingType type;
+    uint16_t size;           // 字符串的最大长度 (含 '\0')，其他类型为 0
+    const char *default_str; // 字符串的默认值
+    int32_t default_int;     // 整数 / 布尔的默认值
+    uint8_t group;           // 所属的组，0 (SETTING_GROUP_NONE) 表示单独保存
+};
+
+/**
+ * @brief 设置组的声明，组内的项打包为一条记录 (NVSManager::writeRecord) 一起写入
+ */
+struct SettingGroupDef {
+    const char *name; // 记录名，不超过 NVS_RECORD_NAME_MAX
+    uint16_t version; // 组内的项增删或改变类型时递增，版本不同的记录视为不存在
+};
+
+// 固件的设置组和设置项编号，见 settings.def
+enum SettingGroupId : uint8_t {
+    SETTING_GROUP_NONE,
+#define SETTING_GROUP(name, record, version) SETTING_GROUP_##name,
+#define SETTING_STR(name, group, key, value, size)
+#define SETTING_I32(name, group, key, value)
+#define SETTING_BOOL(name, group, key, value)
+#include "settings.def"
+#undef SETTING_GROUP
+#undef SETTING_STR
+#undef SETTING_I32
+#undef SETTING_BOOL
+    SETTING_GROUP_COUNT,
+};
+
+enum SettingId : uint8_t {
+#define SETTING_GROUP(name, record, version)
+#define SETTING_STR(name, group, key, value, size) SETTING_##name,
+#define SETTING_I32(name, group, key, value) SETTING_##name,
+#define SETTING_BOOL(name, group, key, value) SETTING_##name,
+#include "settings.def"
+#undef SETTING_GROUP
+#undef SETTING_STR
+#undef SETTING_I32
+#undef SETTING_BOOL
+    SETTING_COUNT,
+};
+
+extern const SettingDef SETTING_DEFS[SETTING_COUNT];
+extern const SettingGroupDef SETTING_GROUPS[SETTING_GROUP_COUNT]; // [0] 为 SETTING_GROUP_NONE
+
+/**
+ * @brief 带缓存的类型化设置项
+ *
+ * 设置项在表中声明一次 (类型、默认值、长度)，缓存在定长的内存区中。load() 用 NVSManager
+ * 已打开的句柄遍历一次命名空间，逐个读取已声明的键，之后的读取只访问缓存；load() 未能
+ * 读到的项在首次读取时单独从 NVS 读取 (read-through)。写入先更新缓存并标记待写，
+ * 随即写入 NVS 并提交，失败时保持待写，由 flush() 重试；值未变化时不写入。
+ * 同一组的项 (如 Wi-Fi 的 SSID 和密码) 保存为一条带代数的记录，组内任一项修改时整组写入
+ * 另一个槽位，断电后读到的要么是旧的一组值，要么是新的一组值。需要同时修改多项时用
+ * beginBatch() / commitBatch()，每个组只写入一次。
+ * 读取返回指向缓存的指针，不分配内存；字符串指针在该项下次 set() 前有效。
+ * set() / flush() 之间互斥，读取已缓存的项不加锁。
+ */
+class SettingsStore {
+public:
+    struct Stats {
+        uint32_t hits;           // 从缓存读取
+        uint32_t misses;         // 读取时从 NVS 读取
+        uint32_t loaded;         // load() 读取的项数
+        uint32_t writes;         // 写入 NVS 的次数 (一个组计一次)
+        uint32_t writes_avoided; // 值未变化而跳过的写入
+        uint32_t failures;       // 写入失败次数
+    };
+
+    /**
+     * @param defs 设置项表和组表，须在对象的生命周期内有效；默认为 settings.def
+     */
+    explicit SettingsStore(const SettingDef *defs = SETTING_DEFS, size_t count = SETTING_COUNT,
+                           const SettingGroupDef *groups = SETTING_GROUPS,
+                           size_t group_count = SETTING_GROUP_COUNT);
+    ~SettingsStore();
+
+    /**
+     * @brief 遍历 NVS 填充缓存，NVS 中没有的项使用默认值
+     *
+     * 待写的项保留缓存中的值。旧版本以 blob 保存的字符串项改写为字符串，组内单独保存的
+     * 旧数据写入组记录，之后删除。
+     * @return 遍历失败时返回错误，各项改为首次读取时从 NVS 读取
+     */
+    esp_err_t load(NVSManager &nvs);
+
+    const char *str(size_t id);
+    int32_t i32(size_t id);
+    bool flag(size_t id);
+
+    /**
+     * @return ESP_ERR_INVALID_ARG 编号或类型不符，ESP_ERR_INVALID_SIZE 字符串过长，
+     *         其他为 NVS 写入错误 (缓存已更新，保持待写)
+     */
+    esp_err_t set(size_t id, const char *value);
+    esp_err_t set(size_t id, int32_t value);
+    esp_err_t set(size_t id, bool value);
+
+    /**
+     * @brief 写入所有待写的项并提交一次
+     */
+    esp_err_t flush();
+
+    /**
+     * @brief 开始批量修改
+     *
+     * 之后的 set() 只更新缓存，commitBatch() 时一起写入，每个组一条记录；rollbackBatch()
+     * 丢弃未写入的修改，各项重新从 NVS 读取。之前未写入的修改在开始时先写入。
+     * 同一时间只能有一个批量修改，期间其他任务的修改也会一并提交或回滚。
+     * @return false 已在批量修改中
+     */
+    bool beginBatch();
+    esp_err_t commitBatch();
+    void rollbackBatch();
+
+    /**
+     * @brief 按 NVS 键查找编号
+     * @return 不存在时返回 -1
+     */
+    int find(std::string_view key) const;
+
+    const SettingDef &def(size_t id) const { return defs_[id]; }
+    size_t count() const { return count_; }
+    Stats stats() const;
+
+private:
+    enum State : uint8_t {
+        STATE_UNKNOWN, // 尚未从 NVS 读取
+        STATE_STORED,  // 缓存与 NVS 中的值一致 (或待写)
+        STATE_DEFAULT, // NVS 中没有该键，缓存为默认值
+    };
+
+    struct Entry {
+        uint16_t offset; // 字符串在 strings_ 中的位置
+        State state;
+        bool dirty;
+        bool legacy;   // NVS 中有旧格式的数据 (blob / 组内单独的键)，写入后删除
+        int32_t value; // 整数 / 布尔
+    };
+
+    struct Group {
+        NVSManager::RecordState record;
+        bool known;  // 已读取过记录，record 可用于写入
+        bool stored; // NVS 中有当前版本的记录
+    };
+
+    const SettingDef *defs_;
+    size_t count_;
+    const SettingGroupDef *group_defs_;
+    size_t group_count_;
+    uint32_t used_groups_ = 0; // 有设置项的组
+    Entry entries_[SETTINGS_MAX_COUNT];
+    Group groups_[SETTINGS_MAX_GROUPS];
+    char strings_[SETTINGS_CACHE_SIZE];
+    uint8_t record_[NVS_RECORD_MAX]; // 组记录的编码 / 解码缓冲区，持锁使用
+    NVSManager *nvs_ = nullptr;
+    SemaphoreHandle_t mutex_;
+    bool batch_ = false;
+
+    std::atomic<uint32_t> hits_;
+    std::atomic<uint32_t> misses_;
+    uint32_t loaded_ = 0;
+    uint32_t writes_ = 0;
+    uint32_t writes_avoided_ = 0;
+    uint32_t failures_ = 0;
+
+    bool valid(size_t id, SettingType type) const;
+    void setDefault(size_t id);
+    bool readEntry(size_t id, nvs_type_t type);
+    void ensureLoaded(size_t id);
+    esp_err_t writeEntry(size_t id);
+    esp_err_t flushLocked();
+    static size_t encodedSize(const SettingDef &def);
+    bool readGroup(uint8_t group);
+    bool decodeGroup(uint8_t group, size_t length);
+    size_t encodeGroup(uint8_t group);
+    esp_err_t writeGroup(uint8_t group);
+    esp_err_t markDirty(size_t id);
+};
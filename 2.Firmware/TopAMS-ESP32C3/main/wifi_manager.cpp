@@ -2,14 +2,16 @@
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "esp_smartconfig.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "freertos/FreeRTOS.h"
 #include <stdlib.h>
 #include <string.h>
 
 #include "instance.h"
-#include "nvs_manager.h"
+#include "settings_store.h"
 #include "wifi_manager.h"
+#include "ws_frame.h"
 
 /* FreeRTOS event group to signal when we are connected & ready to make a request */
 EventGroupHandle_t WifiManager::s_wifi_event_group = nullptr;
@@ -23,15 +25,162 @@ static const char *TAG = "[SmartConfig]";
 
 WifiManager::WifiManager() {}
 
+// 点分十进制的 IPv4 地址
+static bool parse_ip(const char *text, esp_ip4_addr_t &out) {
+    return text != nullptr && text[0] != '\0' && esp_netif_str_to_ip4(text, &out) == ESP_OK;
+}
+
+static long elapsed_ms(int64_t us) { return static_cast<long>(us / 1000); }
+
+void WifiManager::loadApCache() {
+    WifiApCache ap;
+    size_t length = sizeof(ap);
+    esp_err_t err = Instance::get().nvs_manager->readRecord(WIFI_AP_RECORD, WIFI_AP_VERSION, &ap,
+                                                            length, ap_record_);
+    ap_valid_ = err == ESP_OK && length == sizeof(ap) && memchr(ap.ssid, '\0', sizeof(ap.ssid)) &&
+                ap.channel >= 1 && ap.channel <= 14;
+    if (ap_valid_) {
+        ap_ = ap;
+    }
+}
+
+void WifiManager::saveApCache(const wifi_event_sta_connected_t &event) {
+    WifiApCache ap = {};
+    memcpy(ap.ssid, event.ssid, event.ssid_len < 32 ? event.ssid_len : 32);
+    memcpy(ap.bssid, event.bssid, sizeof(ap.bssid));
+    ap.channel = event.channel;
+    if (ap_valid_ && memcmp(&ap, &ap_, sizeof(ap)) == 0) {
+        return; // 同一个 AP，不重复写入
+    }
+    esp_err_t err = Instance::get().nvs_manager->writeRecord(WIFI_AP_RECORD, WIFI_AP_VERSION, &ap,
+                                                             sizeof(ap), ap_record_);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save AP: %s", esp_err_to_name(err));
+        return;
+    }
+    ap_ = ap;
+    ap_valid_ = true;
+    ESP_LOGI(TAG, "Saved AP " MACSTR " on channel %u", MAC2STR(ap.bssid), ap.channel);
+}
+
+void WifiManager::configure(const char *ssid, const char *password) {
+    wifi_config_t wifi_config;
+    memset(&wifi_config, 0, sizeof(wifi_config));
+    strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid));
+    strncpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password));
+    // 只扫描保存的信道，找到该 BSSID 即关联；否则扫描全部信道，连接信号最强的 AP
+    fast_ = ap_valid_ && strcmp(ap_.ssid, ssid) == 0;
+    if (fast_) {
+        wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, ap_.bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.channel = ap_.channel;
+        ESP_LOGI(TAG, "Fast connect to " MACSTR " on channel %u", MAC2STR(ap_.bssid),
+                 ap_.channel);
+    } else {
+        wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    }
+    failures_ = 0;
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+}
+
+void WifiManager::applyStaticIp() {
+    SettingsStore &settings = *Instance::get().settings;
+    const char *ip = settings.str(SETTING_STATIC_IP);
+    if (ip[0] == '\0') {
+        if (boot_.static_ip) {
+            esp_netif_dhcpc_start(sta_netif_);
+            boot_.static_ip = false;
+        }
+        return;
+    }
+    esp_netif_ip_info_t info = {};
+    esp_netif_dns_info_t dns = {};
+    const char *dns_text = settings.str(SETTING_STATIC_DNS);
+    if (!parse_ip(ip, info.ip) || !parse_ip(settings.str(SETTING_STATIC_NETMASK), info.netmask) ||
+        !parse_ip(settings.str(SETTING_STATIC_GATEWAY), info.gw) ||
+        (dns_text[0] != '\0' && !parse_ip(dns_text, dns.ip.u_addr.ip4))) {
+        ESP_LOGE(TAG, "Invalid static IP settings, using DHCP");
+        return;
+    }
+    if (dns_text[0] == '\0') {
+        dns.ip.u_addr.ip4 = info.gw;
+    }
+    dns.ip.type = ESP_IPADDR_TYPE_V4;
+    // DHCP 未启动时返回错误，可以忽略
+    esp_netif_dhcpc_stop(sta_netif_);
+    if (esp_netif_set_ip_info(sta_netif_, &info) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set static IP, using DHCP");
+        esp_netif_dhcpc_start(sta_netif_);
+        return;
+    }
+    esp_netif_set_dns_info(sta_netif_, ESP_NETIF_DNS_MAIN, &dns);
+    boot_.static_ip = true;
+    ESP_LOGI(TAG, "Static IP %s", ip);
+}
+
+void WifiManager::startSmartconfig() {
+    if (smartconfig_) {
+        return;
+    }
+    smartconfig_ = true;
+    if (xTaskCreate(WifiManager::smartconfig_task, "smartconfig_example_task", 4096, this, 3,
+                    NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create smartconfig task");
+        smartconfig_ = false;
+    }
+}
+
+void WifiManager::onDisconnected() {
+    xEventGroupClearBits(s_wifi_event_group, CONNECTED_BIT);
+    failures_++;
+    if (fast_ && failures_ >= WIFI_FAST_CONNECT_ATTEMPTS) {
+        // AP 换了信道或已更换，清除 BSSID 和信道重新扫描，连接后保存新的 AP
+        ESP_LOGW(TAG, "Saved AP not reachable, scanning all channels");
+        wifi_config_t wifi_config;
+        if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK) {
+            wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+            wifi_config.sta.bssid_set = false;
+            wifi_config.sta.channel = 0;
+            esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+        }
+        fast_ = false;
+        failures_ = 0;
+        if (boot_.fallbacks < UINT8_MAX) {
+            boot_.fallbacks++;
+        }
+    } else if (!fast_ && failures_ >= WIFI_SMARTCONFIG_AFTER_FAILURES) {
+        // 保存的 SSID 或密码可能已失效，同时允许重新配网
+        startSmartconfig();
+    }
+    esp_wifi_connect();
+}
+
 void WifiManager::event_handler(void *arg, esp_event_base_t event_base, int32_t event_id,
                                 void *event_data) {
+    WifiManager *self = static_cast<WifiManager *>(arg);
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        xTaskCreate(WifiManager::smartconfig_task, "smartconfig_example_task", 4096, NULL, 3, NULL);
+        if (Instance::get().settings->str(SETTING_WIFI_SSID)[0] == '\0') {
+            self->startSmartconfig();
+        }
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        self->failures_ = 0;
+        if (self->boot_.connect_us == 0) {
+            self->boot_.connect_us = esp_timer_get_time();
+        }
+        self->saveApCache(*static_cast<wifi_event_sta_connected_t *>(event_data));
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        esp_wifi_connect();
-        xEventGroupClearBits(s_wifi_event_group, CONNECTED_BIT);
+        self->onDisconnected();
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         xEventGroupSetBits(s_wifi_event_group, CONNECTED_BIT);
+        BootStats &boot = self->boot_;
+        if (boot.ip_us == 0) {
+            boot.ip_us = esp_timer_get_time();
+            ESP_LOGI(TAG, "Boot: associated at %ld ms, IP at %ld ms (%s, %u fallbacks, %s)",
+                     elapsed_ms(boot.connect_us), elapsed_ms(boot.ip_us),
+                     boot.fast ? "saved AP" : "full scan", boot.fallbacks,
+                     boot.static_ip ? "static IP" : "DHCP");
+        }
     } else if (event_base == SC_EVENT && event_id == SC_EVENT_SCAN_DONE) {
         ESP_LOGI(TAG, "Scan done");
     } else if (event_base == SC_EVENT && event_id == SC_EVENT_FOUND_CHANNEL) {
@@ -41,8 +190,8 @@ void WifiManager::event_handler(void *arg, esp_event_base_t event_base, int32_t
 
         smartconfig_event_got_ssid_pswd_t *evt = (smartconfig_event_got_ssid_pswd_t *)event_data;
         wifi_config_t wifi_config;
-        char ssid[32] = {0};
-        char password[64] = {0};
+        char ssid[33] = {0}; // evt->ssid 不含结尾 '\0'
+        char password[65] = {0};
         uint8_t rvd_data[33] = {0};
 
         bzero(&wifi_config, sizeof(wifi_config_t));
@@ -63,10 +212,7 @@ void WifiManager::event_handler(void *arg, esp_event_base_t event_base, int32_t
         ESP_LOGI(TAG, "SSID:%s", ssid);
         ESP_LOGI(TAG, "PASSWORD:%s", password);
         // Save to NVS
-        auto nvs = Instance::get().nvs_manager;
-        nvs->set("wifi_ssid", ssid);
-        nvs->set("wifi_pass", password);
-        nvs->commit();
+        Instance::get().wifi_manager->set_credentials(ssid, password);
         if (evt->type == SC_TYPE_ESPTOUCH_V2) {
             ESP_ERROR_CHECK(esp_smartconfig_get_rvd_data(rvd_data, sizeof(rvd_data)));
             ESP_LOGI(TAG, "RVD_DATA:");
@@ -78,6 +224,8 @@ void WifiManager::event_handler(void *arg, esp_event_base_t event_base, int32_t
 
         ESP_ERROR_CHECK(esp_wifi_disconnect());
         ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+        self->fast_ = false;
+        self->failures_ = 0;
         esp_wifi_connect();
     } else if (event_base == SC_EVENT && event_id == SC_EVENT_SEND_ACK_DONE) {
         xEventGroupSetBits(s_wifi_event_group, ESPTOUCH_DONE_BIT);
@@ -86,46 +234,42 @@ void WifiManager::event_handler(void *arg, esp_event_base_t event_base, int32_t
 
 void WifiManager::init() {
     s_wifi_event_group = xEventGroupCreate();
-    esp_netif_t *sta_netif = esp_netif_create_default_wifi_sta();
-    assert(sta_netif);
+    sta_netif_ = esp_netif_create_default_wifi_sta();
+    assert(sta_netif_);
 
-    char ssid[32] = {0};
-    char password[64] = {0};
-    auto nvs = Instance::get().nvs_manager;
-    bool nvs_ok = false;
+    auto settings = Instance::get().settings;
+    const char *ssid = settings->str(SETTING_WIFI_SSID);
+    const char *password = settings->str(SETTING_WIFI_PASS);
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
-                                               &WifiManager::event_handler, NULL));
+                                               &WifiManager::event_handler, this));
     ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
-                                               &WifiManager::event_handler, NULL));
+                                               &WifiManager::event_handler, this));
     ESP_ERROR_CHECK(
-        esp_event_handler_register(SC_EVENT, ESP_EVENT_ANY_ID, &WifiManager::event_handler, NULL));
+        esp_event_handler_register(SC_EVENT, ESP_EVENT_ANY_ID, &WifiManager::event_handler, this));
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
 
-    if (nvs->get("wifi_ssid", ssid) == ESP_OK && nvs->get("wifi_pass", password) == ESP_OK) {
+    if (ssid[0] != '\0') {
         ESP_LOGI(TAG, "Find SSID and password in NVS");
         ESP_LOGI(TAG, "SSID: %s", ssid);
-        ESP_LOGI(TAG, "Password: %s", password);
-        wifi_config_t wifi_config;
-        memset(&wifi_config, 0, sizeof(wifi_config));
-        strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid));
-        strncpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password));
-        ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-        ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+        loadApCache();
+        applyStaticIp();
+        configure(ssid, password);
+        boot_.fast = fast_;
         ESP_ERROR_CHECK(esp_wifi_start());
+        boot_.start_us = esp_timer_get_time();
         ESP_ERROR_CHECK(esp_wifi_connect());
-        nvs_ok = true;
-    }
-    if (!nvs_ok) {
+    } else {
+        // 如果 NVS 中没有 SSID 和密码，则在 STA_START 时开始 SmartConfig
         ESP_LOGI(TAG, "No SSID and password in NVS, start smartconfig");
-        // 如果 NVS 中没有 SSID 和密码，则开始 SmartConfig
-        ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
         ESP_ERROR_CHECK(esp_wifi_start());
     }
 }
 
 void WifiManager::smartconfig_task(void *parm) {
+    WifiManager *self = static_cast<WifiManager *>(parm);
     EventBits_t uxBits;
     ESP_ERROR_CHECK(esp_smartconfig_set_type(SC_TYPE_ESPTOUCH));
     smartconfig_start_config_t cfg = SMARTCONFIG_START_CONFIG_DEFAULT();
@@ -139,6 +283,8 @@ void WifiManager::smartconfig_task(void *parm) {
         if (uxBits & ESPTOUCH_DONE_BIT) {
             ESP_LOGI(TAG, "smartconfig over");
             esp_smartconfig_stop();
+            // 之后连续连接失败时可以再次启动
+            self->smartconfig_ = false;
             vTaskDelete(NULL);
         }
     }
@@ -157,15 +303,51 @@ bool WifiManager::is_connected() {
 }
 
 bool WifiManager::set_ssid(const char *ssid) {
-    auto nvs = Instance::get().nvs_manager;
-    nvs->set("wifi_ssid", ssid);
-    return nvs->commit() == ESP_OK;
+    return Instance::get().settings->set(SETTING_WIFI_SSID, ssid) == ESP_OK;
 }
 
 bool WifiManager::set_password(const char *password) {
-    auto nvs = Instance::get().nvs_manager;
-    nvs->set("wifi_pass", password);
-    return nvs->commit() == ESP_OK;
+    return Instance::get().settings->set(SETTING_WIFI_PASS, password) == ESP_OK;
+}
+
+bool WifiManager::set_credentials(const char *ssid, const char *password) {
+    SettingsStore &settings = *Instance::get().settings;
+    // 其他批量修改进行中时不能加入，否则失败时的回滚会丢弃对方的修改
+    if (!settings.beginBatch()) {
+        ESP_LOGW(TAG, "Settings batch in progress, WiFi settings not saved");
+        return false;
+    }
+    if (settings.set(SETTING_WIFI_SSID, ssid) != ESP_OK ||
+        settings.set(SETTING_WIFI_PASS, password) != ESP_OK) {
+        settings.rollbackBatch();
+        return false;
+    }
+    return settings.commitBatch() == ESP_OK;
+}
+
+bool WifiManager::set_static_ip(const char *ip, const char *netmask, const char *gateway,
+                                const char *dns) {
+    esp_ip4_addr_t addr;
+    bool dhcp = ip == nullptr || ip[0] == '\0';
+    if (dhcp) {
+        ip = netmask = gateway = dns = "";
+    } else if (!parse_ip(ip, addr) || !parse_ip(netmask, addr) || !parse_ip(gateway, addr) ||
+               (dns != nullptr && dns[0] != '\0' && !parse_ip(dns, addr))) {
+        return false;
+    }
+    SettingsStore &settings = *Instance::get().settings;
+    if (!settings.beginBatch()) {
+        ESP_LOGW(TAG, "Settings batch in progress, WiFi settings not saved");
+        return false;
+    }
+    if (settings.set(SETTING_STATIC_IP, ip) != ESP_OK ||
+        settings.set(SETTING_STATIC_NETMASK, netmask) != ESP_OK ||
+        settings.set(SETTING_STATIC_GATEWAY, gateway) != ESP_OK ||
+        settings.set(SETTING_STATIC_DNS, dns != nullptr ? dns : "") != ESP_OK) {
+        settings.rollbackBatch();
+        return false;
+    }
+    return settings.commitBatch() == ESP_OK;
 }
 
 bool WifiManager::reconnect() {
@@ -174,17 +356,14 @@ bool WifiManager::reconnect() {
         ESP_ERROR_CHECK(esp_wifi_disconnect());
         vTaskDelay(pdMS_TO_TICKS(1000)); // 等待一段时间
     }
-    char ssid[32] = {0};
-    char password[64] = {0};
-    auto nvs = Instance::get().nvs_manager;
-    if (nvs->get("wifi_ssid", ssid) == ESP_OK && nvs->get("wifi_pass", password) == ESP_OK) {
+    auto settings = Instance::get().settings;
+    const char *ssid = settings->str(SETTING_WIFI_SSID);
+    const char *password = settings->str(SETTING_WIFI_PASS);
+    if (ssid[0] != '\0') {
         ESP_LOGI(TAG, "Reconnecting with SSID: %s", ssid);
-        wifi_config_t wifi_config;
-        memset(&wifi_config, 0, sizeof(wifi_config));
-        strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid));
-        strncpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password));
         ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-        ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+        applyStaticIp();
+        configure(ssid, password);
         ESP_ERROR_CHECK(esp_wifi_start());
         ESP_ERROR_CHECK(esp_wifi_connect());
         return true;
@@ -193,3 +372,89 @@ bool WifiManager::reconnect() {
         return false;
     }
 }
+
+template <typename Enc>
+static void handle_wifi_ssid(void *ctx, const WSArgs &args, Enc &response) {
+    if (static_cast<WifiManager *>(ctx)->set_ssid(args.str(0))) {
+        response.beginMap().key(WS_KEY_success).boolean(true).end();
+    } else {
+        ws_write_error(response, "Failed to save WiFi SSID");
+    }
+}
+
+template <typename Enc>
+static void handle_wifi_password(void *ctx, const WSArgs &args, Enc &response) {
+    if (static_cast<WifiManager *>(ctx)->set_password(args.str(0))) {
+        response.beginMap().key(WS_KEY_success).boolean(true).end();
+    } else {
+        ws_write_error(response, "Failed to save WiFi password");
+    }
+}
+
+template <typename Enc>
+static void handle_wifi(void *ctx, const WSArgs &args, Enc &response) {
+    if (static_cast<WifiManager *>(ctx)->set_credentials(args.str(0), args.str(1))) {
+        response.beginMap().key(WS_KEY_success).boolean(true).end();
+    } else {
+        ws_write_error(response, "Failed to save WiFi credentials");
+    }
+}
+
+template <typename Enc>
+static void handle_static_ip(void *ctx, const WSArgs &args, Enc &response) {
+    if (static_cast<WifiManager *>(ctx)->set_static_ip(args.str(0), args.str(1), args.str(2),
+                                                       args.str(3))) {
+        response.beginMap().key(WS_KEY_success).boolean(true);
+        response.key(WS_KEY_message).str("Applied on next reconnect").end();
+    } else {
+        ws_write_error(response, "Invalid or unsaved static IP");
+    }
+}
+
+template <typename Enc>
+static void handle_reconnect(void *ctx, const WSArgs &args, Enc &response) {
+    if (static_cast<WifiManager *>(ctx)->reconnect()) {
+        response.beginMap().key(WS_KEY_success).boolean(true);
+        response.key(WS_KEY_message).str("Reconnecting to WiFi...").end();
+    } else {
+        ws_write_error(response, "Failed to initiate WiFi reconnection");
+    }
+}
+
+static const WSParam SETTING_PARAMS[] = {
+    {"value", WS_PARAM_STRING, true},
+};
+
+// {"type": "setting", "key": "wifi", "ssid": "...", "password": "..."}
+static const WSParam WIFI_PARAMS[] = {
+    {"ssid", WS_PARAM_STRING, true},
+    {"password", WS_PARAM_STRING, true},
+};
+
+// {"type": "setting", "key": "static_ip", "ip": "192.168.1.50", "netmask": "255.255.255.0",
+//  "gateway": "192.168.1.1", "dns": "192.168.1.1"}，ip 为空时改回 DHCP
+static const WSParam STATIC_IP_PARAMS[] = {
+    {"ip", WS_PARAM_STRING, true},
+    {"netmask", WS_PARAM_STRING, false},
+    {"gateway", WS_PARAM_STRING, false},
+    {"dns", WS_PARAM_STRING, false},
+};
+
+static const WSCommand SETTING_COMMANDS[] = {
+    {"wifi_ssid", WS_HANDLER(handle_wifi_ssid), WS_PARAMS(SETTING_PARAMS)},
+    {"wifi_password", WS_HANDLER(handle_wifi_password), WS_PARAMS(SETTING_PARAMS)},
+    {"wifi", WS_HANDLER(handle_wifi), WS_PARAMS(WIFI_PARAMS)},
+    {"static_ip", WS_HANDLER(handle_static_ip), WS_PARAMS(STATIC_IP_PARAMS)},
+};
+
+static const WSCommand SYSTEM_COMMANDS[] = {
+    {"reconnect_wifi", WS_HANDLER(handle_reconnect), nullptr, 0},
+};
+
+bool WifiManager::registerCommands(WSDispatcher &dispatcher) {
+    static const WSModule settings = {"setting", "key", "Unknown setting key", SETTING_COMMANDS,
+                                      sizeof(SETTING_COMMANDS) / sizeof(SETTING_COMMANDS[0])};
+    static const WSModule system = {"system", "action", nullptr, SYSTEM_COMMANDS,
+                                    sizeof(SYSTEM_COMMANDS) / sizeof(SYSTEM_COMMANDS[0])};
+    return dispatcher.add(settings, this) && dispatcher.add(system, this);
+}
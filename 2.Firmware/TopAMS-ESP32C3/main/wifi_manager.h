@@ -1,9 +1,42 @@
 #pragma once
 
 #include "esp_event.h" // IWYU pragma: keep
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "nvs_manager.h"
+#include "ws_dispatch.h"
+#include <stdint.h>
+
+#define WIFI_AP_RECORD "wifi_ap"
+#define WIFI_AP_VERSION 1 // WifiApCache 的布局改变时递增
+// 指定 BSSID 和信道连续失败该次数后清除，改为全信道扫描
+#define WIFI_FAST_CONNECT_ATTEMPTS 2
+// 已保存 SSID 时，全信道扫描连续失败该次数后才启动 SmartConfig (其信道切换会拖慢连接)
+#define WIFI_SMARTCONFIG_AFTER_FAILURES 5
+
+/**
+ * @brief 上次连接的 AP，下次启动时直接在该信道连接该 BSSID，省去全信道扫描
+ */
+struct WifiApCache {
+    char ssid[33]; // 只在与设置项 SETTING_WIFI_SSID 相同时使用
+    uint8_t bssid[6];
+    uint8_t channel;
+};
 
 class WifiManager {
 public:
+    /**
+     * @brief 启动到连接的各时间点 (esp_timer，自启动起的微秒)，未到达时为 0
+     */
+    struct BootStats {
+        bool fast;          // 本次启动使用了保存的 BSSID 和信道
+        bool static_ip;     // 使用静态 IP，不等待 DHCP
+        uint8_t fallbacks;  // 快速连接失败后改为全信道扫描的次数
+        int64_t start_us;   // esp_wifi_connect()
+        int64_t connect_us; // 与 AP 关联
+        int64_t ip_us;      // 取得 IP
+    };
+
     WifiManager();
     void init();
 
@@ -13,9 +46,47 @@ public:
 
     bool set_password(const char *password);
 
+    /**
+     * @brief 同时保存 SSID 和密码，断电后不会只保存了其中一个
+     */
+    bool set_credentials(const char *ssid, const char *password);
+
+    /**
+     * @brief 保存静态 IP (SETTING_STATIC_*)，下次连接时生效
+     * @param ip 为空时改回 DHCP，其余参数忽略
+     * @param dns 可以为空，此时使用网关
+     * @return false 地址格式错误或保存失败
+     */
+    bool set_static_ip(const char *ip, const char *netmask, const char *gateway,
+                       const char *dns);
+
     bool reconnect();
 
+    BootStats bootStats() const { return boot_; }
+
+    /**
+     * @brief 注册 setting (wifi_ssid / wifi_password / wifi / static_ip) 和
+     *        system.reconnect_wifi 命令
+     */
+    bool registerCommands(WSDispatcher &dispatcher);
+
 private:
+    esp_netif_t *sta_netif_ = nullptr;
+    WifiApCache ap_ = {};
+    bool ap_valid_ = false;
+    NVSManager::RecordState ap_record_;
+    bool fast_ = false; // 当前配置指定了 BSSID 和信道
+    uint8_t failures_ = 0;
+    volatile bool smartconfig_ = false; // SmartConfig 任务运行中
+    BootStats boot_ = {};
+
+    void loadApCache();
+    void saveApCache(const wifi_event_sta_connected_t &event);
+    void configure(const char *ssid, const char *password);
+    void applyStaticIp();
+    void startSmartconfig();
+    void onDisconnected();
+
     static void event_handler(void *arg, esp_event_base_t event_base, int32_t event_id,
                               void *event_data);
     static void smartconfig_task(void *parm);
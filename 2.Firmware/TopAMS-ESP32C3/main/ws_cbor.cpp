@@ -0,0 +1,67 @@
+#include "ws_cbor.h"
+#include <math.h>
+#include <string.h>
+
+CborWriter &CborWriter::put(uint8_t b) {
+    if (len_ < size_) {
+        buf_[len_++] = b;
+    } else {
+        overflow_ = true;
+    }
+    return *this;
+}
+
+CborWriter &CborWriter::raw(const void *data, size_t len) {
+    if (size_ - len_ < len) {
+        overflow_ = true;
+        return *this;
+    }
+    memcpy(buf_ + len_, data, len);
+    len_ += len;
+    return *this;
+}
+
+// 参数按最短的形式编码
+CborWriter &CborWriter::head(uint8_t major, uint64_t arg) {
+    major <<= 5;
+    if (arg < 24) {
+        return put(major | arg);
+    }
+    int bytes = arg <= 0xFF ? 1 : arg <= 0xFFFF ? 2 : arg <= 0xFFFFFFFFu ? 4 : 8;
+    put(major | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27));
+    for (int i = bytes - 1; i >= 0; i--) {
+        put(static_cast<uint8_t>(arg >> (i * 8)));
+    }
+    return *this;
+}
+
+CborWriter &CborWriter::key(std::string_view name) {
+    WSKey id = ws_key_find(name);
+    return id != WS_KEY_NONE ? key(id) : str(name);
+}
+
+CborWriter &CborWriter::str(std::string_view s) {
+    return head(3, s.size()).raw(s.data(), s.size());
+}
+
+CborWriter &CborWriter::num(int64_t v) {
+    return v >= 0 ? head(0, static_cast<uint64_t>(v)) : head(1, static_cast<uint64_t>(-1 - v));
+}
+
+CborWriter &CborWriter::decimal(float v) {
+    float tenths = roundf(v * 10) / 10;
+    if (tenths == truncf(tenths) && fabsf(tenths) < 2147483648.0f) {
+        return num(static_cast<int64_t>(tenths));
+    }
+    return real(tenths);
+}
+
+CborWriter &CborWriter::real(float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    put(0xFA);
+    for (int i = 3; i >= 0; i--) {
+        put(static_cast<uint8_t>(bits >> (i * 8)));
+    }
+    return *this;
+}
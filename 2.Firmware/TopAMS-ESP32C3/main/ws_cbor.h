@@ -0,0 +1,49 @@
+#pragma once
+
+#include "ws_schema.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+
+/**
+ * @brief 写入定长缓冲区的 CBOR 编码器 (RFC 8949)，接口与 WSJsonWriter 相同
+ *
+ * 对象和数组使用不定长编码 (0xBF / 0x9F ... 0xFF)，写入前不需要知道成员数，
+ * 因此可以像 JSON 一样流式输出。ws_schema.def 中的键写为整数编号，其余键写为文本。
+ * 溢出时 ok() 返回 false，之后的写入被忽略。
+ */
+class CborWriter {
+public:
+    CborWriter(char *buf, size_t size) : buf_(reinterpret_cast<uint8_t *>(buf)), size_(size) {}
+
+    CborWriter &beginMap() { return put(0xBF); }
+    CborWriter &beginArray() { return put(0x9F); }
+    CborWriter &end() { return put(0xFF); }
+    CborWriter &key(WSKey id) { return head(0, id); }
+    CborWriter &key(std::string_view name);
+    CborWriter &str(std::string_view s);
+    CborWriter &num(int64_t v);
+    CborWriter &decimal(float v); // 整数值写为整数，否则写为单精度浮点数
+    CborWriter &real(float v);
+    CborWriter &boolean(bool v) { return put(v ? 0xF5 : 0xF4); }
+    CborWriter &null() { return put(0xF6); }
+
+    /**
+     * @brief 写入文本串的头部，之后用 raw() 写入 len 字节内容
+     */
+    CborWriter &textHead(size_t len) { return head(3, len); }
+    CborWriter &raw(const void *data, size_t len);
+
+    const char *data() const { return reinterpret_cast<const char *>(buf_); }
+    size_t length() const { return len_; }
+    bool ok() const { return !overflow_; }
+
+private:
+    CborWriter &put(uint8_t b);
+    CborWriter &head(uint8_t major, uint64_t arg);
+
+    uint8_t *buf_;
+    size_t size_;
+    size_t len_ = 0;
+    bool overflow_ = false;
+};
@@ -0,0 +1,190 @@
+#include "ws_dispatch.h"
+#include "esp_log.h"
+#include "json_stream.h"
+#include <stdio.h>
+#include <string.h>
+#include <type_traits>
+
+static const char *TAG = "[WSDispatch]";
+
+int WSArgs::toInt(size_t i, int fallback) const {
+    int out;
+    return value(i).toInt(out) ? out : fallback;
+}
+
+bool WSArgs::toBool(size_t i, bool fallback) const {
+    bool out;
+    return value(i).toBool(out) ? out : fallback;
+}
+
+bool WSArgs::bind(const WSJsonValue &object, const WSParam *params, uint8_t count) {
+    root = object;
+    for (uint8_t i = 0; i < count; i++) {
+        const WSParam &param = params[i];
+        WSJsonValue value = object[param.name];
+        bool valid;
+        switch (param.type) {
+            case WS_PARAM_STRING:
+                valid = value.isString();
+                break;
+            case WS_PARAM_INT:
+                valid = value.isNumber();
+                break;
+            case WS_PARAM_BOOL:
+                valid = value.type() == WS_JSON_BOOL;
+                break;
+            case WS_PARAM_ARRAY:
+                valid = value.isArray();
+                break;
+            default:
+                valid = value.isObject();
+                break;
+        }
+        if (!valid && (param.required || value)) {
+            return false;
+        }
+        values_[i] = valid ? value : WSJsonValue();
+    }
+    return true;
+}
+
+WSDispatcher::WSDispatcher() : types_{}, entries_{}, type_count_(0), command_count_(0) {}
+
+uint32_t WSDispatcher::commandHash(std::string_view type, std::string_view action) {
+    return json_path_hash(action, json_path_hash(".", json_path_hash(type)));
+}
+
+const WSDispatcher::Type *WSDispatcher::findType(std::string_view name) const {
+    uint32_t hash = json_path_hash(name);
+    for (size_t i = 0; i < type_count_; i++) {
+        if (types_[i].hash == hash && name == types_[i].name) {
+            return &types_[i];
+        }
+    }
+    return nullptr;
+}
+
+// 二分查找第一个不小于 hash 的位置，哈希相同的相邻项逐个比较名称
+const WSDispatcher::Entry *WSDispatcher::findCommand(const Type &type,
+                                                     std::string_view action) const {
+    uint32_t hash = commandHash(type.name, action);
+    size_t lo = 0;
+    size_t hi = command_count_;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (entries_[mid].hash < hash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (; lo < command_count_ && entries_[lo].hash == hash; lo++) {
+        if (entries_[lo].type == &type && action == entries_[lo].command->action) {
+            return &entries_[lo];
+        }
+    }
+    return nullptr;
+}
+
+bool WSDispatcher::add(const WSModule &module, void *ctx) {
+    const Type *type = findType(module.type);
+    if (type != nullptr) {
+        bool same = type->selector == module.selector ||
+                    (type->selector && module.selector &&
+                     strcmp(type->selector, module.selector) == 0);
+        if (!same) {
+            ESP_LOGE(TAG, "Selector mismatch for type %s", module.type);
+            return false;
+        }
+    } else if (type_count_ >= WS_DISPATCH_MAX_TYPES) {
+        ESP_LOGE(TAG, "Too many types, %s not registered", module.type);
+        return false;
+    }
+    if (command_count_ + module.count > WS_DISPATCH_MAX_COMMANDS) {
+        ESP_LOGE(TAG, "Too many commands, %s not registered", module.type);
+        return false;
+    }
+    for (size_t i = 0; i < module.count; i++) {
+        const WSCommand &command = module.commands[i];
+        bool duplicate = type != nullptr && findCommand(*type, command.action) != nullptr;
+        for (size_t j = 0; j < i && !duplicate; j++) {
+            duplicate = strcmp(module.commands[j].action, command.action) == 0;
+        }
+        if (duplicate || command.param_count > WS_DISPATCH_MAX_PARAMS) {
+            ESP_LOGE(TAG, "Invalid command %s.%s", module.type, command.action);
+            return false;
+        }
+    }
+
+    if (type == nullptr) {
+        Type &added = types_[type_count_++];
+        added = {json_path_hash(module.type), module.type, module.selector, module.unknown_error};
+        type = &added;
+    }
+    // 插入排序，注册只在启动时进行
+    for (size_t i = 0; i < module.count; i++) {
+        Entry entry = {commandHash(module.type, module.commands[i].action), type,
+                       &module.commands[i], ctx};
+        size_t pos = command_count_++;
+        while (pos > 0 && entries_[pos - 1].hash > entry.hash) {
+            entries_[pos] = entries_[pos - 1];
+            pos--;
+        }
+        entries_[pos] = entry;
+    }
+    return true;
+}
+
+template <typename Enc>
+void WSDispatcher::handle(void *ctx, int fd, const WSJsonValue &request, Enc &response) {
+    static_cast<const WSDispatcher *>(ctx)->dispatch(fd, request, response);
+}
+
+template <typename Enc>
+void WSDispatcher::dispatch(int fd, const WSJsonValue &request, Enc &response) const {
+    WSJsonValue type_value = request["type"];
+    if (!type_value.isString()) {
+        ws_write_error(response, "Missing or invalid action");
+        return;
+    }
+    const Type *type = findType(type_value.view());
+    if (type == nullptr) {
+        ws_write_error(response, "Unknown type");
+        return;
+    }
+
+    std::string_view action;
+    if (type->selector != nullptr) {
+        WSJsonValue selector = request[type->selector];
+        if (!selector.isString()) {
+            char message[48];
+            snprintf(message, sizeof(message), "Missing or invalid %s", type->selector);
+            ws_write_error(response, message);
+            return;
+        }
+        action = selector.view();
+    }
+    const Entry *entry = findCommand(*type, action);
+    if (entry == nullptr) {
+        ws_write_error(response, type->unknown_error ? type->unknown_error : "Unknown action");
+        return;
+    }
+
+    const WSCommand &command = *entry->command;
+    WSArgs args;
+    args.fd = fd;
+    if (!args.bind(request, command.params, command.param_count)) {
+        ws_write_error(response, "Invalid parameters");
+        return;
+    }
+    if constexpr (std::is_same_v<Enc, CborWriter>) {
+        command.cbor(entry->ctx, args, response);
+    } else {
+        command.json(entry->ctx, args, response);
+    }
+}
+
+template void WSDispatcher::handle(void *, int, const WSJsonValue &, WSJsonWriter &);
+template void WSDispatcher::handle(void *, int, const WSJsonValue &, CborWriter &);
+template void WSDispatcher::dispatch(int, const WSJsonValue &, WSJsonWriter &) const;
+template void WSDispatcher::dispatch(int, const WSJsonValue &, CborWriter &) const;
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "ws_frame.h"
+#include "ws_json.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define WS_DISPATCH_MAX_TYPES 12    // 不同的 type 数
+#define WS_DISPATCH_MAX_COMMANDS 64 // 所有模块注册的命令总数
+#define WS_DISPATCH_MAX_PARAMS 6    // 单个命令的参数数
+
+// 参数类型，与 WSJsonType 对应；WS_PARAM_INT 接受任意数字，按 toInt() 截断
+enum WSParamType : uint8_t {
+    WS_PARAM_STRING,
+    WS_PARAM_INT,
+    WS_PARAM_BOOL,
+    WS_PARAM_ARRAY,
+    WS_PARAM_OBJECT,
+};
+
+/**
+ * @brief 命令参数的声明，分发时按声明的顺序取出并校验类型
+ */
+struct WSParam {
+    const char *name;
+    WSParamType type;
+    bool required; // false 时可以省略，但出现时类型必须正确
+};
+
+/**
+ * @brief 分发给命令处理函数的请求，参数下标与 WSCommand::params 的顺序相同
+ */
+class WSArgs {
+public:
+    int fd;
+    WSJsonValue root;
+
+    bool has(size_t i) const { return i < WS_DISPATCH_MAX_PARAMS && values_[i]; }
+    WSJsonValue value(size_t i) const { return has(i) ? values_[i] : WSJsonValue(); }
+    const char *str(size_t i) const { return value(i).str(); } // 省略时为 nullptr
+    int toInt(size_t i, int fallback = 0) const;
+    bool toBool(size_t i, bool fallback = false) const;
+
+    /**
+     * @brief 按参数表从 object 中取出并校验参数，分发和嵌套的请求 (如 batch 的 ops) 共用
+     * @return false 必需的参数缺失，或出现的参数类型不符
+     */
+    bool bind(const WSJsonValue &object, const WSParam *params, uint8_t count);
+
+private:
+    WSJsonValue values_[WS_DISPATCH_MAX_PARAMS];
+};
+
+/**
+ * @brief 命令处理函数，在 httpd 任务中执行，参数已通过校验
+ *
+ * 响应按连接的编码写入 (Enc 为 WSJsonWriter 或 CborWriter)，处理函数写为模板，
+ * 命令表中用 WS_HANDLER(fn) 填入两种编码的实例。
+ */
+template <typename Enc>
+using WSCommandHandler = void (*)(void *ctx, const WSArgs &args, Enc &response);
+
+struct WSCommand {
+    const char *action; // selector 字段的值，模块没有 selector 时为 ""
+    WSCommandHandler<WSJsonWriter> json;
+    WSCommandHandler<CborWriter> cbor;
+    const WSParam *params;
+    uint8_t param_count;
+};
+
+// 声明参数表: {"add", WS_HANDLER(handle_add), WS_PARAMS(ADD_PARAMS)}，没有参数时为 nullptr, 0
+#define WS_PARAMS(params) params, static_cast<uint8_t>(sizeof(params) / sizeof((params)[0]))
+
+/**
+ * @brief 一个模块注册的命令，同一 type 可以由多个模块分别注册
+ */
+struct WSModule {
+    const char *type;
+    const char *selector;      // 区分命令的字段 ("action" / "key")，nullptr 表示只有一个命令
+    const char *unknown_error; // selector 的值未注册时的错误，nullptr 为 "Unknown action"
+    const WSCommand *commands;
+    size_t count;
+};
+
+/**
+ * @brief 表驱动的 WebSocket 命令分发
+ *
+ * 各模块在启动时 add() 自己的命令表，按 "type.action" 的哈希 (json_path_hash) 排序，
+ * 分发时二分查找后比较名称确认，再按参数声明取出并校验参数，校验失败统一返回
+ * {"error": "Invalid parameters"}。add() 须在服务启动前完成，handle() 只在 httpd 任务中调用，
+ * 均不加锁。
+ */
+class WSDispatcher {
+public:
+    WSDispatcher();
+
+    /**
+     * @brief 注册模块的命令，表和 ctx 须在分发器的生命周期内有效
+     * @return false 容量不足，或 type 的 selector 与已注册的不一致，或命令重复 (整表不注册)
+     */
+    bool add(const WSModule &module, void *ctx);
+
+    /**
+     * @brief 分发一条请求，签名与 WSFrameHandler 相同，ctx 为 WSDispatcher
+     */
+    template <typename Enc>
+    static void handle(void *ctx, int fd, const WSJsonValue &request, Enc &response);
+
+    template <typename Enc>
+    void dispatch(int fd, const WSJsonValue &request, Enc &response) const;
+
+    size_t commandCount() const { return command_count_; }
+
+private:
+    struct Type {
+        uint32_t hash;
+        const char *name;
+        const char *selector;
+        const char *unknown_error;
+    };
+
+    struct Entry {
+        uint32_t hash; // type "." action
+        const Type *type;
+        const WSCommand *command;
+        void *ctx;
+    };
+
+    const Type *findType(std::string_view name) const;
+    const Entry *findCommand(const Type &type, std::string_view action) const;
+    static uint32_t commandHash(std::string_view type, std::string_view action);
+
+    Type types_[WS_DISPATCH_MAX_TYPES];
+    Entry entries_[WS_DISPATCH_MAX_COMMANDS]; // 按 hash 升序
+    size_t type_count_;
+    size_t command_count_;
+};
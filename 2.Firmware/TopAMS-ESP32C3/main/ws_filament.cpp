@@ -0,0 +1,167 @@
+#include "ws_filament.h"
+#include "ws_frame.h"
+
+static const WSParam ADD_PARAMS[] = {
+    {"motor_id", WS_PARAM_INT, true},
+    {"metadata", WS_PARAM_STRING, true},
+};
+static const WSParam ID_PARAMS[] = {
+    {"id", WS_PARAM_INT, true},
+};
+static const WSParam UPDATE_PARAMS[] = {
+    {"id", WS_PARAM_INT, true},
+    {"motor_id", WS_PARAM_INT, false},
+    {"metadata", WS_PARAM_STRING, false},
+};
+static const WSParam BATCH_PARAMS[] = {
+    {"ops", WS_PARAM_ARRAY, true},
+};
+
+// 执行一条耗材修改，args 已按该 action 的参数表校验；成功返回 nullptr，失败返回错误信息
+// id 为新增或修改的耗材 ID
+static const char *apply_filament_op(FilamentManager &manager, std::string_view action,
+                                     const WSArgs &args, int &id) {
+    if (action == "add") {
+        id = manager.addFilament(args.toInt(0), args.str(1));
+        return id != -1 ? nullptr : "Motor ID already in use";
+    }
+    id = args.toInt(0);
+    if (action == "remove") {
+        return manager.removeFilament(id) ? nullptr : "ID not found";
+    }
+    bool success = manager.updateFilament(id, args.toInt(1, -1), args.has(2) ? args.str(2) : "");
+    return success ? nullptr : "Update failed";
+}
+
+// batch 中的一个操作按对应单条命令的参数表校验
+static const char *bind_filament_op(const WSJsonValue &op, std::string_view &action,
+                                    WSArgs &args) {
+    WSJsonValue value = op["action"];
+    if (!value.isString()) {
+        return "Missing or invalid action";
+    }
+    action = value.view();
+    bool valid;
+    if (action == "add") {
+        valid = args.bind(op, WS_PARAMS(ADD_PARAMS));
+    } else if (action == "remove") {
+        valid = args.bind(op, WS_PARAMS(ID_PARAMS));
+    } else if (action == "update") {
+        valid = args.bind(op, WS_PARAMS(UPDATE_PARAMS));
+    } else {
+        return "Unknown action";
+    }
+    return valid ? nullptr : "Invalid parameters";
+}
+
+static void notify_changed(const WSFilamentModule &module) {
+    if (module.changed != nullptr) {
+        module.changed(module.changed_ctx);
+    }
+}
+
+// add / remove / update 的参数已由分发器校验，与 batch 中的单个操作共用同一流程
+template <typename Enc>
+static void handle_single(void *ctx, const WSArgs &args, std::string_view action, Enc &w) {
+    WSFilamentModule &module = *static_cast<WSFilamentModule *>(ctx);
+    int id = -1;
+    const char *error = apply_filament_op(*module.manager, action, args, id);
+    if (error != nullptr) {
+        ws_write_error(w, error);
+        return;
+    }
+    w.beginMap().key(WS_KEY_success).boolean(true);
+    if (action == "add") {
+        w.key(WS_KEY_id).num(id);
+    }
+    w.end();
+    notify_changed(module);
+}
+
+template <typename Enc> static void handle_add(void *ctx, const WSArgs &args, Enc &w) {
+    handle_single(ctx, args, "add", w);
+}
+
+template <typename Enc> static void handle_remove(void *ctx, const WSArgs &args, Enc &w) {
+    handle_single(ctx, args, "remove", w);
+}
+
+template <typename Enc> static void handle_update(void *ctx, const WSArgs &args, Enc &w) {
+    handle_single(ctx, args, "update", w);
+}
+
+// 按顺序执行 ops 中的 add / remove / update，全部成功才写入存储，任一失败全部回滚
+// 成功: {"success": true, "ids": [...]}，与 ops 一一对应
+// 失败: {"error": "...", "index": 失败的操作序号}
+template <typename Enc> static void handle_batch(void *ctx, const WSArgs &args, Enc &w) {
+    WSFilamentModule &module = *static_cast<WSFilamentModule *>(ctx);
+    FilamentManager &manager = *module.manager;
+    WSJsonValue ops = args.value(0);
+    size_t op_count = ops.size();
+    if (op_count == 0 || op_count > WS_FILAMENT_BATCH_MAX_OPS) {
+        ws_write_error(w, "Invalid parameters");
+        return;
+    }
+    if (!manager.beginBatch()) {
+        ws_write_error(w, "Batch unavailable");
+        return;
+    }
+
+    int ids[WS_FILAMENT_BATCH_MAX_OPS];
+    const char *error = nullptr;
+    int index = 0;
+    for (WSJsonValue op = ops.first(); op; op = op.next()) {
+        std::string_view action;
+        WSArgs op_args;
+        op_args.fd = args.fd;
+        ids[index] = -1;
+        error = bind_filament_op(op, action, op_args);
+        if (error == nullptr) {
+            error = apply_filament_op(manager, action, op_args, ids[index]);
+        }
+        if (error != nullptr) {
+            break;
+        }
+        index++;
+    }
+    if (error != nullptr) {
+        manager.rollbackBatch();
+        w.beginMap().key(WS_KEY_error).str(error).key(WS_KEY_index).num(index).end();
+        return;
+    }
+    manager.commitBatch();
+
+    w.beginMap().key(WS_KEY_success).boolean(true).key(WS_KEY_ids).beginArray();
+    for (size_t i = 0; i < op_count; i++) {
+        w.num(ids[i]);
+    }
+    w.end().end();
+    notify_changed(module);
+}
+
+template <typename Enc> static void handle_list(void *ctx, const WSArgs &args, Enc &w) {
+    const FilamentManager &manager = *static_cast<WSFilamentModule *>(ctx)->manager;
+    FilamentManager::Reader table = manager.read();
+    const Filament *filament = table->getFilamentById(args.toInt(0));
+    if (filament == nullptr) {
+        ws_write_error(w, "ID not found");
+        return;
+    }
+    w.beginMap().key(WS_KEY_id).num(filament->id);
+    w.key(WS_KEY_motor_id).num(filament->motor_id);
+    w.key(WS_KEY_metadata).str(filament->metadata).end();
+}
+
+static const WSCommand FILAMENT_COMMANDS[] = {
+    {"add", WS_HANDLER(handle_add), WS_PARAMS(ADD_PARAMS)},
+    {"remove", WS_HANDLER(handle_remove), WS_PARAMS(ID_PARAMS)},
+    {"update", WS_HANDLER(handle_update), WS_PARAMS(UPDATE_PARAMS)},
+    {"batch", WS_HANDLER(handle_batch), WS_PARAMS(BATCH_PARAMS)},
+    {"list", WS_HANDLER(handle_list), WS_PARAMS(ID_PARAMS)},
+};
+
+bool ws_filament_register(WSDispatcher &dispatcher, WSFilamentModule &module) {
+    static const WSModule commands = {"filament", "action", nullptr, FILAMENT_COMMANDS,
+                                      sizeof(FILAMENT_COMMANDS) / sizeof(FILAMENT_COMMANDS[0])};
+    return dispatcher.add(commands, &module);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "filament_manager.h"
+#include "ws_dispatch.h"
+
+// 一次 batch 请求最多的操作数
+#define WS_FILAMENT_BATCH_MAX_OPS 64
+
+// 注册 filament 命令时的上下文，须在分发器的生命周期内有效
+struct WSFilamentModule {
+    FilamentManager *manager;
+    void (*changed)(void *ctx); // 耗材表被修改后调用，据此推送变化；可以为 nullptr
+    void *changed_ctx;
+};
+
+/**
+ * @brief 注册 {"type": "filament", "action": ...} 命令
+ *
+ * action:
+ *   add / remove / update  单条修改
+ *   batch                  {"ops": [{"action": "add", ...}, ...]}，按顺序执行，任一失败全部回滚
+ *   list                   {"id": n}，返回该耗材
+ */
+bool ws_filament_register(WSDispatcher &dispatcher, WSFilamentModule &module);
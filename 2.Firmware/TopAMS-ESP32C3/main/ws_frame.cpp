@@ -0,0 +1,161 @@
+#include "ws_frame.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "[WSFrame]";
+
+WSFramePool::WSFramePool() : stats_{} {
+    for (Slot &slot : slots_) {
+        slot.fd = -1;
+    }
+}
+
+WSFramePool::Slot *WSFramePool::acquire(int fd) {
+    Slot *free_slot = nullptr;
+    for (Slot &slot : slots_) {
+        if (slot.fd == fd) {
+            return &slot;
+        }
+        if (slot.fd < 0 && free_slot == nullptr) {
+            free_slot = &slot;
+        }
+    }
+    if (free_slot != nullptr) {
+        free_slot->fd = fd;
+        free_slot->encoding = WS_ENCODING_JSON;
+        stats_.in_use++;
+    }
+    return free_slot;
+}
+
+void WSFramePool::release(int fd) {
+    for (Slot &slot : slots_) {
+        if (slot.fd == fd) {
+            slot.fd = -1;
+            stats_.in_use--;
+            return;
+        }
+    }
+}
+
+// 逗号分隔的列表中是否有 name，忽略各项前后的空白
+static bool has_token(std::string_view list, std::string_view name) {
+    while (true) {
+        size_t comma = list.find(',');
+        std::string_view item = list.substr(0, comma);
+        size_t begin = item.find_first_not_of(" \t");
+        if (begin != std::string_view::npos &&
+            item.substr(begin, item.find_last_not_of(" \t") + 1 - begin) == name) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            return false;
+        }
+        list.remove_prefix(comma + 1);
+    }
+}
+
+// httpd 只要请求头中出现 WS_PROTOCOL_CBOR 就在握手中确认该子协议，客户端之后按 CBOR 收发，
+// 因此这里同样截断读取并在列表中查找，而不是要求整个请求头相同
+void WSFramePool::open(httpd_req_t *req) {
+    int fd = httpd_req_to_sockfd(req);
+    Slot *slot = acquire(fd);
+    if (slot == nullptr) {
+        stats_.exhausted++;
+        return;
+    }
+    char protocols[WS_FRAME_PROTOCOL_SIZE];
+    esp_err_t err =
+        httpd_req_get_hdr_value_str(req, "Sec-WebSocket-Protocol", protocols, sizeof(protocols));
+    if ((err == ESP_OK || err == ESP_ERR_HTTPD_RESULT_TRUNC) &&
+        has_token(protocols, WS_PROTOCOL_CBOR)) {
+        slot->encoding = WS_ENCODING_CBOR;
+    }
+}
+
+WSEncoding WSFramePool::encoding(int fd) const {
+    for (const Slot &slot : slots_) {
+        if (slot.fd == fd) {
+            return slot.encoding;
+        }
+    }
+    return WS_ENCODING_JSON;
+}
+
+WSFramePool::Stats WSFramePool::stats() const { return stats_; }
+
+static esp_err_t send_frame(httpd_req_t *req, httpd_ws_type_t type, const char *payload,
+                            size_t len) {
+    httpd_ws_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.type = type;
+    frame.payload = (uint8_t *)payload;
+    frame.len = len;
+    esp_err_t ret = httpd_ws_send_frame(req, &frame);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "httpd_ws_send_frame failed with %d", ret);
+    }
+    return ret;
+}
+
+// 解析失败时的错误和 handler 的输出直接写入发送缓冲区，返回响应的长度
+template <typename Enc>
+size_t WSFramePool::respond(Slot &slot, bool parsed, bool binary, WSFrameHandler<Enc> handler,
+                            void *ctx) {
+    Enc w(slot.tx, sizeof(slot.tx));
+    if (!parsed || !json_.root().isObject()) {
+        stats_.errors++;
+        ws_write_error(w, json_.overflow() ? "Request too large"
+                          : binary         ? "Invalid CBOR"
+                                           : "Invalid JSON");
+    } else {
+        handler(ctx, slot.fd, json_.root(), w);
+        if (!w.ok()) {
+            stats_.errors++;
+            ESP_LOGW(TAG, "Response exceeds %d bytes", WS_FRAME_TX_SIZE);
+            w = Enc(slot.tx, sizeof(slot.tx));
+            ws_write_error(w, "Response too large");
+        }
+    }
+    return w.length();
+}
+
+esp_err_t WSFramePool::handle(httpd_req_t *req, WSFrameHandler<WSJsonWriter> json,
+                              WSFrameHandler<CborWriter> cbor, void *ctx) {
+    int fd = httpd_req_to_sockfd(req);
+    Slot *slot = acquire(fd);
+    if (slot == nullptr) {
+        // 连接数不超过 max_open_sockets 时不会发生；没有缓冲区无法读出负载，只能关闭连接
+        stats_.exhausted++;
+        ESP_LOGW(TAG, "No frame buffer for fd %d", fd);
+        return ESP_FAIL;
+    }
+
+    // 帧头和负载一次读入，len 为 0 时 httpd 先读取帧头
+    httpd_ws_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.payload = (uint8_t *)slot->rx;
+    esp_err_t ret = httpd_ws_recv_frame(req, &frame, WS_FRAME_RX_SIZE);
+    if (ret == ESP_ERR_INVALID_SIZE) {
+        ESP_LOGW(TAG, "Frame too large (%u bytes), closing fd %d", (unsigned)frame.len, fd);
+        return ret;
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "httpd_ws_recv_frame failed with %d", ret);
+        return ret;
+    }
+    if (frame.len == 0) {
+        return ESP_OK;
+    }
+    slot->rx[frame.len] = '\0';
+    stats_.frames++;
+
+    bool binary = frame.type == HTTPD_WS_TYPE_BINARY;
+    bool parsed = binary ? json_.parseCbor(slot->rx, frame.len) : json_.parse(slot->rx, frame.len);
+    if (slot->encoding == WS_ENCODING_CBOR) {
+        size_t len = respond(*slot, parsed, binary, cbor, ctx);
+        return send_frame(req, HTTPD_WS_TYPE_BINARY, slot->tx, len);
+    }
+    size_t len = respond(*slot, parsed, binary, json, ctx);
+    return send_frame(req, HTTPD_WS_TYPE_TEXT, slot->tx, len);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "esp_http_server.h"
+#include "ws_cbor.h"
+#include "ws_json.h"
+#include <stddef.h>
+#include <string_view>
+
+#define WS_FRAME_POOL_SIZE 7  // 与 httpd 默认 max_open_sockets 相同
+#define WS_FRAME_RX_SIZE 1536 // 单帧请求最大长度，超出时关闭连接
+#define WS_FRAME_TX_SIZE 1024 // 单帧响应最大长度
+#define WS_FRAME_PROTOCOL_SIZE 49 // 读取 Sec-WebSocket-Protocol 的缓冲区，与 httpd 相同
+
+/**
+ * @brief 请求处理回调，在 httpd 任务中执行
+ * @param request 解析后的请求，只在回调期间有效
+ * @param response 按连接的编码写入响应 (Enc 为 WSJsonWriter 或 CborWriter)，溢出时改为发送错误
+ */
+template <typename Enc>
+using WSFrameHandler = void (*)(void *ctx, int fd, const WSJsonValue &request, Enc &response);
+
+// 处理函数写为模板，两种编码各实例化一份: handle(req, WS_HANDLER(fn), ctx)
+#define WS_HANDLER(fn) fn<WSJsonWriter>, fn<CborWriter>
+
+// {"error": "<message>"}
+template <typename Enc> void ws_write_error(Enc &w, std::string_view message) {
+    w.beginMap().key(WS_KEY_error).str(message).end();
+}
+
+/**
+ * @brief WebSocket 帧缓冲区池
+ *
+ * 每个连接在第一次发来数据时绑定一个预分配的接收 / 发送缓冲区，连接关闭时 release() 归还。
+ * 请求一次读入接收缓冲区后原地解析，响应直接写入发送缓冲区并作为一帧发出，
+ * 处理一帧不分配堆内存。所有方法只在 httpd 任务中调用 (请求处理和 close_fn)，不加锁。
+ *
+ * 握手时以 WS_PROTOCOL_CBOR 子协议连接的客户端使用 CBOR：请求为二进制帧，解析后与 JSON
+ * 请求相同；响应由 handler 的 CborWriter 实例直接编码，与推送 (WSPush) 相同。
+ */
+class WSFramePool {
+public:
+    struct Stats {
+        uint32_t frames;    // 处理的请求帧数
+        uint32_t errors;    // 无效 JSON / CBOR、超长响应等
+        uint32_t exhausted; // 没有空闲缓冲区的次数
+        size_t in_use;      // 当前绑定的连接数
+    };
+
+    WSFramePool();
+
+    /**
+     * @brief 握手 (GET) 时调用，绑定缓冲区并按请求的子协议确定该连接的编码
+     *
+     * 客户端提供的子协议列表 (逗号分隔) 中有 WS_PROTOCOL_CBOR 时为 CBOR。
+     */
+    void open(httpd_req_t *req);
+
+    /**
+     * @brief 连接的编码，未绑定缓冲区的连接为 JSON
+     */
+    WSEncoding encoding(int fd) const;
+
+    /**
+     * @brief 接收一帧请求，交给 handler 处理并发回响应
+     * @return 接收或发送失败时返回错误，httpd 随后关闭连接
+     */
+    esp_err_t handle(httpd_req_t *req, WSFrameHandler<WSJsonWriter> json,
+                     WSFrameHandler<CborWriter> cbor, void *ctx);
+
+    /**
+     * @brief 连接关闭时归还缓冲区
+     */
+    void release(int fd);
+
+    Stats stats() const;
+
+private:
+    struct Slot {
+        int fd; // -1 为空闲
+        WSEncoding encoding;
+        char rx[WS_FRAME_RX_SIZE + 1];
+        char tx[WS_FRAME_TX_SIZE];
+    };
+
+    Slot *acquire(int fd);
+    template <typename Enc>
+    size_t respond(Slot &slot, bool parsed, bool binary, WSFrameHandler<Enc> handler, void *ctx);
+
+    Slot slots_[WS_FRAME_POOL_SIZE];
+    WSJson json_; // 请求在 httpd 任务中逐个处理，所有连接共用
+    Stats stats_;
+};
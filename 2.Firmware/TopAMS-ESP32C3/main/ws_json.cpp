@@ -0,0 +1,699 @@
+#include "ws_json.h"
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char *skip_ws(char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+static bool is_digit(const char *p, const char *end) { return p < end && *p >= '0' && *p <= '9'; }
+
+// 读取 4 位十六进制数
+static bool read_hex4(const char *p, const char *end, uint32_t &out) {
+    if (end - p < 4) {
+        return false;
+    }
+    out = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        uint32_t digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            return false;
+        }
+        out = (out << 4) | digit;
+    }
+    return true;
+}
+
+// 按 UTF-8 写入码点，返回写入的字节数
+static size_t put_utf8(char *out, uint32_t cp) {
+    if (cp < 0x80) {
+        out[0] = static_cast<char>(cp);
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = static_cast<char>(0xC0 | (cp >> 6));
+        out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | (cp >> 12));
+        out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = static_cast<char>(0xF0 | (cp >> 18));
+    out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+bool WSJson::parse(char *buf, size_t len) {
+    buf_ = buf;
+    end_ = buf + len;
+    count_ = 0;
+    overflow_ = false;
+    if (len > UINT16_MAX) {
+        overflow_ = true;
+        return false;
+    }
+    char *p = parseValue(skip_ws(buf, end_), 0);
+    if (p == nullptr || skip_ws(p, end_) != end_) {
+        count_ = 0;
+        return false;
+    }
+    return true;
+}
+
+int WSJson::addToken(WSJsonType type, const char *at) {
+    if (count_ >= WS_JSON_MAX_TOKENS) {
+        overflow_ = true;
+        return -1;
+    }
+    tokens_[count_] = {static_cast<uint16_t>(at - buf_), 0, 0, 0, type, 0};
+    return count_++;
+}
+
+char *WSJson::parseValue(char *p, int depth) {
+    if (p >= end_) {
+        return nullptr;
+    }
+    switch (*p) {
+        case '{':
+            return parseContainer(p, depth, false);
+        case '[':
+            return parseContainer(p, depth, true);
+        case '"':
+            return parseString(p);
+        case 't':
+            return parseLiteral(p, "true", WS_JSON_BOOL);
+        case 'f':
+            return parseLiteral(p, "false", WS_JSON_BOOL);
+        case 'n':
+            return parseLiteral(p, "null", WS_JSON_NULL);
+        default:
+            return parseNumber(p);
+    }
+}
+
+// 反转义写入的位置不会超过读取的位置，结尾的 '\0' 最多覆盖右引号
+char *WSJson::parseString(char *p) {
+    int index = addToken(WS_JSON_STRING, p + 1);
+    if (index < 0) {
+        return nullptr;
+    }
+    char *start = ++p;
+    char *out = start;
+    while (p < end_) {
+        char c = *p++;
+        if (c == '"') {
+            *out = '\0';
+            tokens_[index].len = static_cast<uint16_t>(out - start);
+            return p;
+        }
+        if (static_cast<uint8_t>(c) < 0x20) {
+            return nullptr;
+        }
+        if (c != '\\') {
+            *out++ = c;
+            continue;
+        }
+        if (p >= end_) {
+            return nullptr;
+        }
+        switch (*p++) {
+            case '"':
+                *out++ = '"';
+                break;
+            case '\\':
+                *out++ = '\\';
+                break;
+            case '/':
+                *out++ = '/';
+                break;
+            case 'b':
+                *out++ = '\b';
+                break;
+            case 'f':
+                *out++ = '\f';
+                break;
+            case 'n':
+                *out++ = '\n';
+                break;
+            case 'r':
+                *out++ = '\r';
+                break;
+            case 't':
+                *out++ = '\t';
+                break;
+            case 'u': {
+                uint32_t cp;
+                if (!read_hex4(p, end_, cp)) {
+                    return nullptr;
+                }
+                p += 4;
+                // 代理对合并为一个码点，不成对的代理项替换为 '?'
+                uint32_t low;
+                if (cp >= 0xD800 && cp < 0xDC00 && end_ - p >= 6 && p[0] == '\\' &&
+                    p[1] == 'u' && read_hex4(p + 2, end_, low) && low >= 0xDC00 && low < 0xE000) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    p += 6;
+                }
+                if (cp >= 0xD800 && cp < 0xE000) {
+                    cp = '?';
+                }
+                out += put_utf8(out, cp);
+                break;
+            }
+            default:
+                return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+char *WSJson::parseNumber(char *p) {
+    char *start = p;
+    if (p < end_ && *p == '-') {
+        p++;
+    }
+    if (!is_digit(p, end_)) {
+        return nullptr;
+    }
+    while (is_digit(p, end_)) {
+        p++;
+    }
+    if (p < end_ && *p == '.') {
+        if (!is_digit(++p, end_)) {
+            return nullptr;
+        }
+        while (is_digit(p, end_)) {
+            p++;
+        }
+    }
+    if (p < end_ && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < end_ && (*p == '+' || *p == '-')) {
+            p++;
+        }
+        if (!is_digit(p, end_)) {
+            return nullptr;
+        }
+        while (is_digit(p, end_)) {
+            p++;
+        }
+    }
+    int index = addToken(WS_JSON_NUMBER, start);
+    if (index < 0) {
+        return nullptr;
+    }
+    tokens_[index].len = static_cast<uint16_t>(p - start);
+    return p;
+}
+
+char *WSJson::parseLiteral(char *p, std::string_view word, WSJsonType type) {
+    if (static_cast<size_t>(end_ - p) < word.size() || std::string_view(p, word.size()) != word) {
+        return nullptr;
+    }
+    int index = addToken(type, p);
+    if (index < 0) {
+        return nullptr;
+    }
+    tokens_[index].len = static_cast<uint16_t>(word.size());
+    return p + word.size();
+}
+
+// 对象的成员为键 token 加值 token，兄弟链接在键上
+char *WSJson::parseContainer(char *p, int depth, bool array) {
+    if (depth >= WS_JSON_MAX_DEPTH) {
+        return nullptr;
+    }
+    int index = addToken(array ? WS_JSON_ARRAY : WS_JSON_OBJECT, p);
+    if (index < 0) {
+        return nullptr;
+    }
+    char close = array ? ']' : '}';
+    p = skip_ws(p + 1, end_);
+    if (p < end_ && *p == close) {
+        return p + 1;
+    }
+
+    int prev = -1;
+    while (true) {
+        int item = count_;
+        if (!array) {
+            if (p >= end_ || *p != '"' || (p = parseString(p)) == nullptr) {
+                return nullptr;
+            }
+            p = skip_ws(p, end_);
+            if (p >= end_ || *p != ':') {
+                return nullptr;
+            }
+            p = skip_ws(p + 1, end_);
+        }
+        p = parseValue(p, depth + 1);
+        if (p == nullptr) {
+            return nullptr;
+        }
+        if (prev >= 0) {
+            tokens_[prev].sibling = static_cast<uint16_t>(item);
+        }
+        prev = item;
+        tokens_[index].size++;
+
+        p = skip_ws(p, end_);
+        if (p >= end_) {
+            return nullptr;
+        }
+        if (*p == close) {
+            return p + 1;
+        }
+        if (*p != ',') {
+            return nullptr;
+        }
+        p = skip_ws(p + 1, end_);
+    }
+}
+
+// CBOR 头部: 主类型、参数 (长度 / 数值 / 浮点数的位)，参数为 31 时为不定长
+static char *cbor_head(char *p, const char *end, uint8_t &major, uint64_t &arg,
+                       bool &indefinite) {
+    if (p >= end) {
+        return nullptr;
+    }
+    uint8_t initial = static_cast<uint8_t>(*p++);
+    major = initial >> 5;
+    uint8_t info = initial & 0x1F;
+    indefinite = false;
+    arg = 0;
+    if (info < 24) {
+        arg = info;
+    } else if (info <= 27) {
+        size_t n = 1u << (info - 24);
+        if (static_cast<size_t>(end - p) < n) {
+            return nullptr;
+        }
+        for (size_t i = 0; i < n; i++) {
+            arg = (arg << 8) | static_cast<uint8_t>(*p++);
+        }
+    } else if (info == 31) {
+        indefinite = true;
+    } else {
+        return nullptr;
+    }
+    return p;
+}
+
+static float half_to_float(uint16_t half) {
+    int exponent = (half >> 10) & 0x1F;
+    int mantissa = half & 0x3FF;
+    float value;
+    if (exponent == 0) {
+        value = ldexpf(mantissa, -24);
+    } else if (exponent != 31) {
+        value = ldexpf(mantissa + 1024, exponent - 25);
+    } else {
+        value = mantissa == 0 ? INFINITY : NAN;
+    }
+    return (half & 0x8000) ? -value : value;
+}
+
+bool WSJson::parseCbor(char *buf, size_t len) {
+    buf_ = buf;
+    end_ = buf + len;
+    count_ = 0;
+    overflow_ = false;
+    if (len > UINT16_MAX) {
+        overflow_ = true;
+        return false;
+    }
+    char *p = parseCborItem(buf, 0, false);
+    if (p != end_) {
+        count_ = 0;
+        return false;
+    }
+    return true;
+}
+
+void WSJson::setInline(int index, uint32_t bits, uint8_t flags) {
+    tokens_[index].offset = static_cast<uint16_t>(bits);
+    tokens_[index].len = static_cast<uint16_t>(bits >> 16);
+    tokens_[index].flags = TOKEN_INLINE | flags;
+}
+
+// 文本串的内容前移到头部的位置，腾出结尾的 '\0'；key 为 true 时整数解析为键编号
+char *WSJson::parseCborItem(char *p, int depth, bool key) {
+    char *start = p;
+    uint8_t major;
+    uint64_t arg;
+    bool indefinite;
+    p = cbor_head(p, end_, major, arg, indefinite);
+    if (p == nullptr || (indefinite && major != 4 && major != 5)) {
+        return nullptr;
+    }
+    if (key && major != 0 && major != 3) {
+        return nullptr;
+    }
+    // 标签只修饰后面的值，循环跳过；连续的标签不递归，不受 httpd 任务栈限制
+    while (major == 6) {
+        start = p;
+        p = cbor_head(p, end_, major, arg, indefinite);
+        if (p == nullptr || (indefinite && major != 4 && major != 5)) {
+            return nullptr;
+        }
+    }
+
+    switch (major) {
+        case 0:
+        case 1: {
+            if (key) {
+                // 未知的键编号保留，查找时不会匹配任何名称
+                int index = addToken(WS_JSON_STRING, buf_);
+                if (index < 0) {
+                    return nullptr;
+                }
+                tokens_[index].offset = arg < WS_KEY_NONE + 0x10000u ? arg : 0;
+                tokens_[index].flags = TOKEN_KEY_ID;
+                return p;
+            }
+            int32_t value;
+            if (major == 0) {
+                value = arg > INT32_MAX ? INT32_MAX : static_cast<int32_t>(arg);
+            } else {
+                value = arg > INT32_MAX ? INT32_MIN : static_cast<int32_t>(-1 - (int64_t)arg);
+            }
+            int index = addToken(WS_JSON_NUMBER, start);
+            if (index < 0) {
+                return nullptr;
+            }
+            setInline(index, static_cast<uint32_t>(value), 0);
+            return p;
+        }
+        case 3: {
+            if (arg > static_cast<uint64_t>(end_ - p)) {
+                return nullptr;
+            }
+            int index = addToken(WS_JSON_STRING, start);
+            if (index < 0) {
+                return nullptr;
+            }
+            memmove(start, p, arg);
+            start[arg] = '\0';
+            tokens_[index].len = static_cast<uint16_t>(arg);
+            return p + arg;
+        }
+        case 4:
+        case 5: {
+            bool array = major == 4;
+            // 每个元素至少 1 字节，成员数超过剩余长度时一定无效
+            if (depth >= WS_JSON_MAX_DEPTH ||
+                (!indefinite && arg > static_cast<uint64_t>(end_ - p))) {
+                return nullptr;
+            }
+            int index = addToken(array ? WS_JSON_ARRAY : WS_JSON_OBJECT, start);
+            if (index < 0) {
+                return nullptr;
+            }
+            int prev = -1;
+            for (uint64_t i = 0; indefinite || i < arg; i++) {
+                if (indefinite) {
+                    if (p >= end_) {
+                        return nullptr;
+                    }
+                    if (static_cast<uint8_t>(*p) == 0xFF) {
+                        p++;
+                        break;
+                    }
+                }
+                int item = count_;
+                if (!array && (p = parseCborItem(p, depth + 1, true)) == nullptr) {
+                    return nullptr;
+                }
+                if ((p = parseCborItem(p, depth + 1, false)) == nullptr) {
+                    return nullptr;
+                }
+                if (prev >= 0) {
+                    tokens_[prev].sibling = static_cast<uint16_t>(item);
+                }
+                prev = item;
+                tokens_[index].size++;
+            }
+            return p;
+        }
+        case 7: {
+            WSJsonType type = WS_JSON_NUMBER;
+            uint32_t bits = 0;
+            uint8_t flags = TOKEN_FLOAT;
+            uint8_t info = static_cast<uint8_t>(*start) & 0x1F;
+            if (info == 20 || info == 21) {
+                type = WS_JSON_BOOL;
+                bits = info == 21;
+                flags = 0;
+            } else if (info == 22 || info == 23) {
+                type = WS_JSON_NULL;
+                flags = 0;
+            } else if (info >= 25 && info <= 27) {
+                float value;
+                if (info == 25) {
+                    value = half_to_float(static_cast<uint16_t>(arg));
+                } else if (info == 26) {
+                    uint32_t raw = static_cast<uint32_t>(arg);
+                    memcpy(&value, &raw, sizeof(value));
+                } else {
+                    double raw;
+                    memcpy(&raw, &arg, sizeof(raw));
+                    value = static_cast<float>(raw);
+                }
+                memcpy(&bits, &value, sizeof(bits));
+            } else {
+                return nullptr;
+            }
+            int index = addToken(type, start);
+            if (index < 0) {
+                return nullptr;
+            }
+            setInline(index, bits, flags);
+            return p;
+        }
+        default:
+            return nullptr;
+    }
+}
+
+std::string_view WSJson::text(const Token &token) const {
+    if (token.flags & TOKEN_KEY_ID) {
+        const char *name = ws_key_name(token.offset);
+        return name ? std::string_view(name) : std::string_view();
+    }
+    if (token.flags & TOKEN_INLINE) {
+        return std::string_view();
+    }
+    return std::string_view(buf_ + token.offset, token.len);
+}
+
+WSJsonType WSJsonValue::type() const {
+    return doc_ ? static_cast<WSJsonType>(doc_->tokens_[index_].type) : WS_JSON_NONE;
+}
+
+WSJsonValue WSJsonValue::operator[](std::string_view key) const {
+    if (!isObject()) {
+        return WSJsonValue();
+    }
+    uint16_t k = doc_->tokens_[index_].size ? index_ + 1 : 0;
+    while (k != 0) {
+        const WSJson::Token &token = doc_->tokens_[k];
+        // 未知的键编号不匹配任何名称，包括空字符串
+        bool unknown = (token.flags & WSJson::TOKEN_KEY_ID) && ws_key_name(token.offset) == nullptr;
+        if (!unknown && doc_->text(token) == key) {
+            return WSJsonValue(doc_, k + 1);
+        }
+        k = token.sibling;
+    }
+    return WSJsonValue();
+}
+
+const char *WSJsonValue::str() const {
+    if (!isString()) {
+        return nullptr;
+    }
+    const WSJson::Token &token = doc_->tokens_[index_];
+    if (token.flags & WSJson::TOKEN_KEY_ID) {
+        const char *name = ws_key_name(token.offset);
+        return name ? name : "";
+    }
+    return doc_->buf_ + token.offset;
+}
+
+std::string_view WSJsonValue::view() const {
+    WSJsonType t = type();
+    if (t == WS_JSON_NONE || t == WS_JSON_OBJECT || t == WS_JSON_ARRAY) {
+        return std::string_view();
+    }
+    return doc_->text(doc_->tokens_[index_]);
+}
+
+bool WSJsonValue::toInt(int &out) const {
+    if (!isNumber()) {
+        return false;
+    }
+    const WSJson::Token &token = doc_->tokens_[index_];
+    if (token.flags & WSJson::TOKEN_INLINE) {
+        uint32_t bits = token.offset | static_cast<uint32_t>(token.len) << 16;
+        if (!(token.flags & WSJson::TOKEN_FLOAT)) {
+            out = static_cast<int32_t>(bits);
+            return true;
+        }
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        out = value >= INT_MAX ? INT_MAX : value <= INT_MIN ? INT_MIN : static_cast<int>(value);
+        return true;
+    }
+    // 数字后面紧跟其他字符，复制出来再转换
+    std::string_view text = view();
+    char number[32];
+    if (text.size() >= sizeof(number)) {
+        return false;
+    }
+    memcpy(number, text.data(), text.size());
+    number[text.size()] = '\0';
+    double value = strtod(number, nullptr);
+    if (value >= INT_MAX) {
+        out = INT_MAX;
+    } else if (value <= INT_MIN) {
+        out = INT_MIN;
+    } else {
+        out = static_cast<int>(value);
+    }
+    return true;
+}
+
+bool WSJsonValue::toBool(bool &out) const {
+    if (type() != WS_JSON_BOOL) {
+        return false;
+    }
+    const WSJson::Token &token = doc_->tokens_[index_];
+    out = (token.flags & WSJson::TOKEN_INLINE) ? token.offset != 0 : view() == "true";
+    return true;
+}
+
+size_t WSJsonValue::size() const {
+    return isObject() || isArray() ? doc_->tokens_[index_].size : 0;
+}
+
+WSJsonValue WSJsonValue::first() const {
+    return size() ? WSJsonValue(doc_, index_ + 1) : WSJsonValue();
+}
+
+WSJsonValue WSJsonValue::next() const {
+    if (!doc_ || doc_->tokens_[index_].sibling == 0) {
+        return WSJsonValue();
+    }
+    return WSJsonValue(doc_, doc_->tokens_[index_].sibling);
+}
+
+WSJsonValue WSJsonValue::value() const {
+    return isString() && index_ + 1 < doc_->count_ ? WSJsonValue(doc_, index_ + 1) : WSJsonValue();
+}
+
+void WSJsonWriter::separator() {
+    if (after_key_) {
+        after_key_ = false;
+        return;
+    }
+    uint32_t bit = 1u << depth_;
+    if (has_items_ & bit) {
+        w_.chr(',');
+    }
+    has_items_ |= bit;
+}
+
+WSJsonWriter &WSJsonWriter::beginMap() {
+    separator();
+    w_.chr('{');
+    depth_++;
+    has_items_ &= ~(1u << depth_);
+    arrays_ &= ~(1u << depth_);
+    return *this;
+}
+
+WSJsonWriter &WSJsonWriter::beginArray() {
+    separator();
+    w_.chr('[');
+    depth_++;
+    has_items_ &= ~(1u << depth_);
+    arrays_ |= 1u << depth_;
+    return *this;
+}
+
+WSJsonWriter &WSJsonWriter::end() {
+    w_.chr((arrays_ & (1u << depth_)) ? ']' : '}');
+    depth_--;
+    return *this;
+}
+
+WSJsonWriter &WSJsonWriter::key(std::string_view name) {
+    separator();
+    w_.str(name).chr(':');
+    after_key_ = true;
+    return *this;
+}
+
+WSJsonWriter &WSJsonWriter::str(std::string_view s) {
+    separator();
+    w_.str(s);
+    return *this;
+}
+
+WSJsonWriter &WSJsonWriter::num(int64_t v) {
+    separator();
+    // Writer::num 为 long，在 32 位平台上不够
+    char digits[21];
+    size_t n = 0;
+    uint64_t u = v < 0 ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v);
+    do {
+        digits[n++] = static_cast<char>('0' + u % 10);
+        u /= 10;
+    } while (u > 0);
+    if (v < 0) {
+        w_.chr('-');
+    }
+    while (n > 0) {
+        w_.chr(digits[--n]);
+    }
+    return *this;
+}
+
+WSJsonWriter &WSJsonWriter::decimal(float v) {
+    separator();
+    long tenths = lroundf(v * 10);
+    if (tenths < 0) {
+        w_.chr('-');
+        tenths = -tenths;
+    }
+    w_.num(tenths / 10).chr('.').num(tenths % 10);
+    return *this;
+}
+
+WSJsonWriter &WSJsonWriter::boolean(bool v) {
+    separator();
+    w_.boolean(v);
+    return *this;
+}
+
+WSJsonWriter &WSJsonWriter::null() {
+    separator();
+    w_.raw("null");
+    return *this;
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "bambu_command.h"
+#include "ws_schema.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+
+#define WS_JSON_MAX_TOKENS 192 // 单个请求最多的值 (对象的键也算一个)
+#define WS_JSON_MAX_DEPTH 8
+
+enum WSJsonType : uint8_t {
+    WS_JSON_NONE, // 不存在
+    WS_JSON_OBJECT,
+    WS_JSON_ARRAY,
+    WS_JSON_STRING,
+    WS_JSON_NUMBER,
+    WS_JSON_BOOL,
+    WS_JSON_NULL,
+};
+
+class WSJson;
+
+/**
+ * @brief WSJson 中的一个值
+ *
+ * 不存在的值 type() 为 WS_JSON_NONE，访问时返回默认值，因此可以连续取成员而不必逐层检查。
+ * 只在所属的 WSJson 和输入缓冲区有效期间可用。
+ */
+class WSJsonValue {
+public:
+    WSJsonValue() : doc_(nullptr), index_(0) {}
+
+    WSJsonType type() const;
+    bool isObject() const { return type() == WS_JSON_OBJECT; }
+    bool isArray() const { return type() == WS_JSON_ARRAY; }
+    bool isString() const { return type() == WS_JSON_STRING; }
+    bool isNumber() const { return type() == WS_JSON_NUMBER; }
+    explicit operator bool() const { return type() != WS_JSON_NONE; }
+
+    /**
+     * @brief 对象成员，不存在或不是对象时返回空值
+     */
+    WSJsonValue operator[](std::string_view key) const;
+
+    /**
+     * @brief 反转义后的字符串，以 '\0' 结尾；不是字符串时返回 nullptr
+     */
+    const char *str() const;
+
+    /**
+     * @brief 字符串内容或数字 / 字面量的原文；对象、数组和从 CBOR 解析的数字 / 布尔值返回空
+     */
+    std::string_view view() const;
+
+    /**
+     * @brief 数字转为 int，小数部分截断 (与 cJSON 的 valueint 相同)
+     * @return false 不是数字
+     */
+    bool toInt(int &out) const;
+    bool toBool(bool &out) const;
+
+    /**
+     * @brief 数组的元素数 / 对象的成员数
+     */
+    size_t size() const;
+
+    /**
+     * @brief 数组的第一个元素和之后的元素:
+     *   for (WSJsonValue item = array.first(); item; item = item.next())
+     * 对象同样遍历，得到的是键，member.value() 取对应的值
+     */
+    WSJsonValue first() const;
+    WSJsonValue next() const;
+    WSJsonValue value() const;
+
+private:
+    friend class WSJson;
+    WSJsonValue(const WSJson *doc, uint16_t index) : doc_(doc), index_(index) {}
+
+    const WSJson *doc_;
+    uint16_t index_;
+};
+
+/**
+ * @brief 原地解析的 JSON 文档，用于 WebSocket 请求
+ *
+ * 一次扫描输入缓冲区，为每个值记录一个定长 token (偏移、长度、下一个兄弟)，不分配堆内存。
+ * 字符串在缓冲区中原地反转义并以 '\0' 结尾，因此输入会被修改，且在文档使用期间需保持有效。
+ * 值的数量超过 WS_JSON_MAX_TOKENS 或嵌套超过 WS_JSON_MAX_DEPTH 时解析失败。
+ * parseCbor() 以同样的方式解析二进制协议的请求，整数键按 ws_schema.def 映射为名称，
+ * 之后的访问与 JSON 相同。
+ */
+class WSJson {
+public:
+    WSJson() : buf_(nullptr), end_(nullptr), count_(0), overflow_(false) {}
+
+    /**
+     * @brief 解析 buf 中的 len 字节 (不超过 65535)
+     * @return false 语法错误或超出容量
+     */
+    bool parse(char *buf, size_t len);
+
+    /**
+     * @brief 解析 CBOR 编码的文档，字符串原地移动并以 '\0' 结尾
+     *
+     * 支持定长和不定长的数组 / 对象、整数、半 / 单 / 双精度浮点数、布尔值和 null，
+     * 对象的键为文本或键编号，忽略标签；不支持字节串和分段的文本串。
+     */
+    bool parseCbor(char *buf, size_t len);
+
+    /**
+     * @brief 根值，解析失败时为空值
+     */
+    WSJsonValue root() const { return count_ ? WSJsonValue(this, 0) : WSJsonValue(); }
+
+    /**
+     * @brief 上次解析是否因超出 WS_JSON_MAX_TOKENS 失败
+     */
+    bool overflow() const { return overflow_; }
+
+private:
+    friend class WSJsonValue;
+
+    enum TokenFlag : uint8_t {
+        TOKEN_KEY_ID = 1u << 0, // offset 为 ws_schema.def 中的键编号
+        TOKEN_INLINE = 1u << 1, // offset | len << 16 为数值本身 (int32 / 布尔)
+        TOKEN_FLOAT = 1u << 2,  // 与 TOKEN_INLINE 同时设置，数值为 float 的位
+    };
+
+    struct Token {
+        uint16_t offset;  // 在 buf_ 中的偏移
+        uint16_t len;     // 字符串为反转义后的长度，对象和数组为 0
+        uint16_t sibling; // 同一容器中的下一个 token，0 表示没有
+        uint16_t size;    // 对象的成员数 / 数组的元素数
+        uint8_t type;     // WSJsonType
+        uint8_t flags;    // TokenFlag
+    };
+
+    // 以下解析函数返回值之后的位置，出错时返回 nullptr
+    int addToken(WSJsonType type, const char *at);
+    char *parseValue(char *p, int depth);
+    char *parseString(char *p);
+    char *parseNumber(char *p);
+    char *parseLiteral(char *p, std::string_view word, WSJsonType type);
+    char *parseContainer(char *p, int depth, bool array);
+    char *parseCborItem(char *p, int depth, bool key);
+    void setInline(int index, uint32_t bits, uint8_t flags);
+    std::string_view text(const Token &token) const;
+
+    char *buf_;
+    const char *end_;
+    Token tokens_[WS_JSON_MAX_TOKENS];
+    uint16_t count_;
+    bool overflow_;
+};
+
+/**
+ * @brief 与 CborWriter 接口相同的 JSON 写入器，自动插入逗号，用于同时支持两种编码的推送
+ *
+ * 输出紧凑格式 (无空格)，写入定长缓冲区，溢出时 ok() 返回 false。嵌套不超过 32 层。
+ */
+class WSJsonWriter {
+public:
+    WSJsonWriter(char *buf, size_t size) : w_(buf, size), depth_(0), after_key_(false) {}
+
+    WSJsonWriter &beginMap();
+    WSJsonWriter &beginArray();
+    WSJsonWriter &end();
+    WSJsonWriter &key(WSKey id) { return key(ws_key_name(id)); }
+    WSJsonWriter &key(std::string_view name);
+    WSJsonWriter &str(std::string_view s);
+    WSJsonWriter &num(int64_t v);
+    WSJsonWriter &decimal(float v); // 保留一位小数
+    WSJsonWriter &boolean(bool v);
+    WSJsonWriter &null();
+
+    const char *data() const { return w_.c_str(); }
+    size_t length() const { return w_.length(); }
+    bool ok() const { return w_.ok(); }
+
+private:
+    void separator();
+
+    BambuCmd::Writer w_;
+    uint32_t has_items_ = 0; // 按层，该层已写入元素
+    uint32_t arrays_ = 0;    // 按层，该层是数组
+    uint8_t depth_;
+    bool after_key_;
+};
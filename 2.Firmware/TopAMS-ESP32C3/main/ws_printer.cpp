@@ -0,0 +1,384 @@
+#include "ws_printer.h"
+#include "esp_timer.h"
+#include "instance.h"
+#include <string.h>
+
+using BambuCmd::Writer;
+
+#define WS_PRINTER_COMMAND_SIZE 512 // 转发的单条命令最大长度
+
+// 各命令的构造函数，seq 由 send() 生成
+using BuildFn = bool (*)(Writer &w, const WSArgs &args, uint32_t seq);
+
+// 注册时指定了连接则只有会话 0；持有共享指针，发送期间会话被关闭也不会释放连接
+static std::shared_ptr<BambuMQTT> printer_of(void *ctx, int session) {
+    if (ctx) {
+        return session == 0 ? std::shared_ptr<BambuMQTT>(std::shared_ptr<BambuMQTT>(),
+                                                         static_cast<BambuMQTT *>(ctx))
+                            : nullptr;
+    }
+    return session < 0 ? nullptr : Instance::get().printer_sessions->get(session);
+}
+
+// 在 httpd 任务中执行，命令缓冲区不占用栈
+// session_arg 为可选参数 "session" 在参数表中的位置，省略时发给会话 0
+template <typename Enc>
+static void send(void *ctx, const WSArgs &args, size_t session_arg, BuildFn build,
+                 Enc &response) {
+    static char payload[WS_PRINTER_COMMAND_SIZE];
+    std::shared_ptr<BambuMQTT> mqtt = printer_of(ctx, args.toInt(session_arg, 0));
+    if (mqtt == nullptr || !mqtt->isConnected()) {
+        ws_write_error(response, "Printer not connected");
+        return;
+    }
+    uint32_t seq = BambuCmd::NextSequenceId();
+    Writer w(payload);
+    if (!build(w, args, seq)) {
+        ws_write_error(response, "Command too long");
+        return;
+    }
+    if (!mqtt->send_command(w.view(), seq, nullptr, nullptr)) {
+        ws_write_error(response, "Failed to send command");
+        return;
+    }
+    response.beginMap().key(WS_KEY_success).boolean(true);
+    response.key(WS_KEY_sequence_id).num(seq).end();
+}
+
+template <typename Enc>
+static void handle_pause(void *ctx, const WSArgs &args, Enc &response) {
+    send(ctx, args, 0, [](Writer &w, const WSArgs &, uint32_t seq) {
+        return BambuCmd::SimpleCmd(w, "print", "pause", seq);
+    }, response);
+}
+
+template <typename Enc>
+static void handle_resume(void *ctx, const WSArgs &args, Enc &response) {
+    send(ctx, args, 0, [](Writer &w, const WSArgs &, uint32_t seq) {
+        return BambuCmd::SimpleCmd(w, "print", "resume", seq);
+    }, response);
+}
+
+template <typename Enc>
+static void handle_stop(void *ctx, const WSArgs &args, Enc &response) {
+    send(ctx, args, 0, [](Writer &w, const WSArgs &, uint32_t seq) {
+        return BambuCmd::SimpleCmd(w, "print", "stop", seq);
+    }, response);
+}
+
+template <typename Enc>
+static void handle_pushall(void *ctx, const WSArgs &args, Enc &response) {
+    send(ctx, args, 0, [](Writer &w, const WSArgs &, uint32_t seq) {
+        return BambuCmd::SimpleCmd(w, "pushing", "pushall", seq);
+    }, response);
+}
+
+template <typename Enc>
+static void handle_gcode(void *ctx, const WSArgs &args, Enc &response) {
+    send(ctx, args, 1, [](Writer &w, const WSArgs &a, uint32_t seq) {
+        return BambuCmd::SendGcodeCmd(w, a.str(0), seq);
+    }, response);
+}
+
+template <typename Enc>
+static void handle_speed(void *ctx, const WSArgs &args, Enc &response) {
+    send(ctx, args, 1, [](Writer &w, const WSArgs &a, uint32_t seq) {
+        return BambuCmd::SpeedProfileCmd(w, a.str(0), seq);
+    }, response);
+}
+
+// 凭据整组保存后立即切换连接
+template <typename Enc>
+static bool apply_credentials(const char *host, const char *serial, const char *access_code,
+                              Enc &response) {
+    Instance &instance = Instance::get();
+    SettingsStore &settings = *instance.settings;
+    if (host[0] == '\0' || serial[0] == '\0') {
+        ws_write_error(response, "Invalid printer credentials");
+        return false;
+    }
+    if (!settings.beginBatch()) {
+        ws_write_error(response, "Failed to save printer credentials");
+        return false;
+    }
+    if (settings.set(SETTING_PRINTER_HOST, host) != ESP_OK ||
+        settings.set(SETTING_PRINTER_SERIAL, serial) != ESP_OK ||
+        settings.set(SETTING_PRINTER_CODE, access_code) != ESP_OK) {
+        settings.rollbackBatch();
+        ws_write_error(response, "Invalid printer credentials");
+        return false;
+    }
+    if (settings.commitBatch() != ESP_OK) {
+        ws_write_error(response, "Failed to save printer credentials");
+        return false;
+    }
+    instance.applyPrinter();
+    return true;
+}
+
+template <typename Enc>
+static void handle_credentials(void *ctx, const WSArgs &args, Enc &response) {
+    if (apply_credentials(args.str(0), args.str(1), args.str(2), response)) {
+        response.beginMap().key(WS_KEY_success).boolean(true).end();
+    }
+}
+
+// 访问码不返回
+template <typename Enc>
+static void handle_profiles(void *ctx, const WSArgs &args, Enc &response) {
+    Instance &instance = Instance::get();
+    PrinterProfiles &profiles = *instance.printer_profiles;
+    int active = profiles.find(instance.settings->str(SETTING_PRINTER_SERIAL));
+    response.beginMap().key(WS_KEY_success).boolean(true).key(WS_KEY_active).num(active);
+    response.key(WS_KEY_profiles).beginArray();
+    for (size_t slot = 0; slot < PRINTER_PROFILE_MAX; slot++) {
+        PrinterProfile profile;
+        if (!profiles.get(slot, profile)) {
+            continue;
+        }
+        response.beginMap().key(WS_KEY_slot).num(slot);
+        response.key(WS_KEY_name).str(profile.name);
+        response.key(WS_KEY_host).str(profile.host);
+        response.key(WS_KEY_serial).str(profile.serial).end();
+    }
+    response.end().end();
+}
+
+template <typename Enc>
+static void handle_save_profile(void *ctx, const WSArgs &args, Enc &response) {
+    int slot = args.toInt(0, -1);
+    esp_err_t err = slot < 0 ? ESP_ERR_INVALID_ARG
+                             : Instance::get().printer_profiles->save(
+                                   slot, args.has(1) ? args.str(1) : "", args.str(2),
+                                   args.str(3), args.str(4));
+    if (err == ESP_ERR_INVALID_ARG || err == ESP_ERR_INVALID_SIZE) {
+        ws_write_error(response, "Invalid printer profile");
+    } else if (err != ESP_OK) {
+        ws_write_error(response, "Failed to save printer profile");
+    } else {
+        response.beginMap().key(WS_KEY_success).boolean(true).key(WS_KEY_slot).num(slot).end();
+    }
+}
+
+template <typename Enc>
+static void handle_delete_profile(void *ctx, const WSArgs &args, Enc &response) {
+    int slot = args.toInt(0, -1);
+    esp_err_t err = slot < 0 ? ESP_ERR_INVALID_ARG
+                             : Instance::get().printer_profiles->remove(slot);
+    if (err == ESP_ERR_INVALID_ARG) {
+        ws_write_error(response, "Invalid printer profile");
+    } else if (err != ESP_OK) {
+        ws_write_error(response, "Failed to delete printer profile");
+    } else {
+        response.beginMap().key(WS_KEY_success).boolean(true).end();
+    }
+}
+
+// 复制到当前连接的设置项并重新连接，不需要重启
+template <typename Enc>
+static void handle_select_profile(void *ctx, const WSArgs &args, Enc &response) {
+    PrinterProfile profile;
+    int slot = args.toInt(0, -1);
+    if (slot < 0 || !Instance::get().printer_profiles->get(slot, profile)) {
+        ws_write_error(response, "Printer profile not found");
+        return;
+    }
+    if (apply_credentials(profile.host, profile.serial, profile.access_code, response)) {
+        response.beginMap().key(WS_KEY_success).boolean(true).key(WS_KEY_host).str(profile.host);
+        response.key(WS_KEY_serial).str(profile.serial).end();
+    }
+}
+
+// 局域网中最近广播过的打印机，按最后见到的时间从新到旧
+// slot 为序列号相同的保存的打印机 (没有为 -1)，moved 为保存的地址与广播不同
+template <typename Enc>
+static void handle_discover(void *ctx, const WSArgs &args, Enc &response) {
+    static PrinterDiscovery::Printer printers[PRINTER_DISCOVERY_MAX];
+    Instance &instance = Instance::get();
+    size_t count = instance.printer_discovery->list(printers, PRINTER_DISCOVERY_MAX);
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    response.beginMap().key(WS_KEY_success).boolean(true).key(WS_KEY_printers).beginArray();
+    for (size_t i = 0; i < count; i++) {
+        const PrinterDiscovery::Printer &printer = printers[i];
+        PrinterProfile profile;
+        int slot = instance.printer_profiles->find(printer.serial);
+        bool moved = slot >= 0 && instance.printer_profiles->get(slot, profile) &&
+                     strcmp(profile.host, printer.host) != 0;
+        response.beginMap().key(WS_KEY_host).str(printer.host);
+        response.key(WS_KEY_serial).str(printer.serial);
+        response.key(WS_KEY_model).str(printer.model);
+        response.key(WS_KEY_name).str(printer.name);
+        response.key(WS_KEY_lan_only).boolean(printer.lan_only);
+        response.key(WS_KEY_slot).num(slot);
+        response.key(WS_KEY_moved).boolean(moved);
+        response.key(WS_KEY_age_ms).num(now_ms - printer.seen_ms).end();
+    }
+    response.end().end();
+}
+
+// 用户确认后把已保存的打印机 (档案或当前连接) 的地址改为广播中的地址，访问码不变
+template <typename Enc>
+static void handle_use_discovered(void *ctx, const WSArgs &args, Enc &response) {
+    static PrinterDiscovery::Printer printers[PRINTER_DISCOVERY_MAX];
+    Instance &instance = Instance::get();
+    SettingsStore &settings = *instance.settings;
+    PrinterProfiles &profiles = *instance.printer_profiles;
+    const char *serial = args.str(0);
+    size_t count = instance.printer_discovery->list(printers, PRINTER_DISCOVERY_MAX);
+    const PrinterDiscovery::Printer *printer = nullptr;
+    for (size_t i = 0; i < count && printer == nullptr; i++) {
+        if (strcmp(printers[i].serial, serial) == 0) {
+            printer = &printers[i];
+        }
+    }
+    if (printer == nullptr) {
+        ws_write_error(response, "Printer not discovered");
+        return;
+    }
+
+    PrinterProfile profile;
+    int slot = profiles.find(serial);
+    bool current = strcmp(serial, settings.str(SETTING_PRINTER_SERIAL)) == 0;
+    if (slot < 0 && !current) {
+        ws_write_error(response, "Printer not saved");
+        return;
+    }
+    if (slot >= 0 && profiles.get(slot, profile) && strcmp(profile.host, printer->host) != 0 &&
+        profiles.save(slot, profile.name, printer->host, profile.serial,
+                      profile.access_code) != ESP_OK) {
+        ws_write_error(response, "Failed to save printer profile");
+        return;
+    }
+    if (current && strcmp(printer->host, settings.str(SETTING_PRINTER_HOST)) != 0) {
+        if (settings.set(SETTING_PRINTER_HOST, printer->host) != ESP_OK) {
+            ws_write_error(response, "Failed to save printer credentials");
+            return;
+        }
+        instance.applyPrinter();
+    } else if (slot >= 0 && (settings.i32(SETTING_PRINTER_FANOUT) & (1u << slot))) {
+        instance.applyFanout();
+    }
+    response.beginMap().key(WS_KEY_success).boolean(true).key(WS_KEY_host).str(printer->host);
+    response.key(WS_KEY_slot).num(slot);
+    response.key(WS_KEY_active).boolean(current).end();
+}
+
+static const WSParam SESSION_PARAMS[] = {
+    {"session", WS_PARAM_INT, false},
+};
+// 各会话的连接和换料调度，会话 0 的 slot 为 -1
+template <typename Enc>
+static void handle_sessions(void *ctx, const WSArgs &args, Enc &response) {
+    Instance &instance = Instance::get();
+    const FilamentScheduler &scheduler = *instance.filament_scheduler;
+    FilamentScheduler::Stats stats = scheduler.stats();
+    response.beginMap().key(WS_KEY_success).boolean(true).key(WS_KEY_owner).num(scheduler.owner());
+    response.key(WS_KEY_waiting).num(scheduler.waiting());
+    response.key(WS_KEY_granted).num(stats.granted);
+    response.key(WS_KEY_queued).num(stats.queued);
+    response.key(WS_KEY_skipped).num(stats.skipped);
+    response.key(WS_KEY_max_wait_ms).num(stats.max_wait_ms);
+    response.key(WS_KEY_sessions).beginArray();
+    for (size_t session = 0; session < PRINTER_SESSION_MAX; session++) {
+        std::shared_ptr<BambuMQTT> mqtt = instance.printer_sessions->get(session);
+        if (!mqtt) {
+            continue;
+        }
+        BambuMQTT::Summary summary;
+        mqtt->summary(summary);
+        response.beginMap().key(WS_KEY_session).num(session);
+        response.key(WS_KEY_slot).num(instance.printer_sessions->profileOf(session));
+        response.key(WS_KEY_host).str(summary.ip);
+        response.key(WS_KEY_serial).str(summary.serial);
+        response.key(WS_KEY_connected).boolean(summary.connected);
+        response.key(WS_KEY_gcode_state).str(summary.gcode_state);
+        response.key(WS_KEY_tray_now).num(summary.tray_now);
+        response.key(WS_KEY_dropped).num(mqtt->getIngestStats().dropped).end();
+    }
+    response.end().end();
+}
+
+// 保存后立即打开或关闭附加会话，返回实际打开的会话数 (堆不足时少于 mask 中的槽位数)
+template <typename Enc>
+static void handle_fanout(void *ctx, const WSArgs &args, Enc &response) {
+    Instance &instance = Instance::get();
+    int mask = args.toInt(0, -1);
+    if (mask < 0 || mask >= (1 << PRINTER_PROFILE_MAX)) {
+        ws_write_error(response, "Invalid profile mask");
+        return;
+    }
+    if (instance.settings->set(SETTING_PRINTER_FANOUT, (int32_t)mask) != ESP_OK) {
+        ws_write_error(response, "Failed to save fanout");
+        return;
+    }
+    size_t opened = instance.applyFanout();
+    response.beginMap().key(WS_KEY_success).boolean(true).key(WS_KEY_mask).num(mask);
+    response.key(WS_KEY_sessions).num(opened).end();
+}
+
+static const WSParam GCODE_PARAMS[] = {
+    {"gcode", WS_PARAM_STRING, true},
+    {"session", WS_PARAM_INT, false},
+};
+static const WSParam SPEED_PARAMS[] = {
+    {"profile", WS_PARAM_STRING, true},
+    {"session", WS_PARAM_INT, false},
+};
+static const WSParam CREDENTIAL_PARAMS[] = {
+    {"host", WS_PARAM_STRING, true},
+    {"serial", WS_PARAM_STRING, true},
+    {"access_code", WS_PARAM_STRING, true},
+};
+
+static const WSParam MASK_PARAMS[] = {
+    {"mask", WS_PARAM_INT, true},
+};
+static const WSParam SERIAL_PARAMS[] = {
+    {"serial", WS_PARAM_STRING, true},
+};
+static const WSParam SLOT_PARAMS[] = {
+    {"slot", WS_PARAM_INT, true},
+};
+static const WSParam PROFILE_PARAMS[] = {
+    {"slot", WS_PARAM_INT, true},
+    {"name", WS_PARAM_STRING, false},
+    {"host", WS_PARAM_STRING, true},
+    {"serial", WS_PARAM_STRING, true},
+    {"access_code", WS_PARAM_STRING, true},
+};
+
+static const WSCommand PRINTER_COMMANDS[] = {
+    {"pause", WS_HANDLER(handle_pause), WS_PARAMS(SESSION_PARAMS)},
+    {"resume", WS_HANDLER(handle_resume), WS_PARAMS(SESSION_PARAMS)},
+    {"stop", WS_HANDLER(handle_stop), WS_PARAMS(SESSION_PARAMS)},
+    {"pushall", WS_HANDLER(handle_pushall), WS_PARAMS(SESSION_PARAMS)},
+    {"gcode", WS_HANDLER(handle_gcode), WS_PARAMS(GCODE_PARAMS)},
+    {"speed", WS_HANDLER(handle_speed), WS_PARAMS(SPEED_PARAMS)},
+};
+
+// 不经过打印机连接，ctx 为 nullptr
+static const WSCommand PROFILE_COMMANDS[] = {
+    {"profiles", WS_HANDLER(handle_profiles), nullptr, 0},
+    {"save_profile", WS_HANDLER(handle_save_profile), WS_PARAMS(PROFILE_PARAMS)},
+    {"delete_profile", WS_HANDLER(handle_delete_profile), WS_PARAMS(SLOT_PARAMS)},
+    {"select_profile", WS_HANDLER(handle_select_profile), WS_PARAMS(SLOT_PARAMS)},
+    {"discover", WS_HANDLER(handle_discover), nullptr, 0},
+    {"use_discovered", WS_HANDLER(handle_use_discovered), WS_PARAMS(SERIAL_PARAMS)},
+    {"sessions", WS_HANDLER(handle_sessions), nullptr, 0},
+    {"fanout", WS_HANDLER(handle_fanout), WS_PARAMS(MASK_PARAMS)},
+};
+
+static const WSCommand SETTING_COMMANDS[] = {
+    {"printer", WS_HANDLER(handle_credentials), WS_PARAMS(CREDENTIAL_PARAMS)},
+};
+
+bool ws_printer_register(WSDispatcher &dispatcher, BambuMQTT *mqtt) {
+    static const WSModule commands = {"printer", "action", nullptr, PRINTER_COMMANDS,
+                                      sizeof(PRINTER_COMMANDS) / sizeof(PRINTER_COMMANDS[0])};
+    static const WSModule profiles = {"printer", "action", nullptr, PROFILE_COMMANDS,
+                                      sizeof(PROFILE_COMMANDS) / sizeof(PROFILE_COMMANDS[0])};
+    static const WSModule settings = {"setting", "key", "Unknown setting key", SETTING_COMMANDS,
+                                      sizeof(SETTING_COMMANDS) / sizeof(SETTING_COMMANDS[0])};
+    return dispatcher.add(commands, mqtt) && dispatcher.add(profiles, nullptr) &&
+           dispatcher.add(settings, nullptr);
+}
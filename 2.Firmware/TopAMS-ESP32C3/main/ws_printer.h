@@ -0,0 +1,31 @@
+#pragma once
+
+#include "ws_dispatch.h"
+
+class BambuMQTT;
+
+/**
+ * @brief 注册 {"type": "printer", "action": ...} 命令，转发给打印机
+ *
+ * action:
+ *   pause / resume / stop   打印控制
+ *   pushall                 请求打印机上报完整状态
+ *   gcode                   {"gcode": "G28\n..."}，逐行执行
+ *   speed                   {"profile": "1"-"4"}，静音 / 标准 / 运动 / 狂暴
+ * 以上命令可带 {"session": n} 发给同时连接的其他打印机，省略时为当前打印机 (会话 0)。
+ * 成功时返回 {"success": true, "sequence_id": n}，打印机的回复不等待。
+ * 以下 action 不经过打印机连接：
+ *   profiles                列出保存的打印机 (不含访问码) 和当前连接的槽位 (active)
+ *   save_profile            {"slot", "name" (可选), "host", "serial", "access_code"}
+ *   delete_profile          {"slot"}
+ *   select_profile          {"slot"}，设为当前打印机并重新连接
+ *   discover                局域网中最近广播过的打印机 (SSDP)，moved 为保存的地址已变化
+ *   use_discovered          {"serial"}，把保存的打印机的地址改为广播中的地址并重新连接；
+ *                           广播没有认证，只在用户确认后更新
+ *   sessions                各打印机会话的连接状态，以及占用电机的会话 (owner) 和排队数
+ *   fanout                  {"mask"}，同时连接的保存的打印机 (bit n 为槽位 n)
+ * 另外注册 {"type": "setting", "key": "printer", "host", "serial", "access_code"}，
+ * 三项作为一组保存，随即重新连接。
+ * @param mqtt 为 nullptr 时使用 Instance 的连接
+ */
+bool ws_printer_register(WSDispatcher &dispatcher, BambuMQTT *mqtt = nullptr);
@@ -0,0 +1,353 @@
+#include "ws_push.h"
+#include "esp_log.h"
+#include "filament_changer.h"
+#include "ws_cbor.h"
+#include <string.h>
+
+static const char *TAG = "[WSPush]";
+
+// 所有托盘
+static constexpr uint16_t ALL_TRAYS = (1u << (BAMBU_MAX_AMS * BAMBU_TRAYS_PER_AMS)) - 1;
+
+WSPush::WSPush()
+    : status_{}, sessions_(0), motors_{FILAMENT_PHASE_IDLE, -1, -1, 0, 0, -1}, server_(nullptr),
+      filaments_(nullptr), work_queued_(false), lock_(xSemaphoreCreateMutex()),
+      timer_(nullptr) {
+    for (auto &client : clients_) {
+        client = {-1, 0, 0, {}, {}, 0, WS_ENCODING_JSON};
+    }
+    esp_timer_create_args_t args = {};
+    args.callback = timer_callback;
+    args.arg = this;
+    args.name = "ws_push";
+    if (esp_timer_create(&args, &timer_) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create push timer");
+    }
+}
+
+WSPush::~WSPush() {
+    if (timer_) {
+        esp_timer_stop(timer_);
+        esp_timer_delete(timer_);
+    }
+    vSemaphoreDelete(lock_);
+}
+
+void WSPush::attach(httpd_handle_t server, const FilamentManager *filaments) {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    server_ = server;
+    filaments_ = filaments;
+    work_queued_ = false;
+    if (server == nullptr) {
+        for (auto &client : clients_) {
+            client = {-1, 0, 0, {}, {}, 0, WS_ENCODING_JSON};
+        }
+    }
+    xSemaphoreGive(lock_);
+}
+
+WSPush::Client *WSPush::findClient(int fd) {
+    for (auto &client : clients_) {
+        if (client.fd == fd) {
+            return &client;
+        }
+    }
+    return nullptr;
+}
+
+bool WSPush::subscribe(int fd, uint8_t topics, WSEncoding encoding) {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    Client *client = findClient(fd);
+    if (client == nullptr) {
+        client = findClient(-1);
+        if (client == nullptr) {
+            xSemaphoreGive(lock_);
+            ESP_LOGW(TAG, "Too many subscribers, fd %d rejected", fd);
+            return false;
+        }
+        *client = {fd, 0, 0, {}, {}, 0, encoding};
+    }
+    // 新订阅的主题先推送完整快照
+    uint8_t added = topics & ~client->topics;
+    client->topics |= topics;
+    client->pending |= added;
+    for (size_t session = 0; (added & WS_TOPIC_STATUS) && session < WS_PUSH_MAX_SESSIONS;
+         session++) {
+        if (sessions_ & (1u << session)) {
+            client->status_fields[session] = ~0u;
+            client->tray_fields[session] = ALL_TRAYS;
+        }
+    }
+    xSemaphoreGive(lock_);
+    if (added) {
+        schedule();
+    }
+    return true;
+}
+
+void WSPush::unsubscribe(int fd, uint8_t topics) {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    Client *client = findClient(fd);
+    if (client) {
+        client->topics &= ~topics;
+        client->pending &= client->topics;
+        if (client->topics == 0) {
+            client->fd = -1;
+        }
+    }
+    xSemaphoreGive(lock_);
+}
+
+void WSPush::removeClient(int fd) {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    Client *client = findClient(fd);
+    if (client) {
+        *client = {-1, 0, 0, {}, {}, 0, WS_ENCODING_JSON};
+    }
+    xSemaphoreGive(lock_);
+}
+
+// 调用者持有 lock_，返回是否有客户端订阅了该主题
+bool WSPush::markPending(uint8_t topic, size_t session, uint32_t status_fields,
+                         uint16_t tray_fields) {
+    bool any = false;
+    for (auto &client : clients_) {
+        if (client.fd >= 0 && (client.topics & topic)) {
+            client.pending |= topic;
+            client.status_fields[session] |= status_fields;
+            client.tray_fields[session] |= tray_fields;
+            any = true;
+        }
+    }
+    return any;
+}
+
+// ingest 任务中调用，只复制状态并累加脏位
+void WSPush::onStatus(size_t session, const BambuStatus &status) {
+    if (session >= WS_PUSH_MAX_SESSIONS) {
+        return;
+    }
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    status_[session] = status;
+    sessions_ |= 1u << session;
+    bool any = markPending(WS_TOPIC_STATUS, session, status.dirty, status.tray_dirty);
+    xSemaphoreGive(lock_);
+    if (any) {
+        schedule();
+    }
+}
+
+void WSPush::removeSession(size_t session) {
+    if (session >= WS_PUSH_MAX_SESSIONS) {
+        return;
+    }
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    status_[session] = BambuStatus();
+    sessions_ &= ~(1u << session);
+    for (auto &client : clients_) {
+        client.status_fields[session] = 0;
+        client.tray_fields[session] = 0;
+    }
+    xSemaphoreGive(lock_);
+}
+
+void WSPush::publishFilaments() {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    bool any = markPending(WS_TOPIC_FILAMENTS, 0, 0, 0);
+    xSemaphoreGive(lock_);
+    if (any) {
+        schedule();
+    }
+}
+
+void WSPush::publishMotors(const MotorState &state) {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    motors_ = state;
+    bool any = markPending(WS_TOPIC_MOTORS, 0, 0, 0);
+    xSemaphoreGive(lock_);
+    if (any) {
+        schedule();
+    }
+}
+
+// 已有待执行的推送时不重复排队
+void WSPush::schedule() {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    bool queue = server_ != nullptr && !work_queued_;
+    work_queued_ = work_queued_ || queue;
+    httpd_handle_t server = server_;
+    xSemaphoreGive(lock_);
+    if (queue && httpd_queue_work(server, push_work, this) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to queue push work");
+        xSemaphoreTake(lock_, portMAX_DELAY);
+        work_queued_ = false;
+        xSemaphoreGive(lock_);
+    }
+}
+
+void WSPush::timer_callback(void *arg) { static_cast<WSPush *>(arg)->schedule(); }
+
+// httpd 任务中执行：取出到期客户端的待推送内容，间隔未到的客户端由定时器稍后重试
+void WSPush::push_work(void *arg) {
+    WSPush *self = static_cast<WSPush *>(arg);
+    Job jobs[WS_PUSH_MAX_CLIENTS];
+    size_t job_count = 0;
+    int64_t now = esp_timer_get_time();
+    int64_t next_due = INT64_MAX;
+
+    xSemaphoreTake(self->lock_, portMAX_DELAY);
+    self->work_queued_ = false;
+    self->motors_snapshot_ = self->motors_;
+    for (auto &client : self->clients_) {
+        if (client.fd < 0 || client.pending == 0) {
+            continue;
+        }
+        int64_t due = client.last_push_us + WS_PUSH_MIN_INTERVAL_MS * 1000LL;
+        if (client.last_push_us != 0 && due > now) {
+            next_due = due < next_due ? due : next_due;
+            continue;
+        }
+        Job &job = jobs[job_count++];
+        job = {client.fd, client.pending, {}, {}, client.encoding};
+        memcpy(job.status_fields, client.status_fields, sizeof(job.status_fields));
+        memcpy(job.tray_fields, client.tray_fields, sizeof(job.tray_fields));
+        client.pending = 0;
+        memset(client.status_fields, 0, sizeof(client.status_fields));
+        memset(client.tray_fields, 0, sizeof(client.tray_fields));
+        client.last_push_us = now;
+    }
+    xSemaphoreGive(self->lock_);
+
+    for (size_t i = 0; i < job_count; i++) {
+        self->sendJob(jobs[i]);
+    }
+    if (next_due != INT64_MAX && self->timer_) {
+        esp_timer_stop(self->timer_);
+        esp_timer_start_once(self->timer_, next_due - now);
+    }
+}
+
+void WSPush::sendJob(const Job &job) {
+    if (job.encoding == WS_ENCODING_CBOR) {
+        sendJobAs<CborWriter>(job);
+    } else {
+        sendJobAs<WSJsonWriter>(job);
+    }
+}
+
+template <typename Enc> void WSPush::sendJobAs(const Job &job) {
+    httpd_ws_type_t type =
+        job.encoding == WS_ENCODING_CBOR ? HTTPD_WS_TYPE_BINARY : HTTPD_WS_TYPE_TEXT;
+    // 超过单帧长度的主题跳过，其余主题照常发送；发送失败时客户端已被移除
+    uint8_t overflow = 0;
+    Job kept = job; // 未发出的会话状态
+    for (size_t session = 0; (job.topics & WS_TOPIC_STATUS) && session < WS_PUSH_MAX_SESSIONS;
+         session++) {
+        uint32_t fields = job.status_fields[session];
+        uint16_t trays = job.tray_fields[session];
+        kept.status_fields[session] = 0;
+        kept.tray_fields[session] = 0;
+        // 只有托盘脏位而没有具体托盘时不推送
+        if ((fields & ~BAMBU_FIELD_AMS_TRAY) == 0 && trays == 0) {
+            continue;
+        }
+        xSemaphoreTake(lock_, portMAX_DELAY);
+        status_snapshot_ = status_[session];
+        xSemaphoreGive(lock_);
+        Enc w(buffer_, sizeof(buffer_));
+        ws_write_status(w, status_snapshot_, session, fields, trays);
+        if (!w.ok()) {
+            ESP_LOGW(TAG, "Status frame exceeds %d bytes", WS_PUSH_BUFFER_SIZE);
+            overflow |= WS_TOPIC_STATUS;
+            kept.status_fields[session] = fields;
+            kept.tray_fields[session] = trays;
+        } else if (!send(job.fd, type, w.data(), w.length())) {
+            return;
+        }
+    }
+    if (job.topics & WS_TOPIC_MOTORS) {
+        Enc w(buffer_, sizeof(buffer_));
+        ws_write_motors(w, motors_snapshot_);
+        if (!w.ok()) {
+            ESP_LOGW(TAG, "Motors frame exceeds %d bytes", WS_PUSH_BUFFER_SIZE);
+            overflow |= WS_TOPIC_MOTORS;
+        } else if (!send(job.fd, type, w.data(), w.length())) {
+            return;
+        }
+    }
+    if (job.topics & WS_TOPIC_FILAMENTS) {
+        Enc w(buffer_, sizeof(buffer_));
+        ws_write_filaments(w, filaments_);
+        if (!w.ok()) {
+            // 超过单帧长度，只通知变化
+            ESP_LOGW(TAG, "Filament table exceeds %d bytes", WS_PUSH_BUFFER_SIZE);
+            w = Enc(buffer_, sizeof(buffer_));
+            w.beginMap().key(WS_KEY_topic).str("filaments").key(WS_KEY_truncated).boolean(true);
+            w.end();
+        }
+        if (!send(job.fd, type, w.data(), w.length())) {
+            return;
+        }
+    }
+    if (overflow) {
+        keepPending(kept, overflow);
+    }
+}
+
+// 未发出的主题和字段放回待推送，随下一次变化的推送重试，不立即重新排队
+void WSPush::keepPending(const Job &job, uint8_t topics) {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    Client *client = findClient(job.fd);
+    if (client) {
+        client->pending |= topics & client->topics;
+        for (size_t session = 0; (topics & WS_TOPIC_STATUS) && session < WS_PUSH_MAX_SESSIONS;
+             session++) {
+            client->status_fields[session] |= job.status_fields[session];
+            client->tray_fields[session] |= job.tray_fields[session];
+        }
+    }
+    xSemaphoreGive(lock_);
+}
+
+// 发送失败或连接已不是 WebSocket 时移除客户端
+bool WSPush::send(int fd, httpd_ws_type_t type, const char *payload, size_t len) {
+    if (httpd_ws_get_fd_info(server_, fd) != HTTPD_WS_CLIENT_WEBSOCKET) {
+        removeClient(fd);
+        return false;
+    }
+    httpd_ws_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.type = type;
+    frame.payload = (uint8_t *)payload;
+    frame.len = len;
+    esp_err_t err = httpd_ws_send_frame_async(server_, fd, &frame);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Push to fd %d failed: %s", fd, esp_err_to_name(err));
+        removeClient(fd);
+        return false;
+    }
+    return true;
+}
+
+uint8_t WSPush::parseTopics(const WSJsonValue &topics) {
+    if (!topics.isArray()) {
+        return 0;
+    }
+    uint8_t mask = 0;
+    for (WSJsonValue item = topics.first(); item; item = item.next()) {
+        if (!item.isString()) {
+            return 0;
+        }
+        std::string_view name = item.view();
+        if (name == "status") {
+            mask |= WS_TOPIC_STATUS;
+        } else if (name == "filaments") {
+            mask |= WS_TOPIC_FILAMENTS;
+        } else if (name == "motors") {
+            mask |= WS_TOPIC_MOTORS;
+        } else {
+            return 0;
+        }
+    }
+    return mask;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "esp_http_server.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "model/bambu_status.h"
+#include "ws_json.h"
+#include "ws_topic.h"
+#include <stdint.h>
+#include <string_view>
+
+class FilamentManager;
+
+#define WS_PUSH_MAX_CLIENTS 7        // 与 httpd 默认 max_open_sockets 相同
+#define WS_PUSH_MIN_INTERVAL_MS 250  // 同一客户端两次推送的最小间隔
+#define WS_PUSH_BUFFER_SIZE 4096     // 单帧推送的最大长度
+#define WS_PUSH_MAX_SESSIONS 4       // 与 PRINTER_SESSION_MAX 相同
+
+// 推送主题，订阅时可组合
+enum WSTopic : uint8_t {
+    WS_TOPIC_STATUS = 1u << 0,    // "status"，各打印机会话状态的变化字段
+    WS_TOPIC_FILAMENTS = 1u << 1, // "filaments"，耗材表变化后推送整表
+    WS_TOPIC_MOTORS = 1u << 2,    // "motors"，换料阶段和驱动中的电机
+};
+
+/**
+ * @brief WebSocket 订阅推送
+ *
+ * 客户端发送 {"type":"subscribe","topics":["status",...]} 订阅，订阅后先收到一次完整快照，
+ * 之后只在数据变化时收到推送 (以 "topams.cbor.v1" 子协议连接时为同样字段的 CBOR 二进制帧)：
+ *   {"topic":"status","session":0, <变化的字段>}
+ *   {"topic":"filaments","filaments":[{"id":..,"motor_id":..,"metadata":".."}]}
+ *   {"topic":"motors","phase":"feed","from":0,"to":3,"completed":..,"aborted":..,"session":0}
+ *
+ * status 按会话分别推送，订阅时的快照包含所有已有上报的会话。
+ * 发布方 (ingest 任务、httpd 任务等) 只累加各客户端待推送的字段，实际发送在 httpd 任务中
+ * 通过 httpd_ws_send_frame_async 完成。同一客户端两次推送至少间隔 WS_PUSH_MIN_INTERVAL_MS，
+ * 间隔内的变化合并到下一次推送。
+ */
+class WSPush {
+public:
+    using MotorState = WSMotorState;
+
+    WSPush();
+    ~WSPush();
+
+    /**
+     * @brief 绑定 httpd 实例，在 httpd_start 之后调用；传入 nullptr 时清空所有订阅
+     * @param filaments 推送耗材表时读取，只在 httpd 任务中访问
+     */
+    void attach(httpd_handle_t server, const FilamentManager *filaments);
+
+    /**
+     * @brief 增加订阅并推送订阅主题的完整快照
+     * @param encoding 推送帧的编码，与该连接握手时协商的一致
+     * @return false 客户端数已满
+     */
+    bool subscribe(int fd, uint8_t topics, WSEncoding encoding = WS_ENCODING_JSON);
+    void unsubscribe(int fd, uint8_t topics);
+
+    /**
+     * @brief 连接关闭时调用
+     */
+    void removeClient(int fd);
+
+    // 以下发布接口可在任意任务中调用
+    void onStatus(size_t session, const BambuStatus &status);
+    void publishFilaments();
+    void publishMotors(const MotorState &state);
+
+    /**
+     * @brief 会话关闭时调用，丢弃其状态，之后订阅的快照不再包含该会话
+     */
+    void removeSession(size_t session);
+
+    /**
+     * @brief 解析主题数组 ["status", ...]
+     * @return WSTopic 位掩码，包含未知主题时返回 0
+     */
+    static uint8_t parseTopics(const WSJsonValue &topics);
+
+private:
+    struct Client {
+        int fd;                 // -1 为空
+        uint8_t topics;         // 已订阅
+        uint8_t pending;        // 待推送
+        uint32_t status_fields[WS_PUSH_MAX_SESSIONS]; // 按会话，待推送的 BambuStatusField
+        uint16_t tray_fields[WS_PUSH_MAX_SESSIONS];   // 按会话，待推送的托盘
+        int64_t last_push_us;
+        WSEncoding encoding;
+    };
+
+    // 在 httpd 任务中发送的一次推送
+    struct Job {
+        int fd;
+        uint8_t topics;
+        uint32_t status_fields[WS_PUSH_MAX_SESSIONS];
+        uint16_t tray_fields[WS_PUSH_MAX_SESSIONS];
+        WSEncoding encoding;
+    };
+
+    Client *findClient(int fd);
+    bool markPending(uint8_t topic, size_t session, uint32_t status_fields, uint16_t tray_fields);
+    void keepPending(const Job &job, uint8_t topics);
+    void schedule();
+    void sendJob(const Job &job);
+    template <typename Enc> void sendJobAs(const Job &job);
+    bool send(int fd, httpd_ws_type_t type, const char *payload, size_t len);
+    static void push_work(void *arg);
+    static void timer_callback(void *arg);
+
+    Client clients_[WS_PUSH_MAX_CLIENTS];
+    BambuStatus status_[WS_PUSH_MAX_SESSIONS]; // 各会话最近一次合并后的状态
+    uint8_t sessions_;                         // 按会话，已有上报
+    MotorState motors_;
+    httpd_handle_t server_;
+    const FilamentManager *filaments_;
+    bool work_queued_;
+    SemaphoreHandle_t lock_; // 保护以上状态
+    esp_timer_handle_t timer_;
+
+    // 只在 httpd 任务中使用，避免占用栈
+    BambuStatus status_snapshot_; // 正在编码的会话
+    MotorState motors_snapshot_;
+    char buffer_[WS_PUSH_BUFFER_SIZE];
+};
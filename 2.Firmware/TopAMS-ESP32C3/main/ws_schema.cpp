@@ -0,0 +1,74 @@
+#include "ws_schema.h"
+#include "json_stream.h"
+
+#define WS_KEY_LIMIT 128     // 编号上限，保持编码不超过 2 字节
+#define WS_KEY_HASH_SIZE 256 // 2 的幂且不小于 2 * 键数
+
+namespace {
+
+struct KeyEntry {
+    uint8_t id;
+    const char *name;
+};
+
+constexpr KeyEntry entries[] = {
+#define WS_KEY(id, name) {id, #name},
+#include "ws_schema.def"
+#undef WS_KEY
+};
+
+struct KeyTables {
+    const char *names[WS_KEY_LIMIT];   // 编号 -> 名称
+    uint8_t slots[WS_KEY_HASH_SIZE];   // 名称哈希 -> 编号，0 为空槽
+};
+
+constexpr KeyTables make_tables() {
+    KeyTables tables{};
+    for (const KeyEntry &entry : entries) {
+        tables.names[entry.id] = entry.name;
+        uint32_t slot = json_path_hash(entry.name) & (WS_KEY_HASH_SIZE - 1);
+        while (tables.slots[slot] != 0) {
+            slot = (slot + 1) & (WS_KEY_HASH_SIZE - 1);
+        }
+        tables.slots[slot] = entry.id;
+    }
+    return tables;
+}
+
+// 编号唯一且在范围内，名称不重复
+constexpr bool valid_entries() {
+    for (size_t i = 0; i < sizeof(entries) / sizeof(entries[0]); i++) {
+        if (entries[i].id == 0 || entries[i].id >= WS_KEY_LIMIT) {
+            return false;
+        }
+        for (size_t j = 0; j < i; j++) {
+            if (entries[i].id == entries[j].id ||
+                std::string_view(entries[i].name) == std::string_view(entries[j].name)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(valid_entries(), "ws_schema.def: duplicate or out of range key");
+static_assert(sizeof(entries) / sizeof(entries[0]) * 2 <= WS_KEY_HASH_SIZE,
+              "WS_KEY_HASH_SIZE too small");
+
+constexpr KeyTables tables = make_tables();
+
+} // namespace
+
+const char *ws_key_name(uint32_t id) { return id < WS_KEY_LIMIT ? tables.names[id] : nullptr; }
+
+WSKey ws_key_find(std::string_view name) {
+    uint32_t slot = json_path_hash(name) & (WS_KEY_HASH_SIZE - 1);
+    while (tables.slots[slot] != 0) {
+        uint8_t id = tables.slots[slot];
+        if (name == tables.names[id]) {
+            return static_cast<WSKey>(id);
+        }
+        slot = (slot + 1) & (WS_KEY_HASH_SIZE - 1);
+    }
+    return WS_KEY_NONE;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <string_view>
+
+// /ws 的子协议，握手时协商后该连接的请求、响应和推送都使用 CBOR
+#define WS_PROTOCOL_CBOR "topams.cbor.v1"
+
+enum WSEncoding : uint8_t {
+    WS_ENCODING_JSON, // 文本帧
+    WS_ENCODING_CBOR, // 二进制帧，键按 ws_schema.def 编码为整数
+};
+
+// 协议中的键，编号见 ws_schema.def
+enum WSKey : uint8_t {
+    WS_KEY_NONE = 0,
+#define WS_KEY(id, name) WS_KEY_##name = id,
+#include "ws_schema.def"
+#undef WS_KEY
+};
+
+/**
+ * @brief 键编号对应的名称
+ * @return 未知编号返回 nullptr
+ */
+const char *ws_key_name(uint32_t id);
+
+/**
+ * @brief 按名称查找键编号 (哈希表，编译期生成)
+ * @return 不在键表中时返回 WS_KEY_NONE
+ */
+WSKey ws_key_find(std::string_view name);
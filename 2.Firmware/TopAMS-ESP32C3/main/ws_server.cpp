@@ -14,29 +14,35 @@
 #include <esp_wifi.h>
 #include <nvs_flash.h>
 #include <sys/param.h>
+#include <unistd.h>
 
 #include "filament_manager.h"
 #include "instance.h"
+#include "ws_filament.h"
 #include "ws_server.h"
 #include <esp_http_server.h>
 
 const char *WSServer::TAG = "[WebSocketServer]";
 
-void handle_ws_message(const char *message, std::string &response);
-
-WSServer::WSServer() : server(nullptr) {}
+WSServer::WSServer(FilamentManager &filaments) : server(nullptr), filaments(filaments) {
+    registerCommands();
+}
 WSServer::~WSServer() { stop(); }
 
 esp_err_t WSServer::start() {
     if (!server) {
         server = start_webserver();
-        return server ? ESP_OK : ESP_FAIL;
+        if (!server) {
+            return ESP_FAIL;
+        }
+        push.attach(server, &filaments);
     }
     return ESP_OK;
 }
 
 esp_err_t WSServer::stop() {
     if (server) {
+        push.attach(nullptr, nullptr);
         esp_err_t ret = stop_webserver(server);
         if (ret == ESP_OK) {
             server = nullptr;
@@ -48,113 +54,53 @@ esp_err_t WSServer::stop() {
 
 httpd_handle_t WSServer::getHandle() const { return server; }
 
+WSPush &WSServer::getPush() { return push; }
+
+WSFramePool::Stats WSServer::getFrameStats() const { return frames.stats(); }
+
+WSEncoding WSServer::getEncoding(int fd) const { return frames.encoding(fd); }
+
+WSDispatcher &WSServer::getDispatcher() { return dispatcher; }
+
 void WSServer::onConnect(esp_event_base_t event_base, int32_t event_id, void *event_data) {
     if (server == nullptr) {
         ESP_LOGI(TAG, "Starting webserver");
-        server = start_webserver();
+        start();
     }
 }
 
 void WSServer::onDisconnect(esp_event_base_t event_base, int32_t event_id, void *event_data) {
     if (server) {
         ESP_LOGI(TAG, "Stopping webserver");
-        if (stop_webserver(server) == ESP_OK) {
-            server = nullptr;
-        } else {
+        if (stop() != ESP_OK) {
             ESP_LOGE(TAG, "Failed to stop http server");
         }
     }
 }
 
 // 静态成员实现
-void WSServer::ws_async_send(void *arg) {
-    static const char *data = "Async data";
-    async_resp_arg *resp_arg = (async_resp_arg *)arg;
-    httpd_handle_t hd = resp_arg->hd;
-    int fd = resp_arg->fd;
-    httpd_ws_frame_t ws_pkt;
-    memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
-    ws_pkt.payload = (uint8_t *)data;
-    ws_pkt.len = strlen(data);
-    ws_pkt.type = HTTPD_WS_TYPE_TEXT;
-    httpd_ws_send_frame_async(hd, fd, &ws_pkt);
-    free(resp_arg);
-}
-
-esp_err_t WSServer::trigger_async_send(httpd_handle_t handle, httpd_req_t *req) {
-    async_resp_arg *resp_arg = (async_resp_arg *)malloc(sizeof(async_resp_arg));
-    if (resp_arg == NULL) {
-        return ESP_ERR_NO_MEM;
-    }
-    resp_arg->hd = req->handle;
-    resp_arg->fd = httpd_req_to_sockfd(req);
-    esp_err_t ret = httpd_queue_work(handle, ws_async_send, resp_arg);
-    if (ret != ESP_OK) {
-        free(resp_arg);
-    }
-    return ret;
+// 连接关闭时取消该连接的订阅并归还帧缓冲区，设置 close_fn 后需要自行关闭 socket
+void WSServer::close_handler(httpd_handle_t hd, int sockfd) {
+    WSServer &self = *Instance::get().ws_server;
+    self.push.removeClient(sockfd);
+    self.frames.release(sockfd);
+    close(sockfd);
 }
 
 esp_err_t WSServer::echo_handler(httpd_req_t *req) {
     if (req->method == HTTP_GET) {
         ESP_LOGI(TAG, "Handshake done, the new connection was opened");
+        Instance::get().ws_server->frames.open(req);
         return ESP_OK;
     }
-
-    httpd_ws_frame_t ws_pkt;
-    uint8_t *buf = NULL;
-    memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
-    ws_pkt.type = HTTPD_WS_TYPE_TEXT;
-
-    // 获取 WebSocket 帧长度
-    esp_err_t ret = httpd_ws_recv_frame(req, &ws_pkt, 0);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "httpd_ws_recv_frame failed to get frame len with %d", ret);
-        return ret;
-    }
-
-    ESP_LOGI(TAG, "frame len is %d", ws_pkt.len);
-    if (ws_pkt.len) {
-        buf = (uint8_t *)calloc(1, ws_pkt.len + 1); // 为 NULL 终止符分配空间
-        if (buf == NULL) {
-            ESP_LOGE(TAG, "Failed to calloc memory for buf");
-            return ESP_ERR_NO_MEM;
-        }
-
-        ws_pkt.payload = (uint8_t *)buf;
-        ret = httpd_ws_recv_frame(req, &ws_pkt, ws_pkt.len);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "httpd_ws_recv_frame failed with %d", ret);
-            free(buf);
-            return ret;
-        }
-
-        ESP_LOGI(TAG, "Got packet with message: %s", ws_pkt.payload);
-
-        std::string response;
-        // 处理 WebSocket 消息
-        handle_ws_message(reinterpret_cast<const char *>(ws_pkt.payload), response);
-
-        // 发送响应
-        httpd_ws_frame_t response_pkt;
-        memset(&response_pkt, 0, sizeof(httpd_ws_frame_t));
-        response_pkt.type = HTTPD_WS_TYPE_TEXT;
-        response_pkt.payload = (uint8_t *)response.c_str();
-        response_pkt.len = response.length();
-
-        ret = httpd_ws_send_frame(req, &response_pkt);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "httpd_ws_send_frame failed with %d", ret);
-        }
-    }
-
-    free(buf);
-    return ret;
+    WSServer &self = *Instance::get().ws_server;
+    return self.frames.handle(req, WS_HANDLER(WSDispatcher::handle), &self.dispatcher);
 }
 
 httpd_handle_t WSServer::start_webserver() {
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.close_fn = close_handler;
 
     // Start the httpd server
     ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
@@ -165,7 +111,9 @@ httpd_handle_t WSServer::start_webserver() {
                                        .method = HTTP_GET,
                                        .handler = echo_handler,
                                        .user_ctx = NULL,
-                                       .is_websocket = true};
+                                       .is_websocket = true,
+                                       .handle_ws_control_frames = false,
+                                       .supported_subprotocol = WS_PROTOCOL_CBOR};
         httpd_register_uri_handler(server, &ws);
         return server;
     }
@@ -179,145 +127,51 @@ esp_err_t WSServer::stop_webserver(httpd_handle_t server) {
     return httpd_stop(server);
 }
 
-static FilamentManager filamentManager;
-
-void handle_ws_message(const char *message, std::string &response) {
-    cJSON *root = cJSON_Parse(message);
-    if (!root) {
-        response = R"({"error": "Invalid JSON"})";
-        return;
+// {"type": "subscribe", "topics": ["status", "filaments", "motors"]}，unsubscribe 相同
+template <typename Enc>
+static void handle_subscribe(void *ctx, const WSArgs &args, Enc &response) {
+    WSServer &server = *static_cast<WSServer *>(ctx);
+    uint8_t topics = WSPush::parseTopics(args.value(0));
+    if (topics == 0) {
+        ws_write_error(response, "Invalid topics");
+    } else if (server.getPush().subscribe(args.fd, topics, server.getEncoding(args.fd))) {
+        response.beginMap().key(WS_KEY_success).boolean(true).end();
+    } else {
+        ws_write_error(response, "Too many subscribers");
     }
-    cJSON *type = cJSON_GetObjectItem(root, "type");
-    if (!cJSON_IsString(type)) {
-        response = R"({"error": "Missing or invalid action"})";
-        cJSON_Delete(root);
+}
+
+template <typename Enc>
+static void handle_unsubscribe(void *ctx, const WSArgs &args, Enc &response) {
+    uint8_t topics = WSPush::parseTopics(args.value(0));
+    if (topics == 0) {
+        ws_write_error(response, "Invalid topics");
         return;
     }
+    static_cast<WSServer *>(ctx)->getPush().unsubscribe(args.fd, topics);
+    response.beginMap().key(WS_KEY_success).boolean(true).end();
+}
 
-    std::string_view type_char = type->valuestring;
-    if (type_char == "setting") {
-        cJSON *key = cJSON_GetObjectItem(root, "key");
-        if (!cJSON_IsString(key)) {
-            response = R"({"error": "Missing or invalid key"})";
-            cJSON_Delete(root);
-            return;
-        }
-        std::string_view key_char = key->valuestring;
-        if (key_char == "wifi_ssid") {
-            cJSON *value = cJSON_GetObjectItem(root, "value");
-            if (cJSON_IsString(value)) {
-                // Save WiFi SSID to NVS or appropriate storage
-                response = R"({"success": true})";
-            } else {
-                response = R"({"error": "Invalid value for wifi_ssid"})";
-            }
-        } else if (key_char == "wifi_password") {
-            cJSON *value = cJSON_GetObjectItem(root, "value");
-            if (cJSON_IsString(value)) {
-                // Save WiFi password to NVS or appropriate storage
-                response = R"({"success": true})";
-            } else {
-                response = R"({"error": "Invalid value for wifi_password"})";
-            }
-        } else {
-            response = R"({"error": "Unknown setting key"})";
-        }
+static const WSParam TOPIC_PARAMS[] = {
+    {"topics", WS_PARAM_ARRAY, true},
+};
 
-    } else if (type_char == "system") {
-        cJSON *action = cJSON_GetObjectItem(root, "action");
-        if (!cJSON_IsString(action)) {
-            response = R"({"error": "Missing or invalid action"})";
-            cJSON_Delete(root);
-            return;
-        }
+static const WSCommand SUBSCRIBE_COMMANDS[] = {
+    {"", WS_HANDLER(handle_subscribe), WS_PARAMS(TOPIC_PARAMS)},
+};
 
-        std::string_view action_char = action->valuestring;
-        if (action_char == "reboot") {
-            response = R"({"success": true, "message": "Rebooting..."})";
-            esp_restart();
-        } else if (action_char == "reconnect_wifi") {
-            if (Instance::get().wifi_manager->reconnect()) {
-                response = R"({"success": true, "message": "Reconnecting to WiFi..."})";
-            } else {
-                response = R"({"error": "Failed to initiate WiFi reconnection"})";
-            }
-        } else if (action_char == "get_mac") {
-            uint8_t mac[6];
-            esp_read_mac(mac, ESP_MAC_WIFI_STA);
-            char mac_str[18];
-            snprintf(mac_str, sizeof(mac_str), "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1],
-                     mac[2], mac[3], mac[4], mac[5]);
-            response = std::string(R"({"success": true, "mac": ")") + mac_str + R"("})";
-        } else {
-            response = R"({"error": "Unknown action"})";
-        }
-    } else if (type_char == "filament") {
-        cJSON *action = cJSON_GetObjectItem(root, "action");
-        if (!cJSON_IsString(action)) {
-            response = R"({"error": "Missing or invalid action"})";
-            cJSON_Delete(root);
-            return;
-        }
+static const WSCommand UNSUBSCRIBE_COMMANDS[] = {
+    {"", WS_HANDLER(handle_unsubscribe), WS_PARAMS(TOPIC_PARAMS)},
+};
 
-        std::string_view action_char = action->valuestring;
-        if (action_char == "add") {
-            cJSON *motor_id = cJSON_GetObjectItem(root, "motor_id");
-            cJSON *metadata = cJSON_GetObjectItem(root, "metadata");
-            if (cJSON_IsNumber(motor_id) && cJSON_IsString(metadata)) {
-                int id = filamentManager.addFilament(motor_id->valueint, metadata->valuestring);
-                if (id != -1) {
-                    response = R"({"success": true, "id": )" + std::to_string(id) + "}";
-                } else {
-                    response = R"({"error": "Motor ID already in use"})";
-                }
-            } else {
-                response = R"({"error": "Invalid parameters"})";
-            }
-        } else if (action_char == "remove") {
-            cJSON *id = cJSON_GetObjectItem(root, "id");
-            if (cJSON_IsNumber(id)) {
-                bool success = filamentManager.removeFilament(id->valueint);
-                response = success ? R"({"success": true})" : R"({"error": "ID not found"})";
-            } else {
-                response = R"({"error": "Invalid parameters"})";
-            }
-        } else if (action_char == "update") {
-            cJSON *id = cJSON_GetObjectItem(root, "id");
-            cJSON *motor_id = cJSON_GetObjectItem(root, "motor_id");
-            cJSON *metadata = cJSON_GetObjectItem(root, "metadata");
-            if (cJSON_IsNumber(id)) {
-                bool success = filamentManager.updateFilament(
-                    id->valueint, cJSON_IsNumber(motor_id) ? motor_id->valueint : -1,
-                    cJSON_IsString(metadata) ? metadata->valuestring : "");
-                response = success ? R"({"success": true})" : R"({"error": "Update failed"})";
-            } else {
-                response = R"({"error": "Invalid parameters"})";
-            }
-        } else if (action_char == "list") {
-            cJSON *id = cJSON_GetObjectItem(root, "id");
-            if (cJSON_IsNumber(id)) {
-                const Filament *filament = filamentManager.getFilamentById(id->valueint);
-                if (filament) {
-                    cJSON *filament_json = cJSON_CreateObject();
-                    cJSON_AddNumberToObject(filament_json, "id", filament->id);
-                    cJSON_AddNumberToObject(filament_json, "motor_id", filament->motor_id);
-                    cJSON_AddStringToObject(filament_json, "metadata", filament->metadata);
-                    char *json_str = cJSON_Print(filament_json);
-                    response = json_str;
-                    cJSON_free(json_str);
-                    cJSON_Delete(filament_json);
-                } else {
-                    response = R"({"error": "ID not found"})";
-                }
-            } else {
-                response = R"({"error": "Invalid parameters"})";
-            }
-        } else {
-            response = R"({"error": "Unknown action"})";
-        }
-    } else {
-        response = R"({"error": "Unknown type"})";
-    }
+void WSServer::registerCommands() {
+    static const WSModule subscribe = {"subscribe", nullptr, nullptr, SUBSCRIBE_COMMANDS, 1};
+    static const WSModule unsubscribe = {"unsubscribe", nullptr, nullptr, UNSUBSCRIBE_COMMANDS, 1};
+    dispatcher.add(subscribe, this);
+    dispatcher.add(unsubscribe, this);
 
-    cJSON_Delete(root);
+    static WSFilamentModule filament_module = {
+        &filaments,
+        [](void *ctx) { static_cast<WSServer *>(ctx)->getPush().publishFilaments(); }, this};
+    ws_filament_register(dispatcher, filament_module);
 }
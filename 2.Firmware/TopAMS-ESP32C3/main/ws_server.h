@@ -4,14 +4,31 @@
 #include <esp_http_server.h>
 #include <esp_log.h>
 
+#include "ws_dispatch.h"
+#include "ws_frame.h"
+#include "ws_push.h"
+
+class FilamentManager;
+
 class WSServer {
 public:
-    WSServer();
+    /**
+     * @param filaments 耗材命令和推送使用的耗材表，与其他模块共用
+     */
+    explicit WSServer(FilamentManager &filaments);
     ~WSServer();
 
     esp_err_t start();
     esp_err_t stop();
     httpd_handle_t getHandle() const;
+    WSPush &getPush();
+    WSFramePool::Stats getFrameStats() const;
+    WSEncoding getEncoding(int fd) const;
+
+    /**
+     * @brief 命令分发器，各模块在服务启动前注册自己的命令
+     */
+    WSDispatcher &getDispatcher();
 
     // 事件处理
     void onConnect(esp_event_base_t event_base, int32_t event_id, void *event_data);
@@ -19,15 +36,15 @@ public:
 
 private:
     httpd_handle_t server;
+    FilamentManager &filaments;
+    WSPush push;
+    WSFramePool frames;
+    WSDispatcher dispatcher;
     static const char *TAG;
 
-    struct async_resp_arg {
-        httpd_handle_t hd;
-        int fd;
-    };
+    void registerCommands();
 
-    static void ws_async_send(void *arg);
-    static esp_err_t trigger_async_send(httpd_handle_t handle, httpd_req_t *req);
+    static void close_handler(httpd_handle_t hd, int sockfd);
     static esp_err_t echo_handler(httpd_req_t *req);
     static esp_err_t stop_webserver(httpd_handle_t server);
     static httpd_handle_t start_webserver();
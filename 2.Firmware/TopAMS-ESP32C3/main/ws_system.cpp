@@ -0,0 +1,122 @@
+#include "ws_system.h"
+#include "esp_mac.h"
+#include "instance.h"
+#include <esp_system.h>
+#include <stdio.h>
+
+template <typename Enc> static void handle_reboot(void *ctx, const WSArgs &args, Enc &response) {
+    response.beginMap().key(WS_KEY_success).boolean(true);
+    response.key(WS_KEY_message).str("Rebooting...").end();
+    // 关机回调也会写回，这里先写回以便失败时记录日志
+    Instance::get().persist_service->flush();
+    esp_restart();
+}
+
+template <typename Enc>
+static void handle_get_mac(void *ctx, const WSArgs &args, Enc &response) {
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    char mac_str[18];
+    snprintf(mac_str, sizeof(mac_str), "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2],
+             mac[3], mac[4], mac[5]);
+    response.beginMap().key(WS_KEY_success).boolean(true).key(WS_KEY_mac).str(mac_str).end();
+}
+
+template <typename Enc>
+static void handle_mqtt_stats(void *ctx, const WSArgs &args, Enc &response) {
+    BambuMQTT::IngestStats stats = Instance::get().bambu_mqtt->getIngestStats();
+    response.beginMap().key(WS_KEY_success).boolean(true);
+    response.key(WS_KEY_pushed).num(stats.pushed);
+    response.key(WS_KEY_dropped).num(stats.dropped);
+    response.key(WS_KEY_high_water).num(stats.high_water);
+    response.key(WS_KEY_capacity).num(stats.capacity).end();
+}
+
+template <typename Enc>
+static void handle_persist_stats(void *ctx, const WSArgs &args, Enc &response) {
+    PersistService::Stats stats = Instance::get().persist_service->stats();
+    response.beginMap().key(WS_KEY_success).boolean(true);
+    response.key(WS_KEY_requests).num(stats.requests);
+    response.key(WS_KEY_commits).num(stats.commits);
+    response.key(WS_KEY_commits_avoided).num(stats.commits_avoided);
+    response.key(WS_KEY_failures).num(stats.failures);
+    response.key(WS_KEY_bytes_written).num(static_cast<int64_t>(stats.bytes_written)).end();
+}
+
+template <typename Enc>
+static void handle_ws_stats(void *ctx, const WSArgs &args, Enc &response) {
+    WSFramePool::Stats stats = Instance::get().ws_server->getFrameStats();
+    response.beginMap().key(WS_KEY_success).boolean(true);
+    response.key(WS_KEY_frames).num(stats.frames);
+    response.key(WS_KEY_errors).num(stats.errors);
+    response.key(WS_KEY_exhausted).num(stats.exhausted);
+    response.key(WS_KEY_in_use).num(stats.in_use).end();
+}
+
+template <typename Enc>
+static void write_phase(Enc &response, const char *name,
+                        const FilamentChanger::PhaseStats &phase) {
+    response.key(name).beginMap().key(WS_KEY_count).num(phase.count);
+    response.key(WS_KEY_last_ms).num(phase.last_ms);
+    response.key(WS_KEY_min_ms).num(phase.min_ms);
+    response.key(WS_KEY_max_ms).num(phase.max_ms);
+    // 平均值保留一位小数
+    float avg = phase.count ? (float)phase.total_ms / phase.count : 0;
+    response.key(WS_KEY_avg_ms).decimal(avg).end();
+}
+
+template <typename Enc>
+static void handle_changer_stats(void *ctx, const WSArgs &args, Enc &response) {
+    const FilamentChanger &changer = *Instance::get().filament_changer;
+    const FilamentChanger::Stats &stats = changer.stats();
+    response.beginMap().key(WS_KEY_success).boolean(true);
+    response.key(WS_KEY_phase).str(FilamentChanger::phaseName(changer.phase()));
+    response.key(WS_KEY_completed).num(stats.completed);
+    response.key(WS_KEY_aborted).num(stats.aborted);
+    for (int i = FILAMENT_PHASE_RETRACT; i < FILAMENT_PHASE_COUNT; i++) {
+        write_phase(response, FilamentChanger::phaseName((FilamentChangePhase)i), stats.phases[i]);
+    }
+    write_phase(response, "total", stats.total);
+    response.end();
+}
+
+// 自启动起的毫秒数，尚未到达时为 null
+template <typename Enc> static void write_ms(Enc &response, WSKey key, int64_t us) {
+    response.key(key);
+    if (us == 0) {
+        response.null();
+    } else {
+        response.num(us / 1000);
+    }
+}
+
+template <typename Enc>
+static void handle_boot_stats(void *ctx, const WSArgs &args, Enc &response) {
+    Instance &instance = Instance::get();
+    WifiManager::BootStats boot = instance.wifi_manager->bootStats();
+    response.beginMap().key(WS_KEY_success).boolean(true);
+    response.key(WS_KEY_reset_reason).num(esp_reset_reason());
+    response.key(WS_KEY_fast).boolean(boot.fast);
+    response.key(WS_KEY_static_ip).boolean(boot.static_ip);
+    response.key(WS_KEY_fallbacks).num(boot.fallbacks);
+    write_ms(response, WS_KEY_connect_ms, boot.connect_us);
+    write_ms(response, WS_KEY_ip_ms, boot.ip_us);
+    write_ms(response, WS_KEY_mqtt_ms, instance.bambu_mqtt->firstConnectedUs());
+    response.end();
+}
+
+static const WSCommand SYSTEM_COMMANDS[] = {
+    {"reboot", WS_HANDLER(handle_reboot), nullptr, 0},
+    {"get_mac", WS_HANDLER(handle_get_mac), nullptr, 0},
+    {"mqtt_stats", WS_HANDLER(handle_mqtt_stats), nullptr, 0},
+    {"persist_stats", WS_HANDLER(handle_persist_stats), nullptr, 0},
+    {"ws_stats", WS_HANDLER(handle_ws_stats), nullptr, 0},
+    {"changer_stats", WS_HANDLER(handle_changer_stats), nullptr, 0},
+    {"boot_stats", WS_HANDLER(handle_boot_stats), nullptr, 0},
+};
+
+bool ws_system_register(WSDispatcher &dispatcher) {
+    static const WSModule commands = {"system", "action", nullptr, SYSTEM_COMMANDS,
+                                      sizeof(SYSTEM_COMMANDS) / sizeof(SYSTEM_COMMANDS[0])};
+    return dispatcher.add(commands, nullptr);
+}
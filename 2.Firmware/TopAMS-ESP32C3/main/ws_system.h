@@ -0,0 +1,16 @@
+#pragma once
+
+#include "ws_dispatch.h"
+
+/**
+ * @brief 注册 {"type": "system", "action": ...} 命令
+ *
+ * action:
+ *   reboot                       写回未保存的修改后重启
+ *   get_mac                      Wi-Fi STA 的 MAC 地址
+ *   mqtt_stats / persist_stats   MQTT 接收环形缓冲区 / 持久化服务的统计
+ *   ws_stats / changer_stats     WebSocket 帧缓冲区 / 换料各阶段耗时的统计
+ *   boot_stats                   复位原因，启动到关联 AP、取得 IP、连接打印机的耗时
+ * reconnect_wifi 由 WifiManager 注册
+ */
+bool ws_system_register(WSDispatcher &dispatcher);
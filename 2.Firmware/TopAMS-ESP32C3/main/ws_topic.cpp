@@ -0,0 +1,127 @@
+#include "ws_topic.h"
+#include "filament_changer.h"
+#include "filament_manager.h"
+#include "ws_cbor.h"
+#include "ws_json.h"
+
+template <typename Enc>
+void ws_write_status(Enc &w, const BambuStatus &s, size_t session, uint32_t fields,
+                     uint16_t trays) {
+    w.beginMap().key(WS_KEY_topic).str("status").key(WS_KEY_session).num(session);
+    if (fields & BAMBU_FIELD_NOZZLE_TEMPER) {
+        w.key(WS_KEY_nozzle_temper).decimal(s.nozzle_temper);
+    }
+    if (fields & BAMBU_FIELD_NOZZLE_TARGET) {
+        w.key(WS_KEY_nozzle_target_temper).decimal(s.nozzle_target_temper);
+    }
+    if (fields & BAMBU_FIELD_BED_TEMPER) {
+        w.key(WS_KEY_bed_temper).decimal(s.bed_temper);
+    }
+    if (fields & BAMBU_FIELD_BED_TARGET) {
+        w.key(WS_KEY_bed_target_temper).decimal(s.bed_target_temper);
+    }
+    if (fields & BAMBU_FIELD_WIFI_SIGNAL) {
+        w.key(WS_KEY_wifi_signal).str(s.wifi_signal);
+    }
+    if (fields & BAMBU_FIELD_GCODE_STATE) {
+        w.key(WS_KEY_gcode_state).str(s.gcode_state);
+    }
+    if (fields & BAMBU_FIELD_PRINT_STAGE) {
+        w.key(WS_KEY_mc_print_stage).num(s.mc_print_stage);
+    }
+    if (fields & BAMBU_FIELD_STG_CUR) {
+        w.key(WS_KEY_stg_cur).num(s.stg_cur);
+    }
+    if (fields & BAMBU_FIELD_PERCENT) {
+        w.key(WS_KEY_mc_percent).num(s.mc_percent);
+    }
+    if (fields & BAMBU_FIELD_REMAINING_TIME) {
+        w.key(WS_KEY_mc_remaining_time).num(s.mc_remaining_time);
+    }
+    if (fields & BAMBU_FIELD_LAYER) {
+        w.key(WS_KEY_layer_num).num(s.layer_num);
+        w.key(WS_KEY_total_layer_num).num(s.total_layer_num);
+    }
+    if (fields & BAMBU_FIELD_PRINT_ERROR) {
+        w.key(WS_KEY_print_error).num(s.print_error);
+    }
+    if (fields & BAMBU_FIELD_FANS) {
+        w.key(WS_KEY_cooling_fan_speed).num(s.cooling_fan_speed);
+        w.key(WS_KEY_big_fan1_speed).num(s.big_fan1_speed);
+        w.key(WS_KEY_big_fan2_speed).num(s.big_fan2_speed);
+        w.key(WS_KEY_heatbreak_fan_speed).num(s.heatbreak_fan_speed);
+    }
+    if (fields & BAMBU_FIELD_AMS_STATUS) {
+        w.key(WS_KEY_ams_status).num(s.ams_status);
+    }
+    if (fields & BAMBU_FIELD_TRAY_NOW) {
+        w.key(WS_KEY_tray_now).num(s.tray_now);
+    }
+    if (fields & BAMBU_FIELD_TRAY_TAR) {
+        w.key(WS_KEY_tray_tar).num(s.tray_tar);
+    }
+    if (fields & BAMBU_FIELD_TRAY_PRE) {
+        w.key(WS_KEY_tray_pre).num(s.tray_pre);
+    }
+    if (fields & BAMBU_FIELD_AMS_UNIT) {
+        w.key(WS_KEY_ams).beginArray();
+        for (int i = 0; i < s.ams_count && i < BAMBU_MAX_AMS; i++) {
+            w.beginMap().key(WS_KEY_id).num(i);
+            w.key(WS_KEY_temp).decimal(s.ams[i].temp);
+            w.key(WS_KEY_humidity).num(s.ams[i].humidity).end();
+        }
+        w.end();
+    }
+    if ((fields & BAMBU_FIELD_AMS_TRAY) && trays) {
+        w.key(WS_KEY_trays).beginArray();
+        for (int i = 0; i < BAMBU_MAX_AMS * BAMBU_TRAYS_PER_AMS; i++) {
+            if (!(trays & (1u << i))) {
+                continue;
+            }
+            const BambuTray &tray = s.ams[i / BAMBU_TRAYS_PER_AMS].trays[i % BAMBU_TRAYS_PER_AMS];
+            w.beginMap().key(WS_KEY_id).num(i).key(WS_KEY_type).str(tray.type);
+            w.key(WS_KEY_color).str(tray.color).key(WS_KEY_remain).num(tray.remain);
+            w.key(WS_KEY_nozzle_temp_min).num(tray.nozzle_temp_min);
+            w.key(WS_KEY_nozzle_temp_max).num(tray.nozzle_temp_max).end();
+        }
+        w.end();
+    }
+    if (fields & BAMBU_FIELD_HMS) {
+        w.key(WS_KEY_hms).beginArray();
+        for (int i = 0; i < s.hms_count && i < BAMBU_MAX_HMS; i++) {
+            w.beginMap().key(WS_KEY_attr).num(s.hms[i].attr);
+            w.key(WS_KEY_code).num(s.hms[i].code).end();
+        }
+        w.end();
+    }
+    w.end();
+}
+
+template <typename Enc> void ws_write_filaments(Enc &w, const FilamentManager *filaments) {
+    w.beginMap().key(WS_KEY_topic).str("filaments").key(WS_KEY_filaments).beginArray();
+    if (filaments) {
+        filaments->forEach([&](const Filament &filament) {
+            w.beginMap().key(WS_KEY_id).num(filament.id);
+            w.key(WS_KEY_motor_id).num(filament.motor_id);
+            w.key(WS_KEY_metadata).str(filament.metadata).end();
+        });
+    }
+    w.end().end();
+}
+
+template <typename Enc> void ws_write_motors(Enc &w, const WSMotorState &state) {
+    w.beginMap().key(WS_KEY_topic).str("motors");
+    w.key(WS_KEY_phase).str(
+        FilamentChanger::phaseName(static_cast<FilamentChangePhase>(state.phase)));
+    w.key(WS_KEY_from).num(state.from_motor).key(WS_KEY_to).num(state.to_motor);
+    w.key(WS_KEY_completed).num(state.completed);
+    w.key(WS_KEY_aborted).num(state.aborted);
+    w.key(WS_KEY_session).num(state.session).end();
+}
+
+template void ws_write_status(WSJsonWriter &, const BambuStatus &, size_t, uint32_t, uint16_t);
+template void ws_write_status(CborWriter &, const BambuStatus &, size_t, uint32_t, uint16_t);
+template void ws_write_filaments(WSJsonWriter &, const FilamentManager *);
+template void ws_write_filaments(CborWriter &, const FilamentManager *);
+template void ws_write_motors(WSJsonWriter &, const WSMotorState &);
+template void ws_write_motors(CborWriter &, const WSMotorState &);
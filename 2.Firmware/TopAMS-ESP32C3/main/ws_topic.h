@@ -0,0 +1,29 @@
+#pragma once
+
+#include "model/bambu_status.h"
+#include <stddef.h>
+#include <stdint.h>
+
+class FilamentManager;
+
+// motors 主题的内容
+struct WSMotorState {
+    uint8_t phase; // FilamentChangePhase
+    int8_t from_motor;
+    int8_t to_motor;
+    uint32_t completed;
+    uint32_t aborted;
+    int8_t session; // 占用电机 (或刚结束换料) 的打印机会话，-1 为尚未换料
+};
+
+/**
+ * @brief 推送帧的编码，Enc 为 WSJsonWriter 或 CborWriter，两种编码的字段完全相同
+ *
+ * status 只写入 session (打印机会话编号)、fields (BambuStatusField) 和 trays 中标记的字段；
+ * filaments 为 nullptr 时写入空表。
+ */
+template <typename Enc>
+void ws_write_status(Enc &w, const BambuStatus &s, size_t session, uint32_t fields,
+                     uint16_t trays);
+template <typename Enc> void ws_write_filaments(Enc &w, const FilamentManager *filaments);
+template <typename Enc> void ws_write_motors(Enc &w, const WSMotorState &state);
@@ -0,0 +1,355 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+模拟 Bambu 打印机的本地 MQTT 服务，用于在没有硬件的情况下运行 host/ 下的主机构建
+
+- 内置最小 MQTT 3.1.1 服务端 (明文 TCP，不依赖第三方库)
+- 客户端订阅 device/<serial>/report 后，按指定速率回放录制的上报
+  录制文件为 mqtt_test.py 保存的 JSONL (每行 {"timestamp", "topic", "payload"})，
+  或每行一条原始 JSON 负载
+- 收到 device/<serial>/request 上的命令后，按 sequence_id 在 report 主题上回复
+- --ssdp 时按打印机的格式定期向 UDP 2021 发送 SSDP NOTIFY，用于验证固件的打印机发现
+- --printers N 时在 --host 起连续的 N 个地址上各模拟一台打印机 (如 127.0.0.1-127.0.0.4)，
+  第 i 台的序列号为 SIM 加 13 位的 i + 1，用于验证固件同时连接多台打印机
+
+用法:
+    python3 printer_sim.py --rate 20 --loop
+"""
+
+import argparse
+import asyncio
+import copy
+import ipaddress
+import json
+import logging
+import os
+import random
+import socket
+import struct
+import time
+from datetime import datetime
+from typing import List, Optional, Tuple
+
+MQTT_CONNECT = 0x10
+MQTT_CONNACK = 0x20
+MQTT_PUBLISH = 0x30
+MQTT_PUBACK = 0x40
+MQTT_SUBSCRIBE = 0x80
+MQTT_SUBACK = 0x90
+MQTT_PINGREQ = 0xC0
+MQTT_PINGRESP = 0xD0
+MQTT_DISCONNECT = 0xE0
+
+# 命令所在的对象，与 ReportParser 的回复表一致
+COMMAND_GROUPS = ("print", "system", "info", "pushing")
+
+SSDP_PORT = 2021
+# 未指定 --serial 时广播的序列号，与 topams_host 的默认值一致
+SSDP_DEFAULT_SERIAL = "SIM0000000000001"
+
+logger = logging.getLogger("PrinterSim")
+
+
+def load_records(path: str) -> List[Tuple[Optional[float], str]]:
+    """读取录制文件，返回 [(时间戳秒或 None, 负载)]"""
+    records = []
+    with open(path, "r", encoding="utf-8") as f:
+        for line in f:
+            line = line.strip()
+            if not line:
+                continue
+            data = json.loads(line)
+            if isinstance(data, dict) and "payload" in data and "topic" in data:
+                if not data["topic"].endswith("/report"):
+                    continue
+                ts = None
+                if data.get("timestamp"):
+                    ts = datetime.fromisoformat(data["timestamp"]).timestamp()
+                payload = data["payload"]
+                if not isinstance(payload, str):
+                    payload = json.dumps(payload, separators=(",", ":"))
+                records.append((ts, payload))
+            else:
+                records.append((None, line))
+    return records
+
+
+def encode_packet(packet_type: int, body: bytes) -> bytes:
+    header = bytearray([packet_type])
+    length = len(body)
+    while True:
+        byte = length % 128
+        length //= 128
+        header.append(byte | 0x80 if length > 0 else byte)
+        if length == 0:
+            break
+    return bytes(header) + body
+
+
+def encode_str(value: str) -> bytes:
+    data = value.encode("utf-8")
+    return struct.pack("!H", len(data)) + data
+
+
+async def read_packet(reader: asyncio.StreamReader) -> Tuple[int, bytes]:
+    packet_type = (await reader.readexactly(1))[0]
+    length = 0
+    for shift in range(0, 28, 7):
+        byte = (await reader.readexactly(1))[0]
+        length |= (byte & 0x7F) << shift
+        if byte & 0x80 == 0:
+            break
+    body = await reader.readexactly(length) if length else b""
+    return packet_type, body
+
+
+class PrinterSession:
+    """一个客户端连接"""
+
+    def __init__(self, sim: "PrinterSim", reader, writer):
+        self.sim = sim
+        self.reader = reader
+        self.writer = writer
+        self.report_topic: Optional[str] = None
+        self.replay_task: Optional[asyncio.Task] = None
+        self.published = 0
+
+    def send(self, packet_type: int, body: bytes):
+        self.writer.write(encode_packet(packet_type, body))
+
+    def publish(self, topic: str, payload: str):
+        self.send(MQTT_PUBLISH, encode_str(topic) + payload.encode("utf-8"))
+        self.published += 1
+
+    async def run(self):
+        peer = self.writer.get_extra_info("peername")
+        try:
+            packet_type, body = await read_packet(self.reader)
+            if packet_type != MQTT_CONNECT or not self.check_connect(body):
+                self.send(MQTT_CONNACK, bytes([0, 5]))  # not authorized
+                await self.writer.drain()
+                return
+            self.send(MQTT_CONNACK, bytes([0, 0]))
+            logger.info(f"Client connected: {peer}")
+
+            while True:
+                packet_type, body = await read_packet(self.reader)
+                kind = packet_type & 0xF0
+                if kind == MQTT_SUBSCRIBE:
+                    self.handle_subscribe(body)
+                elif kind == MQTT_PUBLISH:
+                    self.handle_publish(packet_type, body)
+                elif kind == MQTT_PINGREQ:
+                    self.send(MQTT_PINGRESP, b"")
+                elif kind == MQTT_DISCONNECT:
+                    break
+                await self.writer.drain()
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        finally:
+            if self.replay_task:
+                self.replay_task.cancel()
+            self.writer.close()
+            logger.info(f"Client disconnected: {peer}, published {self.published} reports")
+
+    def check_connect(self, body: bytes) -> bool:
+        pos = 2 + struct.unpack("!H", body[0:2])[0] + 1
+        flags = body[pos]
+        pos += 3  # flags + keepalive
+        fields = []
+        while pos < len(body):
+            length = struct.unpack("!H", body[pos:pos + 2])[0]
+            fields.append(body[pos + 2:pos + 2 + length].decode("utf-8"))
+            pos += 2 + length
+        password = fields[2] if flags & 0x40 and len(fields) >= 3 else None
+        if self.sim.args.password and password != self.sim.args.password:
+            logger.warning("Rejected client with wrong password")
+            return False
+        return True
+
+    def handle_subscribe(self, body: bytes):
+        packet_id = body[0:2]
+        pos = 2
+        granted = bytearray()
+        while pos < len(body):
+            length = struct.unpack("!H", body[pos:pos + 2])[0]
+            topic = body[pos + 2:pos + 2 + length].decode("utf-8")
+            qos = body[pos + 2 + length]
+            pos += 3 + length
+            granted.append(min(qos, 1))
+            logger.info(f"Subscribed: {topic}")
+            if topic.endswith("/report") and self.sim.accepts(topic):
+                self.report_topic = topic
+        self.send(MQTT_SUBACK, packet_id + bytes(granted))
+        if self.report_topic and not self.replay_task:
+            self.replay_task = asyncio.create_task(self.replay())
+
+    def handle_publish(self, packet_type: int, body: bytes):
+        qos = (packet_type >> 1) & 0x03
+        length = struct.unpack("!H", body[0:2])[0]
+        topic = body[2:2 + length].decode("utf-8")
+        pos = 2 + length
+        if qos > 0:
+            self.send(MQTT_PUBACK, body[pos:pos + 2])
+            pos += 2
+        payload = body[pos:].decode("utf-8", errors="replace")
+        logger.info(f"Request on {topic}: {payload}")
+        if topic.endswith("/request") and self.report_topic:
+            asyncio.create_task(self.reply(payload))
+
+    async def reply(self, payload: str):
+        try:
+            request = json.loads(payload)
+        except json.JSONDecodeError:
+            logger.warning("Request is not valid JSON")
+            return
+        args = self.sim.args
+        for group in COMMAND_GROUPS:
+            cmd = request.get(group)
+            if not isinstance(cmd, dict) or "sequence_id" not in cmd:
+                continue
+            if random.random() < args.drop_rate:
+                logger.info(f"Dropping reply for sequence_id={cmd['sequence_id']}")
+                continue
+            await asyncio.sleep(args.reply_delay / 1000.0)
+            result = "failed" if random.random() < args.fail_rate else "success"
+            response = {group: {"command": cmd.get("command", ""),
+                                "sequence_id": str(cmd["sequence_id"]),
+                                "result": result}}
+            self.publish(self.report_topic, json.dumps(response, separators=(",", ":")))
+            if cmd.get("command") == "pushall" and self.sim.full_status:
+                self.publish(self.report_topic, self.sim.full_status)
+            await self.writer.drain()
+
+    async def replay(self):
+        records = self.sim.records
+        args = self.sim.args
+        while True:
+            prev_ts = None
+            start = time.monotonic()
+            for index, (ts, payload) in enumerate(records):
+                if args.rate > 0:
+                    delay = start + index / args.rate - time.monotonic()
+                elif ts is not None and prev_ts is not None:
+                    delay = (ts - prev_ts) / args.speed
+                else:
+                    delay = 0 if prev_ts is None else 1.0
+                prev_ts = ts
+                if delay > 0:
+                    await asyncio.sleep(delay)
+                self.publish(self.report_topic, payload)
+                await self.writer.drain()
+            if not args.loop:
+                logger.info("Replay finished")
+                return
+
+
+class PrinterSim:
+    def __init__(self, args):
+        self.args = args
+        self.records = load_records(args.replay)
+        # pushall 时回复第一条完整的 push_status
+        self.full_status = next((p for _, p in self.records if '"push_status"' in p), None)
+        logger.info(f"Loaded {len(self.records)} reports from {args.replay}")
+
+    def accepts(self, topic: str) -> bool:
+        return not self.args.serial or topic == f"device/{self.args.serial}/report"
+
+    async def handle(self, reader, writer):
+        await PrinterSession(self, reader, writer).run()
+
+    def ssdp_notify(self) -> bytes:
+        args = self.args
+        lines = [
+            "NOTIFY * HTTP/1.1",
+            f"HOST: 239.255.255.250:{SSDP_PORT}",
+            "Server: Buildroot/2018.02-rc3 UPnP/1.0 ssdpd/1.8",
+            f"Location: {args.host}",
+            "NT: urn:bambulab-com:device:3dprinter:1",
+            f"USN: {args.serial or SSDP_DEFAULT_SERIAL}",
+            "Cache-Control: max-age=1800",
+            f"DevModel.bambu.com: {args.model}",
+            f"DevName.bambu.com: {args.name}",
+            "DevSignal.bambu.com: -44",
+            "DevConnect.bambu.com: lan",
+            "DevBind.bambu.com: free",
+        ]
+        return ("\r\n".join(lines) + "\r\n\r\n").encode("utf-8")
+
+    async def announce(self):
+        """按打印机的格式定期发送 SSDP NOTIFY"""
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+        packet = self.ssdp_notify()
+        logger.info(f"Announcing on {self.args.ssdp}:{SSDP_PORT}")
+        while True:
+            try:
+                sock.sendto(packet, (self.args.ssdp, SSDP_PORT))
+            except OSError as e:
+                logger.warning(f"SSDP send failed: {e}")
+            await asyncio.sleep(self.args.ssdp_interval)
+
+    async def serve(self):
+        server = await asyncio.start_server(self.handle, self.args.host, self.args.port)
+        logger.info(f"Printer simulator listening on {self.args.host}:{self.args.port}")
+        if self.args.ssdp:
+            asyncio.create_task(self.announce())
+        async with server:
+            await server.serve_forever()
+
+
+def fleet(args) -> List[argparse.Namespace]:
+    """--printers N 时每台打印机的参数：地址依次加 1，序列号和名称按编号区分"""
+    if args.printers <= 1:
+        return [args]
+    base = ipaddress.IPv4Address(args.host)
+    printers = []
+    for i in range(args.printers):
+        printer = copy.copy(args)
+        printer.host = str(base + i)
+        printer.serial = f"SIM{i + 1:013d}"
+        printer.name = f"{args.name}-{i + 1}"
+        printers.append(printer)
+    return printers
+
+
+async def serve_all(printers: List[argparse.Namespace]):
+    await asyncio.gather(*(PrinterSim(printer).serve() for printer in printers))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Bambu 打印机 MQTT 模拟器")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8883)
+    parser.add_argument("--serial", default="", help="只接受该序列号的订阅，默认接受任意序列号")
+    parser.add_argument("--password", default="", help="校验访问码，默认不校验")
+    parser.add_argument("--replay", help="录制的上报文件，默认 sim_data/sample_reports.jsonl",
+                        default=os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                             "sim_data", "sample_reports.jsonl"))
+    parser.add_argument("--rate", type=float, default=0,
+                        help="每秒回放条数，0 表示按录制时间戳回放")
+    parser.add_argument("--speed", type=float, default=1.0, help="按时间戳回放时的倍速")
+    parser.add_argument("--loop", action="store_true", help="循环回放")
+    parser.add_argument("--reply-delay", type=float, default=50, help="命令回复延迟 (ms)")
+    parser.add_argument("--fail-rate", type=float, default=0, help="命令回复 failed 的概率")
+    parser.add_argument("--drop-rate", type=float, default=0, help="不回复命令的概率")
+    parser.add_argument("--ssdp", metavar="ADDR",
+                        help="向 ADDR:2021 发送 SSDP NOTIFY，如 255.255.255.255 或 127.0.0.1")
+    parser.add_argument("--ssdp-interval", type=float, default=5, help="NOTIFY 间隔 (秒)")
+    parser.add_argument("--model", default="N2S", help="NOTIFY 中的型号 (N2S 为 A1)")
+    parser.add_argument("--name", default="TopAMS-Sim", help="NOTIFY 中的打印机名称")
+    parser.add_argument("--printers", type=int, default=1,
+                        help="模拟的打印机数，从 --host 起每台占用一个地址，忽略 --serial")
+    parser.add_argument("-v", "--verbose", action="store_true")
+    args = parser.parse_args()
+
+    logging.basicConfig(level=logging.INFO if args.verbose else logging.WARNING,
+                        format="%(asctime)s %(name)s: %(message)s")
+    try:
+        asyncio.run(serve_all(fleet(args)))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -1,8 +1,15 @@
+import argparse
 import websocket
 import json
 
-def interactive_ws_api():
-    ws = websocket.create_connection("ws://192.168.1.86:80/ws")
+import ws_schema
+
+def interactive_ws_api(host, cbor):
+    # --cbor 时以二进制子协议连接，请求和响应的内容不变
+    if cbor:
+        ws = websocket.create_connection(f"ws://{host}/ws", subprotocols=[ws_schema.PROTOCOL])
+    else:
+        ws = websocket.create_connection(f"ws://{host}/ws")
 
     try:
         while True:
@@ -56,8 +63,12 @@ def interactive_ws_api():
                 print("Invalid choice. Please try again.")
                 continue
 
-            ws.send(json.dumps(request))
-            response = ws.recv()
+            if cbor:
+                ws.send(ws_schema.encode(request), opcode=websocket.ABNF.OPCODE_BINARY)
+                response = json.dumps(ws_schema.decode(ws.recv()), ensure_ascii=False)
+            else:
+                ws.send(json.dumps(request))
+                response = ws.recv()
             print("Response:", response)
 
     except Exception as e:
@@ -66,4 +77,9 @@ def interactive_ws_api():
         ws.close()
 
 if __name__ == "__main__":
-    interactive_ws_api()
\ No newline at end of file
+    parser = argparse.ArgumentParser(description="耗材 WebSocket API 交互测试")
+    parser.add_argument("--host", default="192.168.1.86:80")
+    parser.add_argument("--cbor", action="store_true",
+                        help=f"使用二进制协议 ({ws_schema.PROTOCOL})")
+    args = parser.parse_args()
+    interactive_ws_api(args.host, args.cbor)
\ No newline at end of file
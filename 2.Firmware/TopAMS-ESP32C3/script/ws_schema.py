@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+WebSocket 二进制协议 (子协议 topams.cbor.v1) 的编解码，键表直接读取固件的 main/ws_schema.def
+
+- 对象的键在键表中时编码为整数编号，否则为文本；解码时整数键还原为名称
+- 只依赖标准库，覆盖固件使用的 CBOR 子集: 整数、浮点数、文本、数组、对象、布尔值和 null
+
+用法:
+    import ws_schema
+    ws.send(ws_schema.encode({"type": "filament", "action": "list", "id": 1}),
+            opcode=websocket.ABNF.OPCODE_BINARY)
+    print(ws_schema.decode(ws.recv()))
+
+    python3 ws_schema.py              # 打印键表
+"""
+
+import os
+import re
+import struct
+from typing import Any, Dict, Tuple
+
+PROTOCOL = "topams.cbor.v1"
+
+SCHEMA_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "main",
+                           "ws_schema.def")
+
+
+def load_keys(path: str = SCHEMA_PATH) -> Dict[str, int]:
+    """读取 WS_KEY(编号, 名称) 行，返回 名称 -> 编号"""
+    keys = {}
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            match = re.match(r"\s*WS_KEY\(\s*(\d+)\s*,\s*(\w+)\s*\)", line)
+            if match:
+                keys[match.group(2)] = int(match.group(1))
+    return keys
+
+
+KEYS = load_keys()
+NAMES = {key_id: name for name, key_id in KEYS.items()}
+
+
+def _head(major: int, arg: int) -> bytes:
+    if arg < 24:
+        return bytes([major << 5 | arg])
+    for info, fmt in ((24, ">B"), (25, ">H"), (26, ">I"), (27, ">Q")):
+        if arg < 1 << (8 * struct.calcsize(fmt)):
+            return bytes([major << 5 | info]) + struct.pack(fmt, arg)
+    raise ValueError("integer too large")
+
+
+def _encode(value: Any, out: bytearray) -> None:
+    if value is None:
+        out.append(0xF6)
+    elif isinstance(value, bool):
+        out.append(0xF5 if value else 0xF4)
+    elif isinstance(value, int):
+        out += _head(0, value) if value >= 0 else _head(1, -1 - value)
+    elif isinstance(value, float):
+        out += b"\xfa" + struct.pack(">f", value)
+    elif isinstance(value, str):
+        data = value.encode("utf-8")
+        out += _head(3, len(data)) + data
+    elif isinstance(value, (list, tuple)):
+        out += _head(4, len(value))
+        for item in value:
+            _encode(item, out)
+    elif isinstance(value, dict):
+        out += _head(5, len(value))
+        for key, item in value.items():
+            _encode(KEYS.get(key, key), out)
+            _encode(item, out)
+    else:
+        raise TypeError(f"cannot encode {type(value).__name__}")
+
+
+def encode(value: Any) -> bytes:
+    out = bytearray()
+    _encode(value, out)
+    return bytes(out)
+
+
+def _decode(data: bytes, pos: int) -> Tuple[Any, int]:
+    initial = data[pos]
+    pos += 1
+    major, info = initial >> 5, initial & 0x1F
+    arg = info
+    if 24 <= info <= 27:
+        size = 1 << (info - 24)
+        arg = int.from_bytes(data[pos:pos + size], "big")
+        if major == 7:
+            fmt = {2: ">e", 4: ">f", 8: ">d"}.get(size)
+            if fmt is None:
+                raise ValueError("invalid simple value")
+            return struct.unpack(fmt, data[pos:pos + size])[0], pos + size
+        pos += size
+    elif info == 31:
+        arg = None
+    elif info > 27:
+        raise ValueError("invalid additional info")
+
+    if major == 0:
+        return arg, pos
+    if major == 1:
+        return -1 - arg, pos
+    if major in (2, 3):
+        raw = data[pos:pos + arg]
+        return (raw.decode("utf-8") if major == 3 else bytes(raw)), pos + arg
+    if major in (4, 5):
+        items = [] if major == 4 else {}
+        count = 0
+        while arg is None or count < arg:
+            if arg is None and data[pos] == 0xFF:
+                pos += 1
+                break
+            if major == 4:
+                item, pos = _decode(data, pos)
+                items.append(item)
+            else:
+                key, pos = _decode(data, pos)
+                item, pos = _decode(data, pos)
+                items[NAMES.get(key, key) if isinstance(key, int) else key] = item
+            count += 1
+        return items, pos
+    if major == 6:
+        return _decode(data, pos)
+    simple = {20: False, 21: True, 22: None, 23: None}
+    if info in simple:
+        return simple[info], pos
+    raise ValueError("invalid simple value")
+
+
+def decode(data: bytes) -> Any:
+    value, pos = _decode(bytes(data), 0)
+    if pos != len(data):
+        raise ValueError("trailing data")
+    return value
+
+
+if __name__ == "__main__":
+    for name, key_id in sorted(KEYS.items(), key=lambda item: item[1]):
+        print(f"{key_id:3d} {name}")